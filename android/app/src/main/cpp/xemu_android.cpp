@@ -665,7 +665,7 @@ static bool WriteConfigToml(const std::string& config_path,
     audio->insert_or_assign("volume_limit", 1.0);
   }
   if (!android->contains("force_cpu_blit")) {
-    android->insert_or_assign("force_cpu_blit", false);
+    android->insert_or_assign("force_cpu_blit", true);
   }
   if (!android->contains("tcg_tuning")) {
     android->insert_or_assign("tcg_tuning", true);
@@ -958,7 +958,6 @@ extern "C" int SDL_main(int argc, char* argv[]) {
     } else if (!g_config.sys.files.eeprom_path) {
       xemu_settings_set_string(&g_config.sys.files.eeprom_path, "");
     }
-    setenv("XEMU_ANDROID_FORCE_CPU_BLIT", "0", 1);
     g_config.general.show_welcome = false;
     g_config.perf.cache_shaders = true;
     LogInfoInt("Config final show_welcome=%d", g_config.general.show_welcome ? 1 : 0);
@@ -70,6 +70,11 @@ static void xemu_settings_apply_defaults(void)
     g_config.display.renderer = CONFIG_DISPLAY_RENDERER_VULKAN;
     g_config.display.filtering = CONFIG_DISPLAY_FILTERING_NEAREST;
     g_config.display.quality.surface_scale = 1;
+    g_config.display.quality.upscale_factor = 2;
+    g_config.display.quality.sharpness = 0.5f;
+    g_config.display.quality.dynamic_scale.min_scale = 1;
+    g_config.display.quality.dynamic_scale.max_scale = 2;
+    g_config.display.quality.dynamic_scale.target_frame_time = 16.0f;
     g_config.display.window.fullscreen_on_startup = false;
     g_config.display.window.fullscreen_exclusive = false;
     g_config.display.window.startup_size =
@@ -102,6 +107,8 @@ static void xemu_settings_apply_defaults(void)
 
     g_config.perf.hard_fpu = true;
     g_config.perf.cache_shaders = true;
+    g_config.perf.async_shader_compile = false;
+    g_config.perf.yield_on_gpu_wait = true;
 }
 
 // Optimized parsers - avoid string allocations
@@ -151,6 +158,38 @@ static std::string to_lower_ascii(std::string value)
     return value;
 }
 
+// Match a config_spec.yml enum value by name, case-insensitively
+static bool parse_enum(const std::string &value, const char *const *names,
+                       int count, int *out)
+{
+    std::string normalized = to_lower_ascii(value);
+    for (int i = 0; i < count; i++) {
+        if (normalized == names[i]) {
+            *out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T, size_t N>
+static void load_enum(toml::node_view<toml::node> node,
+                      const char *const (&names)[N], T *out)
+{
+    auto value = node.value<std::string>();
+    int parsed;
+    if (value && parse_enum(*value, names, (int)N, &parsed)) {
+        *out = (T)parsed;
+    }
+}
+
+static void load_bool(toml::node_view<toml::node> node, bool *out)
+{
+    if (auto value = node.value<bool>()) {
+        *out = *value;
+    }
+}
+
 const char *xemu_settings_get_error_message(void)
 {
     return error_msg.empty() ? NULL : error_msg.c_str();
@@ -209,7 +248,7 @@ bool xemu_settings_load(void)
 
     xemu_settings_apply_defaults();
     error_msg.clear();
-    setenv("XEMU_ANDROID_FORCE_CPU_BLIT", "0", 1);
+    setenv("XEMU_ANDROID_FORCE_CPU_BLIT", "1", 1);
     setenv("XEMU_ANDROID_TCG_TUNING", "1", 1);
     setenv("XEMU_ANDROID_TCG_THREAD", "multi", 1);
     setenv("XEMU_ANDROID_TCG_TB_SIZE", "128", 1);
@@ -261,6 +300,62 @@ bool xemu_settings_load(void)
             g_config.display.quality.surface_scale = scale;
         }
 
+        static const char *const upscaler_names[] = {
+            "off", "sharpen", "edge_adaptive",
+        };
+        load_enum(display_quality["upscaler"], upscaler_names,
+                  &g_config.display.quality.upscaler);
+        if (auto factor = display_quality["upscale_factor"].value<int64_t>()) {
+            g_config.display.quality.upscale_factor = (int)*factor;
+        }
+        if (auto sharpness = display_quality["sharpness"].value<double>()) {
+            g_config.display.quality.sharpness = (float)*sharpness;
+        }
+        if (auto overrides = display_quality["title_overrides"].as_array()) {
+            static const char *const override_upscaler_names[] = {
+                "global", "off", "sharpen", "edge_adaptive",
+            };
+            g_config.display.quality.title_overrides =
+                (struct title_override *)calloc(
+                    overrides->size(),
+                    sizeof(*g_config.display.quality.title_overrides));
+            unsigned int count = 0;
+            for (auto &node : *overrides) {
+                auto entry = node.as_table();
+                auto title_id = entry ? (*entry)["title_id"].value<std::string>() :
+                                        std::nullopt;
+                if (!title_id) {
+                    continue;
+                }
+                auto *o = &g_config.display.quality.title_overrides[count++];
+                o->title_id = strdup(title_id->c_str());
+                o->sharpness = -1.0f;
+                load_enum((*entry)["upscaler"], override_upscaler_names,
+                          &o->upscaler);
+                if (auto f = (*entry)["upscale_factor"].value<int64_t>()) {
+                    o->upscale_factor = (int)*f;
+                }
+                if (auto sh = (*entry)["sharpness"].value<double>()) {
+                    o->sharpness = (float)*sh;
+                }
+            }
+            g_config.display.quality.title_overrides_count = count;
+        }
+
+        auto dynamic_scale = display_quality["dynamic_scale"];
+        load_bool(dynamic_scale["enable"],
+                  &g_config.display.quality.dynamic_scale.enable);
+        if (auto min = dynamic_scale["min_scale"].value<int64_t>()) {
+            g_config.display.quality.dynamic_scale.min_scale = (int)*min;
+        }
+        if (auto max = dynamic_scale["max_scale"].value<int64_t>()) {
+            g_config.display.quality.dynamic_scale.max_scale = (int)*max;
+        }
+        if (auto target = dynamic_scale["target_frame_time"].value<double>()) {
+            g_config.display.quality.dynamic_scale.target_frame_time =
+                (float)*target;
+        }
+
         if (auto filtering = display["filtering"].value<std::string>()) {
             CONFIG_DISPLAY_FILTERING parsed;
             if (parse_filtering(*filtering, &parsed)) {
@@ -272,6 +367,26 @@ bool xemu_settings_load(void)
             g_config.display.window.vsync = *vsync;
         }
 
+        static const char *const frame_pacing_names[] = {
+            "vsync", "mailbox", "halve",
+        };
+        load_enum(display_window["frame_pacing"], frame_pacing_names,
+                  &g_config.display.window.frame_pacing);
+
+        auto display_vulkan = display["vulkan"];
+        static const char *const geometry_shader_names[] = {
+            "auto", "enabled", "disabled",
+        };
+        load_enum(display_vulkan["geometry_shader"], geometry_shader_names,
+                  &g_config.display.vulkan.geometry_shader);
+        load_bool(display_vulkan["native_present"],
+                  &g_config.display.vulkan.native_present);
+        static const char *const present_mode_names[] = {
+            "fifo", "fifo_relaxed", "mailbox",
+        };
+        load_enum(display_vulkan["present_mode"], present_mode_names,
+                  &g_config.display.vulkan.present_mode);
+
         // Performance settings
         if (auto hard_fpu = perf["hard_fpu"].value<bool>()) {
             g_config.perf.hard_fpu = *hard_fpu;
@@ -279,6 +394,10 @@ bool xemu_settings_load(void)
         if (auto cache_shaders = perf["cache_shaders"].value<bool>()) {
             g_config.perf.cache_shaders = *cache_shaders;
         }
+        load_bool(perf["async_shader_compile"],
+                  &g_config.perf.async_shader_compile);
+        load_bool(perf["pipeline_fifo"], &g_config.perf.pipeline_fifo);
+        load_bool(perf["yield_on_gpu_wait"], &g_config.perf.yield_on_gpu_wait);
 
         // Audio settings
         if (auto vp_workers = audio_vp["num_workers"].value<int64_t>()) {
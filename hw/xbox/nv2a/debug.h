@@ -79,6 +79,12 @@
     _X(NV2A_PROF_FINISH_FLUSH) \
     _X(NV2A_PROF_FINISH_STALLED) \
     _X(NV2A_PROF_CLEAR) \
+    _X(NV2A_PROF_CLEAR_LOAD_OP) \
+    _X(NV2A_PROF_PFIFO_BATCH) \
+    _X(NV2A_PROF_PFIFO_BATCH_RECORDS) \
+    _X(NV2A_PROF_PFIFO_BATCH_METHODS) \
+    _X(NV2A_PROF_POLL_PARKED) \
+    _X(NV2A_PROF_POLL_PARKED_US) \
     _X(NV2A_PROF_QUEUE_SUBMIT) \
     _X(NV2A_PROF_QUEUE_SUBMIT_AUX) \
     _X(NV2A_PROF_PIPELINE_NOTDIRTY) \
@@ -90,23 +96,39 @@
     _X(NV2A_PROF_INLINE_BUFFERS) \
     _X(NV2A_PROF_INLINE_ARRAYS) \
     _X(NV2A_PROF_INLINE_ELEMENTS) \
+    _X(NV2A_PROF_DRAW) \
+    _X(NV2A_PROF_DRAW_BATCH) \
     _X(NV2A_PROF_QUERY) \
     _X(NV2A_PROF_SHADER_GEN) \
+    _X(NV2A_PROF_SHADER_SPIRV_CACHE_HIT) \
     _X(NV2A_PROF_SHADER_BIND) \
     _X(NV2A_PROF_SHADER_BIND_NOTDIRTY) \
+    _X(NV2A_PROF_SHADER_PENDING_SKIP) \
+    _X(NV2A_PROF_SHADER_PREFETCH) \
     _X(NV2A_PROF_SHADER_UBO_DIRTY) \
     _X(NV2A_PROF_SHADER_UBO_NOTDIRTY) \
+    _X(NV2A_PROF_DESCRIPTOR_SET_WRITE) \
+    _X(NV2A_PROF_DESCRIPTOR_SET_PUSH) \
     _X(NV2A_PROF_ATTR_BIND) \
     _X(NV2A_PROF_TEX_UPLOAD) \
+    _X(NV2A_PROF_TEX_UPLOAD_PBO) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_1) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_2) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_3) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_4) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_4_NOTDIRTY) \
+    _X(NV2A_PROF_GEOM_BUFFER_UPDATE_INDEX) \
+    _X(NV2A_PROF_GEOM_BUFFER_UPDATE_WRAP) \
+    _X(NV2A_PROF_GEOM_BUFFER_UPDATE_STALL) \
     _X(NV2A_PROF_SURF_SWIZZLE) \
     _X(NV2A_PROF_SURF_CREATE) \
     _X(NV2A_PROF_SURF_DOWNLOAD) \
+    _X(NV2A_PROF_SURF_DOWNLOAD_FILL) \
+    _X(NV2A_PROF_SURF_DOWNLOAD_ELIDED) \
+    _X(NV2A_PROF_SURF_DOWNLOAD_PREFETCH) \
+    _X(NV2A_PROF_SURF_DOWNLOAD_PREFETCH_HIT) \
     _X(NV2A_PROF_SURF_UPLOAD) \
+    _X(NV2A_PROF_SURF_UPLOAD_ROWS) \
     _X(NV2A_PROF_SURF_TO_TEX) \
     _X(NV2A_PROF_SURF_TO_TEX_FALLBACK) \
     _X(NV2A_PROF_QUEUE_SUBMIT_1) \
@@ -114,6 +136,12 @@
     _X(NV2A_PROF_QUEUE_SUBMIT_3) \
     _X(NV2A_PROF_QUEUE_SUBMIT_4) \
     _X(NV2A_PROF_QUEUE_SUBMIT_5) \
+    _X(NV2A_PROF_PRESENT) \
+    _X(NV2A_PROF_PRESENT_WAIT_US) \
+    _X(NV2A_PROF_PRESENT_LATENCY_US) \
+    _X(NV2A_PROF_PRESENT_DROPPED) \
+    _X(NV2A_PROF_DISPLAY_UPSCALE) \
+    _X(NV2A_PROF_UI_BQL_HOLD_US) \
 
 enum NV2A_PROF_COUNTERS_ENUM {
     #define _X(x) x,
@@ -124,10 +152,15 @@ enum NV2A_PROF_COUNTERS_ENUM {
 
 #define NV2A_PROF_NUM_FRAMES 300
 
+/* 1 ms buckets of guest frame time; the last bucket also counts longer frames */
+#define NV2A_PROF_FRAME_TIME_BUCKETS 64
+
 typedef struct NV2AStats {
     int64_t last_flip_time;
+    int64_t last_increment_time;
     unsigned int frame_count;
     unsigned int increment_fps;
+    unsigned int frame_time_histogram[NV2A_PROF_FRAME_TIME_BUCKETS];
     struct {
         int mspf;
         int counters[NV2A_PROF__COUNT];
@@ -145,12 +178,19 @@ const char *nv2a_profile_get_counter_name(unsigned int cnt);
 int nv2a_profile_get_counter_value(unsigned int cnt);
 void nv2a_profile_increment(void);
 void nv2a_profile_flip_stall(void);
+void nv2a_profile_reset_frame_time_histogram(void);
 
 static inline void nv2a_profile_inc_counter(enum NV2A_PROF_COUNTERS_ENUM cnt)
 {
     g_nv2a_stats.frame_working.counters[cnt] += 1;
 }
 
+static inline void nv2a_profile_add_counter(enum NV2A_PROF_COUNTERS_ENUM cnt,
+                                            int value)
+{
+    g_nv2a_stats.frame_working.counters[cnt] += value;
+}
+
 #ifdef CONFIG_RENDERDOC
 void nv2a_dbg_renderdoc_init(void);
 void *nv2a_dbg_renderdoc_get_api(void);
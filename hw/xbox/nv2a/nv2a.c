@@ -20,7 +20,20 @@
  */
 
 #include "hw/xbox/nv2a/nv2a_int.h"
+#include "hw/core/cpu.h"
 #include "qemu/main-loop.h"
+#include "qemu/timer.h"
+#include "ui/xemu-settings.h"
+
+/* Identical reads of a register before the vCPU is parked */
+#define NV2A_POLL_SPIN_THRESHOLD 64
+
+/* Upper bound on how long a parked vCPU waits for a register to change */
+#define NV2A_POLL_TIMEOUT_MS 1
+
+/* VBLANK periods of the 60 Hz (NTSC/VGA) and 50 Hz (PAL) video modes */
+#define NV2A_VBLANK_PERIOD_60HZ_NS (NANOSECONDS_PER_SECOND / 60)
+#define NV2A_VBLANK_PERIOD_50HZ_NS (NANOSECONDS_PER_SECOND / 50)
 
 void nv2a_update_irq(NV2AState *d)
 {
@@ -48,11 +61,99 @@ void nv2a_update_irq(NV2AState *d)
     if (d->pmc.pending_interrupts && d->pmc.enabled_interrupts) {
         trace_nv2a_irq(d->pmc.pending_interrupts);
         pci_irq_assert(PCI_DEVICE(d));
+        /* A parked vCPU has to run to take the interrupt */
+        nv2a_poll_notify(d);
     } else {
         pci_irq_deassert(PCI_DEVICE(d));
     }
 }
 
+/* Wake a vCPU parked in nv2a_poll_park. May be called from any thread. */
+void nv2a_poll_notify(NV2AState *d)
+{
+    qatomic_inc(&d->poll.generation);
+
+    if (qatomic_read(&d->poll.waiters)) {
+        qemu_mutex_lock(&d->poll.lock);
+        qemu_cond_broadcast(&d->poll.cond);
+        qemu_mutex_unlock(&d->poll.lock);
+    }
+}
+
+/*
+ * Runs on the vCPU thread from its queued work, outside of cpu_exec and of
+ * any memory access, so the BQL can be dropped while waiting for a polled
+ * register to change or a short timeout to expire.
+ */
+static void nv2a_poll_park(CPUState *cpu, run_on_cpu_data data)
+{
+    NV2AState *d = data.host_ptr;
+    int64_t start_ns = get_clock();
+
+    bql_unlock();
+    qemu_mutex_lock(&d->poll.lock);
+    qatomic_inc(&d->poll.waiters);
+    if (qatomic_read(&d->poll.generation) == d->poll.park_generation) {
+        qemu_cond_timedwait(&d->poll.cond, &d->poll.lock,
+                            NV2A_POLL_TIMEOUT_MS);
+    }
+    qatomic_dec(&d->poll.waiters);
+    qemu_mutex_unlock(&d->poll.lock);
+    bql_lock();
+
+    d->poll.park_pending = false;
+
+    /* The counters are otherwise only updated from the FIFO thread */
+    NV2AStats *stats = &g_nv2a_stats;
+    qatomic_inc(&stats->frame_working.counters[NV2A_PROF_POLL_PARKED]);
+    qatomic_add(&stats->frame_working.counters[NV2A_PROF_POLL_PARKED_US],
+                (get_clock() - start_ns) / 1000);
+}
+
+/*
+ * Spin-wait detection for MMIO reads served from shadow registers. Called
+ * with the BQL held from the MMIO dispatch. When the guest keeps reading the
+ * same value from the same register it is waiting on the GPU, so rather than
+ * let the vCPU spin through TCG, have it leave the CPU loop once this access
+ * completes and park in nv2a_poll_park until a polled register changes.
+ *
+ * @generation is the nv2a_poll_begin() snapshot taken before @val was read.
+ */
+void nv2a_poll_check(NV2AState *d, int block, hwaddr addr, uint64_t val,
+                     uint32_t generation)
+{
+    if (!g_config.perf.yield_on_gpu_wait || !current_cpu) {
+        return;
+    }
+
+    /* Guests poll several registers in turn, so track each separately */
+    NV2APollSlot *slot =
+        &d->poll.slots[(block * 31 + (addr >> 2)) % NV2A_POLL_SLOTS];
+
+    if (block != slot->block || addr != slot->addr || val != slot->val) {
+        slot->block = block;
+        slot->addr = addr;
+        slot->val = val;
+        slot->repeat = 0;
+        return;
+    }
+
+    /* Once detected, keep parking on every read until the value changes */
+    if (slot->repeat < NV2A_POLL_SPIN_THRESHOLD) {
+        slot->repeat++;
+        return;
+    }
+
+    if (d->poll.park_pending) {
+        return;
+    }
+
+    /* Queued work kicks the vCPU out of the CPU loop before it runs */
+    d->poll.park_pending = true;
+    d->poll.park_generation = generation;
+    async_run_on_cpu(current_cpu, nv2a_poll_park, RUN_ON_CPU_HOST_PTR(d));
+}
+
 DMAObject nv_dma_load(NV2AState *d, hwaddr dma_obj_address)
 {
     assert(dma_obj_address < memory_region_size(&d->ramin));
@@ -193,16 +294,68 @@ int nv2a_get_screen_off(void)
     return g_nv2a->vga.sr[VGA_SEQ_CLOCK_MODE] & VGA_SR01_SCREEN_OFF;
 }
 
-static void nv2a_vga_gfx_update(void *opaque)
+/*
+ * The encoder clock is not modelled, so the refresh rate is inferred from the
+ * programmed mode: 576 active lines is a PAL mode, anything else is 60 Hz.
+ */
+static int64_t nv2a_vblank_period_ns(NV2AState *d)
 {
-    VGACommonState *vga = opaque;
-    vga->hw_ops->gfx_update(vga);
+    if (d->pramdac.fp_vdisplay_end + 1 == 576) {
+        return NV2A_VBLANK_PERIOD_50HZ_NS;
+    }
+    return NV2A_VBLANK_PERIOD_60HZ_NS;
+}
+
+int64_t nv2a_get_vblank_period_ns(void)
+{
+    return qatomic_read(&g_nv2a->vblank_period_ns);
+}
+
+void nv2a_set_title_id(uint32_t title_id)
+{
+    qatomic_set(&g_nv2a->title_id, title_id);
+}
+
+static void nv2a_vblank_timer_arm(NV2AState *d, int64_t now)
+{
+    int64_t period = nv2a_vblank_period_ns(d);
+    qatomic_set(&d->vblank_period_ns, period);
+
+    /* Schedule on a fixed grid, but don't try to catch up after a stall */
+    d->vblank_deadline += period;
+    if (d->vblank_deadline <= now) {
+        d->vblank_deadline = now + period;
+    }
+    timer_mod(d->vblank_timer, d->vblank_deadline);
+}
+
+/*
+ * VBLANK is paced by the virtual clock rather than by host display refresh,
+ * so guest frame timing is independent of when (or how often) the UI
+ * presents. Runs with the BQL held.
+ */
+static void nv2a_vblank_timer_cb(void *opaque)
+{
+    NV2AState *d = opaque;
 
-    NV2AState *d = container_of(vga, NV2AState, vga);
     d->pcrtc.pending_interrupts |= NV_PCRTC_INTR_0_VBLANK;
     d->pcrtc.raster = 0;
-
     nv2a_update_irq(d);
+
+    nv2a_vblank_timer_arm(d, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+}
+
+static void nv2a_vblank_timer_restart(NV2AState *d)
+{
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    d->vblank_deadline = now;
+    nv2a_vblank_timer_arm(d, now);
+}
+
+static void nv2a_vga_gfx_update(void *opaque)
+{
+    VGACommonState *vga = opaque;
+    vga->hw_ops->gfx_update(vga);
 }
 
 static void nv2a_init_memory(NV2AState *d, MemoryRegion *ram)
@@ -235,8 +388,7 @@ static void nv2a_init_memory(NV2AState *d, MemoryRegion *ram)
     pgraph_init(d);
 
     /* fire up pfifo */
-    qemu_thread_create(&d->pfifo.thread, "nv2a.pfifo_thread",
-                       pfifo_thread, d, QEMU_THREAD_JOINABLE);
+    pfifo_init(d);
 }
 
 static void nv2a_init_vga(NV2AState *d)
@@ -274,6 +426,10 @@ static void nv2a_lock_fifo(NV2AState *d)
 
 static void nv2a_unlock_fifo(NV2AState *d)
 {
+    /* FIFO registers may have been reset or restored */
+    pfifo_invalidate_method_queue(d);
+    pfifo_update_shadow_regs(d);
+    pgraph_update_shadow_regs(&d->pgraph);
     pfifo_kick(d);
     qemu_mutex_unlock(&d->pgraph.lock);
     qemu_mutex_unlock(&d->pfifo.lock);
@@ -328,6 +484,8 @@ static void nv2a_reset(NV2AState *d)
         d->puserdac.palette[i*3+2] = i;
     }
 
+    nv2a_vblank_timer_restart(d);
+
     nv2a_unlock_fifo(d);
 }
 
@@ -356,6 +514,17 @@ static void nv2a_realize(PCIDevice *dev, Error **errp)
     qemu_mutex_init(&d->pfifo.lock);
     qemu_cond_init(&d->pfifo.fifo_cond);
     qemu_cond_init(&d->pfifo.fifo_idle_cond);
+    qemu_cond_init(&d->pfifo.pusher_cond);
+    seqlock_init(&d->pfifo.shadow.seq);
+
+    qemu_mutex_init(&d->poll.lock);
+    qemu_cond_init(&d->poll.cond);
+    for (int i = 0; i < NV2A_POLL_SLOTS; i++) {
+        d->poll.slots[i].block = -1;
+    }
+
+    d->vblank_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, nv2a_vblank_timer_cb, d);
+    d->vblank_period_ns = NV2A_VBLANK_PERIOD_60HZ_NS;
 }
 
 static void nv2a_exitfn(PCIDevice *dev)
@@ -365,8 +534,10 @@ static void nv2a_exitfn(PCIDevice *dev)
 
     d->exiting = true;
 
-    qemu_cond_broadcast(&d->pfifo.fifo_cond);
-    qemu_thread_join(&d->pfifo.thread);
+    timer_free(d->vblank_timer);
+    d->vblank_timer = NULL;
+
+    pfifo_destroy(d);
 
     pgraph_destroy(&d->pgraph);
 }
@@ -428,6 +599,8 @@ static int nv2a_post_load(void *opaque, int version_id)
 {
     NV2AState *d = opaque;
     qatomic_set(&d->pgraph.flush_pending, true);
+    d->pgraph.program_data_generation++;
+    nv2a_vblank_timer_restart(d);
     nv2a_unlock_fifo(d);
     return 0;
 }
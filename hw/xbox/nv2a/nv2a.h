@@ -27,12 +27,18 @@ void nv2a_context_init(void);
 void nv2a_android_early_context_init(void);
 bool nv2a_android_copy_readback(uint8_t **buffer, size_t *buffer_size,
                                 int *width, int *height);
+bool nv2a_android_get_framebuffer_image(void **image,
+                                        unsigned int *generation);
 #endif
 int nv2a_get_framebuffer_surface(void);
 void nv2a_release_framebuffer_surface(void);
+bool nv2a_set_present_window(void *window);
+bool nv2a_present_framebuffer(float aspect_ratio);
 void nv2a_set_surface_scale_factor(unsigned int scale);
 unsigned int nv2a_get_surface_scale_factor(void);
 const uint8_t *nv2a_get_dac_palette(void);
 int nv2a_get_screen_off(void);
+int64_t nv2a_get_vblank_period_ns(void);
+void nv2a_set_title_id(uint32_t title_id);
 
 #endif
@@ -28,6 +28,7 @@
 #include "qemu/units.h"
 #include "qemu/thread.h"
 #include "qemu/queue.h"
+#include "qemu/seqlock.h"
 #include "qemu/main-loop.h"
 #include "qapi/error.h"
 #include "qemu/error-report.h"
@@ -67,6 +68,34 @@ typedef struct DMAObject {
     hwaddr limit;
 } DMAObject;
 
+typedef struct PfifoMethodQueue PfifoMethodQueue;
+
+/*
+ * Copies of the PFIFO and USER registers that guests poll while waiting on
+ * the GPU. Published under pfifo.lock, read lock-free from the MMIO handlers.
+ */
+typedef struct PfifoShadowRegs {
+    QemuSeqLock seq;
+    uint32_t mode;
+    uint32_t push1;
+    uint32_t dma_put;
+    uint32_t dma_get;
+    uint32_t ref;
+    uint32_t status;
+    uint32_t pending_interrupts;
+    uint32_t enabled_interrupts;
+} PfifoShadowRegs;
+
+/* Number of registers tracked by the polling detector, see nv2a_poll_check */
+#define NV2A_POLL_SLOTS 16
+
+typedef struct NV2APollSlot {
+    int block;
+    hwaddr addr;
+    uint64_t val;
+    unsigned int repeat;
+} NV2APollSlot;
+
 typedef struct NV2AState {
     /*< private >*/
     PCIDevice parent_obj;
@@ -78,6 +107,10 @@ typedef struct NV2AState {
     VGACommonState vga;
     GraphicHwOps hw_ops;
     QEMUTimer *vblank_timer;
+    int64_t vblank_deadline;
+    int64_t vblank_period_ns;
+
+    uint32_t title_id; // Of the running XBE, for per-title display settings
 
     MemoryRegion *vram;
     MemoryRegion vram_pci;
@@ -103,8 +136,25 @@ typedef struct NV2AState {
         QemuCond fifo_idle_cond;
         bool fifo_kick;
         bool halt;
+        QemuThread pusher_thread;
+        QemuCond pusher_cond;
+        bool pusher_kick;
+        bool pipelined;
+        PfifoMethodQueue *method_queue;
+        PfifoShadowRegs shadow;
     } pfifo;
 
+    /* Guest polling of shadowed registers, see nv2a_poll_check */
+    struct {
+        QemuMutex lock;
+        QemuCond cond;
+        uint32_t generation; /* Incremented when a polled register changes */
+        int waiters;
+        bool park_pending;
+        uint32_t park_generation;
+        NV2APollSlot slots[NV2A_POLL_SLOTS];
+    } poll;
+
     struct {
         uint32_t regs[0x1000];
     } pvideo;
@@ -161,6 +211,15 @@ typedef struct NV2ABlockInfo {
 extern const NV2ABlockInfo blocktable[NV_NUM_BLOCKS];
 
 void nv2a_update_irq(NV2AState *d);
+void nv2a_poll_notify(NV2AState *d);
+void nv2a_poll_check(NV2AState *d, int block, hwaddr addr, uint64_t val,
+                     uint32_t generation);
+
+/* Snapshot taken before reading a polled register, see nv2a_poll_check */
+static inline uint32_t nv2a_poll_begin(NV2AState *d)
+{
+    return qatomic_read(&d->poll.generation);
+}
 
 static inline
 void nv2a_reg_log_read(int block, hwaddr addr, unsigned int size, uint64_t val)
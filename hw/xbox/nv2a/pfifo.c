@@ -20,6 +20,8 @@
  */
 
 #include "nv2a_int.h"
+#include "pfifo_queue.h"
+#include "ui/xemu-settings.h"
 
 typedef struct RAMHTEntry {
     uint32_t handle;
@@ -29,33 +31,117 @@ typedef struct RAMHTEntry {
     bool valid;
 } RAMHTEntry;
 
-static void pfifo_run_pusher(NV2AState *d);
-static uint32_t ramht_hash(NV2AState *d, uint32_t handle);
-static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t handle);
+static bool pfifo_run_pusher(NV2AState *d);
+static uint32_t ramht_hash(uint32_t ramht, unsigned int channel_id,
+                           uint32_t handle);
+static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t ramht,
+                               unsigned int channel_id, uint32_t handle);
 
-/* PFIFO - MMIO and DMA FIFO submission to PGRAPH and VPE */
-uint64_t pfifo_read(void *opaque, hwaddr addr, unsigned int size)
+/*
+ * Guests spin on DMA GET, REF, CACHE1 status and the interrupt registers while
+ * waiting on the GPU. Copies of them are published here so MMIO reads don't
+ * contend for pfifo.lock, which the FIFO thread holds for most of a batch.
+ * Called with pfifo.lock held after any change to the shadowed registers.
+ */
+void pfifo_update_shadow_regs(NV2AState *d)
 {
-    NV2AState *d = (NV2AState *)opaque;
+    PfifoShadowRegs *s = &d->pfifo.shadow;
+
+    seqlock_write_begin(&s->seq);
+    qatomic_set(&s->mode, d->pfifo.regs[NV_PFIFO_MODE]);
+    qatomic_set(&s->push1, d->pfifo.regs[NV_PFIFO_CACHE1_PUSH1]);
+    qatomic_set(&s->dma_put, d->pfifo.regs[NV_PFIFO_CACHE1_DMA_PUT]);
+    qatomic_set(&s->dma_get, d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET]);
+    qatomic_set(&s->ref, d->pfifo.regs[NV_PFIFO_CACHE1_REF]);
+    qatomic_set(&s->status, d->pfifo.regs[NV_PFIFO_CACHE1_STATUS]);
+    qatomic_set(&s->pending_interrupts, d->pfifo.pending_interrupts);
+    qatomic_set(&s->enabled_interrupts, d->pfifo.enabled_interrupts);
+    seqlock_write_end(&s->seq);
+
+    nv2a_poll_notify(d);
+}
 
-    qemu_mutex_lock(&d->pfifo.lock);
+static bool pfifo_read_shadow_reg(NV2AState *d, hwaddr addr, uint64_t *val)
+{
+    PfifoShadowRegs *s = &d->pfifo.shadow;
 
-    uint64_t r = 0;
     switch (addr) {
     case NV_PFIFO_INTR_0:
-        r = d->pfifo.pending_interrupts;
-        break;
+        *val = qatomic_read(&s->pending_interrupts);
+        return true;
     case NV_PFIFO_INTR_EN_0:
-        r = d->pfifo.enabled_interrupts;
-        break;
+        *val = qatomic_read(&s->enabled_interrupts);
+        return true;
     case NV_PFIFO_RUNOUT_STATUS:
-        r = NV_PFIFO_RUNOUT_STATUS_LOW_MARK; /* low mark empty */
-        break;
+        *val = NV_PFIFO_RUNOUT_STATUS_LOW_MARK; /* low mark empty */
+        return true;
+    case NV_PFIFO_CACHE1_STATUS:
+        *val = qatomic_read(&s->status);
+        return true;
+    case NV_PFIFO_CACHE1_DMA_PUT:
+        *val = qatomic_read(&s->dma_put);
+        return true;
+    case NV_PFIFO_CACHE1_DMA_GET:
+        *val = qatomic_read(&s->dma_get);
+        return true;
+    case NV_PFIFO_CACHE1_REF:
+        *val = qatomic_read(&s->ref);
+        return true;
     default:
-        r = d->pfifo.regs[addr];
-        break;
+        return false;
     }
+}
 
+/*
+ * Read a USER register of the channel currently loaded in CACHE1. Returns
+ * false if @channel_id is not the current DMA channel.
+ */
+bool pfifo_read_user_shadow_reg(NV2AState *d, unsigned int channel_id,
+                                hwaddr addr, uint64_t *val)
+{
+    PfifoShadowRegs *s = &d->pfifo.shadow;
+    unsigned int start;
+    bool current;
+
+    do {
+        start = seqlock_read_begin(&s->seq);
+        current = (qatomic_read(&s->mode) & (1 << channel_id)) &&
+                  GET_MASK(qatomic_read(&s->push1),
+                           NV_PFIFO_CACHE1_PUSH1_CHID) == channel_id;
+        switch (addr) {
+        case NV_USER_DMA_PUT:
+            *val = qatomic_read(&s->dma_put);
+            break;
+        case NV_USER_DMA_GET:
+            *val = qatomic_read(&s->dma_get);
+            break;
+        case NV_USER_REF:
+            *val = qatomic_read(&s->ref);
+            break;
+        default:
+            current = false;
+            break;
+        }
+    } while (seqlock_read_retry(&s->seq, start));
+
+    return current;
+}
+
+/* PFIFO - MMIO and DMA FIFO submission to PGRAPH and VPE */
+uint64_t pfifo_read(void *opaque, hwaddr addr, unsigned int size)
+{
+    NV2AState *d = (NV2AState *)opaque;
+
+    uint64_t r = 0;
+    uint32_t poll_generation = nv2a_poll_begin(d);
+    if (pfifo_read_shadow_reg(d, addr, &r)) {
+        nv2a_poll_check(d, NV_PFIFO, addr, r, poll_generation);
+        nv2a_reg_log_read(NV_PFIFO, addr, size, r);
+        return r;
+    }
+
+    qemu_mutex_lock(&d->pfifo.lock);
+    r = d->pfifo.regs[addr];
     qemu_mutex_unlock(&d->pfifo.lock);
 
     nv2a_reg_log_read(NV_PFIFO, addr, size, r);
@@ -79,11 +165,16 @@ void pfifo_write(void *opaque, hwaddr addr, uint64_t val, unsigned int size)
         d->pfifo.enabled_interrupts = val;
         nv2a_update_irq(d);
         break;
+    case NV_PFIFO_CACHE1_DMA_PUT:
+        d->pfifo.regs[addr] = val;
+        break;
     default:
         d->pfifo.regs[addr] = val;
+        pfifo_invalidate_method_queue(d);
         break;
     }
 
+    pfifo_update_shadow_regs(d);
     pfifo_kick(d);
 
     qemu_mutex_unlock(&d->pfifo.lock);
@@ -93,6 +184,8 @@ void pfifo_kick(NV2AState *d)
 {
     d->pfifo.fifo_kick = true;
     qemu_cond_broadcast(&d->pfifo.fifo_cond);
+    d->pfifo.pusher_kick = true;
+    qemu_cond_broadcast(&d->pfifo.pusher_cond);
 }
 
 static bool can_fifo_access(NV2AState *d) {
@@ -122,148 +215,207 @@ static bool is_flip_stall_complete(NV2AState *d)
     return false;
 }
 
-static bool pfifo_stall_for_flip(NV2AState *d)
+/*
+ * Pushbuffer processing is split into two stages which share a ring of
+ * decoded method records:
+ *
+ * - The pusher parses the pushbuffer (jumps, calls, returns and method
+ *   headers) ahead of GET and appends (subchannel, method, parameter span)
+ *   records to the ring while holding pfifo.lock. Decoding has no side
+ *   effects: nothing the guest can observe changes until a record executes.
+ * - The puller takes a batch of records from the ring and runs them through
+ *   PGRAPH under a single pgraph.lock acquisition. RAMHT lookups and the
+ *   engine bindings happen here, as each method executes.
+ *
+ * Guest-visible DMA state (GET, STATE, SUBROUTINE, DCOUNT and the DMA shadow
+ * registers) is only committed by the puller, and only for words PGRAPH
+ * actually consumed, so it never runs ahead of execution and waiting_for_*
+ * stalls resume at the exact word they stopped on. Any guest write that could
+ * change what the pusher would decode invalidates the ring, and decoding
+ * restarts from the committed state.
+ *
+ * By default both stages run on the FIFO thread. With perf.pipeline_fifo the
+ * pusher runs on its own thread, which keeps the FIFO thread free for method
+ * execution and command recording.
+ */
+#define PFIFO_METHOD_QUEUE_SIZE 256
+#define PFIFO_METHOD_BATCH_SIZE 64
+
+struct PfifoMethodQueue {
+    PfifoMethodRecord records[PFIFO_METHOD_QUEUE_SIZE];
+    int head;
+    int count;
+    PfifoDmaState decode; /* Pusher position, valid if decode_valid */
+    bool decode_valid;
+    uint32_t epoch; /* Incremented on every invalidation */
+};
+
+/*
+ * PULL registers updated by executing methods. The puller takes a copy under
+ * pfifo.lock, methods update it while only pgraph.lock is held, and changes
+ * are written back together with the DMA state the batch consumed.
+ */
+typedef struct PfifoPullState {
+    NV2AState *d;
+    int num_methods;
+    uint32_t ramht;
+    unsigned int channel_id;
+    uint32_t engine;
+    uint32_t pull1;
+} PfifoPullState;
+
+static PfifoDmaState pfifo_load_dma_state(NV2AState *d)
+{
+    return (PfifoDmaState){
+        .get = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET],
+        .state = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_STATE],
+        .subroutine = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_SUBROUTINE],
+        .dcount = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_DCOUNT],
+        .rsvd_shadow = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_RSVD_SHADOW],
+        .get_jmp_shadow = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET_JMP_SHADOW],
+        .data_shadow = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_DATA_SHADOW],
+    };
+}
+
+static void pfifo_store_dma_state(NV2AState *d, const PfifoDmaState *s)
 {
-    bool should_stall = false;
+    d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET] = s->get;
+    d->pfifo.regs[NV_PFIFO_CACHE1_DMA_STATE] = s->state;
+    d->pfifo.regs[NV_PFIFO_CACHE1_DMA_SUBROUTINE] = s->subroutine;
+    d->pfifo.regs[NV_PFIFO_CACHE1_DMA_DCOUNT] = s->dcount;
+    d->pfifo.regs[NV_PFIFO_CACHE1_DMA_RSVD_SHADOW] = s->rsvd_shadow;
+    d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET_JMP_SHADOW] = s->get_jmp_shadow;
+    d->pfifo.regs[NV_PFIFO_CACHE1_DMA_DATA_SHADOW] = s->data_shadow;
+}
 
-    if (qatomic_read(&d->pgraph.waiting_for_flip)) {
-        qemu_mutex_lock(&d->pgraph.lock);
-        if (!is_flip_stall_complete(d)) {
-            should_stall = true;
-        } else {
-            d->pgraph.waiting_for_flip = false;
-        }
-        qemu_mutex_unlock(&d->pgraph.lock);
-    }
+static void pfifo_kick_pusher(NV2AState *d)
+{
+    d->pfifo.pusher_kick = true;
+    qemu_cond_broadcast(&d->pfifo.pusher_cond);
+}
 
-    return should_stall;
+static void pfifo_kick_puller(NV2AState *d)
+{
+    d->pfifo.fifo_kick = true;
+    qemu_cond_broadcast(&d->pfifo.fifo_cond);
 }
 
-static bool pfifo_puller_should_stall(NV2AState *d)
+/* Called with pfifo.lock held */
+void pfifo_invalidate_method_queue(NV2AState *d)
 {
-    return pfifo_stall_for_flip(d) || qatomic_read(&d->pgraph.waiting_for_nop) ||
-           qatomic_read(&d->pgraph.waiting_for_context_switch) ||
-           !can_fifo_access(d);
+    PfifoMethodQueue *q = d->pfifo.method_queue;
+
+    q->head = 0;
+    q->count = 0;
+    q->decode_valid = false;
+    q->epoch++;
+
+    pfifo_kick_pusher(d);
 }
 
-static ssize_t pfifo_run_puller(NV2AState *d, uint32_t method_entry,
-                                uint32_t parameter, uint32_t *parameters,
-                                size_t num_words_available,
-                                size_t max_lookahead_words)
+/* Called with pgraph.lock held */
+static bool pfifo_puller_should_stall(NV2AState *d)
 {
-    if (pfifo_puller_should_stall(d)) {
-        return -1;
+    PGRAPHState *pg = &d->pgraph;
+
+    if (pg->waiting_for_flip) {
+        if (!is_flip_stall_complete(d)) {
+            return true;
+        }
+        pg->waiting_for_flip = false;
     }
 
-    uint32_t *pull0 = &d->pfifo.regs[NV_PFIFO_CACHE1_PULL0];
-    uint32_t *pull1 = &d->pfifo.regs[NV_PFIFO_CACHE1_PULL1];
-    uint32_t *engine_reg = &d->pfifo.regs[NV_PFIFO_CACHE1_ENGINE];
-    uint32_t *status = &d->pfifo.regs[NV_PFIFO_CACHE1_STATUS];
-    ssize_t num_proc = -1;
+    return pg->waiting_for_nop || pg->waiting_for_context_switch ||
+           !can_fifo_access(d);
+}
 
-    // TODO think more about locking
+static bool pfifo_pusher_should_stall(NV2AState *d)
+{
+    return !can_fifo_access(d) ||
+           qatomic_read(&d->pgraph.waiting_for_nop);
+}
+
+/*
+ * Execute the method at the front of @rec, binding engines and translating
+ * object handles as it goes. Called with pgraph.lock held. Returns the number
+ * of words PGRAPH consumed, or -1 if it has to stall.
+ */
+static int pfifo_run_method(void *opaque, PfifoMethodRecord *rec)
+{
+    PfifoPullState *pull = opaque;
+    NV2AState *d = pull->d;
+    unsigned int subchannel = rec->subchannel;
+    uint32_t parameter = ldl_le_p(rec->parameters);
 
-    if (!GET_MASK(*pull0, NV_PFIFO_CACHE1_PULL0_ACCESS) ||
-        (*status & NV_PFIFO_CACHE1_STATUS_LOW_MARK)) {
+    if (pfifo_puller_should_stall(d)) {
         return -1;
     }
 
-    uint32_t method = method_entry & 0x1FFC;
-    uint32_t subchannel =
-        GET_MASK(method_entry, NV_PFIFO_CACHE1_METHOD_SUBCHANNEL);
-    bool inc = !GET_MASK(method_entry, NV_PFIFO_CACHE1_METHOD_TYPE);
-
-    if (method == 0) {
-        RAMHTEntry entry = ramht_lookup(d, parameter);
+    if (rec->method == 0) {
+        RAMHTEntry entry =
+            ramht_lookup(d, pull->ramht, pull->channel_id, parameter);
         assert(entry.valid);
         // assert(entry.channel_id == state->channel_id);
         assert(entry.engine == ENGINE_GRAPHICS);
 
         /* the engine is bound to the subchannel */
         assert(subchannel < 8);
-        SET_MASK(*engine_reg, 3 << (4*subchannel), entry.engine);
-        SET_MASK(*pull1, NV_PFIFO_CACHE1_PULL1_ENGINE, entry.engine);
-
-        // TODO: this is fucked
-        qemu_mutex_unlock(&d->pfifo.lock);
-        qemu_mutex_lock(&d->pgraph.lock);
+        SET_MASK(pull->engine, 3 << (4*subchannel), entry.engine);
+        SET_MASK(pull->pull1, NV_PFIFO_CACHE1_PULL1_ENGINE, entry.engine);
 
         // Switch contexts if necessary
-        if (can_fifo_access(d)) {
-            pgraph_context_switch(d, entry.channel_id);
-            if (!d->pgraph.waiting_for_context_switch) {
-                num_proc =
-                    pgraph_method(d, subchannel, 0, entry.instance, parameters,
-                                  num_words_available, max_lookahead_words, inc);
-            }
+        pgraph_context_switch(d, entry.channel_id);
+        if (d->pgraph.waiting_for_context_switch) {
+            return -1;
         }
+        pull->num_methods++;
+        return pgraph_method(d, subchannel, 0, entry.instance, rec->parameters,
+                             rec->num_words, rec->max_lookahead_words,
+                             rec->inc);
+    }
 
-        qemu_mutex_unlock(&d->pgraph.lock);
-        qemu_mutex_lock(&d->pfifo.lock);
-
-    } else if (method >= 0x100) {
-        // method passed to engine
-
-        /* methods that take objects.
-         * TODO: Check this range is correct for the nv2a */
-        if (method >= 0x180 && method < 0x200) {
-            //bql_lock();
-            RAMHTEntry entry = ramht_lookup(d, parameter);
-            assert(entry.valid);
-            // assert(entry.channel_id == state->channel_id);
-            parameter = entry.instance;
-            //bql_unlock();
-        }
-
-        enum FIFOEngine engine = GET_MASK(*engine_reg, 3 << (4*subchannel));
-        assert(engine == ENGINE_GRAPHICS);
-        SET_MASK(*pull1, NV_PFIFO_CACHE1_PULL1_ENGINE, engine);
-
-        // TODO: this is fucked
-        qemu_mutex_unlock(&d->pfifo.lock);
-        qemu_mutex_lock(&d->pgraph.lock);
-
-        if (can_fifo_access(d)) {
-            num_proc =
-                pgraph_method(d, subchannel, method, parameter, parameters,
-                              num_words_available, max_lookahead_words, inc);
-        }
+    // method passed to engine
 
-        qemu_mutex_unlock(&d->pgraph.lock);
-        qemu_mutex_lock(&d->pfifo.lock);
-    } else {
-        assert(false);
+    /* methods that take objects.
+     * TODO: Check this range is correct for the nv2a */
+    if (rec->method >= 0x180 && rec->method < 0x200) {
+        RAMHTEntry entry =
+            ramht_lookup(d, pull->ramht, pull->channel_id, parameter);
+        assert(entry.valid);
+        // assert(entry.channel_id == state->channel_id);
+        parameter = entry.instance;
     }
 
-    if (num_proc > 0) {
-        *status |= NV_PFIFO_CACHE1_STATUS_LOW_MARK;
-    }
+    enum FIFOEngine engine = GET_MASK(pull->engine, 3 << (4*subchannel));
+    assert(engine == ENGINE_GRAPHICS);
+    SET_MASK(pull->pull1, NV_PFIFO_CACHE1_PULL1_ENGINE, engine);
 
-    return num_proc;
+    pull->num_methods++;
+    return pgraph_method(d, subchannel, rec->method, parameter,
+                         rec->parameters, rec->num_words,
+                         rec->max_lookahead_words, rec->inc);
 }
 
-static bool pfifo_pusher_should_stall(NV2AState *d)
-{
-    return !can_fifo_access(d) ||
-           qatomic_read(&d->pgraph.waiting_for_nop);
-}
-
-static void pfifo_run_pusher(NV2AState *d)
+/*
+ * Decode pushbuffer commands into the method queue until it is full, the
+ * pushbuffer is empty or the pusher has to stall. Called with pfifo.lock held.
+ * Returns true if the decode position moved.
+ */
+static bool pfifo_run_pusher(NV2AState *d)
 {
+    PfifoMethodQueue *q = d->pfifo.method_queue;
     uint32_t *push0 = &d->pfifo.regs[NV_PFIFO_CACHE1_PUSH0];
     uint32_t *push1 = &d->pfifo.regs[NV_PFIFO_CACHE1_PUSH1];
-    uint32_t *dma_subroutine = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_SUBROUTINE];
-    uint32_t *dma_state = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_STATE];
     uint32_t *dma_push = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_PUSH];
-    uint32_t *dma_get = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET];
-    uint32_t *dma_put = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_PUT];
-    uint32_t *dma_dcount = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_DCOUNT];
-    uint32_t *status = &d->pfifo.regs[NV_PFIFO_CACHE1_STATUS];
 
     if (!GET_MASK(*push0, NV_PFIFO_CACHE1_PUSH0_ACCESS) ||
         !GET_MASK(*dma_push, NV_PFIFO_CACHE1_DMA_PUSH_ACCESS) ||
         GET_MASK(*dma_push, NV_PFIFO_CACHE1_DMA_PUSH_STATUS)) {
-        return;
+        return false;
+    }
+
+    if (pfifo_pusher_should_stall(d)) {
+        return false;
     }
 
     // TODO: should we become busy here??
@@ -280,9 +432,19 @@ static void pfifo_run_pusher(NV2AState *d)
     assert(GET_MASK(*push1, NV_PFIFO_CACHE1_PUSH1_MODE)
             == NV_PFIFO_CACHE1_PUSH1_MODE_DMA);
 
-    /* We're running so there should be no pending errors... */
-    assert(GET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_ERROR)
-            == NV_PFIFO_CACHE1_DMA_STATE_ERROR_NONE);
+    if (!q->decode_valid) {
+        q->decode = pfifo_load_dma_state(d);
+        q->decode_valid = true;
+
+        /* We're running so there should be no pending errors... */
+        assert(GET_MASK(q->decode.state, NV_PFIFO_CACHE1_DMA_STATE_ERROR)
+                == NV_PFIFO_CACHE1_DMA_STATE_ERROR_NONE);
+    }
+
+    /* Nothing more to decode until the puller has committed the error */
+    if (GET_MASK(q->decode.state, NV_PFIFO_CACHE1_DMA_STATE_ERROR)) {
+        return false;
+    }
 
     hwaddr dma_instance =
         GET_MASK(d->pfifo.regs[NV_PFIFO_CACHE1_DMA_INSTANCE],
@@ -290,148 +452,138 @@ static void pfifo_run_pusher(NV2AState *d)
 
     hwaddr dma_len;
     uint8_t *dma = nv_dma_map(d, dma_instance, &dma_len);
-
-    while (!pfifo_pusher_should_stall(d)) {
-        uint32_t dma_get_v = *dma_get;
-        uint32_t dma_put_v = *dma_put;
-        if (dma_get_v == dma_put_v) break;
-        if (dma_get_v >= dma_len) {
-            assert(false);
-            SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
-                     NV_PFIFO_CACHE1_DMA_STATE_ERROR_PROTECTION);
+    uint32_t dma_put = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_PUT];
+
+    PfifoDmaState start = q->decode;
+
+    while (q->count < PFIFO_METHOD_QUEUE_SIZE) {
+        int tail = (q->head + q->count) % PFIFO_METHOD_QUEUE_SIZE;
+        int max_records = MIN(PFIFO_METHOD_QUEUE_SIZE - q->count,
+                              PFIFO_METHOD_QUEUE_SIZE - tail);
+        int num_records = pfifo_decode_methods(
+            dma, dma_len, dma_put, &q->decode, &q->records[tail], max_records);
+        q->count += num_records;
+        if (num_records < max_records) {
             break;
         }
+    }
 
-        size_t num_words_available = dma_put_v - dma_get_v;
-        assert(num_words_available % 4 == 0);
-        num_words_available /= 4;
-
-        uint32_t *word_ptr = (uint32_t*)(dma + dma_get_v);
-        uint32_t word = ldl_le_p(word_ptr);
-        dma_get_v += 4;
-
-        uint32_t method_type =
-            GET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE);
-        uint32_t method_subchannel =
-            GET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_SUBCHANNEL);
-        uint32_t method =
-            GET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD) << 2;
-        uint32_t method_count =
-            GET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT);
-
-        uint32_t subroutine_state =
-            GET_MASK(*dma_subroutine, NV_PFIFO_CACHE1_DMA_SUBROUTINE_STATE);
-
-        if (method_count) {
-            /* data word of methods command */
-            d->pfifo.regs[NV_PFIFO_CACHE1_DMA_DATA_SHADOW] = word;
-
-            assert((method & 3) == 0);
-            uint32_t method_entry = 0;
-            SET_MASK(method_entry, NV_PFIFO_CACHE1_METHOD_ADDRESS, method >> 2);
-            SET_MASK(method_entry, NV_PFIFO_CACHE1_METHOD_TYPE, method_type);
-            SET_MASK(method_entry, NV_PFIFO_CACHE1_METHOD_SUBCHANNEL,
-                     method_subchannel);
-
-            *status &= ~NV_PFIFO_CACHE1_STATUS_LOW_MARK;
-
-            ssize_t num_words_processed =
-                pfifo_run_puller(d, method_entry, word, word_ptr,
-                                 MIN(method_count, num_words_available),
-                                 num_words_available);
-            if (num_words_processed < 0) {
-                break;
-            }
+    return !pfifo_dma_state_equal(&start, &q->decode);
+}
+
+/*
+ * Execute one batch from the method queue and commit the DMA and PULL state
+ * it consumed. Called with pfifo.lock held, which is dropped while PGRAPH
+ * runs. Returns true if progress was made and the puller did not stall.
+ */
+static bool pfifo_run_puller(NV2AState *d)
+{
+    PfifoMethodQueue *q = d->pfifo.method_queue;
+    uint32_t *pull0 = &d->pfifo.regs[NV_PFIFO_CACHE1_PULL0];
+    uint32_t *pull1 = &d->pfifo.regs[NV_PFIFO_CACHE1_PULL1];
+    uint32_t *engine_reg = &d->pfifo.regs[NV_PFIFO_CACHE1_ENGINE];
+    uint32_t *dma_state = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_STATE];
+    uint32_t *dma_push = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_PUSH];
+    uint32_t *status = &d->pfifo.regs[NV_PFIFO_CACHE1_STATUS];
 
-            dma_get_v += (num_words_processed-1)*4;
+    if (!q->decode_valid) {
+        return false;
+    }
+
+    PfifoMethodRecord batch[PFIFO_METHOD_BATCH_SIZE];
+    int num_records = GET_MASK(*pull0, NV_PFIFO_CACHE1_PULL0_ACCESS) ?
+                          MIN(q->count, PFIFO_METHOD_BATCH_SIZE) : 0;
+    for (int i = 0; i < num_records; i++) {
+        batch[i] = q->records[(q->head + i) % PFIFO_METHOD_QUEUE_SIZE];
+    }
+
+    /*
+     * Records are only appended while the batch runs, so the state following
+     * the batch is known now.
+     */
+    PfifoDmaState end =
+        num_records < q->count ?
+            q->records[(q->head + num_records) % PFIFO_METHOD_QUEUE_SIZE]
+                .start :
+            q->decode;
+    uint32_t epoch = q->epoch;
+    bool stalled = false;
+
+    if (num_records > 0) {
+        PfifoPullState pull = {
+            .d = d,
+            .ramht = d->pfifo.regs[NV_PFIFO_RAMHT],
+            .channel_id = GET_MASK(d->pfifo.regs[NV_PFIFO_CACHE1_PUSH1],
+                                   NV_PFIFO_CACHE1_PUSH1_CHID),
+            .engine = *engine_reg,
+            .pull1 = *pull1,
+        };
+        PfifoPullState pull_start = pull;
+
+        nv2a_profile_inc_counter(NV2A_PROF_PFIFO_BATCH);
+        nv2a_profile_add_counter(NV2A_PROF_PFIFO_BATCH_RECORDS, num_records);
+
+        *status &= ~NV_PFIFO_CACHE1_STATUS_LOW_MARK;
+        pfifo_update_shadow_regs(d);
+
+        qemu_mutex_unlock(&d->pfifo.lock);
+        qemu_mutex_lock(&d->pgraph.lock);
+
+        int num_done =
+            pfifo_drain_methods(batch, num_records, pfifo_run_method, &pull);
+        nv2a_profile_add_counter(NV2A_PROF_PFIFO_BATCH_METHODS,
+                                 pull.num_methods);
+
+        qemu_mutex_unlock(&d->pgraph.lock);
+        qemu_mutex_lock(&d->pfifo.lock);
+
+        if (num_done < num_records) {
+            end = batch[num_done].start;
+            stalled = true;
+        }
 
-            if (method_type == NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE_INC) {
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD,
-                         (method + 4*num_words_processed) >> 2);
+        /* Keep any guest write made while the batch ran */
+        if (pull.engine != pull_start.engine) {
+            *engine_reg = pull.engine;
+        }
+        if (pull.pull1 != pull_start.pull1) {
+            *pull1 = pull.pull1;
+        }
+
+        if (q->epoch == epoch) {
+            q->head = (q->head + num_done) % PFIFO_METHOD_QUEUE_SIZE;
+            q->count -= num_done;
+            if (stalled) {
+                q->records[q->head] = batch[num_done];
             }
-            SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT,
-                     method_count - MIN(method_count, num_words_processed));
-
-            (*dma_dcount) += num_words_processed;
-        } else {
-            /* no command active - this is the first word of a new one */
-            d->pfifo.regs[NV_PFIFO_CACHE1_DMA_RSVD_SHADOW] = word;
-
-            /* match all forms */
-            if ((word & 0xe0000003) == 0x20000000) {
-                /* old jump */
-                d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET_JMP_SHADOW] =
-                    dma_get_v;
-                dma_get_v = word & 0x1fffffff;
-                NV2A_DPRINTF("pb OLD_JMP 0x%x\n", dma_get_v);
-            } else if ((word & 3) == 1) {
-                /* jump */
-                d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET_JMP_SHADOW] =
-                    dma_get_v;
-                dma_get_v = word & 0xfffffffc;
-                NV2A_DPRINTF("pb JMP 0x%x\n", dma_get_v);
-            } else if ((word & 3) == 2) {
-                /* call */
-                if (subroutine_state) {
-                    SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
-                             NV_PFIFO_CACHE1_DMA_STATE_ERROR_CALL);
-                    break;
-                } else {
-                    *dma_subroutine = dma_get_v;
-                    SET_MASK(*dma_subroutine,
-                             NV_PFIFO_CACHE1_DMA_SUBROUTINE_STATE, 1);
-                    dma_get_v = word & 0xfffffffc;
-                    NV2A_DPRINTF("pb CALL 0x%x\n", dma_get_v);
-                }
-            } else if (word == 0x00020000) {
-                /* return */
-                if (!subroutine_state) {
-                    SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
-                             NV_PFIFO_CACHE1_DMA_STATE_ERROR_RETURN);
-                    // break;
-                } else {
-                    dma_get_v = *dma_subroutine & 0xfffffffc;
-                    SET_MASK(*dma_subroutine,
-                             NV_PFIFO_CACHE1_DMA_SUBROUTINE_STATE, 0);
-                    NV2A_DPRINTF("pb RET 0x%x\n", dma_get_v);
-                }
-            } else if ((word & 0xe0030003) == 0) {
-                /* increasing methods */
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD,
-                         (word & 0x1fff) >> 2 );
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_SUBCHANNEL,
-                         (word >> 13) & 7);
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT,
-                         (word >> 18) & 0x7ff);
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE,
-                         NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE_INC);
-                *dma_dcount = 0;
-            } else if ((word & 0xe0030003) == 0x40000000) {
-                /* non-increasing methods */
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD,
-                         (word & 0x1fff) >> 2 );
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_SUBCHANNEL,
-                         (word >> 13) & 7);
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT,
-                         (word >> 18) & 0x7ff);
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE,
-                         NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE_NON_INC);
-                *dma_dcount = 0;
-            } else {
-                NV2A_DPRINTF("pb reserved cmd 0x%x - 0x%x\n",
-                             dma_get_v, word);
-                SET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
-                         NV_PFIFO_CACHE1_DMA_STATE_ERROR_RESERVED_CMD);
-                // break;
-                assert(false);
+            if (num_done) {
+                pfifo_kick_pusher(d);
             }
         }
+    }
 
-        *dma_get = dma_get_v;
+    PfifoDmaState committed = pfifo_load_dma_state(d);
+    bool progress = !pfifo_dma_state_equal(&committed, &end);
 
-        if (GET_MASK(*dma_state, NV_PFIFO_CACHE1_DMA_STATE_ERROR)) {
-            break;
-        }
+    if (progress) {
+        pfifo_store_dma_state(d, &end);
+    }
+
+    /*
+     * A guest write raced with the batch. The executed words are committed
+     * regardless, so restart decoding from there.
+     */
+    if (q->epoch != epoch) {
+        pfifo_invalidate_method_queue(d);
+    }
+
+    if (q->count == 0 && !(*status & NV_PFIFO_CACHE1_STATUS_LOW_MARK)) {
+        *status |= NV_PFIFO_CACHE1_STATUS_LOW_MARK;
+        progress = true;
+    }
+
+    if (progress) {
+        pfifo_update_shadow_regs(d);
     }
 
     // NV2A_DPRINTF("DMA pusher done: max 0x%" HWADDR_PRIx ", 0x%" HWADDR_PRIx " - 0x%" HWADDR_PRIx "\n",
@@ -443,10 +595,39 @@ static void pfifo_run_pusher(NV2AState *d)
         assert(false);
 
         SET_MASK(*dma_push, NV_PFIFO_CACHE1_DMA_PUSH_STATUS, 1); /* suspended */
+        pfifo_invalidate_method_queue(d);
 
         // d->pfifo.pending_interrupts |= NV_PFIFO_INTR_0_DMA_PUSHER;
         // nv2a_update_irq(d);
+        return false;
+    }
+
+    return progress && !stalled;
+}
+
+static void *pfifo_pusher_thread(void *arg)
+{
+    NV2AState *d = (NV2AState *)arg;
+
+    rcu_register_thread();
+
+    qemu_mutex_lock(&d->pfifo.lock);
+    while (!d->exiting) {
+        d->pfifo.pusher_kick = false;
+
+        if (!qatomic_read(&d->pfifo.halt) && pfifo_run_pusher(d)) {
+            pfifo_kick_puller(d);
+        }
+
+        if (!d->pfifo.pusher_kick && !d->exiting) {
+            qemu_cond_wait(&d->pfifo.pusher_cond, &d->pfifo.lock);
+        }
     }
+    qemu_mutex_unlock(&d->pfifo.lock);
+
+    rcu_unregister_thread();
+
+    return NULL;
 }
 
 void *pfifo_thread(void *arg)
@@ -464,7 +645,11 @@ void *pfifo_thread(void *arg)
         pgraph_process_pending(d);
 
         if (!d->pfifo.halt) {
-            pfifo_run_pusher(d);
+            do {
+                if (!d->pfifo.pipelined) {
+                    pfifo_run_pusher(d);
+                }
+            } while (pfifo_run_puller(d));
         }
 
         pgraph_process_pending_reports(d);
@@ -487,10 +672,42 @@ void *pfifo_thread(void *arg)
     return NULL;
 }
 
-static uint32_t ramht_hash(NV2AState *d, uint32_t handle)
+void pfifo_init(NV2AState *d)
+{
+    d->pfifo.method_queue = g_malloc0(sizeof(PfifoMethodQueue));
+    d->pfifo.pipelined = g_config.perf.pipeline_fifo;
+
+    qemu_thread_create(&d->pfifo.thread, "nv2a.pfifo_thread",
+                       pfifo_thread, d, QEMU_THREAD_JOINABLE);
+    if (d->pfifo.pipelined) {
+        qemu_thread_create(&d->pfifo.pusher_thread, "nv2a.pusher_thread",
+                           pfifo_pusher_thread, d, QEMU_THREAD_JOINABLE);
+    }
+}
+
+void pfifo_destroy(NV2AState *d)
+{
+    assert(d->exiting);
+
+    qemu_mutex_lock(&d->pfifo.lock);
+    qemu_cond_broadcast(&d->pfifo.fifo_cond);
+    qemu_cond_broadcast(&d->pfifo.pusher_cond);
+    qemu_mutex_unlock(&d->pfifo.lock);
+
+    qemu_thread_join(&d->pfifo.thread);
+    if (d->pfifo.pipelined) {
+        qemu_thread_join(&d->pfifo.pusher_thread);
+    }
+
+    g_free(d->pfifo.method_queue);
+    d->pfifo.method_queue = NULL;
+}
+
+static uint32_t ramht_hash(uint32_t ramht, unsigned int channel_id,
+                           uint32_t handle)
 {
     unsigned int ramht_size =
-        1 << (GET_MASK(d->pfifo.regs[NV_PFIFO_RAMHT], NV_PFIFO_RAMHT_SIZE)+12);
+        1 << (GET_MASK(ramht, NV_PFIFO_RAMHT_SIZE)+12);
 
     /* XXX: Think this is different to what nouveau calculates... */
     unsigned int bits = ctz32(ramht_size)-1;
@@ -501,25 +718,28 @@ static uint32_t ramht_hash(NV2AState *d, uint32_t handle)
         handle >>= bits;
     }
 
-    unsigned int channel_id = GET_MASK(d->pfifo.regs[NV_PFIFO_CACHE1_PUSH1],
-                                       NV_PFIFO_CACHE1_PUSH1_CHID);
     hash ^= channel_id << (bits - 4);
 
     return hash;
 }
 
 
-static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t handle)
+/*
+ * Look up @handle in the RAMHT described by the @ramht register value for
+ * @channel_id. Takes the register values rather than reading them, so the
+ * puller can call it without pfifo.lock.
+ */
+static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t ramht,
+                               unsigned int channel_id, uint32_t handle)
 {
     hwaddr ramht_size =
-        1 << (GET_MASK(d->pfifo.regs[NV_PFIFO_RAMHT], NV_PFIFO_RAMHT_SIZE)+12);
+        1 << (GET_MASK(ramht, NV_PFIFO_RAMHT_SIZE)+12);
 
-    uint32_t hash = ramht_hash(d, handle);
+    uint32_t hash = ramht_hash(ramht, channel_id, handle);
     assert(hash * 8 < ramht_size);
 
     hwaddr ramht_address =
-        GET_MASK(d->pfifo.regs[NV_PFIFO_RAMHT],
-                 NV_PFIFO_RAMHT_BASE_ADDRESS) << 12;
+        GET_MASK(ramht, NV_PFIFO_RAMHT_BASE_ADDRESS) << 12;
 
     assert(ramht_address + hash * 8 < memory_region_size(&d->ramin));
 
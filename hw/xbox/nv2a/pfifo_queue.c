@@ -0,0 +1,310 @@
+/*
+ * QEMU Geforce NV2A PFIFO method queue
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/host-utils.h"
+#include "debug.h"
+#include "nv2a_regs.h"
+#include "pfifo_queue.h"
+
+void pfifo_advance_dma_state(PfifoDmaState *s, const uint32_t *words,
+                             size_t num_words)
+{
+    uint32_t method = GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD);
+    uint32_t method_count =
+        GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT);
+
+    if (num_words) {
+        s->data_shadow = ldl_le_p(&words[num_words - 1]);
+    }
+    s->get += num_words * 4;
+    if (GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE) ==
+        NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE_INC) {
+        SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD,
+                 method + num_words);
+    }
+    SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT,
+             method_count - MIN(method_count, num_words));
+    s->dcount += num_words;
+}
+
+static void pfifo_consume_record_words(PfifoMethodRecord *rec,
+                                       size_t num_words)
+{
+    assert(num_words <= rec->num_words);
+
+    pfifo_advance_dma_state(&rec->start, rec->parameters, num_words);
+    rec->num_words -= num_words;
+    rec->max_lookahead_words -= num_words;
+    rec->parameters += num_words;
+    if (rec->inc) {
+        rec->method += num_words * 4;
+    }
+}
+
+bool pfifo_dma_state_equal(const PfifoDmaState *a, const PfifoDmaState *b)
+{
+    return a->get == b->get && a->state == b->state &&
+           a->subroutine == b->subroutine && a->dcount == b->dcount &&
+           a->rsvd_shadow == b->rsvd_shadow &&
+           a->get_jmp_shadow == b->get_jmp_shadow &&
+           a->data_shadow == b->data_shadow;
+}
+
+/*
+ * Decode up to @max_records method records from the pushbuffer into @queue,
+ * starting at and advancing @s, until @dma_put is reached. Only @s and @queue
+ * are written. Returns the number of records decoded.
+ */
+int pfifo_decode_methods(uint8_t *dma, hwaddr dma_len, uint32_t dma_put,
+                         PfifoDmaState *s, PfifoMethodRecord *queue,
+                         int max_records)
+{
+    int num_records = 0;
+
+    while (num_records < max_records) {
+        uint32_t dma_get_v = s->get;
+        uint32_t dma_put_v = dma_put;
+        if (dma_get_v == dma_put_v) break;
+        if (dma_get_v >= dma_len) {
+            assert(false);
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
+                     NV_PFIFO_CACHE1_DMA_STATE_ERROR_PROTECTION);
+            break;
+        }
+
+        size_t num_words_available = dma_put_v - dma_get_v;
+        assert(num_words_available % 4 == 0);
+        num_words_available /= 4;
+
+        uint32_t *word_ptr = (uint32_t*)(dma + dma_get_v);
+        uint32_t word = ldl_le_p(word_ptr);
+        dma_get_v += 4;
+
+        uint32_t method_type =
+            GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE);
+        uint32_t method_subchannel =
+            GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_SUBCHANNEL);
+        uint32_t method =
+            GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD) << 2;
+        uint32_t method_count =
+            GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT);
+
+        uint32_t subroutine_state =
+            GET_MASK(s->subroutine, NV_PFIFO_CACHE1_DMA_SUBROUTINE_STATE);
+
+        if (method_count) {
+            /* data word of methods command */
+            assert((method & 3) == 0);
+            assert(method == 0 || method >= 0x100);
+
+            PfifoMethodRecord *rec = &queue[num_records++];
+            *rec = (PfifoMethodRecord){
+                .start = *s,
+                .subchannel = method_subchannel,
+                .method = method,
+                .inc = method_type == NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE_INC,
+                .parameters = word_ptr,
+                .num_words = MIN(method_count, num_words_available),
+            };
+
+            /*
+             * Methods that take objects are translated through RAMHT one
+             * word at a time.
+             * TODO: Check this range is correct for the nv2a
+             */
+            if (method == 0 || (method >= 0x180 && method < 0x200)) {
+                rec->num_words = 1;
+            }
+
+            pfifo_advance_dma_state(s, word_ptr, rec->num_words);
+            continue;
+        }
+
+        /* no command active - this is the first word of a new one */
+        s->rsvd_shadow = word;
+
+        /* match all forms */
+        if ((word & 0xe0000003) == 0x20000000) {
+            /* old jump */
+            s->get_jmp_shadow = dma_get_v;
+            dma_get_v = word & 0x1fffffff;
+            NV2A_DPRINTF("pb OLD_JMP 0x%x\n", dma_get_v);
+        } else if ((word & 3) == 1) {
+            /* jump */
+            s->get_jmp_shadow = dma_get_v;
+            dma_get_v = word & 0xfffffffc;
+            NV2A_DPRINTF("pb JMP 0x%x\n", dma_get_v);
+        } else if ((word & 3) == 2) {
+            /* call */
+            if (subroutine_state) {
+                SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
+                         NV_PFIFO_CACHE1_DMA_STATE_ERROR_CALL);
+                break;
+            } else {
+                s->subroutine = dma_get_v;
+                SET_MASK(s->subroutine,
+                         NV_PFIFO_CACHE1_DMA_SUBROUTINE_STATE, 1);
+                dma_get_v = word & 0xfffffffc;
+                NV2A_DPRINTF("pb CALL 0x%x\n", dma_get_v);
+            }
+        } else if (word == 0x00020000) {
+            /* return */
+            if (!subroutine_state) {
+                SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
+                         NV_PFIFO_CACHE1_DMA_STATE_ERROR_RETURN);
+                // break;
+            } else {
+                dma_get_v = s->subroutine & 0xfffffffc;
+                SET_MASK(s->subroutine,
+                         NV_PFIFO_CACHE1_DMA_SUBROUTINE_STATE, 0);
+                NV2A_DPRINTF("pb RET 0x%x\n", dma_get_v);
+            }
+        } else if ((word & 0xe0030003) == 0) {
+            /* increasing methods */
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD,
+                     (word & 0x1fff) >> 2 );
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_SUBCHANNEL,
+                     (word >> 13) & 7);
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT,
+                     (word >> 18) & 0x7ff);
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE,
+                     NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE_INC);
+            s->dcount = 0;
+        } else if ((word & 0xe0030003) == 0x40000000) {
+            /* non-increasing methods */
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD,
+                     (word & 0x1fff) >> 2 );
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_SUBCHANNEL,
+                     (word >> 13) & 7);
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_COUNT,
+                     (word >> 18) & 0x7ff);
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE,
+                     NV_PFIFO_CACHE1_DMA_STATE_METHOD_TYPE_NON_INC);
+            s->dcount = 0;
+        } else {
+            NV2A_DPRINTF("pb reserved cmd 0x%x - 0x%x\n",
+                         dma_get_v, word);
+            SET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_ERROR,
+                     NV_PFIFO_CACHE1_DMA_STATE_ERROR_RESERVED_CMD);
+            // break;
+            assert(false);
+        }
+
+        s->get = dma_get_v;
+
+        if (GET_MASK(s->state, NV_PFIFO_CACHE1_DMA_STATE_ERROR)) {
+            break;
+        }
+    }
+
+    return num_records;
+}
+
+/*
+ * Set how far each record's method may look ahead: to the end of the run of
+ * records that follow it in the pushbuffer separated by at most one command
+ * word, so everything a method reads is in @queue.
+ */
+static void pfifo_set_lookahead(PfifoMethodRecord *queue, int num_records)
+{
+    size_t lookahead = 0;
+
+    for (int i = num_records - 1; i >= 0; i--) {
+        PfifoMethodRecord *rec = &queue[i];
+        uint32_t end = rec->start.get + rec->num_words * 4;
+
+        if (i + 1 < num_records) {
+            uint32_t gap = queue[i + 1].start.get - end;
+            lookahead = gap <= 4 ? lookahead + gap / 4 : 0;
+        }
+        lookahead += rec->num_words;
+        rec->max_lookahead_words = lookahead;
+    }
+}
+
+/*
+ * The method at the front of @queue consumed @num_words words, running past
+ * the end of its record. Consume the records it covered so they are skipped.
+ */
+static void pfifo_consume_lookahead(PfifoMethodRecord *queue, int num_records,
+                                    size_t num_words)
+{
+    PfifoMethodRecord *rec = &queue[0];
+    uint32_t end = rec->start.get + rec->num_words * 4;
+    size_t remaining = num_words - rec->num_words;
+
+    assert(num_words <= rec->max_lookahead_words);
+    pfifo_consume_record_words(rec, rec->num_words);
+
+    for (int i = 1; i < num_records && remaining; i++) {
+        PfifoMethodRecord *next = &queue[i];
+        size_t gap = (next->start.get - end) / 4;
+
+        /* Only records in the lookahead window can be reached */
+        assert(gap <= 1);
+        if (remaining <= gap) {
+            break;
+        }
+        remaining -= gap;
+        end = next->start.get + next->num_words * 4;
+
+        size_t n = MIN(next->num_words, remaining);
+        pfifo_consume_record_words(next, n);
+        remaining -= n;
+    }
+}
+
+/*
+ * Run a batch of method records through @run_method, consuming them in
+ * place. Returns the number of records fully processed; if it is less than
+ * @num_records, the next record has been partially consumed up to the word
+ * the method stalled on.
+ */
+int pfifo_drain_methods(PfifoMethodRecord *queue, int num_records,
+                        PfifoMethodFunc run_method, void *opaque)
+{
+    int i;
+
+    pfifo_set_lookahead(queue, num_records);
+
+    for (i = 0; i < num_records; i++) {
+        PfifoMethodRecord *rec = &queue[i];
+
+        while (rec->num_words) {
+            int num_proc = run_method(opaque, rec);
+            if (num_proc < 0) {
+                break;
+            }
+
+            if (num_proc > rec->num_words) {
+                pfifo_consume_lookahead(rec, num_records - i, num_proc);
+            } else {
+                pfifo_consume_record_words(rec, num_proc);
+            }
+        }
+
+        if (rec->num_words) {
+            break;
+        }
+    }
+
+    return i;
+}
@@ -0,0 +1,63 @@
+/*
+ * QEMU Geforce NV2A PFIFO method queue
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_XBOX_NV2A_PFIFO_QUEUE_H
+#define HW_XBOX_NV2A_PFIFO_QUEUE_H
+
+#include "qemu/osdep.h"
+#include "exec/hwaddr.h"
+
+typedef struct PfifoDmaState {
+    uint32_t get;
+    uint32_t state;
+    uint32_t subroutine;
+    uint32_t dcount;
+    uint32_t rsvd_shadow;
+    uint32_t get_jmp_shadow;
+    uint32_t data_shadow;
+} PfifoDmaState;
+
+typedef struct PfifoMethodRecord {
+    PfifoDmaState start; /* DMA state before the first unconsumed word */
+    unsigned int subchannel;
+    unsigned int method;
+    bool inc;
+    uint32_t *parameters;
+    size_t num_words;
+    size_t max_lookahead_words; /* Set by pfifo_drain_methods */
+} PfifoMethodRecord;
+
+/*
+ * Execute the method at the front of @rec. Returns the number of words
+ * consumed, or -1 to stall. Up to rec->max_lookahead_words may be consumed;
+ * words past the end of @rec belong to the records that follow it, which are
+ * then consumed without being executed.
+ */
+typedef int (*PfifoMethodFunc)(void *opaque, PfifoMethodRecord *rec);
+
+void pfifo_advance_dma_state(PfifoDmaState *s, const uint32_t *words,
+                             size_t num_words);
+bool pfifo_dma_state_equal(const PfifoDmaState *a, const PfifoDmaState *b);
+int pfifo_decode_methods(uint8_t *dma, hwaddr dma_len, uint32_t dma_put,
+                         PfifoDmaState *s, PfifoMethodRecord *queue,
+                         int max_records);
+int pfifo_drain_methods(PfifoMethodRecord *queue, int num_records,
+                        PfifoMethodFunc run_method, void *opaque);
+
+#endif
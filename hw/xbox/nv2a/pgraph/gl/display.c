@@ -29,9 +29,10 @@
 
 #ifdef __ANDROID__
 #include <android/log.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include "qemu/thread.h"
 #include <string.h>
-#include "system/memory.h"
 #endif
 
 #ifdef __ANDROID__
@@ -52,6 +53,12 @@ static void check_gl_error_android(const char *context)
 #endif
 
 #ifdef __ANDROID__
+/*
+ * CPU readback fallback, android.force_cpu_blit (on by default): the composed
+ * display is read back after each sync and uploaded again by the presenter.
+ * It stays the default until the fence/EGLImage path has been validated on
+ * devices.
+ */
 static QemuMutex g_android_readback_mutex;
 static bool g_android_readback_mutex_init = false;
 static uint8_t *g_android_readback_buf = NULL;
@@ -200,6 +207,162 @@ bool nv2a_android_copy_readback(uint8_t **buffer, size_t *buffer_size,
 
 #endif
 
+#ifdef __ANDROID__
+/*
+ * The display buffer is exported as an EGLImage so the presenting context can
+ * sample it even when it does not share objects with the render context.
+ */
+static EGLImageKHR g_android_display_image = EGL_NO_IMAGE_KHR;
+static unsigned int g_android_display_image_generation;
+
+static void android_destroy_display_image(void)
+{
+    if (g_android_display_image == EGL_NO_IMAGE_KHR) {
+        return;
+    }
+
+    PFNEGLDESTROYIMAGEKHRPROC p_eglDestroyImageKHR =
+        (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+    if (p_eglDestroyImageKHR) {
+        p_eglDestroyImageKHR(eglGetCurrentDisplay(), g_android_display_image);
+    }
+    g_android_display_image = EGL_NO_IMAGE_KHR;
+}
+
+static void android_export_display_image(GLuint texture)
+{
+    android_destroy_display_image();
+
+    PFNEGLCREATEIMAGEKHRPROC p_eglCreateImageKHR =
+        (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+    if (!p_eglCreateImageKHR) {
+        return;
+    }
+
+    static const EGLint attribs[] = {
+        EGL_GL_TEXTURE_LEVEL_KHR, 0,
+        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+        EGL_NONE,
+    };
+    g_android_display_image = p_eglCreateImageKHR(
+        eglGetCurrentDisplay(), eglGetCurrentContext(), EGL_GL_TEXTURE_2D_KHR,
+        (EGLClientBuffer)(uintptr_t)texture, attribs);
+    if (g_android_display_image == EGL_NO_IMAGE_KHR) {
+        __android_log_print(ANDROID_LOG_WARN, "xemu-android",
+                            "render_display: eglCreateImageKHR failed 0x%x",
+                            eglGetError());
+        return;
+    }
+    g_android_display_image_generation++;
+}
+
+bool nv2a_android_get_framebuffer_image(void **image,
+                                        unsigned int *generation)
+{
+    if (g_android_display_image == EGL_NO_IMAGE_KHR) {
+        return false;
+    }
+    *image = g_android_display_image;
+    *generation = g_android_display_image_generation;
+    return true;
+}
+#endif
+
+/*
+ * Hand work off to another context: the producer inserts a fence and flushes,
+ * the consumer makes its GPU queue wait on the fence. The CPU does not block
+ * on either side. Android uses EGL fences, which also order contexts that only
+ * share the display buffer through an EGLImage.
+ */
+#ifdef __ANDROID__
+static PFNEGLCREATESYNCKHRPROC p_eglCreateSyncKHR;
+static PFNEGLDESTROYSYNCKHRPROC p_eglDestroySyncKHR;
+static PFNEGLWAITSYNCKHRPROC p_eglWaitSyncKHR;
+static PFNEGLCLIENTWAITSYNCKHRPROC p_eglClientWaitSyncKHR;
+
+static bool load_egl_sync_symbols(void)
+{
+    static bool loaded, available;
+
+    if (!loaded) {
+        loaded = true;
+        p_eglCreateSyncKHR =
+            (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+        p_eglDestroySyncKHR =
+            (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+        p_eglWaitSyncKHR =
+            (PFNEGLWAITSYNCKHRPROC)eglGetProcAddress("eglWaitSyncKHR");
+        p_eglClientWaitSyncKHR = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress(
+            "eglClientWaitSyncKHR");
+        available = p_eglCreateSyncKHR && p_eglDestroySyncKHR &&
+                    (p_eglWaitSyncKHR || p_eglClientWaitSyncKHR);
+    }
+    return available;
+}
+
+static void *display_fence_create(void)
+{
+    if (!load_egl_sync_symbols()) {
+        glFinish();
+        return NULL;
+    }
+
+    EGLSyncKHR sync =
+        p_eglCreateSyncKHR(eglGetCurrentDisplay(), EGL_SYNC_FENCE_KHR, NULL);
+    if (sync == EGL_NO_SYNC_KHR) {
+        glFinish();
+        return NULL;
+    }
+    glFlush();
+    return sync;
+}
+
+static void display_fence_destroy(void **fence)
+{
+    if (*fence) {
+        p_eglDestroySyncKHR(eglGetCurrentDisplay(), *fence);
+        *fence = NULL;
+    }
+}
+
+static void display_fence_wait(void **fence)
+{
+    if (!*fence) {
+        return;
+    }
+    if (p_eglWaitSyncKHR) {
+        p_eglWaitSyncKHR(eglGetCurrentDisplay(), *fence, 0);
+    } else {
+        p_eglClientWaitSyncKHR(eglGetCurrentDisplay(), *fence, 0,
+                               EGL_FOREVER_KHR);
+    }
+    display_fence_destroy(fence);
+}
+#else
+static void *display_fence_create(void)
+{
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    return fence;
+}
+
+static void display_fence_destroy(void **fence)
+{
+    if (*fence) {
+        glDeleteSync(*fence);
+        *fence = NULL;
+    }
+}
+
+static void display_fence_wait(void **fence)
+{
+    if (*fence) {
+        glWaitSync(*fence, 0, GL_TIMEOUT_IGNORED);
+        display_fence_destroy(fence);
+    }
+}
+#endif
+
 void pgraph_gl_init_display(NV2AState *d)
 {
     struct PGRAPHState *pg = &d->pgraph;
@@ -254,6 +417,7 @@ void pgraph_gl_init_display(NV2AState *d)
         "uniform bool clip_enable;\n"
         "uniform vec4 clip_rect;\n"
         "layout(location = 0) out vec4 out_Color;\n"
+        PVIDEO_YUY2_GLSL
         "void main()\n"
         "{\n"
         "    vec2 uv = gl_FragCoord.xy/display_size;\n"
@@ -275,9 +439,9 @@ void pgraph_gl_init_display(NV2AState *d)
         "                           greaterThan(screenCoord, output_region.zw));\n"
         "        if (!any(clip) && (!pvideo_color_key_enable || out_Color.rgb == pvideo_color_key)) {\n"
         "            vec2 out_xy = (screenCoord - pvideo_pos.xy) * pvideo_scale.z;\n"
-        "            vec2 in_st = (pvideo_in_pos + out_xy * pvideo_scale.xy) / vec2(textureSize(pvideo_tex, 0));\n"
-        "            in_st.y *= -1.0;\n"
-        "            out_Color.rgba = texture(pvideo_tex, in_st);\n"
+        "            vec2 in_xy = pvideo_in_pos + out_xy * pvideo_scale.xy;\n"
+        "            in_xy.y = float(textureSize(pvideo_tex, 0).y) - in_xy.y;\n"
+        "            out_Color.rgba = pvideo_sample(pvideo_tex, in_xy);\n"
         "        }\n"
         "    }\n"
         "}\n";
@@ -318,6 +482,12 @@ void pgraph_gl_finalize_display(PGRAPHState *pg)
     glo_set_current(g_nv2a_context_display);
 #endif
 
+    display_fence_destroy(&r->display_ready_fence);
+    display_fence_destroy(&r->display_release_fence);
+#ifdef __ANDROID__
+    android_destroy_display_image();
+#endif
+
     glDeleteTextures(1, &r->gl_display_buffer);
     r->gl_display_buffer = 0;
 
@@ -339,25 +509,6 @@ void pgraph_gl_finalize_display(PGRAPHState *pg)
     glo_set_current(g_nv2a_context_render);
 }
 
-static uint8_t *convert_texture_data__CR8YB8CB8YA8(const uint8_t *data,
-                                                   unsigned int width,
-                                                   unsigned int height,
-                                                   unsigned int pitch)
-{
-    uint8_t *converted_data = (uint8_t *)g_malloc(width * height * 4);
-    int x, y;
-    for (y = 0; y < height; y++) {
-        const uint8_t *line = &data[y * pitch];
-        const uint32_t row_offset = y * width;
-        for (x = 0; x < width; x++) {
-            uint8_t *pixel = &converted_data[(row_offset + x) * 4];
-            convert_yuy2_to_rgb(line, x, &pixel[0], &pixel[1], &pixel[2]);
-            pixel[3] = 255;
-        }
-    }
-    return converted_data;
-}
-
 static float pvideo_calculate_scale(unsigned int din_dout,
                                            unsigned int output_size)
 {
@@ -466,12 +617,18 @@ static void render_display_pvideo_overlay(NV2AState *d)
     glBindTexture(GL_TEXTURE_2D, r->disp_rndr.pvideo_tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    uint8_t *tex_rgba = convert_texture_data__CR8YB8CB8YA8(
-        d->vram_ptr + base + offset, in_width, in_height, in_pitch);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, in_width, in_height, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, tex_rgba);
-    g_free(tex_rgba);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Raw YUY2 bytes, converted to RGB by the display shader
+    int prev_unpack_alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &prev_unpack_alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, in_pitch / 2);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8,
+                 pvideo_yuy2_texture_width(in_width, in_pitch), in_height, 0,
+                 GL_RG, GL_UNSIGNED_BYTE, d->vram_ptr + base + offset);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, prev_unpack_alignment);
     glUniform1i(r->disp_rndr.pvideo_tex_loc, 1);
     glUniform2f(r->disp_rndr.pvideo_in_pos_loc, in_s / 16.f, in_t / 8.f);
     glUniform4f(r->disp_rndr.pvideo_pos_loc,
@@ -548,6 +705,9 @@ static void render_display(NV2AState *d, SurfaceBinding *surface)
             r->gl_display_buffer_format,
             r->gl_display_buffer_type,
             NULL);
+#ifdef __ANDROID__
+        android_export_display_image(r->gl_display_buffer);
+#endif
     }
 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -644,15 +804,6 @@ static void render_display(NV2AState *d, SurfaceBinding *surface)
         GL_TEXTURE_2D, 0, 0);
 }
 
-static void gl_fence(void)
-{
-    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-    int result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
-                                         (GLuint64)(5000000000));
-    assert(result == GL_CONDITION_SATISFIED || result == GL_ALREADY_SIGNALED);
-    glDeleteSync(fence);
-}
-
 void pgraph_gl_sync(NV2AState *d)
 {
     VGADisplayParams vga_display_params;
@@ -675,7 +826,8 @@ void pgraph_gl_sync(NV2AState *d)
 
     /* FIXME: Sanity check surface dimensions */
 
-    /* Wait for queued commands to complete */
+    PGRAPHGLState *r = pg->gl_renderer_state;
+
 #ifdef __ANDROID__
     bool force_upload = !tcg_enabled();
     if (android_force_cpu_blit() && surface->draw_time == 0) {
@@ -691,20 +843,25 @@ void pgraph_gl_sync(NV2AState *d)
 #else
     pgraph_gl_upload_surface_data(d, surface, !tcg_enabled());
 #endif
-    gl_fence();
-    GL_ASSERT_NO_ERROR("pgraph_gl_sync: upload fence");
 
     /* Render framebuffer */
 #ifdef __ANDROID__
     glo_set_current(g_nv2a_context_render);
+    display_fence_wait(&r->display_release_fence);
     render_display(d, surface);
-    gl_fence();
+    display_fence_destroy(&r->display_ready_fence);
+    r->display_ready_fence = display_fence_create();
     GL_ASSERT_NO_ERROR("pgraph_gl_sync: render fence");
 #else
+    void *upload_fence = display_fence_create();
+
     /* Render framebuffer in display context */
     glo_set_current(g_nv2a_context_display);
+    display_fence_wait(&upload_fence);
+    display_fence_wait(&r->display_release_fence);
     render_display(d, surface);
-    gl_fence();
+    display_fence_destroy(&r->display_ready_fence);
+    r->display_ready_fence = display_fence_create();
     GL_ASSERT_NO_ERROR("pgraph_gl_sync: render fence");
 
     /* Switch back to original context */
@@ -755,5 +912,17 @@ int pgraph_gl_get_framebuffer_surface(NV2AState *d)
     qemu_mutex_unlock(&d->pfifo.lock);
     qemu_event_wait(&d->pgraph.sync_complete);
 
+    /* Sampling in the caller's context waits for render_display on the GPU */
+    display_fence_wait(&r->display_ready_fence);
+
     return r->gl_display_buffer;
 }
+
+void pgraph_gl_release_framebuffer_surface(NV2AState *d)
+{
+    PGRAPHGLState *r = d->pgraph.gl_renderer_state;
+
+    /* The next render_display must not overwrite the buffer being sampled */
+    display_fence_destroy(&r->display_release_fence);
+    r->display_release_fence = display_fence_create();
+}
@@ -392,6 +392,29 @@ void pgraph_gl_draw_end(NV2AState *d)
     NV2A_GL_DGROUP_END();
 }
 
+/*
+ * Drop a draw whose program is still being compiled, keeping the last inline
+ * vertex attribute values as a real draw would.
+ */
+static void skip_draw(PGRAPHState *pg)
+{
+    nv2a_profile_inc_counter(NV2A_PROF_SHADER_PENDING_SKIP);
+
+    if (!pg->inline_buffer_length) {
+        return;
+    }
+
+    for (int i = 0; i < NV2A_VERTEXSHADER_ATTRIBUTES; i++) {
+        VertexAttribute *attr = &pg->vertex_attributes[i];
+        if (attr->inline_buffer_populated) {
+            attr->inline_buffer_populated = false;
+            memcpy(attr->inline_value,
+                   attr->inline_buffer + (pg->inline_buffer_length - 1) * 4,
+                   sizeof(attr->inline_value));
+        }
+    }
+}
+
 void pgraph_gl_flush_draw(NV2AState *d)
 {
     PGRAPHState *pg = &d->pgraph;
@@ -401,6 +424,10 @@ void pgraph_gl_flush_draw(NV2AState *d)
         return;
     }
     assert(r->shader_binding);
+    if (!r->shader_binding->initialized) {
+        skip_draw(pg);
+        return;
+    }
 
     PrimAssemblyState assembly = {
         .primitive_mode = pg->primitive_mode,
@@ -432,12 +459,13 @@ void pgraph_gl_flush_draw(NV2AState *d)
             pg->draw_arrays_count, pg->draw_arrays_length);
 
         if (prim_rw.num_indices > 0) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->gl_prim_rewrite_buffer);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         prim_rw.num_indices * sizeof(uint32_t),
-                         prim_rw.indices, GL_STREAM_DRAW);
+            nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_INDEX);
+            size_t offset = pgraph_gl_stream_buffer_upload(
+                &r->index_stream, prim_rw.indices,
+                prim_rw.num_indices * sizeof(uint32_t));
             glDrawElements(r->shader_binding->gl_primitive_mode,
-                           prim_rw.num_indices, GL_UNSIGNED_INT, (void *)0);
+                           prim_rw.num_indices, GL_UNSIGNED_INT,
+                           (void *)offset);
         } else {
             glMultiDrawArrays(r->shader_binding->gl_primitive_mode,
                               pg->draw_arrays_start, pg->draw_arrays_count,
@@ -471,12 +499,12 @@ void pgraph_gl_flush_draw(NV2AState *d)
                 draw_indices[draw_index_count - 1]);
 
         if (prim_rw.num_indices > 0) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->gl_prim_rewrite_buffer);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         draw_index_count * sizeof(uint32_t), draw_indices,
-                         GL_STREAM_DRAW);
+            nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_INDEX);
+            size_t offset = pgraph_gl_stream_buffer_upload(
+                &r->index_stream, draw_indices,
+                draw_index_count * sizeof(uint32_t));
             glDrawElements(r->shader_binding->gl_primitive_mode,
-                           draw_index_count, GL_UNSIGNED_INT, (void *)0);
+                           draw_index_count, GL_UNSIGNED_INT, (void *)offset);
         } else {
             VertexKey k;
             memset(&k, 0, sizeof(VertexKey));
@@ -510,18 +538,21 @@ void pgraph_gl_flush_draw(NV2AState *d)
 
         if (pg->compressed_attrs) {
             pg->compressed_attrs = 0;
-            pgraph_gl_bind_shaders(pg);
+            if (!pgraph_gl_bind_shaders(pg)) {
+                skip_draw(pg);
+                return;
+            }
         }
 
         for (int i = 0; i < NV2A_VERTEXSHADER_ATTRIBUTES; i++) {
             VertexAttribute *attr = &pg->vertex_attributes[i];
             if (attr->inline_buffer_populated) {
                 nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_3);
-                glBindBuffer(GL_ARRAY_BUFFER, r->gl_inline_buffer[i]);
-                glBufferData(GL_ARRAY_BUFFER,
-                             pg->inline_buffer_length * sizeof(float) * 4,
-                             attr->inline_buffer, GL_STREAM_DRAW);
-                glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, 0, 0);
+                size_t offset = pgraph_gl_stream_buffer_upload(
+                    &r->vertex_stream, attr->inline_buffer,
+                    pg->inline_buffer_length * sizeof(float) * 4);
+                glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, 0,
+                                      (void *)offset);
                 glEnableVertexAttribArray(i);
                 attr->inline_buffer_populated = false;
                 memcpy(attr->inline_value,
@@ -537,12 +568,13 @@ void pgraph_gl_flush_draw(NV2AState *d)
             &r->prim_rewrite_buf, assembly, 0, pg->inline_buffer_length);
 
         if (prim_rw.num_indices > 0) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->gl_prim_rewrite_buffer);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         prim_rw.num_indices * sizeof(uint32_t),
-                         prim_rw.indices, GL_STREAM_DRAW);
+            nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_INDEX);
+            size_t offset = pgraph_gl_stream_buffer_upload(
+                &r->index_stream, prim_rw.indices,
+                prim_rw.num_indices * sizeof(uint32_t));
             glDrawElements(r->shader_binding->gl_primitive_mode,
-                           prim_rw.num_indices, GL_UNSIGNED_INT, (void *)0);
+                           prim_rw.num_indices, GL_UNSIGNED_INT,
+                           (void *)offset);
         } else {
             glDrawArrays(r->shader_binding->gl_primitive_mode,
                          0, pg->inline_buffer_length);
@@ -557,12 +589,13 @@ void pgraph_gl_flush_draw(NV2AState *d)
             &r->prim_rewrite_buf, assembly, 0, index_count);
 
         if (prim_rw.num_indices > 0) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->gl_prim_rewrite_buffer);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         prim_rw.num_indices * sizeof(uint32_t),
-                         prim_rw.indices, GL_STREAM_DRAW);
+            nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_INDEX);
+            size_t offset = pgraph_gl_stream_buffer_upload(
+                &r->index_stream, prim_rw.indices,
+                prim_rw.num_indices * sizeof(uint32_t));
             glDrawElements(r->shader_binding->gl_primitive_mode,
-                           prim_rw.num_indices, GL_UNSIGNED_INT, (void *)0);
+                           prim_rw.num_indices, GL_UNSIGNED_INT,
+                           (void *)offset);
         } else {
             glDrawArrays(r->shader_binding->gl_primitive_mode,
                          0, index_count);
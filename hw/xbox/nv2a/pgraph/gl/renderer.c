@@ -129,6 +129,23 @@ static void pgraph_gl_init(NV2AState *d, Error **errp)
     glGetFloatv(GL_SMOOTH_LINE_WIDTH_RANGE, r->supported_smooth_line_width_range);
     glGetFloatv(GL_ALIASED_LINE_WIDTH_RANGE, r->supported_aliased_line_width_range);
 
+    r->supported_extensions.buffer_storage =
+        (epoxy_is_desktop_gl() && epoxy_gl_version() >= 44) ||
+        glo_check_extension("GL_ARB_buffer_storage") ||
+        glo_check_extension("GL_EXT_buffer_storage");
+    r->supported_extensions.texture_storage =
+        epoxy_is_desktop_gl() ?
+            (epoxy_gl_version() >= 42 ||
+             glo_check_extension("GL_ARB_texture_storage")) :
+            epoxy_gl_version() >= 30;
+    r->supported_extensions.parallel_shader_compile =
+        glo_check_extension("GL_KHR_parallel_shader_compile") ||
+        glo_check_extension("GL_ARB_parallel_shader_compile");
+    if (r->supported_extensions.parallel_shader_compile) {
+        /* Let the driver pick how many compiler threads to use */
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+
     pgraph_gl_init_surfaces(pg);
     pgraph_gl_init_reports(d);
     pgraph_gl_init_textures(d);
@@ -272,6 +289,7 @@ static PGRAPHRenderer pgraph_gl_renderer = {
         .set_surface_scale_factor = pgraph_gl_set_surface_scale_factor,
         .get_surface_scale_factor = pgraph_gl_get_surface_scale_factor,
         .get_framebuffer_surface = pgraph_gl_get_framebuffer_surface,
+        .release_framebuffer_surface = pgraph_gl_release_framebuffer_surface,
     }
 };
 
@@ -39,6 +39,35 @@
 #include "gloffscreen.h"
 #include "constants.h"
 
+#define STREAM_BUFFER_SEGMENTS 4
+
+/*
+ * A ring buffer for data that is written once and drawn from once. With
+ * buffer storage it is persistently mapped, and each segment is fenced before
+ * it is overwritten. Otherwise the buffer is orphaned when it wraps.
+ */
+typedef struct StreamBuffer {
+    GLenum target;
+    GLuint gl_buffer;
+    size_t size;
+    size_t offset;
+    unsigned int segment;
+    bool persistent;
+    uint8_t *mapped;
+    GLsync fences[STREAM_BUFFER_SEGMENTS];
+} StreamBuffer;
+
+#define SURFACE_DOWNLOAD_RING_SIZE 4
+
+/* An asynchronous surface readback into a pixel pack buffer */
+typedef struct SurfaceDownloadSlot {
+    GLuint pbo;
+    size_t pbo_size;
+    GLsync fence;
+    struct SurfaceBinding *surface;
+    unsigned int scale;
+} SurfaceDownloadSlot;
+
 typedef struct SurfaceBinding {
     QTAILQ_ENTRY(SurfaceBinding) entry;
     MemAccessCallback *access_cb;
@@ -62,6 +91,8 @@ typedef struct SurfaceBinding {
     bool draw_dirty;
     bool download_pending;
     bool upload_pending;
+    bool download_likely;
+    SurfaceDownloadSlot *download_slot;
 
     GLuint gl_buffer;
     SurfaceFormatInfo fmt;
@@ -82,6 +113,7 @@ typedef struct TextureBinding {
     bool border_color_set;
     GLenum gl_target;
     GLuint gl_texture;
+    bool immutable;
 } TextureBinding;
 
 typedef struct ShaderModuleCacheKey {
@@ -112,6 +144,14 @@ typedef struct ShaderBinding {
     LruNode node;
     bool initialized;
 
+    /* Program was submitted to the driver and has not been checked yet */
+    bool pending;
+    bool pending_binary;
+
+    /* Program binary was loaded from disk, queued for early submission */
+    bool prefetch_queued;
+    QTAILQ_ENTRY(ShaderBinding) prefetch_entry;
+
     bool cached;
     void *program;
     size_t program_size;
@@ -177,13 +217,17 @@ typedef struct PGRAPHGLState {
     GLenum gl_display_buffer_format;
     GLenum gl_display_buffer_type;
 
+    /* Fences handing the display buffer between render and display */
+    void *display_ready_fence;
+    void *display_release_fence;
+
     Lru element_cache;
     VertexLruNode *element_cache_entries;
-    GLuint gl_inline_array_buffer;
     GLuint gl_memory_buffer;
     GLuint gl_vertex_array;
-    GLuint gl_inline_buffer[NV2A_VERTEXSHADER_ATTRIBUTES];
-    GLuint gl_prim_rewrite_buffer;
+    StreamBuffer vertex_stream;
+    StreamBuffer index_stream;
+    size_t inline_array_offset;
     PrimRewriteBuf prim_rewrite_buf;
 
     QTAILQ_HEAD(, SurfaceBinding) surfaces;
@@ -192,8 +236,11 @@ typedef struct PGRAPHGLState {
     QemuEvent downloads_complete;
     bool download_dirty_surfaces_pending;
     QemuEvent dirty_surfaces_download_complete; // common
+    SurfaceDownloadSlot surface_download_ring[SURFACE_DOWNLOAD_RING_SIZE];
+    unsigned int surface_download_ring_next;
 
     TextureBinding *texture_binding[NV2A_MAX_TEXTURES];
+    StreamBuffer texture_stream;
     Lru texture_cache;
     TextureLruNode *texture_cache_entries;
 
@@ -202,6 +249,7 @@ typedef struct PGRAPHGLState {
     ShaderBinding *shader_binding;
     QemuMutex shader_cache_lock;
     QemuThread shader_disk_thread;
+    QTAILQ_HEAD(, ShaderBinding) shader_prefetch_queue;
 
     Lru shader_module_cache;
     ShaderModuleCacheEntry *shader_module_cache_entries;
@@ -242,6 +290,9 @@ typedef struct PGRAPHGLState {
 
     struct supported_extensions {
         GLboolean texture_filter_anisotropic;
+        GLboolean buffer_storage;
+        GLboolean texture_storage;
+        GLboolean parallel_shader_compile;
     } supported_extensions;
 
 #ifdef __ANDROID__
@@ -253,7 +304,7 @@ extern GloContext *g_nv2a_context_render;
 extern GloContext *g_nv2a_context_display;
 
 unsigned int pgraph_gl_bind_inline_array(NV2AState *d);
-void pgraph_gl_bind_shaders(PGRAPHState *pg);
+bool pgraph_gl_bind_shaders(PGRAPHState *pg);
 void pgraph_gl_bind_textures(NV2AState *d);
 void pgraph_gl_bind_vertex_attributes(NV2AState *d, unsigned int min_element, unsigned int max_element, bool inline_data, unsigned int inline_stride, unsigned int provoking_element);
 bool pgraph_gl_check_surface_to_texture_compatibility(const SurfaceBinding *surface, const TextureShape *shape);
@@ -284,6 +335,14 @@ void pgraph_gl_init_textures(NV2AState *d);
 void pgraph_gl_finalize_textures(PGRAPHState *pg);
 void pgraph_gl_init_buffers(NV2AState *d);
 void pgraph_gl_finalize_buffers(PGRAPHState *pg);
+void pgraph_gl_stream_buffer_init(StreamBuffer *sb, GLenum target, size_t size,
+                                  bool persistent);
+void pgraph_gl_stream_buffer_finalize(StreamBuffer *sb);
+void *pgraph_gl_stream_buffer_reserve(StreamBuffer *sb, size_t size,
+                                      size_t *offset);
+void pgraph_gl_stream_buffer_commit(StreamBuffer *sb);
+size_t pgraph_gl_stream_buffer_upload(StreamBuffer *sb, const void *data,
+                                      size_t size);
 void pgraph_gl_process_pending_downloads(NV2AState *d);
 void pgraph_gl_reload_surface_scale_factor(PGRAPHState *pg);
 void pgraph_gl_render_surface_to_texture(NV2AState *d, SurfaceBinding *surface, TextureBinding *texture, TextureShape *texture_shape, int texture_unit);
@@ -295,9 +354,9 @@ void pgraph_gl_surface_invalidate(NV2AState *d, SurfaceBinding *e);
 void pgraph_gl_unbind_surface(NV2AState *d, bool color);
 void pgraph_gl_upload_surface_data(NV2AState *d, SurfaceBinding *surface, bool force);
 void pgraph_gl_shader_cache_to_disk(ShaderBinding *snode);
-bool pgraph_gl_shader_load_from_memory(ShaderBinding *snode);
 void pgraph_gl_shader_write_cache_reload_list(PGRAPHState *pg);
 void pgraph_gl_set_surface_scale_factor(NV2AState *d, unsigned int scale);
 unsigned int pgraph_gl_get_surface_scale_factor(NV2AState *d);
 int pgraph_gl_get_framebuffer_surface(NV2AState *d);
+void pgraph_gl_release_framebuffer_surface(NV2AState *d);
 #endif
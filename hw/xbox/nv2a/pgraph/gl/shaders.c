@@ -29,6 +29,9 @@
 #include "debug.h"
 #include "renderer.h"
 
+/* Number of cached program binaries handed to the driver per shader bind */
+#define SHADER_PREFETCH_PER_BIND 2
+
 static GLenum get_gl_primitive_mode(enum ShaderPrimitiveMode primitive_mode)
 {
     switch (primitive_mode) {
@@ -45,8 +48,6 @@ static GLuint create_gl_shader(GLenum gl_shader_type,
                                const char *code,
                                const char *name)
 {
-    GLint compiled = 0;
-
     NV2A_GL_DGROUP_BEGIN("Creating new %s", name);
 
     NV2A_DPRINTF("compile new %s, code:\n%s\n", name, code);
@@ -55,27 +56,43 @@ static GLuint create_gl_shader(GLenum gl_shader_type,
     glShaderSource(shader, 1, &code, 0);
     glCompileShader(shader);
 
-    /* Check it compiled */
-    compiled = 0;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        GLchar* log;
-        GLint log_length;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
-        log = g_malloc(log_length * sizeof(GLchar));
-        glGetShaderInfoLog(shader, log_length, NULL, log);
-        fprintf(stderr, "%s\n\n" "nv2a: %s compilation failed: %s\n", code, name, log);
-        g_free(log);
-
-        NV2A_GL_DGROUP_END();
-        abort();
-    }
+    /*
+     * Compile status is not queried here, as that would wait for the driver
+     * to finish compiling. Errors are reported when the program is linked.
+     */
 
     NV2A_GL_DGROUP_END();
 
     return shader;
 }
 
+static void report_shader_compile_errors(GLuint program)
+{
+    GLuint shaders[3];
+    GLsizei count = 0;
+    glGetAttachedShaders(program, ARRAY_SIZE(shaders), &count, shaders);
+
+    for (int i = 0; i < count; i++) {
+        GLint compiled = 0;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+        if (compiled) {
+            continue;
+        }
+
+        GLint code_length = 0, log_length = 0;
+        glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &code_length);
+        glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &log_length);
+        GLchar *code = g_malloc0(code_length + 1);
+        GLchar *log = g_malloc0(log_length + 1);
+        glGetShaderSource(shaders[i], code_length + 1, NULL, code);
+        glGetShaderInfoLog(shaders[i], log_length + 1, NULL, log);
+        fprintf(stderr, "%s\n\n" "nv2a: shader compilation failed: %s\n",
+                code, log);
+        g_free(code);
+        g_free(log);
+    }
+}
+
 static void set_texture_sampler_uniforms(ShaderBinding *binding)
 {
     for (int i = 0; i < NV2A_MAX_TEXTURES; i++) {
@@ -174,6 +191,7 @@ static GLuint get_shader_module_for_key(PGRAPHGLState *r,
     return module->gl_shader;
 }
 
+/* Submit compile and link of the program, without waiting on the result */
 static void generate_shaders(PGRAPHGLState *r, ShaderBinding *binding)
 {
     GLuint program = glCreateProgram();
@@ -217,9 +235,48 @@ static void generate_shaders(PGRAPHGLState *r, ShaderBinding *binding)
 
     /* link the program */
     glLinkProgram(program);
+
+    binding->gl_program = program;
+    binding->pending = true;
+    binding->pending_binary = false;
+}
+
+static bool shader_program_ready(PGRAPHGLState *r, ShaderBinding *binding)
+{
+    if (!r->supported_extensions.parallel_shader_compile) {
+        return true;
+    }
+
+    GLint complete = GL_FALSE;
+    glGetProgramiv(binding->gl_program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete;
+}
+
+/*
+ * Check the result of a submitted program and look up its uniforms. Waits for
+ * the driver if the program is not ready yet. A program generated from source
+ * that fails to link is fatal; a program loaded from a binary is deleted and
+ * false is returned so that it can be regenerated.
+ */
+static bool finalize_shaders(ShaderBinding *binding)
+{
+    GLuint program = binding->gl_program;
+    bool from_binary = binding->pending_binary;
+
+    assert(binding->pending);
+    binding->pending = false;
+    binding->pending_binary = false;
+
     GLint linked = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
-    if(!linked) {
+    if (!linked) {
+        if (from_binary) {
+            NV2A_DPRINTF(
+                "failed to load shader binary from disk: link status is FALSE\n");
+            goto discard_binary;
+        }
+
+        report_shader_compile_errors(program);
         GLchar log[2048];
         glGetProgramInfoLog(program, 2048, NULL, log);
         fprintf(stderr, "nv2a: shader linking failed: %s\n", log);
@@ -228,10 +285,8 @@ static void generate_shaders(PGRAPHGLState *r, ShaderBinding *binding)
 
     glUseProgram(program);
 
-    binding->gl_program = program;
     binding->gl_primitive_mode =
-        get_gl_primitive_mode(state->geom.primitive_mode);
-    binding->initialized = true;
+        get_gl_primitive_mode(binding->state.geom.primitive_mode);
 
     set_texture_sampler_uniforms(binding);
 
@@ -242,11 +297,25 @@ static void generate_shaders(PGRAPHGLState *r, ShaderBinding *binding)
     if (!valid) {
         GLchar log[1024];
         glGetProgramInfoLog(program, 1024, NULL, log);
+        if (from_binary) {
+            NV2A_DPRINTF("failed to load shader binary from disk: %s\n", log);
+            goto discard_binary;
+        }
         fprintf(stderr, "nv2a: shader validation failed: %s\n", log);
         abort();
     }
 
     update_shader_uniform_locs(binding);
+    binding->initialized = true;
+
+    return true;
+
+discard_binary:
+    glDeleteProgram(program);
+    binding->gl_program = 0;
+    /* Write the regenerated program back to the cache */
+    binding->cached = false;
+    return false;
 }
 
 static const char *shader_gl_vendor = NULL;
@@ -302,7 +371,8 @@ void pgraph_gl_shader_write_cache_reload_list(PGRAPHState *pg)
     qemu_event_set(&r->shader_cache_writeback_complete);
 }
 
-bool pgraph_gl_shader_load_from_memory(ShaderBinding *binding)
+/* Submit a program binary loaded from disk, without waiting on the result */
+static bool shader_load_from_memory(ShaderBinding *binding)
 {
 #ifdef __ANDROID__
     while (glGetError() != GL_NO_ERROR) {
@@ -328,41 +398,41 @@ bool pgraph_gl_shader_load_from_memory(ShaderBinding *binding)
         return false;
     }
 
-    GLint link_status = GL_FALSE;
-    glGetProgramiv(gl_program, GL_LINK_STATUS, &link_status);
-    if (!link_status) {
-        NV2A_DPRINTF(
-            "failed to load shader binary from disk: link status is FALSE\n");
-        glDeleteProgram(gl_program);
-        return false;
-    }
-
-    glUseProgram(gl_program);
-
     g_free(binding->program);
 
     binding->program = NULL;
     binding->gl_program = gl_program;
-    binding->gl_primitive_mode =
-        get_gl_primitive_mode(binding->state.geom.primitive_mode);
-    binding->initialized = true;
+    binding->pending = true;
+    binding->pending_binary = true;
 
-    set_texture_sampler_uniforms(binding);
+    return true;
+}
 
-    glValidateProgram(gl_program);
-    GLint valid = 0;
-    glGetProgramiv(gl_program, GL_VALIDATE_STATUS, &valid);
-    if (!valid) {
-        GLchar log[1024];
-        glGetProgramInfoLog(gl_program, 1024, NULL, log);
-        NV2A_DPRINTF("failed to load shader binary from disk: %s\n", log);
-        glDeleteProgram(gl_program);
-        return false;
+/*
+ * Hand a few of the binaries loaded by the disk thread to the driver before
+ * they are first drawn with, so that they are linked by the time they are
+ * needed. Only done when the driver links in the background.
+ */
+static void shader_prefetch_binaries(PGRAPHGLState *r)
+{
+    if (!r->supported_extensions.parallel_shader_compile) {
+        return;
     }
 
-    update_shader_uniform_locs(binding);
+    for (int i = 0; i < SHADER_PREFETCH_PER_BIND; i++) {
+        ShaderBinding *binding = QTAILQ_FIRST(&r->shader_prefetch_queue);
+        if (!binding) {
+            break;
+        }
 
-    return true;
+        QTAILQ_REMOVE(&r->shader_prefetch_queue, binding, prefetch_entry);
+        binding->prefetch_queued = false;
+
+        if (!binding->initialized && !binding->pending &&
+            shader_load_from_memory(binding)) {
+            nv2a_profile_inc_counter(NV2A_PROF_SHADER_PREFETCH);
+        }
+    }
 }
 
 static char *shader_get_bin_directory(uint64_t hash)
@@ -456,7 +526,7 @@ static void shader_load_from_disk(PGRAPHState *pg, uint64_t hash)
     ShaderBinding *binding = container_of(node, ShaderBinding, node);
 
     /* If we happened to regenerate this shader already, then we may as well use the new one */
-    if (binding->initialized) {
+    if (binding->initialized || binding->pending) {
         qemu_mutex_unlock(&r->shader_cache_lock);
         return;
     }
@@ -465,6 +535,10 @@ static void shader_load_from_disk(PGRAPHState *pg, uint64_t hash)
     binding->program_size = shader_size;
     binding->program = program_buffer;
     binding->cached = true;
+    if (!binding->prefetch_queued) {
+        QTAILQ_INSERT_TAIL(&r->shader_prefetch_queue, binding, prefetch_entry);
+        binding->prefetch_queued = true;
+    }
     qemu_mutex_unlock(&r->shader_cache_lock);
     return;
 
@@ -505,6 +579,10 @@ static void shader_cache_entry_init(Lru *lru, LruNode *node, const void *state)
     ShaderBinding *binding = container_of(node, ShaderBinding, node);
     memcpy(&binding->state, state, sizeof(ShaderState));
     binding->initialized = false;
+    binding->pending = false;
+    binding->pending_binary = false;
+    binding->prefetch_queued = false;
+    binding->gl_program = 0;
     binding->cached = false;
     binding->program = NULL;
     binding->save_thread = NULL;
@@ -513,6 +591,12 @@ static void shader_cache_entry_init(Lru *lru, LruNode *node, const void *state)
 static void shader_cache_entry_post_evict(Lru *lru, LruNode *node)
 {
     ShaderBinding *binding = container_of(node, ShaderBinding, node);
+    PGRAPHGLState *r = container_of(lru, PGRAPHGLState, shader_cache);
+
+    if (binding->prefetch_queued) {
+        QTAILQ_REMOVE(&r->shader_prefetch_queue, binding, prefetch_entry);
+        binding->prefetch_queued = false;
+    }
 
     if (binding->save_thread) {
         qemu_thread_join(binding->save_thread);
@@ -524,6 +608,8 @@ static void shader_cache_entry_post_evict(Lru *lru, LruNode *node)
         g_free(binding->program);
     }
 
+    binding->initialized = false;
+    binding->pending = false;
     binding->cached = false;
     binding->save_thread = NULL;
     binding->program = NULL;
@@ -561,6 +647,7 @@ void pgraph_gl_init_shaders(PGRAPHState *pg)
     r->shader_cache.init_node = shader_cache_entry_init;
     r->shader_cache.compare_nodes = shader_cache_entry_compare;
     r->shader_cache.post_node_evict = shader_cache_entry_post_evict;
+    QTAILQ_INIT(&r->shader_prefetch_queue);
 
     qemu_thread_create(&r->shader_disk_thread, "pgraph.renderer_state->shader_cache",
                        shader_reload_lru_from_disk, pg, QEMU_THREAD_JOINABLE);
@@ -777,12 +864,16 @@ static void update_shader_uniforms(PGRAPHState *pg, ShaderBinding *binding)
                           &psh_values, PshUniform__COUNT);
 }
 
-void pgraph_gl_bind_shaders(PGRAPHState *pg)
+/*
+ * Returns false if the program for the current state is still being compiled
+ * by the driver, in which case draws are skipped until it is ready.
+ */
+bool pgraph_gl_bind_shaders(PGRAPHState *pg)
 {
     PGRAPHGLState *r = pg->gl_renderer_state;
 
     bool binding_changed = false;
-    if (r->shader_binding &&
+    if (r->shader_binding && r->shader_binding->initialized &&
         !pgraph_glsl_check_shader_state_dirty(pg, &r->shader_binding->state)) {
         nv2a_profile_inc_counter(NV2A_PROF_SHADER_BIND_NOTDIRTY);
         goto update_uniforms;
@@ -802,9 +893,33 @@ void pgraph_gl_bind_shaders(PGRAPHState *pg)
     LruNode *node = lru_lookup(&r->shader_cache, shader_state_hash, &state);
     ShaderBinding *binding = container_of(node, ShaderBinding, node);
 
-    if (!binding->initialized && !pgraph_gl_shader_load_from_memory(binding)) {
+    if (!binding->initialized && !binding->pending &&
+        !shader_load_from_memory(binding)) {
         nv2a_profile_inc_counter(NV2A_PROF_SHADER_GEN);
         generate_shaders(r, binding);
+    }
+
+    shader_prefetch_binaries(r);
+
+    if (binding->pending) {
+        /*
+         * A skipped draw is never replayed, so never defer one whose pixels
+         * are being counted for a zpass report.
+         */
+        if (g_config.perf.async_shader_compile &&
+            !pg->zpass_pixel_count_enable &&
+            !shader_program_ready(r, binding)) {
+            r->shader_binding = binding;
+            qemu_mutex_unlock(&r->shader_cache_lock);
+            NV2A_GL_DGROUP_END();
+            return false;
+        }
+
+        if (!finalize_shaders(binding)) {
+            nv2a_profile_inc_counter(NV2A_PROF_SHADER_GEN);
+            generate_shaders(r, binding);
+            finalize_shaders(binding);
+        }
         if (g_config.perf.cache_shaders) {
             pgraph_gl_shader_cache_to_disk(binding);
         }
@@ -827,6 +942,8 @@ update_uniforms:
     assert(r->shader_binding);
     assert(r->shader_binding->initialized);
     update_shader_uniforms(pg, r->shader_binding);
+
+    return true;
 }
 
 GLuint pgraph_gl_compile_shader(const char *vs_src, const char *fs_src)
@@ -56,6 +56,7 @@ static void android_sanitize_surface_format(PGRAPHGLState *r,
 #endif
 
 static void surface_download(NV2AState *d, SurfaceBinding *surface, bool force);
+static void surface_discard_prefetch(SurfaceBinding *surface);
 static void surface_download_to_buffer(NV2AState *d, SurfaceBinding *surface,
                                        bool swizzle, bool flip, bool downscale,
                                        uint8_t *pixels);
@@ -136,14 +137,18 @@ void pgraph_gl_set_surface_dirty(PGRAPHState *pg, bool color, bool zeta)
         r->color_binding->draw_dirty |= color;
         r->color_binding->frame_time = pg->frame_time;
         r->color_binding->cleared = false;
-
+        if (color) {
+            surface_discard_prefetch(r->color_binding);
+        }
     }
 
     if (r->zeta_binding) {
         r->zeta_binding->draw_dirty |= zeta;
         r->zeta_binding->frame_time = pg->frame_time;
         r->zeta_binding->cleared = false;
-
+        if (zeta) {
+            surface_discard_prefetch(r->zeta_binding);
+        }
     }
 }
 
@@ -349,8 +354,8 @@ static bool render_surface_to(NV2AState *d, SurfaceBinding *surface,
     glBindFramebuffer(GL_FRAMEBUFFER, r->gl_framebuffer);
     glBindVertexArray(r->gl_vertex_array);
     glBindTexture(gl_target, gl_texture);
-    glUseProgram(
-        r->shader_binding ? r->shader_binding->gl_program : 0);
+    glUseProgram(r->shader_binding && r->shader_binding->initialized ?
+                     r->shader_binding->gl_program : 0);
     return true;
 }
 
@@ -430,8 +435,8 @@ void pgraph_gl_render_surface_to_texture(NV2AState *d, SurfaceBinding *surface,
         return;
     }
     glBindTexture(texture->gl_target, texture->gl_texture);
-    glUseProgram(
-        r->shader_binding ? r->shader_binding->gl_program : 0);
+    glUseProgram(r->shader_binding && r->shader_binding->initialized ?
+                     r->shader_binding->gl_program : 0);
 }
 
 bool pgraph_gl_check_surface_to_texture_compatibility(
@@ -532,6 +537,7 @@ static void surface_access_callback(void *opaque, MemoryRegion *mr, hwaddr addr,
 
         if (surface->draw_dirty) {
             surface->download_pending = true;
+            surface->download_likely = true;
             wait_for_downloads = true;
         }
 
@@ -666,6 +672,7 @@ void pgraph_gl_surface_invalidate(NV2AState *d, SurfaceBinding *surface)
     }
 
     unregister_cpu_access_callback(d, surface);
+    surface_discard_prefetch(surface);
 
     glDeleteTextures(1, &surface->gl_buffer);
 
@@ -808,12 +815,69 @@ static void surface_copy_shrink_row(uint8_t *out, uint8_t *in,
     }
 }
 
+static void surface_shrink(SurfaceBinding *surface, unsigned int factor,
+                           const uint8_t *in, uint8_t *out)
+{
+    assert(surface->pitch >= (surface->width * surface->fmt.bytes_per_pixel));
+    for (unsigned int y = 0; y < surface->height; y++) {
+        surface_copy_shrink_row(out, (uint8_t *)in, surface->width,
+                                surface->fmt.bytes_per_pixel, factor);
+        in += surface->pitch * factor * factor;
+        out += surface->pitch;
+    }
+}
+
+/* Attach @surface alone to the framebuffer so it can be read from */
+static bool surface_download_attach(NV2AState *d, SurfaceBinding *surface)
+{
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           0, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                           0, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                           GL_TEXTURE_2D, 0, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, surface->fmt.gl_attachment,
+                           GL_TEXTURE_2D, surface->gl_buffer, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+#ifdef __ANDROID__
+        const char *status_str = "unknown";
+        switch (status) {
+        case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
+            status_str = "incomplete_attachment";
+            break;
+        case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
+            status_str = "missing_attachment";
+            break;
+        case GL_FRAMEBUFFER_UNSUPPORTED:
+            status_str = "unsupported";
+            break;
+        default:
+            break;
+        }
+        fprintf(stderr, "nv2a: download FBO incomplete (%s=0x%x)\n",
+                status_str, status);
+#endif
+        return false;
+    }
+
+    return true;
+}
+
+/* Re-bind original framebuffer target */
+static void surface_download_detach(NV2AState *d, SurfaceBinding *surface)
+{
+    glFramebufferTexture2D(GL_FRAMEBUFFER, surface->fmt.gl_attachment,
+                           GL_TEXTURE_2D, 0, 0);
+    bind_current_surface(d);
+}
+
 static void surface_download_to_buffer(NV2AState *d, SurfaceBinding *surface,
                                        bool swizzle, bool flip, bool downscale,
                                        uint8_t *pixels)
 {
     PGRAPHState *pg = &d->pgraph;
-    bool ok = true;
 
     swizzle &= surface->swizzle;
     downscale &= (pg->surface_scale_factor != 1);
@@ -828,46 +892,12 @@ static void surface_download_to_buffer(NV2AState *d, SurfaceBinding *surface,
         surface->width, surface->height, surface->pitch,
         surface->fmt.bytes_per_pixel);
 
-    /*  Bind destination surface to framebuffer */
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           0, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
-                           0, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
-                           GL_TEXTURE_2D, 0, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, surface->fmt.gl_attachment,
-                           GL_TEXTURE_2D, surface->gl_buffer, 0);
-
-    {
-        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (status != GL_FRAMEBUFFER_COMPLETE) {
-#ifdef __ANDROID__
-            const char *status_str = "unknown";
-            switch (status) {
-            case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-                status_str = "incomplete_attachment";
-                break;
-            case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-                status_str = "missing_attachment";
-                break;
-            case GL_FRAMEBUFFER_UNSUPPORTED:
-                status_str = "unsupported";
-                break;
-            default:
-                break;
-            }
-            fprintf(stderr, "nv2a: download FBO incomplete (%s=0x%x)\n",
-                    status_str, status);
-#endif
-            ok = false;
-        }
-    }
-
-    if (!ok) {
+    if (!surface_download_attach(d, surface)) {
         if (pixels && surface->size) {
             memset(pixels, 0, surface->size);
         }
-        goto cleanup;
+        surface_download_detach(d, surface);
+        return;
     }
 
     /* Read surface into memory */
@@ -898,16 +928,8 @@ static void surface_download_to_buffer(NV2AState *d, SurfaceBinding *surface,
 
     /* FIXME: Replace this with a hw accelerated version */
     if (downscale) {
-        assert(surface->pitch >= (surface->width * surface->fmt.bytes_per_pixel));
-        uint8_t *out = swizzle_buf, *in = pg->scale_buf;
-        for (unsigned int y = 0; y < surface->height; y++) {
-            surface_copy_shrink_row(out, in, surface->width,
-                                    surface->fmt.bytes_per_pixel,
-                                    pg->surface_scale_factor);
-            in += surface->pitch * pg->surface_scale_factor *
-                  pg->surface_scale_factor;
-            out += surface->pitch;
-        }
+        surface_shrink(surface, pg->surface_scale_factor, pg->scale_buf,
+                       swizzle_buf);
     }
 
     if (swizzle) {
@@ -916,11 +938,137 @@ static void surface_download_to_buffer(NV2AState *d, SurfaceBinding *surface,
         g_free(swizzle_buf);
     }
 
-    /* Re-bind original framebuffer target */
-cleanup:
-    glFramebufferTexture2D(GL_FRAMEBUFFER, surface->fmt.gl_attachment,
-                           GL_TEXTURE_2D, 0, 0);
-    bind_current_surface(d);
+    surface_download_detach(d, surface);
+}
+
+static void surface_download_slot_release(SurfaceDownloadSlot *slot)
+{
+    if (slot->fence) {
+        glDeleteSync(slot->fence);
+        slot->fence = 0;
+    }
+    if (slot->surface) {
+        slot->surface->download_slot = NULL;
+        slot->surface = NULL;
+    }
+}
+
+static void surface_discard_prefetch(SurfaceBinding *surface)
+{
+    if (surface->download_slot) {
+        surface_download_slot_release(surface->download_slot);
+    }
+}
+
+/*
+ * Start reading a dirty surface back into a pixel pack buffer, so that a later
+ * CPU access finds the data already in flight instead of stalling the GL
+ * pipeline. Only surfaces the CPU has read back before are prefetched.
+ */
+static void surface_download_prefetch(NV2AState *d, SurfaceBinding *surface)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHGLState *r = pg->gl_renderer_state;
+
+    if (!surface || !surface->draw_dirty || !surface->download_likely ||
+        surface->download_slot || !surface->width || !surface->height) {
+        return;
+    }
+
+    SurfaceDownloadSlot *slot =
+        &r->surface_download_ring[r->surface_download_ring_next];
+    r->surface_download_ring_next =
+        (r->surface_download_ring_next + 1) % SURFACE_DOWNLOAD_RING_SIZE;
+    surface_download_slot_release(slot);
+
+    unsigned int scale = pg->surface_scale_factor;
+    size_t size = scale * scale * surface->size;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    if (slot->pbo_size < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot->pbo_size = size;
+    }
+
+    if (surface_download_attach(d, surface)) {
+        glo_readpixels(surface->fmt.gl_format, surface->fmt.gl_type,
+                       surface->fmt.bytes_per_pixel, scale * surface->pitch,
+                       scale * surface->width, scale * surface->height, false,
+                       NULL);
+        slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot->surface = surface;
+        slot->scale = scale;
+        surface->download_slot = slot;
+        nv2a_profile_inc_counter(NV2A_PROF_SURF_DOWNLOAD_PREFETCH);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    surface_download_detach(d, surface);
+}
+
+/* Complete a prefetched download, returns false if there was none */
+static bool surface_download_from_prefetch(NV2AState *d,
+                                           SurfaceBinding *surface,
+                                           uint8_t *pixels)
+{
+    PGRAPHState *pg = &d->pgraph;
+    SurfaceDownloadSlot *slot = surface->download_slot;
+
+    if (!slot) {
+        return false;
+    }
+    if (slot->scale != pg->surface_scale_factor) {
+        surface_download_slot_release(slot);
+        return false;
+    }
+
+    GLenum result = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     GL_TIMEOUT_IGNORED);
+    assert(result == GL_CONDITION_SATISFIED || result == GL_ALREADY_SIGNALED);
+
+    size_t size = slot->scale * slot->scale * surface->size;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    const uint8_t *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size,
+                                             GL_MAP_READ_BIT);
+    if (!mapped) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        surface_download_slot_release(slot);
+        return false;
+    }
+
+    trace_nv2a_pgraph_surface_download(
+        surface->color ? "COLOR" : "ZETA",
+        surface->swizzle ? "sz" : "lin", surface->vram_addr,
+        surface->width, surface->height, surface->pitch,
+        surface->fmt.bytes_per_pixel);
+
+    uint8_t *linear_buf = pixels;
+    if (surface->swizzle) {
+        linear_buf = (uint8_t *)g_malloc(surface->size);
+    }
+
+    if (slot->scale != 1) {
+        surface_shrink(surface, slot->scale, mapped, linear_buf);
+    } else {
+        size_t row_bytes = surface->width * surface->fmt.bytes_per_pixel;
+        for (unsigned int y = 0; y < surface->height; y++) {
+            memcpy(linear_buf + y * surface->pitch,
+                   mapped + y * surface->pitch, row_bytes);
+        }
+    }
+
+    if (surface->swizzle) {
+        swizzle_rect(linear_buf, surface->width, surface->height, pixels,
+                     surface->pitch, surface->fmt.bytes_per_pixel);
+        g_free(linear_buf);
+    }
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    surface_download_slot_release(slot);
+
+    nv2a_profile_inc_counter(NV2A_PROF_SURF_DOWNLOAD_PREFETCH_HIT);
+    return true;
 }
 
 static void surface_download(NV2AState *d, SurfaceBinding *surface, bool force)
@@ -934,8 +1082,11 @@ static void surface_download(NV2AState *d, SurfaceBinding *surface, bool force)
 
     nv2a_profile_inc_counter(NV2A_PROF_SURF_DOWNLOAD);
 
-    surface_download_to_buffer(d, surface, true, false, true,
-                               d->vram_ptr + surface->vram_addr);
+    if (!surface_download_from_prefetch(d, surface,
+                                        d->vram_ptr + surface->vram_addr)) {
+        surface_download_to_buffer(d, surface, true, false, true,
+                                   d->vram_ptr + surface->vram_addr);
+    }
 
     memory_region_set_client_dirty(d->vram, surface->vram_addr,
                                    surface->pitch * surface->height,
@@ -1046,6 +1197,7 @@ void pgraph_gl_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
 
     surface->upload_pending = false;
     surface->draw_time = pg->draw_time;
+    surface_discard_prefetch(surface);
 
     if (!surface->width || !surface->height) {
         return;
@@ -1259,6 +1411,8 @@ static void populate_surface_binding_entry_sized(NV2AState *d, bool color,
     entry->upload_pending = true;
     entry->download_pending = false;
     entry->draw_dirty = false;
+    entry->download_likely = false;
+    entry->download_slot = NULL;
     entry->dma_addr = dma.address;
     entry->dma_len = dma.limit;
     entry->frame_time = pg->frame_time;
@@ -1308,6 +1462,8 @@ static void update_surface_part(NV2AState *d, bool upload, bool color)
                                            DIRTY_MEMORY_NV2A);
 
     if (upload && (surface->buffer_dirty || mem_dirty)) {
+        surface_download_prefetch(d, color ? r->color_binding :
+                                             r->zeta_binding);
         pgraph_gl_unbind_surface(d, color);
 
         SurfaceBinding *found = pgraph_gl_surface_get(d, entry.vram_addr);
@@ -1624,6 +1780,11 @@ void pgraph_gl_init_surfaces(PGRAPHState *pg)
     qemu_event_init(&r->downloads_complete, false);
     qemu_event_init(&r->dirty_surfaces_download_complete, false);
 
+    for (int i = 0; i < SURFACE_DOWNLOAD_RING_SIZE; i++) {
+        glGenBuffers(1, &r->surface_download_ring[i].pbo);
+    }
+    r->surface_download_ring_next = 0;
+
     init_render_to_texture(pg);
 }
 
@@ -1657,6 +1818,14 @@ void pgraph_gl_finalize_surfaces(PGRAPHState *pg)
     glDeleteFramebuffers(1, &r->gl_framebuffer);
     r->gl_framebuffer = 0;
 
+    for (int i = 0; i < SURFACE_DOWNLOAD_RING_SIZE; i++) {
+        SurfaceDownloadSlot *slot = &r->surface_download_ring[i];
+        surface_download_slot_release(slot);
+        glDeleteBuffers(1, &slot->pbo);
+        slot->pbo = 0;
+        slot->pbo_size = 0;
+    }
+
     finalize_render_to_texture(pg);
 }
 
@@ -27,7 +27,10 @@
 #include "debug.h"
 #include "renderer.h"
 
-static TextureBinding* generate_texture(const TextureShape s, const uint8_t *texture_data, const uint8_t *palette_data);
+static TextureBinding* generate_texture(PGRAPHGLState *r, const TextureShape s,
+                                        const uint8_t *texture_data,
+                                        const uint8_t *palette_data,
+                                        bool allow_immutable);
 static void texture_binding_destroy(gpointer data);
 
 struct pgraph_texture_possibly_dirty_struct {
@@ -361,6 +364,9 @@ void pgraph_gl_bind_textures(NV2AState *d)
         bool must_destroy = (key_out->binding != NULL)
                             && possibly_dirty
                             && (key_out->binding->data_hash != tex_data_hash);
+        /* Rendering a surface into the texture respecifies its storage */
+        must_destroy |= (key_out->binding != NULL) && surf_to_tex &&
+                        key_out->binding->immutable;
         if (must_destroy) {
             texture_binding_destroy(key_out->binding);
             key_out->binding = NULL;
@@ -368,7 +374,8 @@ void pgraph_gl_bind_textures(NV2AState *d)
 
         if (key_out->binding == NULL) {
             // Must create the texture
-            key_out->binding = generate_texture(state, texture_data, palette_data);
+            key_out->binding = generate_texture(r, state, texture_data,
+                                                palette_data, !surf_to_tex);
             key_out->binding->data_hash = tex_data_hash;
             key_out->binding->scale = 1;
         } else {
@@ -427,10 +434,92 @@ gl_internal_format_to_s3tc_enum(GLint gl_internal_format)
     }
 }
 
-static void upload_gl_texture(GLenum gl_target,
+static const size_t texture_stream_size = 32 * 1024 * 1024;
+
+/* Specify one image of the bound texture, from client memory or a PBO */
+static void texture_image(GLenum gl_target, int level, bool immutable,
+                          GLenum internal_format, unsigned int width,
+                          unsigned int height, unsigned int depth,
+                          GLenum format, GLenum type, const void *pixels)
+{
+    if (gl_target == GL_TEXTURE_3D) {
+        if (immutable) {
+            glTexSubImage3D(gl_target, level, 0, 0, 0, width, height, depth,
+                            format, type, pixels);
+        } else {
+            glTexImage3D(gl_target, level, internal_format, width, height,
+                         depth, 0, format, type, pixels);
+        }
+    } else {
+        if (immutable) {
+            glTexSubImage2D(gl_target, level, 0, 0, width, height, format,
+                            type, pixels);
+        } else {
+            glTexImage2D(gl_target, level, internal_format, width, height, 0,
+                         format, type, pixels);
+        }
+    }
+}
+
+/*
+ * Reserve space for @size bytes of texel data in the pixel unpack ring.
+ * Returns NULL if the data should be passed from client memory instead.
+ */
+static uint8_t *texture_staging_reserve(PGRAPHGLState *r, size_t size,
+                                        size_t *offset)
+{
+    if (size > r->texture_stream.size / 2) {
+        return NULL;
+    }
+
+    uint8_t *ptr =
+        pgraph_gl_stream_buffer_reserve(&r->texture_stream, size, offset);
+    if (!ptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    return ptr;
+}
+
+static void texture_staging_image(PGRAPHGLState *r, GLenum gl_target,
+                                  int level, bool immutable,
+                                  GLenum internal_format, unsigned int width,
+                                  unsigned int height, unsigned int depth,
+                                  GLenum format, GLenum type, size_t offset)
+{
+    pgraph_gl_stream_buffer_commit(&r->texture_stream);
+    texture_image(gl_target, level, immutable, internal_format, width, height,
+                  depth, format, type, (void *)offset);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    nv2a_profile_inc_counter(NV2A_PROF_TEX_UPLOAD_PBO);
+}
+
+/*
+ * Upload @size bytes at @data through the pixel unpack ring, so the driver
+ * does not have to copy from client memory before returning.
+ */
+static void texture_upload(PGRAPHGLState *r, GLenum gl_target, int level,
+                           bool immutable, GLenum internal_format,
+                           unsigned int width, unsigned int height,
+                           unsigned int depth, GLenum format, GLenum type,
+                           const uint8_t *data, size_t size)
+{
+    size_t offset;
+    uint8_t *staging = texture_staging_reserve(r, size, &offset);
+    if (staging) {
+        memcpy(staging, data, size);
+        texture_staging_image(r, gl_target, level, immutable, internal_format,
+                              width, height, depth, format, type, offset);
+    } else {
+        texture_image(gl_target, level, immutable, internal_format, width,
+                      height, depth, format, type, data);
+    }
+}
+
+static void upload_gl_texture(PGRAPHGLState *r, GLenum gl_target,
                               const TextureShape s,
                               const uint8_t *texture_data,
-                              const uint8_t *palette_data)
+                              const uint8_t *palette_data,
+                              bool immutable)
 {
     ColorFormatInfo f = kelvin_color_format_gl_map[s.color_format];
     nv2a_profile_inc_counter(NV2A_PROF_TEX_UPLOAD);
@@ -455,15 +544,19 @@ static void upload_gl_texture(GLenum gl_target,
             /* Can't handle strides unaligned to pixels */
             assert(s.pitch % f.bytes_per_pixel == 0);
 
+            size_t converted_size;
             uint8_t *converted = pgraph_convert_texture_data(
                 s, texture_data, palette_data, adjusted_width, adjusted_height, 1,
-                adjusted_pitch, 0, NULL);
+                adjusted_pitch, 0, &converted_size);
             glPixelStorei(GL_UNPACK_ROW_LENGTH,
                           converted ? 0 : adjusted_pitch / f.bytes_per_pixel);
-            glTexImage2D(GL_TEXTURE_2D, 0, f.gl_internal_format,
-                         adjusted_width, adjusted_height, 0,
-                         f.gl_format, f.gl_type,
-                         converted ? converted : texture_data);
+            texture_upload(r, GL_TEXTURE_2D, 0, immutable,
+                           f.gl_internal_format, adjusted_width,
+                           adjusted_height, 1, f.gl_format, f.gl_type,
+                           converted ? converted : texture_data,
+                           converted ? converted_size :
+                                       adjusted_pitch * (adjusted_height - 1) +
+                                           adjusted_width * f.bytes_per_pixel);
 
             if (converted) {
               g_free(converted);
@@ -513,8 +606,10 @@ static void upload_gl_texture(GLenum gl_target,
                     }
                 }
 
-                glTexImage2D(gl_target, level, GL_RGBA, tex_width, tex_height, 0,
-                             GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, converted);
+                texture_upload(r, gl_target, level, immutable, GL_RGBA,
+                               tex_width, tex_height, 1, GL_RGBA,
+                               GL_UNSIGNED_INT_8_8_8_8_REV, converted,
+                               width * height * 4);
                 g_free(converted);
                 if (s.cubemap && adjusted_width != s.width) {
                     glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
@@ -527,17 +622,42 @@ static void upload_gl_texture(GLenum gl_target,
                     physical_width / 4 * physical_height / 4 * block_size;
             } else {
                 unsigned int pitch = width * f.bytes_per_pixel;
+                bool skip_border = s.cubemap && adjusted_width != s.width;
+
+                /* Unswizzle straight into the unpack buffer if possible */
+                size_t offset;
+                uint8_t *staging = NULL;
+                if (!skip_border &&
+                    !pgraph_texture_needs_conversion(s.color_format)) {
+                    staging = texture_staging_reserve(r, height * pitch,
+                                                      &offset);
+                }
+                if (staging) {
+                    unswizzle_rect(texture_data, width, height, staging, pitch,
+                                   f.bytes_per_pixel);
+                    texture_staging_image(r, gl_target, level, immutable,
+                                          f.gl_internal_format, width, height,
+                                          1, f.gl_format, f.gl_type, offset);
+                    texture_data += width * height * f.bytes_per_pixel;
+                    width /= 2;
+                    height /= 2;
+                    continue;
+                }
+
                 uint8_t *unswizzled = (uint8_t*)g_malloc(height * pitch);
                 unswizzle_rect(texture_data, width, height,
                                unswizzled, pitch, f.bytes_per_pixel);
+                size_t converted_size;
                 uint8_t *converted = pgraph_convert_texture_data(
                     s, unswizzled, palette_data, width, height, 1, pitch, 0,
-                    NULL);
-                uint8_t *pixel_data = converted ? converted : unswizzled;
+                    &converted_size);
+                uint8_t *pixel_base = converted ? converted : unswizzled;
+                size_t pixel_size = converted ? converted_size : height * pitch;
+                uint8_t *pixel_data = pixel_base;
                 unsigned int tex_width = width;
                 unsigned int tex_height = height;
 
-                if (s.cubemap && adjusted_width != s.width) {
+                if (skip_border) {
                     // FIXME: Consider preserving the border.
                     // There does not seem to be a way to reference the border
                     // texels in a cubemap, so they are discarded.
@@ -547,9 +667,10 @@ static void upload_gl_texture(GLenum gl_target,
                     pixel_data += 4 * f.bytes_per_pixel + 4 * pitch;
                 }
 
-                glTexImage2D(gl_target, level, f.gl_internal_format, tex_width,
-                             tex_height, 0, f.gl_format, f.gl_type,
-                             pixel_data);
+                texture_upload(r, gl_target, level, immutable,
+                               f.gl_internal_format, tex_width, tex_height, 1,
+                               f.gl_format, f.gl_type, pixel_data,
+                               pixel_size - (pixel_data - pixel_base));
                 if (s.cubemap && s.border) {
                     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
                 }
@@ -597,10 +718,10 @@ static void upload_gl_texture(GLenum gl_target,
                     gl_internal_format_to_s3tc_enum(f.gl_internal_format),
                     texture_data, width, height, depth);
 
-                glTexImage3D(gl_target, level,  GL_RGBA8,
-                             width, height, depth, 0,
-                             GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV,
-                             converted);
+                texture_upload(r, gl_target, level, immutable, GL_RGBA8,
+                               width, height, depth, GL_RGBA,
+                               GL_UNSIGNED_INT_8_8_8_8_REV, converted,
+                               width * height * depth * 4);
 
                 g_free(converted);
 
@@ -616,14 +737,17 @@ static void upload_gl_texture(GLenum gl_target,
                 unswizzle_box(texture_data, width, height, depth, unswizzled,
                                row_pitch, slice_pitch, f.bytes_per_pixel);
 
+                size_t converted_size;
                 uint8_t *converted = pgraph_convert_texture_data(
                     s, unswizzled, palette_data, width, height, depth,
-                    row_pitch, slice_pitch, NULL);
+                    row_pitch, slice_pitch, &converted_size);
 
-                glTexImage3D(gl_target, level, f.gl_internal_format,
-                             width, height, depth, 0,
-                             f.gl_format, f.gl_type,
-                             converted ? converted : unswizzled);
+                texture_upload(r, gl_target, level, immutable,
+                               f.gl_internal_format, width, height, depth,
+                               f.gl_format, f.gl_type,
+                               converted ? converted : unswizzled,
+                               converted ? converted_size :
+                                           slice_pitch * depth);
 
                 if (converted) {
                     g_free(converted);
@@ -645,9 +769,97 @@ static void upload_gl_texture(GLenum gl_target,
     }
 }
 
-static TextureBinding* generate_texture(const TextureShape s,
+/* Sized format to allocate immutable storage with, or 0 to use glTexImage */
+static GLenum get_texture_storage_format(ColorFormatInfo f)
+{
+    if (f.gl_format == 0) {
+#ifdef __ANDROID__
+        return 0;
+#else
+        /* Compressed formats are decompressed on upload */
+        return GL_RGBA8;
+#endif
+    }
+
+    switch (f.gl_internal_format) {
+    case GL_R8:
+    case GL_RG8:
+    case GL_RGB565:
+    case GL_RGB5_A1:
+    case GL_RGBA4:
+    case GL_RGB8:
+    case GL_RGB8_SNORM:
+    case GL_RGBA8:
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT32F:
+#ifndef __ANDROID__
+    case GL_RGB5:
+    case GL_R16:
+#endif
+        return f.gl_internal_format;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Allocate all levels of the bound texture with glTexStorage. Returns false
+ * if the texture has to be specified level by level instead.
+ */
+static bool allocate_texture_storage(PGRAPHGLState *r, GLenum gl_target,
+                                     const TextureShape s)
+{
+    ColorFormatInfo f = kelvin_color_format_gl_map[s.color_format];
+
+    if (!r->supported_extensions.texture_storage ||
+        (gl_target != GL_TEXTURE_2D && gl_target != GL_TEXTURE_CUBE_MAP &&
+         gl_target != GL_TEXTURE_3D)) {
+        return false;
+    }
+
+    /* Cubemap borders are cropped per level, see upload_gl_texture */
+    if (s.cubemap && s.border) {
+        return false;
+    }
+
+    GLenum storage_format = get_texture_storage_format(f);
+    if (!storage_format) {
+        return false;
+    }
+
+    unsigned int width = s.width;
+    unsigned int height = s.height;
+    unsigned int depth = s.depth;
+    if (!f.linear && s.border) {
+        width = MAX(16, width * 2);
+        height = MAX(16, height * 2);
+        depth = MAX(16, depth * 2);
+    }
+
+    unsigned int levels = f.linear ? 1 : s.levels;
+    unsigned int max_dim = MAX(width, height);
+    if (gl_target == GL_TEXTURE_3D) {
+        max_dim = MAX(max_dim, depth);
+    }
+    if (!width || !height || levels == 0 || levels > 32 - clz32(max_dim)) {
+        return false;
+    }
+
+    if (gl_target == GL_TEXTURE_3D) {
+        glTexStorage3D(gl_target, levels, storage_format, width, height,
+                       depth);
+    } else {
+        glTexStorage2D(gl_target, levels, storage_format, width, height);
+    }
+
+    return true;
+}
+
+static TextureBinding* generate_texture(PGRAPHGLState *r,
+                                        const TextureShape s,
                                         const uint8_t *texture_data,
-                                        const uint8_t *palette_data)
+                                        const uint8_t *palette_data,
+                                        bool allow_immutable)
 {
     ColorFormatInfo f = kelvin_color_format_gl_map[s.color_format];
 
@@ -692,6 +904,9 @@ static TextureBinding* generate_texture(const TextureShape s,
                    s.dimensionality, s.cubemap ? " (Cubemap)" : "",
                    s.width, s.height, s.depth);
 
+    bool immutable =
+        allow_immutable && allocate_texture_storage(r, gl_target, s);
+
     if (gl_target == GL_TEXTURE_CUBE_MAP) {
         unsigned int block_size;
         if (f.gl_internal_format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) {
@@ -722,20 +937,27 @@ static TextureBinding* generate_texture(const TextureShape s,
 
         length = (length + NV2A_CUBEMAP_FACE_ALIGNMENT - 1) & ~(NV2A_CUBEMAP_FACE_ALIGNMENT - 1);
 
-        upload_gl_texture(GL_TEXTURE_CUBE_MAP_POSITIVE_X,
-                          s, texture_data + 0 * length, palette_data);
-        upload_gl_texture(GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-                          s, texture_data + 1 * length, palette_data);
-        upload_gl_texture(GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
-                          s, texture_data + 2 * length, palette_data);
-        upload_gl_texture(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-                          s, texture_data + 3 * length, palette_data);
-        upload_gl_texture(GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
-                          s, texture_data + 4 * length, palette_data);
-        upload_gl_texture(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
-                          s, texture_data + 5 * length, palette_data);
+        upload_gl_texture(r, GL_TEXTURE_CUBE_MAP_POSITIVE_X, s,
+                          texture_data + 0 * length, palette_data,
+                          immutable);
+        upload_gl_texture(r, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, s,
+                          texture_data + 1 * length, palette_data,
+                          immutable);
+        upload_gl_texture(r, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, s,
+                          texture_data + 2 * length, palette_data,
+                          immutable);
+        upload_gl_texture(r, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, s,
+                          texture_data + 3 * length, palette_data,
+                          immutable);
+        upload_gl_texture(r, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, s,
+                          texture_data + 4 * length, palette_data,
+                          immutable);
+        upload_gl_texture(r, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, s,
+                          texture_data + 5 * length, palette_data,
+                          immutable);
     } else {
-        upload_gl_texture(gl_target, s, texture_data, palette_data);
+        upload_gl_texture(r, gl_target, s, texture_data, palette_data,
+                          immutable);
     }
 
     /* Linear textures don't support mipmapping */
@@ -765,6 +987,7 @@ static TextureBinding* generate_texture(const TextureShape s,
     ret->addrv = 0xFFFFFFFF;
     ret->addrp = 0xFFFFFFFF;
     ret->border_color_set = false;
+    ret->immutable = immutable;
     return ret;
 }
 
@@ -822,6 +1045,11 @@ void pgraph_gl_init_textures(NV2AState *d)
     r->texture_cache.init_node = texture_cache_entry_init;
     r->texture_cache.compare_nodes = texture_cache_entry_compare;
     r->texture_cache.post_node_evict = texture_cache_entry_post_evict;
+
+    pgraph_gl_stream_buffer_init(&r->texture_stream, GL_PIXEL_UNPACK_BUFFER,
+                                 texture_stream_size,
+                                 r->supported_extensions.buffer_storage);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
 void pgraph_gl_finalize_textures(PGRAPHState *pg)
@@ -836,4 +1064,6 @@ void pgraph_gl_finalize_textures(PGRAPHState *pg)
     free(r->texture_cache_entries);
 
     r->texture_cache_entries = NULL;
+
+    pgraph_gl_stream_buffer_finalize(&r->texture_stream);
 }
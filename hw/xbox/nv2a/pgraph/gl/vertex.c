@@ -54,11 +54,160 @@ static void update_memory_buffer(NV2AState *d, hwaddr addr, hwaddr size,
 
 void pgraph_gl_update_entire_memory_buffer(NV2AState *d)
 {
-    PGRAPHState *pg = &d->pgraph;
-    PGRAPHGLState *r = pg->gl_renderer_state;
+    /* Upload lazily, only the pages draws actually source from */
+    memory_region_set_client_dirty(d->vram, 0, memory_region_size(d->vram),
+                                   DIRTY_MEMORY_NV2A);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, r->gl_memory_buffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, memory_region_size(d->vram), d->vram_ptr);
+#define STREAM_BUFFER_ALIGNMENT 16
+
+void pgraph_gl_stream_buffer_init(StreamBuffer *sb, GLenum target, size_t size,
+                                  bool persistent)
+{
+    memset(sb, 0, sizeof(*sb));
+    sb->target = target;
+    sb->size = size;
+    sb->persistent = persistent;
+
+    glGenBuffers(1, &sb->gl_buffer);
+    glBindBuffer(target, sb->gl_buffer);
+
+    if (persistent) {
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, size, NULL, flags);
+        sb->mapped = glMapBufferRange(target, 0, size, flags);
+        if (sb->mapped) {
+            return;
+        }
+        /* Fall back to orphaning with a mutable buffer */
+        glDeleteBuffers(1, &sb->gl_buffer);
+        glGenBuffers(1, &sb->gl_buffer);
+        glBindBuffer(target, sb->gl_buffer);
+        sb->persistent = false;
+    }
+
+    glBufferData(target, size, NULL, GL_STREAM_DRAW);
+}
+
+void pgraph_gl_stream_buffer_finalize(StreamBuffer *sb)
+{
+    for (int i = 0; i < STREAM_BUFFER_SEGMENTS; i++) {
+        if (sb->fences[i]) {
+            glDeleteSync(sb->fences[i]);
+            sb->fences[i] = 0;
+        }
+    }
+    if (sb->mapped) {
+        glBindBuffer(sb->target, sb->gl_buffer);
+        glUnmapBuffer(sb->target);
+        sb->mapped = NULL;
+    }
+    glDeleteBuffers(1, &sb->gl_buffer);
+    sb->gl_buffer = 0;
+}
+
+static void stream_buffer_fence_segment(StreamBuffer *sb)
+{
+    assert(!sb->fences[sb->segment]);
+    sb->fences[sb->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/* Wait for the GPU to finish reading a segment before it is overwritten */
+static void stream_buffer_enter_segment(StreamBuffer *sb, unsigned int segment)
+{
+    sb->segment = segment;
+
+    GLsync fence = sb->fences[segment];
+    if (!fence) {
+        return;
+    }
+
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_STALL);
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                         GL_TIMEOUT_IGNORED);
+    }
+    glDeleteSync(fence);
+    sb->fences[segment] = 0;
+}
+
+/*
+ * Make room for @size bytes in the stream buffer and bind it to its target.
+ * Returns a pointer to write the data to, to be followed by
+ * pgraph_gl_stream_buffer_commit(), or NULL if the buffer could not be
+ * mapped. The offset of the data within the buffer is returned in @offset.
+ */
+void *pgraph_gl_stream_buffer_reserve(StreamBuffer *sb, size_t size,
+                                      size_t *offset)
+{
+    if (size > sb->size) {
+        bool persistent = sb->persistent;
+        GLenum target = sb->target;
+        pgraph_gl_stream_buffer_finalize(sb);
+        pgraph_gl_stream_buffer_init(sb, target, pow2ceil(size * 2),
+                                     persistent);
+    }
+
+    glBindBuffer(sb->target, sb->gl_buffer);
+
+    size_t start = ROUND_UP(sb->offset, STREAM_BUFFER_ALIGNMENT);
+    bool wrap = start + size > sb->size;
+    if (wrap) {
+        nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_WRAP);
+        start = 0;
+    }
+
+    *offset = start;
+    sb->offset = start + size;
+
+    if (sb->persistent) {
+        size_t segment_size = sb->size / STREAM_BUFFER_SEGMENTS;
+        unsigned int last_segment = (start + size - 1) / segment_size;
+        if (wrap) {
+            stream_buffer_fence_segment(sb);
+            stream_buffer_enter_segment(sb, 0);
+        }
+        while (sb->segment < last_segment) {
+            stream_buffer_fence_segment(sb);
+            stream_buffer_enter_segment(sb, sb->segment + 1);
+        }
+        return sb->mapped + start;
+    }
+
+    if (wrap) {
+        glBufferData(sb->target, sb->size, NULL, GL_STREAM_DRAW);
+    }
+    return glMapBufferRange(sb->target, start, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void pgraph_gl_stream_buffer_commit(StreamBuffer *sb)
+{
+    if (!sb->persistent) {
+        glUnmapBuffer(sb->target);
+    }
+}
+
+/*
+ * Copy @data into the stream buffer and bind it to its target. Returns the
+ * offset of the data within the buffer.
+ */
+size_t pgraph_gl_stream_buffer_upload(StreamBuffer *sb, const void *data,
+                                      size_t size)
+{
+    size_t offset;
+    void *ptr = pgraph_gl_stream_buffer_reserve(sb, size, &offset);
+    if (ptr) {
+        memcpy(ptr, data, size);
+        pgraph_gl_stream_buffer_commit(sb);
+    } else {
+        glBufferSubData(sb->target, offset, size, data);
+    }
+
+    return offset;
 }
 
 void pgraph_gl_bind_vertex_attributes(NV2AState *d, unsigned int min_element,
@@ -143,8 +292,8 @@ void pgraph_gl_bind_vertex_attributes(NV2AState *d, unsigned int min_element,
 
         hwaddr start = 0;
         if (inline_data) {
-            glBindBuffer(GL_ARRAY_BUFFER, r->gl_inline_array_buffer);
-            attrib_data_addr = attr->inline_array_offset;
+            glBindBuffer(GL_ARRAY_BUFFER, r->vertex_stream.gl_buffer);
+            attrib_data_addr = r->inline_array_offset + attr->inline_array_offset;
             stride = inline_stride;
         } else {
             hwaddr dma_len;
@@ -222,10 +371,8 @@ unsigned int pgraph_gl_bind_inline_array(NV2AState *d)
     NV2A_DPRINTF("draw inline array %d, %d\n", vertex_size, index_count);
 
     nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_2);
-    glBindBuffer(GL_ARRAY_BUFFER, r->gl_inline_array_buffer);
-    GLsizeiptr buffer_size = index_count * vertex_size;
-    glBufferData(GL_ARRAY_BUFFER, buffer_size, NULL, GL_STREAM_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, buffer_size, pg->inline_array);
+    r->inline_array_offset = pgraph_gl_stream_buffer_upload(
+        &r->vertex_stream, pg->inline_array, index_count * vertex_size);
     pgraph_gl_bind_vertex_attributes(d, 0, index_count-1, true, vertex_size,
                                   index_count-1);
 
@@ -246,6 +393,8 @@ static bool vertex_cache_entry_compare(Lru *lru, LruNode *node, const void *key)
 }
 
 static const size_t element_cache_size = 50*1024;
+static const size_t vertex_stream_size = 16 * 1024 * 1024;
+static const size_t index_stream_size = 4 * 1024 * 1024;
 
 void pgraph_gl_init_buffers(NV2AState *d)
 {
@@ -269,9 +418,12 @@ void pgraph_gl_init_buffers(NV2AState *d)
     glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &max_vertex_attributes);
     assert(max_vertex_attributes >= NV2A_VERTEXSHADER_ATTRIBUTES);
 
-    glGenBuffers(NV2A_VERTEXSHADER_ATTRIBUTES, r->gl_inline_buffer);
-    glGenBuffers(1, &r->gl_inline_array_buffer);
-    glGenBuffers(1, &r->gl_prim_rewrite_buffer);
+    pgraph_gl_stream_buffer_init(&r->vertex_stream, GL_ARRAY_BUFFER,
+                                 vertex_stream_size,
+                                 r->supported_extensions.buffer_storage);
+    pgraph_gl_stream_buffer_init(&r->index_stream, GL_ELEMENT_ARRAY_BUFFER,
+                                 index_stream_size,
+                                 r->supported_extensions.buffer_storage);
     pgraph_prim_rewrite_init(&r->prim_rewrite_buf);
 
     glGenBuffers(1, &r->gl_memory_buffer);
@@ -299,14 +451,8 @@ void pgraph_gl_finalize_buffers(PGRAPHState *pg)
     g_free(r->element_cache_entries);
     r->element_cache_entries = NULL;
 
-    glDeleteBuffers(NV2A_VERTEXSHADER_ATTRIBUTES, r->gl_inline_buffer);
-    memset(r->gl_inline_buffer, 0, sizeof(r->gl_inline_buffer));
-
-    glDeleteBuffers(1, &r->gl_inline_array_buffer);
-    r->gl_inline_array_buffer = 0;
-
-    glDeleteBuffers(1, &r->gl_prim_rewrite_buffer);
-    r->gl_prim_rewrite_buffer = 0;
+    pgraph_gl_stream_buffer_finalize(&r->vertex_stream);
+    pgraph_gl_stream_buffer_finalize(&r->index_stream);
     pgraph_prim_rewrite_finalize(&r->prim_rewrite_buf);
 
     glDeleteBuffers(1, &r->gl_memory_buffer);
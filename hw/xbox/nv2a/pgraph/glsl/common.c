@@ -26,10 +26,13 @@ const char *uniform_element_type_to_str[] = {
 };
 
 MString *pgraph_glsl_get_vtx_header(MString *out, bool location, bool smooth,
-                                    bool in, bool prefix, bool array)
+                                    bool interpolated_pos, bool in,
+                                    bool prefix, bool array)
 {
     const char *smooth_s = "";
     const char *flat_s = "flat ";
+    const char *noperspective_s = "noperspective ";
+    const char *pos_qualifier_s = interpolated_pos ? noperspective_s : flat_s;
     const char *qualifier_s = smooth ? smooth_s : flat_s;
     const char *in_out_s = in ? "in" : "out";
     const char *float_s = "float";
@@ -48,7 +51,7 @@ MString *pgraph_glsl_get_vtx_header(MString *out, bool location, bool smooth,
         { smooth_s,    vec4_s,  "vtxT1"  },
         { smooth_s,    vec4_s,  "vtxT2"  },
         { smooth_s,    vec4_s,  "vtxT3"  },
-        { flat_s,      vec4_s,  "vtxPos0" },
+        { pos_qualifier_s, vec4_s, "vtxPos0" },
         { flat_s,      vec4_s,  "vtxPos1" },
         { flat_s,      vec4_s,  "vtxPos2" },
         { flat_s,      float_s, "triMZ"  },
@@ -97,8 +97,13 @@ typedef struct UniformInfo {
 
 #define GLSL_DEFINE(a, b) "#define " stringify(a) " " b "\n"
 
+/*
+ * With @interpolated_pos, vtxPos0 is interpolated across the primitive
+ * (noperspective) instead of carrying one vertex of a flat triangle.
+ */
 MString *pgraph_glsl_get_vtx_header(MString *out, bool location, bool smooth,
-                                    bool in, bool prefix, bool array);
+                                    bool interpolated_pos, bool in,
+                                    bool prefix, bool array);
 void pgraph_glsl_append_version(MString *out, bool vulkan, bool gles,
                                 int gles_version);
 
@@ -127,10 +127,10 @@ MString *pgraph_glsl_gen_geom(const GeomState *state, GenGeomGlslOptions opts)
                        "#define v_vtxPos v_vtxPos0\n"
                        "\n",
                        layout_in, layout_out);
-    pgraph_glsl_get_vtx_header(output, opts.vulkan, state->smooth_shading, true,
-                               true, true);
     pgraph_glsl_get_vtx_header(output, opts.vulkan, state->smooth_shading,
-                               false, false, false);
+                               false, true, true, true);
+    pgraph_glsl_get_vtx_header(output, opts.vulkan, state->smooth_shading,
+                               false, false, false, false);
 
     const char *point_size_expr =
         opts.gles ? "v_vtxPointSize[index]" : "gl_in[index].gl_PointSize";
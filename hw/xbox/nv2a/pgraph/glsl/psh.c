@@ -805,8 +805,12 @@ static void define_colorkey_comparator(MString *preflight)
 static MString* psh_convert(struct PixelShader *ps)
 {
     MString *preflight = mstring_new();
+    if (ps->opts.polygon_mode_emulation != POLY_MODE_FILL) {
+        mstring_append(preflight, "#extension GL_EXT_fragment_shader_barycentric : require\n");
+    }
     pgraph_glsl_get_vtx_header(preflight, ps->opts.vulkan,
-                             ps->state->smooth_shading, true, false, false);
+                               ps->state->smooth_shading,
+                               ps->opts.interpolated_pos, true, false, false);
 
     if (ps->opts.vulkan) {
         mstring_append_fmt(
@@ -970,6 +974,31 @@ static MString* psh_convert(struct PixelShader *ps)
         );
 
     MString *clip = mstring_new();
+
+    /* Derivatives are taken up front, before any invocation is discarded */
+    if (ps->opts.interpolated_pos) {
+        const char *zvalue_expr =
+            ps->state->z_perspective ? "1.0 / vtxPos0.w" : "vtxPos0.z";
+        const char *slope_expr =
+            ps->state->z_perspective ? "vtxPos0.w" : "vtxPos0.z";
+
+        mstring_append_fmt(clip, "precise float zvalue = %s;\n", zvalue_expr);
+        if (ps->opts.depth_slope_from_derivatives) {
+            /* Derivatives are per scaled pixel, triMZ is per surface pixel */
+            mstring_append_fmt(
+                clip,
+                "float zslope = max(abs(dFdx(%s)) * float(surfaceScale.x),\n"
+                "                   abs(dFdy(%s)) * float(surfaceScale.y));\n",
+                slope_expr, slope_expr);
+        } else {
+            mstring_append(clip, "float zslope = triMZ;\n");
+        }
+    }
+    if (ps->opts.polygon_mode_emulation != POLY_MODE_FILL) {
+        mstring_append(clip, "vec3 bary = gl_BaryCoordNoPerspEXT;\n"
+                             "vec3 bary_width = fwidth(bary);\n");
+    }
+
     mstring_append_fmt(clip, "/*  Window-clip (%slusive) */\n",
                        ps->state->window_clip_exclusive ? "Exc" : "Inc");
     if (!ps->state->window_clip_exclusive) {
@@ -995,7 +1024,36 @@ static MString* psh_convert(struct PixelShader *ps)
                              "}\n");
     }
 
-    if (ps->state->z_perspective) {
+    if (ps->opts.polygon_mode_emulation == POLY_MODE_LINE) {
+        /* Keep about one pixel along each edge of the filled triangle */
+        mstring_append(clip, "if (all(greaterThanEqual(bary, bary_width))) {\n"
+                             "  discard;\n"
+                             "}\n");
+    } else if (ps->opts.polygon_mode_emulation == POLY_MODE_POINT) {
+        /* Keep about one pixel at each vertex of the filled triangle */
+        mstring_append(clip, "if (all(lessThan(bary, vec3(1.0) - bary_width))) {\n"
+                             "  discard;\n"
+                             "}\n");
+    }
+
+    if (ps->opts.interpolated_pos && ps->state->z_perspective) {
+        mstring_append(
+            clip,
+            "if (zvalue > 0.0) {\n"
+            "  float zslopeofs = depthFactor*zslope*zvalue*zvalue;\n"
+            "  zvalue += depthOffset;\n"
+            "  zvalue += zslopeofs;\n"
+            "} else {\n"
+            "  zvalue = uintBitsToFloat(0x7F7FFFFFu);\n"
+            "}\n"
+            "if (isnan(zvalue)) {\n"
+            "  zvalue = uintBitsToFloat(0x7F7FFFFFu);\n"
+            "}\n");
+    } else if (ps->opts.interpolated_pos) {
+        mstring_append(clip,
+                       "zvalue += depthOffset;\n"
+                       "zvalue += depthFactor*zslope;\n");
+    } else if (ps->state->z_perspective) {
         mstring_append(
             clip,
             "vec2 unscaled_xy = gl_FragCoord.xy / vec2(surfaceScale);\n"
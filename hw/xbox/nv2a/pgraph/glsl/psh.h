@@ -24,6 +24,7 @@
 
 #include "common.h"
 #include "hw/xbox/nv2a/pgraph/psh_regs.h"
+#include "hw/xbox/nv2a/pgraph/vsh_regs.h"
 
 typedef struct PGRAPHState PGRAPHState;
 
@@ -100,6 +101,17 @@ typedef struct GenPshGlslOptions {
     int gles_version;
     int ubo_binding;
     int tex_binding;
+
+    /*
+     * Used without a geometry shader: depth is taken from the interpolated
+     * vtxPos0, with the slope for polygon offset from screen space
+     * derivatives when the primitive is a triangle. Line and point fill
+     * modes may be emulated with barycentric coordinates
+     * (GL_EXT_fragment_shader_barycentric).
+     */
+    bool interpolated_pos;
+    bool depth_slope_from_derivatives;
+    enum ShaderPolygonMode polygon_mode_emulation;
 } GenPshGlslOptions;
 
 MString *pgraph_glsl_gen_psh(const PshState *state, GenPshGlslOptions opts);
@@ -431,7 +431,133 @@ static MString *decode_opcode(const uint32_t *shader_token,
     return ret;
 }
 
-static MString *decode_token(const uint32_t *shader_token)
+/* Temporaries R0-R11 are tracked for liveness; R12 aliases oPos */
+#define VSH_NUM_TEMP_REGS 12
+
+// Components referenced by an input swizzle, in output write mask layout
+static uint8_t swizzle_read_mask(const uint32_t *shader_token,
+                                 VshFieldName swizzle_field)
+{
+    uint8_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        mask |= 0x8 >> vsh_get_field(shader_token, swizzle_field + i);
+    }
+    return mask;
+}
+
+static void mark_input_live(const uint32_t *shader_token,
+                            VshFieldName mux_field, VshFieldName neg_field,
+                            int reg_num, uint8_t *live, bool *a0_live)
+{
+    switch (vsh_get_field(shader_token, mux_field)) {
+    case PARAM_R:
+        if (reg_num < VSH_NUM_TEMP_REGS) {
+            live[reg_num] |= swizzle_read_mask(shader_token, neg_field + 1);
+        }
+        break;
+    case PARAM_C:
+        if (vsh_get_field(shader_token, FLD_A0X)) {
+            *a0_live = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static bool has_output_write(const uint32_t *shader_token, VshOutputMux mux)
+{
+    return vsh_get_field(shader_token, FLD_OUT_MUX) == mux &&
+           vsh_get_field(shader_token, FLD_OUT_O_MASK) != 0;
+}
+
+/*
+ * Vertex programs are straight-line code, so a single backward pass over the
+ * slots gives exact per-component liveness of the temporary registers. MAC and
+ * ILU temp writes are trimmed to their live components and dropped entirely
+ * when nothing reads them. Output, oPos (R12) and A0 side effects are kept.
+ *
+ * Reads are approximated by every component an input swizzle names, which is
+ * a superset of what the operation actually consumes.
+ */
+void pgraph_glsl_compute_vsh_liveness(const uint32_t *tokens,
+                                      unsigned int length,
+                                      VshSlotLiveness *liveness)
+{
+    uint8_t live[VSH_NUM_TEMP_REGS] = { 0 };
+    bool a0_live = false;
+
+    for (int slot = length - 1; slot >= 0; slot--) {
+        const uint32_t *token = &tokens[slot * VSH_TOKEN_SIZE];
+        VshSlotLiveness *l = &liveness[slot];
+        VshMAC mac = vsh_get_field(token, FLD_MAC);
+        VshILU ilu = vsh_get_field(token, FLD_ILU);
+        int out_reg = vsh_get_field(token, FLD_OUT_R);
+
+        *l = (VshSlotLiveness){ 0 };
+
+        /* Mirror the register selection in decode_opcode */
+        int mac_reg = out_reg;
+        uint8_t mac_write_mask = vsh_get_field(token, FLD_OUT_MAC_MASK);
+        if (ilu != ILU_NOP && mac_reg == 1) {
+            mac_write_mask = 0;
+        }
+        int ilu_reg = mac != MAC_NOP ? 1 : out_reg;
+        uint8_t ilu_write_mask = vsh_get_field(token, FLD_OUT_ILU_MASK);
+
+        if (mac == MAC_ARL) {
+            l->mac_live = a0_live || has_output_write(token, OMUX_MAC);
+        } else if (mac != MAC_NOP) {
+            l->mac_mask = mac_write_mask;
+            if (mac_reg < VSH_NUM_TEMP_REGS) {
+                l->mac_mask &= live[mac_reg];
+            }
+            l->mac_live = l->mac_mask || has_output_write(token, OMUX_MAC);
+        }
+
+        if (ilu != ILU_NOP) {
+            l->ilu_mask = ilu_write_mask;
+            if (ilu_reg < VSH_NUM_TEMP_REGS) {
+                l->ilu_mask &= live[ilu_reg];
+            }
+            l->ilu_live = l->ilu_mask || has_output_write(token, OMUX_ILU);
+        }
+
+        /* Paired MAC and ILU read their inputs before either writes */
+        if (mac == MAC_ARL) {
+            a0_live = false;
+        } else if (mac != MAC_NOP && mac_reg < VSH_NUM_TEMP_REGS) {
+            live[mac_reg] &= ~mac_write_mask;
+        }
+        if (ilu != ILU_NOP && ilu_reg < VSH_NUM_TEMP_REGS) {
+            live[ilu_reg] &= ~ilu_write_mask;
+        }
+
+        int c_reg = (vsh_get_field(token, FLD_C_R_HIGH) << 2) |
+                    vsh_get_field(token, FLD_C_R_LOW);
+
+        if (l->mac_live) {
+            if (mac_opcode_params[mac].A) {
+                mark_input_live(token, FLD_A_MUX, FLD_A_NEG,
+                                vsh_get_field(token, FLD_A_R), live, &a0_live);
+            }
+            if (mac_opcode_params[mac].B) {
+                mark_input_live(token, FLD_B_MUX, FLD_B_NEG,
+                                vsh_get_field(token, FLD_B_R), live, &a0_live);
+            }
+            if (mac_opcode_params[mac].C) {
+                mark_input_live(token, FLD_C_MUX, FLD_C_NEG, c_reg, live,
+                                &a0_live);
+            }
+        }
+        if (l->ilu_live) {
+            mark_input_live(token, FLD_C_MUX, FLD_C_NEG, c_reg, live, &a0_live);
+        }
+    }
+}
+
+static MString *decode_token(const uint32_t *shader_token,
+                             const VshSlotLiveness *liveness)
 {
     MString *ret;
 
@@ -439,7 +565,7 @@ static MString *decode_token(const uint32_t *shader_token)
     VshMAC mac = vsh_get_field(shader_token, FLD_MAC);
     /* See if a ILU opcode is present too: */
     VshILU ilu = vsh_get_field(shader_token, FLD_ILU);
-    if (mac == MAC_NOP && ilu == ILU_NOP) {
+    if (!liveness->mac_live && !liveness->ilu_live) {
         return mstring_new();
     }
 
@@ -452,7 +578,7 @@ static MString *decode_token(const uint32_t *shader_token)
                                 | vsh_get_field(shader_token, FLD_C_R_LOW));
 
     MString *mac_suffix = NULL;
-    if (mac != MAC_NOP) {
+    if (liveness->mac_live) {
         MString *inputs_mac = mstring_new();
         if (mac_opcode_params[mac].A) {
             MString *input_a =
@@ -482,7 +608,7 @@ static MString *decode_token(const uint32_t *shader_token)
         /* Then prepend these inputs with the actual opcode, mask, and input : */
         ret = decode_opcode(shader_token,
                             OMUX_MAC,
-                            vsh_get_field(shader_token, FLD_OUT_MAC_MASK),
+                            liveness->mac_mask,
                             mac_opcode[mac],
                             mstring_get_str(inputs_mac),
                             &mac_suffix);
@@ -491,7 +617,7 @@ static MString *decode_token(const uint32_t *shader_token)
         ret = mstring_new();
     }
 
-    if (ilu != ILU_NOP) {
+    if (liveness->ilu_live) {
         MString *inputs_c = mstring_from_str(", ");
         mstring_append(inputs_c, mstring_get_str(input_c));
 
@@ -499,7 +625,7 @@ static MString *decode_token(const uint32_t *shader_token)
         MString *ilu_op =
             decode_opcode(shader_token,
                           OMUX_ILU,
-                          vsh_get_field(shader_token, FLD_OUT_ILU_MASK),
+                          liveness->ilu_mask,
                           ilu_opcode[ilu],
                           mstring_get_str(inputs_c),
                           NULL);
@@ -730,12 +856,24 @@ void pgraph_glsl_gen_vsh_prog(uint16_t version, const uint32_t *tokens,
 
     mstring_append(header, vsh_header);
 
+    unsigned int program_length = length;
+    for (int slot = 0; slot < length; slot++) {
+        if (vsh_get_field(&tokens[slot * VSH_TOKEN_SIZE], FLD_FINAL)) {
+            program_length = slot + 1;
+            break;
+        }
+    }
+
+    VshSlotLiveness liveness[NV2A_MAX_TRANSFORM_PROGRAM_LENGTH];
+    assert(program_length <= ARRAY_SIZE(liveness));
+    pgraph_glsl_compute_vsh_liveness(tokens, program_length, liveness);
+
     bool has_final = false;
     int slot;
 
-    for (slot=0; slot < length; slot++) {
+    for (slot=0; slot < program_length; slot++) {
         const uint32_t* cur_token = &tokens[slot * VSH_TOKEN_SIZE];
-        MString *token_str = decode_token(cur_token);
+        MString *token_str = decode_token(cur_token, &liveness[slot]);
         mstring_append_fmt(body,
                            "  /* Slot %d: 0x%08X 0x%08X 0x%08X 0x%08X */\n"
                            "  %s\n",
@@ -24,6 +24,17 @@
 
 #include "qemu/mstring.h"
 
+/* Live parts of a vertex program slot, see pgraph_glsl_compute_vsh_liveness */
+typedef struct VshSlotLiveness {
+    bool mac_live;
+    bool ilu_live;
+    uint8_t mac_mask; /* Temporary register components to write */
+    uint8_t ilu_mask;
+} VshSlotLiveness;
+
+void pgraph_glsl_compute_vsh_liveness(const uint32_t *tokens,
+                                      unsigned int length,
+                                      VshSlotLiveness *liveness);
 void pgraph_glsl_gen_vsh_prog(uint16_t version, const uint32_t *tokens,
                               unsigned int length, MString *header,
                               MString *body);
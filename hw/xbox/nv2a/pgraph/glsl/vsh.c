@@ -233,7 +233,8 @@ MString *pgraph_glsl_gen_vsh(const VshState *state, GenVshGlslOptions opts)
         "}\n");
 
     pgraph_glsl_get_vtx_header(header, opts.vulkan, state->smooth_shading,
-                               false, opts.prefix_outputs, false);
+                               opts.interpolated_pos, false,
+                               opts.prefix_outputs, false);
 
     if (opts.prefix_outputs) {
         mstring_append(header,
@@ -414,6 +415,11 @@ MString *pgraph_glsl_gen_vsh(const VshState *state, GenVshGlslOptions opts)
                    "  gl_PointSize = oPts.x;\n"
     );
 
+    if (opts.interpolated_pos) {
+        /* Screen space z and 1/w are linear across the primitive */
+        mstring_append(body, "  vtxPos0.w = 1.0 / vtxPos.w;\n");
+    }
+
     if (state->specular_enable) {
         mstring_append(body,
                        "  vtxD1 = clamp(NaNToOne(oD1), 0.0, 1.0);\n"
@@ -101,6 +101,7 @@ typedef struct GenVshGlslOptions {
     bool gles;
     int gles_version;
     bool prefix_outputs;
+    bool interpolated_pos;
     bool use_push_constants_for_uniform_attrs;
     int ubo_binding;
 } GenVshGlslOptions;
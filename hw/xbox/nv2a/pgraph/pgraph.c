@@ -29,8 +29,8 @@
 #include "ui/xemu-notifications.h"
 #include "ui/xemu-settings.h"
 #include "util.h"
+#include "vertex_data.h"
 #include "swizzle.h"
-#include "nv2a_vsh_emulator.h"
 
 #define PG_GET_MASK(reg, mask) GET_MASK(pgraph_reg_r(pg, reg), mask)
 #define PG_SET_MASK(reg, mask, value)        \
@@ -43,14 +43,54 @@
 
 NV2AState *g_nv2a;
 
+/* Called with pg->lock held after any change to the shadowed registers */
+void pgraph_update_shadow_regs(PGRAPHState *pg)
+{
+    qatomic_set(&pg->shadow.pending_interrupts, pg->pending_interrupts);
+    qatomic_set(&pg->shadow.enabled_interrupts, pg->enabled_interrupts);
+    qatomic_set(&pg->shadow.status, pgraph_reg_r(pg, NV_PGRAPH_STATUS));
+
+    nv2a_poll_notify(container_of(pg, NV2AState, pgraph));
+}
+
+static bool pgraph_read_shadow_reg(PGRAPHState *pg, hwaddr addr,
+                                   uint64_t *val)
+{
+    switch (addr) {
+    case NV_PGRAPH_INTR:
+        *val = qatomic_read(&pg->shadow.pending_interrupts);
+        return true;
+    case NV_PGRAPH_INTR_EN:
+        *val = qatomic_read(&pg->shadow.enabled_interrupts);
+        return true;
+    case NV_PGRAPH_STATUS:
+        *val = qatomic_read(&pg->shadow.status);
+        return true;
+    default:
+        return false;
+    }
+}
+
 uint64_t pgraph_read(void *opaque, hwaddr addr, unsigned int size)
 {
     NV2AState *d = (NV2AState *)opaque;
     PGRAPHState *pg = &d->pgraph;
 
+    uint64_t r = 0;
+
+    /*
+     * Registers the guest spins on are served without pg->lock, which the
+     * FIFO thread holds for the duration of a method batch.
+     */
+    uint32_t poll_generation = nv2a_poll_begin(d);
+    if (pgraph_read_shadow_reg(pg, addr, &r)) {
+        nv2a_poll_check(d, NV_PGRAPH, addr, r, poll_generation);
+        nv2a_reg_log_read(NV_PGRAPH, addr, size, r);
+        return r;
+    }
+
     qemu_mutex_lock(&pg->lock);
 
-    uint64_t r = 0;
     switch (addr) {
     case NV_PGRAPH_INTR:
         r = pg->pending_interrupts;
@@ -177,6 +217,8 @@ void pgraph_write(void *opaque, hwaddr addr, uint64_t val, unsigned int size)
         break;
     }
 
+    pgraph_update_shadow_regs(pg);
+
     qemu_mutex_unlock(&pg->lock);
     qemu_mutex_unlock(&d->pfifo.lock);
 }
@@ -202,9 +244,10 @@ void pgraph_context_switch(NV2AState *d, unsigned int channel_id)
                             NV_PGRAPH_DEBUG_3_HW_CONTEXT_SWITCH));
 
         pg->waiting_for_context_switch = true;
+        pg->pending_interrupts |= NV_PGRAPH_INTR_CONTEXT_SWITCH;
+        pgraph_update_shadow_regs(pg);
         qemu_mutex_unlock(&pg->lock);
         bql_lock();
-        pg->pending_interrupts |= NV_PGRAPH_INTR_CONTEXT_SWITCH;
         nv2a_update_irq(d);
         bql_unlock();
         qemu_mutex_lock(&pg->lock);
@@ -457,6 +500,12 @@ void pgraph_destroy(PGRAPHState *pg)
     qemu_mutex_destroy(&pg->lock);
 }
 
+/*
+ * Acquire the display surface for the current frame. The first reader syncs
+ * with PGRAPH and publishes the surface; readers that arrive while it is
+ * still held share it. Each call must be paired with
+ * nv2a_release_framebuffer_surface. Does not need the BQL.
+ */
 int nv2a_get_framebuffer_surface(void)
 {
     NV2AState *d = g_nv2a;
@@ -464,11 +513,15 @@ int nv2a_get_framebuffer_surface(void)
     int s = 0;
 
     qemu_mutex_lock(&pg->renderer_lock);
-    assert(!pg->framebuffer_in_use);
-    pg->framebuffer_in_use = true;
-    if (pg->renderer->ops.get_framebuffer_surface) {
-        s = pg->renderer->ops.get_framebuffer_surface(d);
+    if (pg->framebuffer_refs == 0) {
+        pg->framebuffer_surface = 0;
+        if (pg->renderer->ops.get_framebuffer_surface) {
+            pg->framebuffer_surface =
+                pg->renderer->ops.get_framebuffer_surface(d);
+        }
     }
+    pg->framebuffer_refs++;
+    s = pg->framebuffer_surface;
     qemu_mutex_unlock(&pg->renderer_lock);
 
     return s;
@@ -479,11 +532,55 @@ void nv2a_release_framebuffer_surface(void)
     NV2AState *d = g_nv2a;
     PGRAPHState *pg = &d->pgraph;
     qemu_mutex_lock(&pg->renderer_lock);
-    pg->framebuffer_in_use = false;
-    qemu_cond_broadcast(&pg->framebuffer_released);
+    assert(pg->framebuffer_refs > 0);
+    if (--pg->framebuffer_refs == 0) {
+        if (pg->renderer->ops.release_framebuffer_surface) {
+            pg->renderer->ops.release_framebuffer_surface(d);
+        }
+        qemu_cond_broadcast(&pg->framebuffer_released);
+    }
     qemu_mutex_unlock(&pg->renderer_lock);
 }
 
+/*
+ * Hand a native window to the renderer to present to directly, or NULL to
+ * stop presenting. Returns true if the renderer will present to it.
+ */
+bool nv2a_set_present_window(void *window)
+{
+    NV2AState *d = g_nv2a;
+    PGRAPHState *pg = &d->pgraph;
+    bool active = false;
+
+    qemu_mutex_lock(&pg->renderer_lock);
+    if (pg->renderer->ops.set_present_window) {
+        active = pg->renderer->ops.set_present_window(d, window);
+    }
+    qemu_mutex_unlock(&pg->renderer_lock);
+
+    return active;
+}
+
+/*
+ * Present the current frame to the window set with nv2a_set_present_window,
+ * letterboxed to @aspect_ratio (0 to fill the window). Returns false if the
+ * renderer has nothing to present to.
+ */
+bool nv2a_present_framebuffer(float aspect_ratio)
+{
+    NV2AState *d = g_nv2a;
+    PGRAPHState *pg = &d->pgraph;
+    bool presented = false;
+
+    qemu_mutex_lock(&pg->renderer_lock);
+    if (pg->renderer->ops.present_framebuffer) {
+        presented = pg->renderer->ops.present_framebuffer(d, aspect_ratio);
+    }
+    qemu_mutex_unlock(&pg->renderer_lock);
+
+    return presented;
+}
+
 void nv2a_set_surface_scale_factor(unsigned int scale)
 {
     NV2AState *d = g_nv2a;
@@ -660,6 +757,12 @@ static void pgraph_method_log(unsigned int subchannel,
     last = method;
 }
 
+static bool pgraph_method_log_enabled(void)
+{
+    return trace_event_get_state_backends(TRACE_NV2A_PGRAPH_METHOD) ||
+           trace_event_get_state_backends(TRACE_NV2A_PGRAPH_METHOD_ABBREV);
+}
+
 static void pgraph_method_inc(MethodFunc handler, uint32_t end,
                               METHOD_HANDLER_ARG_DECL)
 {
@@ -667,10 +770,11 @@ static void pgraph_method_inc(MethodFunc handler, uint32_t end,
         handler(METHOD_HANDLER_ARGS);
         return;
     }
+    bool log = pgraph_method_log_enabled();
     size_t count = MIN(num_words_available, (end - method) / 4);
     for (size_t i = 0; i < count; i++) {
         parameter = ldl_le_p(parameters + i);
-        if (i) {
+        if (i && log) {
             pgraph_method_log(subchannel, NV_KELVIN_PRIMITIVE, method,
                               parameter);
         }
@@ -687,9 +791,10 @@ static void pgraph_method_non_inc(MethodFunc handler, METHOD_HANDLER_ARG_DECL)
         return;
     }
 
+    bool log = pgraph_method_log_enabled();
     for (size_t i = 0; i < num_words_available; i++) {
         parameter = ldl_le_p(parameters + i);
-        if (i) {
+        if (i && log) {
             pgraph_method_log(subchannel, NV_KELVIN_PRIMITIVE, method,
                               parameter);
         }
@@ -951,6 +1056,7 @@ DEF_METHOD(NV097, NO_OPERATION)
                  NV_PGRAPH_NSOURCE_NOTIFICATION); /* TODO: check this */
     pg->pending_interrupts |= NV_PGRAPH_INTR_ERROR;
     pg->waiting_for_nop = true;
+    pgraph_update_shadow_regs(pg);
 
     qemu_mutex_unlock(&pg->lock);
     bql_lock();
@@ -2105,6 +2211,7 @@ DEF_METHOD_INC(NV097, SET_TRANSFORM_PROGRAM)
     assert(program_load < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
     pg->program_data[program_load][slot%4] = parameter;
     pg->program_data_dirty = true;
+    pg->program_data_generation++;
 
     if (slot % 4 == 3) {
         PG_SET_MASK(NV_PGRAPH_CHEOPS_OFFSET,
@@ -2779,36 +2886,56 @@ static void pgraph_expand_draw_arrays(NV2AState *d)
     pgraph_reset_draw_arrays(pg);
 }
 
-void pgraph_check_within_begin_end_block(PGRAPHState *pg)
+/*
+ * Vertex data methods usually arrive as long non-incrementing runs, so the
+ * handlers below consume the whole available span at once instead of going
+ * through pgraph_method_non_inc one word at a time.
+ */
+static size_t pgraph_bulk_method_count(METHOD_HANDLER_ARG_DECL)
 {
-    if (pg->primitive_mode == PRIM_TYPE_INVALID) {
-        NV2A_DPRINTF("Vertex data being sent outside of begin/end block!\n");
+    size_t count = inc ? 1 : num_words_available;
+
+    if (count > 1 && pgraph_method_log_enabled()) {
+        for (size_t i = 1; i < count; i++) {
+            pgraph_method_log(subchannel, NV_KELVIN_PRIMITIVE, method,
+                              ldl_le_p(parameters + i));
+        }
     }
+
+    *num_words_consumed = count;
+    return count;
 }
 
-DEF_METHOD_NON_INC(NV097, ARRAY_ELEMENT16)
+DEF_METHOD(NV097, ARRAY_ELEMENT16)
 {
+    size_t count = pgraph_bulk_method_count(METHOD_HANDLER_ARGS);
+
     pgraph_check_within_begin_end_block(pg);
 
     if (pg->draw_arrays_length) {
         pgraph_expand_draw_arrays(d);
     }
 
-    assert(pg->inline_elements_length < NV2A_MAX_BATCH_LENGTH);
-    pg->inline_elements[pg->inline_elements_length++] = parameter & 0xFFFF;
-    pg->inline_elements[pg->inline_elements_length++] = parameter >> 16;
+    assert(pg->inline_elements_length + count * 2 <= NV2A_MAX_BATCH_LENGTH);
+    pgraph_unpack_index16_pairs(
+        &pg->inline_elements[pg->inline_elements_length], parameters, count);
+    pg->inline_elements_length += count * 2;
 }
 
-DEF_METHOD_NON_INC(NV097, ARRAY_ELEMENT32)
+DEF_METHOD(NV097, ARRAY_ELEMENT32)
 {
+    size_t count = pgraph_bulk_method_count(METHOD_HANDLER_ARGS);
+
     pgraph_check_within_begin_end_block(pg);
 
     if (pg->draw_arrays_length) {
         pgraph_expand_draw_arrays(d);
     }
 
-    assert(pg->inline_elements_length < NV2A_MAX_BATCH_LENGTH);
-    pg->inline_elements[pg->inline_elements_length++] = parameter;
+    assert(pg->inline_elements_length + count <= NV2A_MAX_BATCH_LENGTH);
+    pgraph_copy_words_le(&pg->inline_elements[pg->inline_elements_length],
+                         parameters, count);
+    pg->inline_elements_length += count;
 }
 
 DEF_METHOD(NV097, DRAW_ARRAYS)
@@ -2856,11 +2983,15 @@ DEF_METHOD(NV097, DRAW_ARRAYS)
     pg->draw_arrays_prevent_connect = false;
 }
 
-DEF_METHOD_NON_INC(NV097, INLINE_ARRAY)
+DEF_METHOD(NV097, INLINE_ARRAY)
 {
+    size_t count = pgraph_bulk_method_count(METHOD_HANDLER_ARGS);
+
     pgraph_check_within_begin_end_block(pg);
-    assert(pg->inline_array_length < NV2A_MAX_BATCH_LENGTH);
-    pg->inline_array[pg->inline_array_length++] = parameter;
+    assert(pg->inline_array_length + count <= NV2A_MAX_BATCH_LENGTH);
+    pgraph_copy_words_le(&pg->inline_array[pg->inline_array_length],
+                         parameters, count);
+    pg->inline_array_length += count;
 }
 
 DEF_METHOD_INC(NV097, SET_EYE_VECTOR)
@@ -2898,31 +3029,78 @@ DEF_METHOD_INC(NV097, SET_VERTEX_DATA4F_M)
     }
 }
 
+/*
+ * A non-incrementing run of a SET_VERTEX_DATA* word that completes a vertex
+ * appends one vertex per word. After the first word has taken the per-word
+ * path, the rest of the run is converted straight into the inline buffer.
+ */
+static void pgraph_vertex_data_run(PGRAPHState *pg, const uint32_t *parameters,
+                                   size_t count, unsigned int component,
+                                   void (*unpack)(float *, const uint32_t *,
+                                                  size_t))
+{
+    VertexAttribute *attribute = &pg->vertex_attributes[0];
+    float *vertices = pgraph_append_inline_buffer_vertices(pg, 0, count);
+
+    unpack(&vertices[component], parameters, count);
+    memcpy(attribute->inline_value, &vertices[(count - 1) * 4],
+           sizeof(attribute->inline_value));
+}
+
+/*
+ * Length of the span a SET_VERTEX_DATA* handler consumes. Runs that do not
+ * complete vertices only need their last word.
+ */
+static size_t pgraph_vertex_data_count(bool completes_vertex,
+                                       METHOD_HANDLER_ARG_DECL)
+{
+    if (inc) {
+        return 1;
+    }
+
+    size_t count = pgraph_bulk_method_count(METHOD_HANDLER_ARGS);
+    return completes_vertex ? count : 1;
+}
+
 DEF_METHOD_INC(NV097, SET_VERTEX_DATA2S)
 {
     int slot = (method - NV097_SET_VERTEX_DATA2S) / 4;
+    size_t count = pgraph_vertex_data_count(slot == 0, METHOD_HANDLER_ARGS);
+    if (!inc && slot != 0) {
+        parameter = ldl_le_p(parameters + *num_words_consumed - 1);
+    }
+
     VertexAttribute *attribute = &pg->vertex_attributes[slot];
     pgraph_allocate_inline_buffer_vertices(pg, slot);
-    attribute->inline_value[0] = (float)(int16_t)(parameter & 0xFFFF);
-    attribute->inline_value[1] = (float)(int16_t)(parameter >> 16);
+    pgraph_unpack_2s(&attribute->inline_value[0], parameter);
     attribute->inline_value[2] = 0.0;
     attribute->inline_value[3] = 1.0;
     if (slot == 0) {
         pgraph_finish_inline_buffer_vertex(pg);
+        if (count > 1) {
+            pgraph_vertex_data_run(pg, parameters + 1, count - 1, 0,
+                                   pgraph_unpack_2s_run);
+        }
     }
 }
 
 DEF_METHOD_INC(NV097, SET_VERTEX_DATA4UB)
 {
     int slot = (method - NV097_SET_VERTEX_DATA4UB) / 4;
+    size_t count = pgraph_vertex_data_count(slot == 0, METHOD_HANDLER_ARGS);
+    if (!inc && slot != 0) {
+        parameter = ldl_le_p(parameters + *num_words_consumed - 1);
+    }
+
     VertexAttribute *attribute = &pg->vertex_attributes[slot];
     pgraph_allocate_inline_buffer_vertices(pg, slot);
-    attribute->inline_value[0] = (parameter & 0xFF) / 255.0;
-    attribute->inline_value[1] = ((parameter >> 8) & 0xFF) / 255.0;
-    attribute->inline_value[2] = ((parameter >> 16) & 0xFF) / 255.0;
-    attribute->inline_value[3] = ((parameter >> 24) & 0xFF) / 255.0;
+    pgraph_unpack_4ub_unorm(attribute->inline_value, parameter);
     if (slot == 0) {
         pgraph_finish_inline_buffer_vertex(pg);
+        if (count > 1) {
+            pgraph_vertex_data_run(pg, parameters + 1, count - 1, 0,
+                                   pgraph_unpack_4ub_unorm_run);
+        }
     }
 }
 
@@ -2931,13 +3109,23 @@ DEF_METHOD_INC(NV097, SET_VERTEX_DATA4S_M)
     int slot = (method - NV097_SET_VERTEX_DATA4S_M) / 4;
     unsigned int part = slot % 2;
     slot /= 2;
+    bool completes_vertex = (slot == 0) && (part == 1);
+    size_t count =
+        pgraph_vertex_data_count(completes_vertex, METHOD_HANDLER_ARGS);
+    if (!inc && !completes_vertex) {
+        parameter = ldl_le_p(parameters + *num_words_consumed - 1);
+    }
+
     VertexAttribute *attribute = &pg->vertex_attributes[slot];
     pgraph_allocate_inline_buffer_vertices(pg, slot);
 
-    attribute->inline_value[part * 2 + 0] = (float)(int16_t)(parameter & 0xFFFF);
-    attribute->inline_value[part * 2 + 1] = (float)(int16_t)(parameter >> 16);
-    if ((slot == 0) && (part == 1)) {
+    pgraph_unpack_2s(&attribute->inline_value[part * 2], parameter);
+    if (completes_vertex) {
         pgraph_finish_inline_buffer_vertex(pg);
+        if (count > 1) {
+            pgraph_vertex_data_run(pg, parameters + 1, count - 1, part * 2,
+                                   pgraph_unpack_2s_run);
+        }
     }
 }
 
@@ -3089,21 +3277,12 @@ DEF_METHOD(NV097, LAUNCH_TRANSFORM_PROGRAM)
 {
     unsigned int program_start = parameter;
     assert(program_start < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
-    Nv2aVshProgram program;
-    Nv2aVshParseResult result = nv2a_vsh_parse_program(
-            &program,
-            pg->program_data[program_start],
-            NV2A_MAX_TRANSFORM_PROGRAM_LENGTH - program_start);
-    assert(result == NV2AVPR_SUCCESS);
-
-    Nv2aVshCPUXVSSExecutionState state_linkage;
-    Nv2aVshExecutionState state = nv2a_vsh_emu_initialize_xss_execution_state(
-            &state_linkage, (float*)pg->vsh_constants);
-    memcpy(state_linkage.input_regs, pg->vertex_state_shader_v0, sizeof(pg->vertex_state_shader_v0));
-
-    nv2a_vsh_emu_execute_track_context_writes(&state, &program, pg->vsh_constants_dirty);
 
-    nv2a_vsh_program_destroy(&program);
+    const VshCpuProgram *program = vsh_cpu_get_program(
+        &pg->vsh_cpu_cache, &pg->program_data[0][0], program_start,
+        NV2A_MAX_TRANSFORM_PROGRAM_LENGTH, pg->program_data_generation);
+    vsh_cpu_execute_xvss(program, pg->vertex_state_shader_v0,
+                         pg->vsh_constants, pg->vsh_constants_dirty);
 }
 
 DEF_METHOD(NV097, SET_TRANSFORM_EXECUTION_MODE)
@@ -3304,7 +3483,7 @@ void pgraph_process_pending(NV2AState *d)
 
             qemu_mutex_unlock(&d->pfifo.lock);
             qemu_mutex_lock(&d->pgraph.lock);
-            while (pg->framebuffer_in_use) {
+            while (pg->framebuffer_refs) {
                 qemu_cond_wait(&d->pgraph.framebuffer_released,
                                &d->pgraph.renderer_lock);
             }
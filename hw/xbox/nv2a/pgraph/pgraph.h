@@ -33,6 +33,7 @@
 #include "texture.h"
 #include "util.h"
 #include "vsh_regs.h"
+#include "vsh_cpu.h"
 
 typedef struct NV2AState NV2AState;
 typedef struct PGRAPHNullState PGRAPHNullState;
@@ -122,6 +123,9 @@ typedef struct PGRAPHRenderer {
         void (*set_surface_scale_factor)(NV2AState *d, unsigned int scale);
         unsigned int (*get_surface_scale_factor)(NV2AState *d);
         int (*get_framebuffer_surface)(NV2AState *d);
+        void (*release_framebuffer_surface)(NV2AState *d);
+        bool (*set_present_window)(NV2AState *d, void *window);
+        bool (*present_framebuffer)(NV2AState *d, float aspect_ratio);
     } ops;
 } PGRAPHRenderer;
 
@@ -132,6 +136,13 @@ typedef struct PGRAPHState {
     uint32_t pending_interrupts;
     uint32_t enabled_interrupts;
 
+    /* Polled registers, published for lock-free MMIO reads */
+    struct {
+        uint32_t pending_interrupts;
+        uint32_t enabled_interrupts;
+        uint32_t status;
+    } shadow;
+
     int frame_time;
     int draw_time;
 
@@ -178,6 +189,8 @@ typedef struct PGRAPHState {
     uint32_t vertex_state_shader_v0[4];
     uint32_t program_data[NV2A_MAX_TRANSFORM_PROGRAM_LENGTH][VSH_TOKEN_SIZE];
     bool program_data_dirty;
+    uint32_t program_data_generation; /* Bumped whenever program_data changes */
+    VshCpuProgramCache vsh_cpu_cache;
 
     uint32_t vsh_constants[NV2A_VERTEXSHADER_CONSTANTS][4];
     bool vsh_constants_dirty[NV2A_VERTEXSHADER_CONSTANTS];
@@ -241,7 +254,9 @@ typedef struct PGRAPHState {
     bool sync_pending;
     QemuEvent sync_complete;
 
-    bool framebuffer_in_use;
+    /* Display surface published to the UI, held while refs is non-zero */
+    int framebuffer_surface;
+    unsigned int framebuffer_refs;
     QemuCond framebuffer_released;
 
     enum {
@@ -266,6 +281,7 @@ void pgraph_init(NV2AState *d);
 void pgraph_init_thread(NV2AState *d);
 void pgraph_destroy(PGRAPHState *pg);
 void pgraph_context_switch(NV2AState *d, unsigned int channel_id);
+void pgraph_update_shadow_regs(PGRAPHState *pg);
 void pgraph_process_pending(NV2AState *d);
 void pgraph_process_pending_reports(NV2AState *d);
 void pgraph_pre_savevm_trigger(NV2AState *d);
@@ -279,8 +295,14 @@ int pgraph_method(NV2AState *d, unsigned int subchannel, unsigned int method,
                   bool inc);
 void pgraph_check_within_begin_end_block(PGRAPHState *pg);
 
+void pfifo_init(NV2AState *d);
+void pfifo_destroy(NV2AState *d);
 void *pfifo_thread(void *arg);
 void pfifo_kick(NV2AState *d);
+void pfifo_invalidate_method_queue(NV2AState *d);
+void pfifo_update_shadow_regs(NV2AState *d);
+bool pfifo_read_user_shadow_reg(NV2AState *d, unsigned int channel_id,
+                                hwaddr addr, uint64_t *val);
 
 void pgraph_renderer_register(const PGRAPHRenderer *renderer);
 
@@ -383,6 +405,8 @@ void pgraph_get_clear_depth_stencil_value(PGRAPHState *pg, float *depth, int *st
 /* Vertex */
 void pgraph_allocate_inline_buffer_vertices(PGRAPHState *pg, unsigned int attr);
 void pgraph_finish_inline_buffer_vertex(PGRAPHState *pg);
+float *pgraph_append_inline_buffer_vertices(PGRAPHState *pg, unsigned int attr,
+                                           size_t count);
 void pgraph_reset_inline_buffers(PGRAPHState *pg);
 void pgraph_reset_draw_arrays(PGRAPHState *pg);
 void pgraph_update_inline_value(VertexAttribute *attr, const uint8_t *data);
@@ -27,6 +27,13 @@ void nv2a_profile_increment(void)
     const int64_t fps_update_interval = 250000;
     g_nv2a_stats.last_flip_time = now;
 
+    if (g_nv2a_stats.last_increment_time) {
+        int64_t bucket = (now - g_nv2a_stats.last_increment_time) / 1000;
+        bucket = MIN(bucket, NV2A_PROF_FRAME_TIME_BUCKETS - 1);
+        g_nv2a_stats.frame_time_histogram[bucket]++;
+    }
+    g_nv2a_stats.last_increment_time = now;
+
     static int64_t frame_count = 0;
     frame_count++;
 
@@ -53,6 +60,12 @@ void nv2a_profile_flip_stall(void)
     memset(&g_nv2a_stats.frame_working, 0, sizeof(g_nv2a_stats.frame_working));
 }
 
+void nv2a_profile_reset_frame_time_histogram(void)
+{
+    memset(g_nv2a_stats.frame_time_histogram, 0,
+           sizeof(g_nv2a_stats.frame_time_histogram));
+}
+
 const char *nv2a_profile_get_counter_name(unsigned int cnt)
 {
     const char *default_names[NV2A_PROF__COUNT] = {
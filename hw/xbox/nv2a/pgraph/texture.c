@@ -325,6 +325,20 @@ TextureShape pgraph_get_texture_shape(PGRAPHState *pg, int texture_idx)
     return shape;
 }
 
+/* Whether pgraph_convert_texture_data() converts textures of this format */
+bool pgraph_texture_needs_conversion(unsigned int color_format)
+{
+    switch (color_format) {
+    case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8:
+    case NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_CR8YB8CB8YA8:
+    case NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_YB8CR8YA8CB8:
+    case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R6G5B5:
+        return true;
+    default:
+        return false;
+    }
+}
+
 uint8_t *pgraph_convert_texture_data(const TextureShape s, const uint8_t *data,
                                      const uint8_t *palette_data,
                                      unsigned int width, unsigned int height,
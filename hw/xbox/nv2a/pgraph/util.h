@@ -83,4 +83,45 @@ void convert_uyvy_to_rgb(const uint8_t *line, unsigned int ix,
     *b = cliptobyte((298 * c + 516 * d + 128) >> 8);
 }
 
+/*
+ * GLSL for sampling a PVIDEO overlay uploaded as raw CR8YB8CB8YA8 (YUY2)
+ * bytes in a two channel texture: R is Y, G is Cb on even and Cr on odd
+ * columns. Does the same conversion as convert_yuy2_to_rgb per texel, then
+ * filters bilinearly. pvideo_sample takes a position in texels.
+ */
+#define PVIDEO_YUY2_GLSL \
+    "vec3 pvideo_texel(sampler2D tex, ivec2 p)\n" \
+    "{\n" \
+    "    ivec2 size = textureSize(tex, 0);\n" \
+    "    p = clamp(p, ivec2(0), size - 1);\n" \
+    "    int x0 = p.x - (p.x & 1);\n" \
+    "    float y = texelFetch(tex, p, 0).r;\n" \
+    "    float cb = texelFetch(tex, ivec2(x0, p.y), 0).g;\n" \
+    "    float cr = texelFetch(tex, ivec2(min(x0 + 1, size.x - 1), p.y), 0).g;\n" \
+    "    vec3 c = floor(vec3(y, cb, cr) * 255.0 + 0.5) - vec3(16.0, 128.0, 128.0);\n" \
+    "    vec3 rgb = vec3(298.0 * c.x + 409.0 * c.z,\n" \
+    "                    298.0 * c.x - 100.0 * c.y - 208.0 * c.z,\n" \
+    "                    298.0 * c.x + 516.0 * c.y);\n" \
+    "    return clamp(floor((rgb + 128.0) / 256.0) / 255.0, 0.0, 1.0);\n" \
+    "}\n" \
+    "vec4 pvideo_sample(sampler2D tex, vec2 pos)\n" \
+    "{\n" \
+    "    pos -= 0.5;\n" \
+    "    ivec2 p = ivec2(floor(pos));\n" \
+    "    vec2 f = pos - vec2(p);\n" \
+    "    vec3 top = mix(pvideo_texel(tex, p),\n" \
+    "                   pvideo_texel(tex, p + ivec2(1, 0)), f.x);\n" \
+    "    vec3 bottom = mix(pvideo_texel(tex, p + ivec2(0, 1)),\n" \
+    "                      pvideo_texel(tex, p + ivec2(1, 1)), f.x);\n" \
+    "    return vec4(mix(top, bottom, f.y), 1.0);\n" \
+    "}\n"
+
+/* Texture width for a PVIDEO overlay, padded so the last Cr is included */
+static inline
+int pvideo_yuy2_texture_width(int in_width, int pitch)
+{
+    int width = (in_width + 1) & ~1;
+    return width * 2 <= pitch ? width : in_width;
+}
+
 #endif
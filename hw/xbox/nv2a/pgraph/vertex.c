@@ -82,6 +82,13 @@ void pgraph_update_inline_value(VertexAttribute *attr, const uint8_t *data)
     }
 }
 
+void pgraph_check_within_begin_end_block(PGRAPHState *pg)
+{
+    if (pg->primitive_mode == PRIM_TYPE_INVALID) {
+        NV2A_DPRINTF("Vertex data being sent outside of begin/end block!\n");
+    }
+}
+
 void pgraph_get_inline_values(PGRAPHState *pg, uint16_t attrs,
                                float values[NV2A_VERTEXSHADER_ATTRIBUTES][4],
                                int *count)
@@ -134,6 +141,37 @@ void pgraph_finish_inline_buffer_vertex(PGRAPHState *pg)
     pg->inline_buffer_length++;
 }
 
+/*
+ * Equivalent to count calls of pgraph_finish_inline_buffer_vertex. Returns
+ * the new vertices of attr, which repeat its current value, for a bulk
+ * handler to overwrite.
+ */
+float *pgraph_append_inline_buffer_vertices(PGRAPHState *pg, unsigned int attr,
+                                           size_t count)
+{
+    pgraph_check_within_begin_end_block(pg);
+    assert(pg->inline_buffer_length + count <= NV2A_MAX_BATCH_LENGTH);
+
+    pgraph_allocate_inline_buffer_vertices(pg, attr);
+    assert(pg->vertex_attributes[attr].inline_buffer_populated);
+
+    for (int i = 0; i < NV2A_VERTEXSHADER_ATTRIBUTES; i++) {
+        VertexAttribute *attribute = &pg->vertex_attributes[i];
+        if (!attribute->inline_buffer_populated) {
+            continue;
+        }
+        float *dst = &attribute->inline_buffer[pg->inline_buffer_length * 4];
+        for (size_t j = 0; j < count; j++) {
+            memcpy(&dst[j * 4], attribute->inline_value, sizeof(float) * 4);
+        }
+    }
+
+    float *vertices = &pg->vertex_attributes[attr]
+                           .inline_buffer[pg->inline_buffer_length * 4];
+    pg->inline_buffer_length += count;
+    return vertices;
+}
+
 void pgraph_reset_inline_buffers(PGRAPHState *pg)
 {
     pg->inline_elements_length = 0;
@@ -0,0 +1,95 @@
+/*
+ * QEMU Geforce NV2A implementation
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_XBOX_NV2A_PGRAPH_VERTEX_DATA_H
+#define HW_XBOX_NV2A_PGRAPH_VERTEX_DATA_H
+
+#include <stdint.h>
+#include <string.h>
+#include "qemu/bswap.h"
+
+/*
+ * Bulk conversion kernels for vertex data pushed through the pushbuffer.
+ * These are written as simple fixed-trip-count loops so the compiler can
+ * vectorize them, and must produce bit-identical results to the per-word
+ * method handlers.
+ */
+
+/* NV097_INLINE_ARRAY, NV097_ARRAY_ELEMENT32 */
+static inline void pgraph_copy_words_le(uint32_t *dst, const uint32_t *src,
+                                        size_t count)
+{
+#if HOST_BIG_ENDIAN
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = ldl_le_p(&src[i]);
+    }
+#else
+    memcpy(dst, src, count * sizeof(uint32_t));
+#endif
+}
+
+/* NV097_ARRAY_ELEMENT16: two 16-bit indices per word, low half first */
+static inline void pgraph_unpack_index16_pairs(uint32_t *dst,
+                                               const uint32_t *src,
+                                               size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        uint32_t v = ldl_le_p(&src[i]);
+        dst[i * 2 + 0] = v & 0xFFFF;
+        dst[i * 2 + 1] = v >> 16;
+    }
+}
+
+/* NV097_SET_VERTEX_DATA4UB: four normalized unsigned bytes */
+static inline void pgraph_unpack_4ub_unorm(float out[4], uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = (float)((v >> (i * 8)) & 0xFF) / 255.0f;
+    }
+}
+
+/* NV097_SET_VERTEX_DATA2S, NV097_SET_VERTEX_DATA4S_M: two signed shorts */
+static inline void pgraph_unpack_2s(float out[2], uint32_t v)
+{
+    out[0] = (float)(int16_t)(v & 0xFFFF);
+    out[1] = (float)(int16_t)(v >> 16);
+}
+
+/* Runs of NV097_SET_VERTEX_DATA4UB: one attribute vector per word */
+static inline void pgraph_unpack_4ub_unorm_run(float *out, const uint32_t *src,
+                                               size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        pgraph_unpack_4ub_unorm(&out[i * 4], ldl_le_p(&src[i]));
+    }
+}
+
+/*
+ * Runs of NV097_SET_VERTEX_DATA2S, NV097_SET_VERTEX_DATA4S_M: two components
+ * of one attribute vector per word, the others are left untouched
+ */
+static inline void pgraph_unpack_2s_run(float *out, const uint32_t *src,
+                                        size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        pgraph_unpack_2s(&out[i * 4], ldl_le_p(&src[i]));
+    }
+}
+
+#endif
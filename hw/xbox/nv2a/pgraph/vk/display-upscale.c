@@ -0,0 +1,560 @@
+/*
+ * Geforce NV2A PGRAPH Vulkan Renderer
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "renderer.h"
+
+/*
+ * Spatial upscaler for the display image.
+ *
+ * When enabled, the display shader renders the frame at internal resolution
+ * into an intermediate source image, and a compute pass writes the (larger)
+ * display image from it. Everything downstream of the display image is
+ * unaware of the extra pass.
+ *
+ * The edge adaptive mode weights a 4x4 texel neighborhood with a windowed
+ * Lanczos-2 kernel. The kernel is squeezed along the local luma gradient so
+ * edges are interpolated along their direction rather than across it, and
+ * the result is clamped to the nearest 2x2 texels to avoid ringing. The
+ * sharpen mode interpolates bilinearly. Both then apply contrast-adaptive
+ * sharpening, which sharpens less where local contrast is already high.
+ */
+
+#define UPSCALE_WORKGROUP_SIZE 8
+
+typedef struct UpscalePushConstants {
+    int32_t src_size[2];
+    int32_t dst_size[2];
+    float sharpness;
+    int32_t edge_adaptive;
+} UpscalePushConstants;
+
+static const char *upscale_comp_glsl =
+    "#version 450\n"
+    "layout(local_size_x = 8, local_size_y = 8) in;\n"
+    "layout(binding = 0) uniform sampler2D src_tex;\n"
+    "layout(binding = 1, rgba8) uniform writeonly image2D dst_img;\n"
+    "layout(push_constant, std430) uniform PushConstants {\n"
+    "    ivec2 src_size;\n"
+    "    ivec2 dst_size;\n"
+    "    float sharpness;\n"
+    "    int edge_adaptive;\n"
+    "};\n"
+    "float luma(vec3 c) { return dot(c, vec3(0.299, 0.587, 0.114)); }\n"
+    // Approximation of Lanczos-2 without sin(), lob in [1/4, 1/2] sets how
+    // sharp the window is
+    "float lanczos2(float d2, float lob)\n"
+    "{\n"
+    "    d2 = min(d2, 4.0);\n"
+    "    float b = 2.0 / 5.0 * d2 - 1.0;\n"
+    "    float a = lob * d2 - 1.0;\n"
+    "    return (25.0 / 16.0 * b * b - 9.0 / 16.0) * a * a;\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "    ivec2 dst = ivec2(gl_GlobalInvocationID.xy);\n"
+    "    if (any(greaterThanEqual(dst, dst_size))) {\n"
+    "        return;\n"
+    "    }\n"
+    "    vec2 pos = (vec2(dst) + 0.5) * vec2(src_size) / vec2(dst_size) - 0.5;\n"
+    "    ivec2 base = ivec2(floor(pos));\n"
+    "    vec2 f = pos - vec2(base);\n"
+    "\n"
+    // 4x4 neighborhood, [1][1] is the top-left texel of the quad around pos
+    "    vec3 c[4][4];\n"
+    "    float l[4][4];\n"
+    "    for (int y = 0; y < 4; y++) {\n"
+    "        for (int x = 0; x < 4; x++) {\n"
+    "            ivec2 p = clamp(base + ivec2(x - 1, y - 1), ivec2(0), src_size - 1);\n"
+    "            c[y][x] = texelFetch(src_tex, p, 0).rgb;\n"
+    "            l[y][x] = luma(c[y][x]);\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    vec4 quad_w = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y),\n"
+    "                       (1.0 - f.x) * f.y, f.x * f.y);\n"
+    "    vec3 quad_min = min(min(c[1][1], c[1][2]), min(c[2][1], c[2][2]));\n"
+    "    vec3 quad_max = max(max(c[1][1], c[1][2]), max(c[2][1], c[2][2]));\n"
+    "    vec3 color = c[1][1] * quad_w.x + c[1][2] * quad_w.y +\n"
+    "                 c[2][1] * quad_w.z + c[2][2] * quad_w.w;\n"
+    "\n"
+    "    if (edge_adaptive != 0) {\n"
+    "        vec2 dir = vec2(0.0);\n"
+    "        float lmin = 1.0, lmax = 0.0;\n"
+    "        for (int i = 0; i < 4; i++) {\n"
+    "            int qx = 1 + (i & 1), qy = 1 + (i >> 1);\n"
+    "            dir += quad_w[i] * vec2(l[qy][qx + 1] - l[qy][qx - 1],\n"
+    "                                    l[qy + 1][qx] - l[qy - 1][qx]);\n"
+    "            lmin = min(lmin, min(min(l[qy][qx - 1], l[qy][qx + 1]),\n"
+    "                                 min(l[qy - 1][qx], l[qy + 1][qx])));\n"
+    "            lmax = max(lmax, max(max(l[qy][qx - 1], l[qy][qx + 1]),\n"
+    "                                 max(l[qy - 1][qx], l[qy + 1][qx])));\n"
+    "        }\n"
+    "        float dir_len = length(dir);\n"
+    // How much of the local contrast is explained by a single edge
+    "        float edge = clamp(0.5 * dir_len / (lmax - lmin + 1.0 / 255.0), 0.0, 1.0);\n"
+    "        vec2 across = dir_len > 1.0 / 4096.0 ? dir / dir_len : vec2(1.0, 0.0);\n"
+    "        vec2 along = vec2(-across.y, across.x);\n"
+    "        float lob = mix(0.5, 0.21, edge);\n"
+    "        float along_scale = 1.0 - 0.5 * edge;\n"
+    "\n"
+    "        vec3 sum = vec3(0.0);\n"
+    "        float wsum = 0.0;\n"
+    "        for (int y = 0; y < 4; y++) {\n"
+    "            for (int x = 0; x < 4; x++) {\n"
+    "                vec2 o = vec2(x - 1, y - 1) - f;\n"
+    "                vec2 r = vec2(dot(o, across), dot(o, along) * along_scale);\n"
+    "                float w = lanczos2(dot(r, r), lob);\n"
+    "                sum += c[y][x] * w;\n"
+    "                wsum += w;\n"
+    "            }\n"
+    "        }\n"
+    "        if (wsum > 0.0) {\n"
+    "            color = clamp(sum / wsum, quad_min, quad_max);\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    if (sharpness > 0.0) {\n"
+    // Contrast-adaptive sharpening around the nearest source texel
+    "        int nx = f.x < 0.5 ? 1 : 2, ny = f.y < 0.5 ? 1 : 2;\n"
+    "        vec3 n = c[ny - 1][nx], s = c[ny + 1][nx];\n"
+    "        vec3 w = c[ny][nx - 1], e = c[ny][nx + 1];\n"
+    "        vec3 mn = min(min(min(n, s), min(w, e)), c[ny][nx]);\n"
+    "        vec3 mx = max(max(max(n, s), max(w, e)), c[ny][nx]);\n"
+    "        vec3 amp = sqrt(clamp(min(mn, 1.0 - mx) / max(mx, 1.0 / 255.0), 0.0, 1.0));\n"
+    "        vec3 wt = -amp / mix(8.0, 5.0, sharpness);\n"
+    "        color = clamp((color + (n + s + w + e) * wt) / (1.0 + 4.0 * wt), 0.0, 1.0);\n"
+    "    }\n"
+    "\n"
+    "    imageStore(dst_img, dst, vec4(color, 1.0));\n"
+    "}\n";
+
+static void create_descriptor_pool(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+        },
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = ARRAY_SIZE(pool_sizes),
+        .pPoolSizes = pool_sizes,
+        .maxSets = 1,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+    };
+    VK_CHECK(vkCreateDescriptorPool(r->device, &pool_info, NULL,
+                                    &r->display.upscale.descriptor_pool));
+}
+
+static void destroy_descriptor_pool(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    vkDestroyDescriptorPool(r->device, r->display.upscale.descriptor_pool,
+                            NULL);
+    r->display.upscale.descriptor_pool = VK_NULL_HANDLE;
+}
+
+static void create_descriptor_set_layout(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+        {
+            .binding = 1,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = ARRAY_SIZE(bindings),
+        .pBindings = bindings,
+    };
+    VK_CHECK(vkCreateDescriptorSetLayout(
+        r->device, &layout_info, NULL,
+        &r->display.upscale.descriptor_set_layout));
+}
+
+static void destroy_descriptor_set_layout(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    vkDestroyDescriptorSetLayout(
+        r->device, r->display.upscale.descriptor_set_layout, NULL);
+    r->display.upscale.descriptor_set_layout = VK_NULL_HANDLE;
+}
+
+static void create_descriptor_set(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = r->display.upscale.descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &r->display.upscale.descriptor_set_layout,
+    };
+    VK_CHECK(vkAllocateDescriptorSets(r->device, &alloc_info,
+                                      &r->display.upscale.descriptor_set));
+}
+
+static void create_pipeline_layout(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .size = sizeof(UpscalePushConstants),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &r->display.upscale.descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    VK_CHECK(vkCreatePipelineLayout(r->device, &pipeline_layout_info, NULL,
+                                    &r->display.upscale.pipeline_layout));
+}
+
+static void destroy_pipeline_layout(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    vkDestroyPipelineLayout(r->device, r->display.upscale.pipeline_layout,
+                            NULL);
+    r->display.upscale.pipeline_layout = VK_NULL_HANDLE;
+}
+
+// Compiled on first use, most configurations never need it
+static void create_pipeline(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    ShaderModuleInfo *module = pgraph_vk_create_shader_module_from_glsl(
+        r, VK_SHADER_STAGE_COMPUTE_BIT, upscale_comp_glsl);
+
+    VkComputePipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .layout = r->display.upscale.pipeline_layout,
+        .stage =
+            (VkPipelineShaderStageCreateInfo){
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pName = "main",
+                .module = module->module,
+            },
+    };
+    VK_CHECK(vkCreateComputePipelines(r->device, r->vk_pipeline_cache, 1,
+                                      &pipeline_info, NULL,
+                                      &r->display.upscale.pipeline));
+
+    pgraph_vk_destroy_shader_module(r, module);
+}
+
+static void destroy_pipeline(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (r->display.upscale.pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(r->device, r->display.upscale.pipeline, NULL);
+        r->display.upscale.pipeline = VK_NULL_HANDLE;
+    }
+}
+
+static void destroy_source_image(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkDisplayState *d = &r->display;
+
+    if (d->upscale.framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(r->device, d->upscale.framebuffer, NULL);
+        d->upscale.framebuffer = VK_NULL_HANDLE;
+    }
+
+    if (d->upscale.image_view != VK_NULL_HANDLE) {
+        vkDestroyImageView(r->device, d->upscale.image_view, NULL);
+        d->upscale.image_view = VK_NULL_HANDLE;
+    }
+
+    if (d->upscale.image != VK_NULL_HANDLE) {
+        vmaDestroyImage(r->allocator, d->upscale.image,
+                        d->upscale.allocation);
+        d->upscale.image = VK_NULL_HANDLE;
+        d->upscale.allocation = VK_NULL_HANDLE;
+    }
+
+    d->upscale.width = 0;
+    d->upscale.height = 0;
+}
+
+static void create_source_image(PGRAPHState *pg, int width, int height)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkDisplayState *d = &r->display;
+
+    destroy_source_image(pg);
+
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .extent.width = width,
+        .extent.height = height,
+        .extent.depth = 1,
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                 VK_IMAGE_USAGE_SAMPLED_BIT,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VmaAllocationCreateInfo alloc_create_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+    };
+    VK_CHECK(vmaCreateImage(r->allocator, &image_create_info,
+                            &alloc_create_info, &d->upscale.image,
+                            &d->upscale.allocation, NULL));
+
+    VkImageViewCreateInfo image_view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = d->upscale.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.layerCount = 1,
+    };
+    VK_CHECK(vkCreateImageView(r->device, &image_view_create_info, NULL,
+                               &d->upscale.image_view));
+
+    VkFramebufferCreateInfo framebuffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = d->render_pass,
+        .attachmentCount = 1,
+        .pAttachments = &d->upscale.image_view,
+        .width = width,
+        .height = height,
+        .layers = 1,
+    };
+    VK_CHECK(vkCreateFramebuffer(r->device, &framebuffer_create_info, NULL,
+                                 &d->upscale.framebuffer));
+
+    d->upscale.width = width;
+    d->upscale.height = height;
+}
+
+void pgraph_vk_init_display_upscale(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(r->physical_device,
+                                        VK_FORMAT_R8G8B8A8_UNORM, &props);
+    r->display.upscale.storage_optimal =
+        props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    r->display.upscale.storage_linear =
+        props.linearTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+
+    create_descriptor_pool(pg);
+    create_descriptor_set_layout(pg);
+    create_descriptor_set(pg);
+    create_pipeline_layout(pg);
+}
+
+void pgraph_vk_finalize_display_upscale(PGRAPHState *pg)
+{
+    destroy_source_image(pg);
+    destroy_pipeline(pg);
+    destroy_pipeline_layout(pg);
+    destroy_descriptor_set_layout(pg);
+    destroy_descriptor_pool(pg);
+}
+
+/*
+ * Get the framebuffer the display shader should render a @width x @height
+ * frame into before it is upscaled. Frees the source image when @width is 0.
+ */
+VkFramebuffer pgraph_vk_display_upscale_source(PGRAPHState *pg, int width,
+                                               int height)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkDisplayState *d = &r->display;
+
+    if (!width) {
+        destroy_source_image(pg);
+        return VK_NULL_HANDLE;
+    }
+
+    if (d->upscale.image == VK_NULL_HANDLE || d->upscale.width != width ||
+        d->upscale.height != height) {
+        create_source_image(pg, width, height);
+    }
+
+    return d->upscale.framebuffer;
+}
+
+/*
+ * Record the upscale from the source image, left in color attachment layout
+ * by the display render pass, into the display image. The display image is
+ * left in shader read layout.
+ */
+void pgraph_vk_display_upscale(PGRAPHState *pg, VkCommandBuffer cmd,
+                               bool edge_adaptive, float sharpness)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkDisplayState *d = &r->display;
+
+    assert(d->upscale.image != VK_NULL_HANDLE);
+
+    if (d->upscale.pipeline == VK_NULL_HANDLE) {
+        create_pipeline(pg);
+    }
+
+    VkDescriptorImageInfo image_infos[] = {
+        {
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .imageView = d->upscale.image_view,
+            .sampler = d->sampler,
+        },
+        {
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .imageView = d->image_view,
+        },
+    };
+    VkWriteDescriptorSet descriptor_writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = d->upscale.descriptor_set,
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &image_infos[0],
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = d->upscale.descriptor_set,
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &image_infos[1],
+        },
+    };
+    vkUpdateDescriptorSets(r->device, ARRAY_SIZE(descriptor_writes),
+                           descriptor_writes, 0, NULL);
+
+    pgraph_vk_begin_debug_marker(r, cmd, RGBA_YELLOW, "Display Upscale");
+
+    VkImageMemoryBarrier pre_barriers[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = d->upscale.image,
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.layerCount = 1,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = d->image,
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(cmd,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, ARRAY_SIZE(pre_barriers), pre_barriers);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      d->upscale.pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            d->upscale.pipeline_layout, 0, 1,
+                            &d->upscale.descriptor_set, 0, NULL);
+
+    UpscalePushConstants push_constants = {
+        .src_size = { d->upscale.width, d->upscale.height },
+        .dst_size = { d->width, d->height },
+        .sharpness = sharpness,
+        .edge_adaptive = edge_adaptive,
+    };
+    vkCmdPushConstants(cmd, d->upscale.pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants),
+                       &push_constants);
+
+    vkCmdDispatch(cmd,
+                  (d->width + UPSCALE_WORKGROUP_SIZE - 1) /
+                      UPSCALE_WORKGROUP_SIZE,
+                  (d->height + UPSCALE_WORKGROUP_SIZE - 1) /
+                      UPSCALE_WORKGROUP_SIZE,
+                  1);
+
+    VkImageMemoryBarrier post_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = d->image,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.layerCount = 1,
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, NULL, 0, NULL, 1, &post_barrier);
+
+    pgraph_vk_end_debug_marker(r, cmd);
+
+    nv2a_profile_inc_counter(NV2A_PROF_DISPLAY_UPSCALE);
+}
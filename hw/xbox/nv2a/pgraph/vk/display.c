@@ -18,6 +18,7 @@
  */
 
 #include "renderer.h"
+#include "ui/xemu-settings.h"
 #include <EGL/egl.h>
 #include <math.h>
 
@@ -68,25 +69,6 @@ bool pgraph_vk_gl_external_memory_available(void)
 }
 #endif
 
-static uint8_t *convert_texture_data__CR8YB8CB8YA8(uint8_t *data_out,
-                                                   const uint8_t *data_in,
-                                                   unsigned int width,
-                                                   unsigned int height,
-                                                   unsigned int pitch)
-{
-    int x, y;
-    for (y = 0; y < height; y++) {
-        const uint8_t *line = &data_in[y * pitch];
-        const uint32_t row_offset = y * width;
-        for (x = 0; x < width; x++) {
-            uint8_t *pixel = &data_out[(row_offset + x) * 4];
-            convert_yuy2_to_rgb(line, x, &pixel[0], &pixel[1], &pixel[2]);
-            pixel[3] = 255;
-        }
-    }
-    return data_out;
-}
-
 static float pvideo_calculate_scale(unsigned int din_dout,
                                     unsigned int output_size)
 {
@@ -122,10 +104,11 @@ static void create_pvideo_image(PGRAPHState *pg, int width, int height)
     PGRAPHVkState *r = pg->vk_renderer_state;
     PGRAPHVkDisplayState *d = &r->display;
 
-    if (d->pvideo.image == VK_NULL_HANDLE || d->pvideo.width != width ||
-        d->pvideo.height != height) {
-        destroy_pvideo_image(pg);
+    if (d->pvideo.image != VK_NULL_HANDLE && d->pvideo.width == width &&
+        d->pvideo.height == height) {
+        return;
     }
+    destroy_pvideo_image(pg);
 
     VkImageCreateInfo image_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -135,7 +118,7 @@ static void create_pvideo_image(PGRAPHState *pg, int width, int height)
         .extent.depth = 1,
         .mipLevels = 1,
         .arrayLayers = 1,
-        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .format = VK_FORMAT_R8G8_UNORM,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
@@ -154,7 +137,7 @@ static void create_pvideo_image(PGRAPHState *pg, int width, int height)
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .image = d->pvideo.image,
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .format = VK_FORMAT_R8G8_UNORM,
         .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
         .subresourceRange.baseMipLevel = 0,
         .subresourceRange.levelCount = image_create_info.mipLevels,
@@ -176,6 +159,9 @@ static void create_pvideo_image(PGRAPHState *pg, int width, int height)
     };
     VK_CHECK(vkCreateSampler(r->device, &sampler_create_info, NULL,
                              &d->pvideo.sampler));
+
+    d->pvideo.width = width;
+    d->pvideo.height = height;
 }
 
 static void upload_pvideo_image(PGRAPHState *pg, PvideoState state)
@@ -184,10 +170,15 @@ static void upload_pvideo_image(PGRAPHState *pg, PvideoState state)
     PGRAPHVkState *r = pg->vk_renderer_state;
     PGRAPHVkDisplayState *disp = &r->display;
 
-    create_pvideo_image(pg, state.in_width, state.in_height);
+    // Raw YUY2 bytes, converted to RGB by the display shader
+    int width = pvideo_yuy2_texture_width(state.in_width, state.pitch);
+    create_pvideo_image(pg, width, state.in_height);
 
     // FIXME: Dirty tracking. We don't necessarily need to upload so much.
 
+    size_t size = (size_t)state.pitch * state.in_height;
+    assert(size <= r->storage_buffers[BUFFER_STAGING_SRC].buffer_size);
+
     // Copy texture data to mapped device buffer
     uint8_t *mapped_memory_ptr;
 
@@ -195,13 +186,11 @@ static void upload_pvideo_image(PGRAPHState *pg, PvideoState state)
                           r->storage_buffers[BUFFER_STAGING_SRC].allocation,
                           (void *)&mapped_memory_ptr));
 
-    convert_texture_data__CR8YB8CB8YA8(
-        mapped_memory_ptr, d->vram_ptr + state.base + state.offset,
-        state.in_width, state.in_height, state.pitch);
+    memcpy(mapped_memory_ptr, d->vram_ptr + state.base + state.offset, size);
 
     vmaFlushAllocation(r->allocator,
                        r->storage_buffers[BUFFER_STAGING_SRC].allocation, 0,
-                       VK_WHOLE_SIZE);
+                       size);
 
     vmaUnmapMemory(r->allocator,
                    r->storage_buffers[BUFFER_STAGING_SRC].allocation);
@@ -224,26 +213,26 @@ static void upload_pvideo_image(PGRAPHState *pg, PvideoState state)
                          &host_barrier, 0, NULL);
 
     pgraph_vk_transition_image_layout(
-        pg, cmd, disp->pvideo.image, VK_FORMAT_R8_UNORM,
+        pg, cmd, disp->pvideo.image, VK_FORMAT_R8G8_UNORM,
         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
     VkBufferImageCopy region = {
         .bufferOffset = 0,
-        .bufferRowLength = 0,
+        .bufferRowLength = state.pitch / 2,
         .bufferImageHeight = 0,
         .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
         .imageSubresource.mipLevel = 0,
         .imageSubresource.baseArrayLayer = 0,
         .imageSubresource.layerCount = 1,
         .imageOffset = (VkOffset3D){ 0, 0, 0 },
-        .imageExtent = (VkExtent3D){ state.in_width, state.in_height, 1 },
+        .imageExtent = (VkExtent3D){ width, state.in_height, 1 },
     };
     vkCmdCopyBufferToImage(cmd, r->storage_buffers[BUFFER_STAGING_SRC].buffer,
                            disp->pvideo.image,
                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
     pgraph_vk_transition_image_layout(pg, cmd, disp->pvideo.image,
-                                      VK_FORMAT_R8G8B8A8_UNORM,
+                                      VK_FORMAT_R8G8_UNORM,
                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     pgraph_vk_end_single_time_commands(pg, cmd);
@@ -253,6 +242,7 @@ static const char *display_frag_glsl =
     "#version 450\n"
     "layout(binding = 0) uniform sampler2D tex;\n"
     "layout(binding = 1) uniform sampler2D pvideo_tex;\n"
+    PVIDEO_YUY2_GLSL
     "layout(push_constant, std430) uniform PushConstants {\n"
     "    float line_offset;\n"
     "    vec2 display_size;\n"
@@ -278,10 +268,11 @@ static const char *display_frag_glsl =
     "                           greaterThan(screen_coord, output_region.zw));\n"
     "        if (!any(clip) && (!pvideo_color_key_enable || out_Color.rgb == pvideo_color_key)) {\n"
     "            vec2 out_xy = screen_coord - pvideo_pos.xy;\n"
-    "            vec2 in_st = (pvideo_in_pos + out_xy * pvideo_scale.xy) / textureSize(pvideo_tex, 0);\n"
-    "            out_Color.rgba = texture(pvideo_tex, in_st);\n"
+    "            vec2 in_xy = pvideo_in_pos + out_xy * pvideo_scale.xy;\n"
+    "            out_Color.rgba = pvideo_sample(pvideo_tex, in_xy);\n"
     "        }\n"
     "    }\n"
+    "    out_Color.a = 1.0;\n" // Scanout is opaque
     "}\n";
 
 static void create_descriptor_pool(PGRAPHState *pg)
@@ -667,6 +658,9 @@ static bool create_display_image(PGRAPHState *pg, int width, int height)
     d->fd = -1;
 #endif
 
+    d->storage_image = use_optimal_tiling ? d->upscale.storage_optimal :
+                                            d->upscale.storage_linear;
+
     // Create image
     VkImageCreateInfo image_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -679,10 +673,14 @@ static bool create_display_image(PGRAPHState *pg, int width, int height)
         .format = VK_FORMAT_R8G8B8A8_UNORM,
         .tiling = use_optimal_tiling ? VK_IMAGE_TILING_OPTIMAL : VK_IMAGE_TILING_LINEAR,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
     };
+    if (d->storage_image) {
+        image_create_info.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
 
     VkExternalMemoryImageCreateInfo external_memory_image_create_info = {
         .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
@@ -1033,14 +1031,15 @@ static PvideoState get_pvideo_state(PGRAPHState *pg)
     return state;
 }
 
-static void update_uniforms(PGRAPHState *pg, SurfaceBinding *surface)
+static void update_uniforms(PGRAPHState *pg, SurfaceBinding *surface,
+                            int width, int height)
 {
     NV2AState *d = container_of(pg, NV2AState, pgraph);
     PGRAPHVkState *r = pg->vk_renderer_state;
     ShaderUniformLayout *l = &r->display.display_frag->push_constants;
 
     int display_size_loc = uniform_index(l, "display_size");  // FIXME: Cache
-    uniform2f(l, display_size_loc, r->display.width, r->display.height);
+    uniform2f(l, display_size_loc, width, height);
 
     VGADisplayParams vga_display_params;
     d->vga.get_params(&d->vga, &vga_display_params);
@@ -1069,7 +1068,14 @@ static void update_uniforms(PGRAPHState *pg, SurfaceBinding *surface)
     }
 }
 
-static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
+/*
+ * Render @surface into the display image. With an @upscaler the frame is
+ * rendered at internal resolution into the upscaler's source image instead,
+ * and upscaled into the display image.
+ */
+static void render_display(PGRAPHState *pg, SurfaceBinding *surface,
+                           CONFIG_DISPLAY_QUALITY_UPSCALER upscaler,
+                           int width, int height, float sharpness)
 {
     NV2AState *d = container_of(pg, NV2AState, pgraph);
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -1078,6 +1084,14 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
         return;
     }
 
+    bool upscale = upscaler != CONFIG_DISPLAY_QUALITY_UPSCALER_OFF;
+    VkFramebuffer framebuffer = disp->framebuffer;
+    if (upscale) {
+        framebuffer = pgraph_vk_display_upscale_source(pg, width, height);
+    } else {
+        pgraph_vk_display_upscale_source(pg, 0, 0);
+    }
+
     if (r->in_command_buffer &&
         surface->draw_time >= r->command_buffer_start_time) {
         pgraph_vk_finish(pg, VK_FINISH_REASON_PRESENTING);
@@ -1090,7 +1104,7 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
         upload_pvideo_image(pg, disp->pvideo.state);
     }
 
-    update_uniforms(pg, surface);
+    update_uniforms(pg, surface, width, height);
     update_descriptor_set(pg, surface);
 
     VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
@@ -1102,15 +1116,16 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     pgraph_vk_transition_image_layout(
-        pg, cmd, disp->image, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        pg, cmd, upscale ? disp->upscale.image : disp->image,
+        VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
     VkRenderPassBeginInfo render_pass_begin_info = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .renderPass = disp->render_pass,
-        .framebuffer = disp->framebuffer,
-        .renderArea.extent.width = disp->width,
-        .renderArea.extent.height = disp->height,
+        .framebuffer = framebuffer,
+        .renderArea.extent.width = width,
+        .renderArea.extent.height = height,
     };
     vkCmdBeginRenderPass(cmd, &render_pass_begin_info,
                          VK_SUBPASS_CONTENTS_INLINE);
@@ -1122,16 +1137,16 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
                             0, NULL);
 
     VkViewport viewport = {
-        .width = disp->width,
-        .height = disp->height,
+        .width = width,
+        .height = height,
         .minDepth = 0.0,
         .maxDepth = 1.0,
     };
     vkCmdSetViewport(cmd, 0, 1, &viewport);
 
     VkRect2D scissor = {
-        .extent.width = disp->width,
-        .extent.height = disp->height,
+        .extent.width = width,
+        .extent.height = height,
     };
     vkCmdSetScissor(cmd, 0, 1, &scissor);
 
@@ -1166,10 +1181,16 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-    pgraph_vk_transition_image_layout(pg, cmd, disp->image,
-                                      VK_FORMAT_R8G8B8_UNORM,
-                                      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (upscale) {
+        pgraph_vk_display_upscale(
+            pg, cmd, upscaler == CONFIG_DISPLAY_QUALITY_UPSCALER_EDGE_ADAPTIVE,
+            sharpness);
+    } else {
+        pgraph_vk_transition_image_layout(
+            pg, cmd, disp->image, VK_FORMAT_R8G8B8_UNORM,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
 
     pgraph_vk_end_debug_marker(r, cmd);
     pgraph_vk_end_single_time_commands(pg, cmd);
@@ -1217,6 +1238,7 @@ void pgraph_vk_init_display(PGRAPHState *pg)
     create_render_pass(pg);
     create_display_pipeline(pg);
     create_surface_sampler(pg);
+    pgraph_vk_init_display_upscale(pg);
 }
 
 void pgraph_vk_finalize_display(PGRAPHState *pg)
@@ -1224,6 +1246,7 @@ void pgraph_vk_finalize_display(PGRAPHState *pg)
     PGRAPHVkState *r = pg->vk_renderer_state;
 
     destroy_pvideo_image(pg);
+    pgraph_vk_finalize_display_upscale(pg);
 
     if (r->display.image != VK_NULL_HANDLE) {
         destroy_current_display_image(pg);
@@ -1236,7 +1259,8 @@ void pgraph_vk_finalize_display(PGRAPHState *pg)
     destroy_descriptor_pool(pg);
 }
 
-void pgraph_vk_render_display(PGRAPHState *pg)
+/* Returns true if the display image holds the current frame */
+bool pgraph_vk_render_display(PGRAPHState *pg)
 {
     NV2AState *d = container_of(pg, NV2AState, pgraph);
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -1248,7 +1272,7 @@ void pgraph_vk_render_display(PGRAPHState *pg)
         d, d->pcrtc.start + vga_display_params.line_offset);
     if (surface == NULL || !surface->color || !surface->width ||
         !surface->height) {
-        return;
+        return false;
     }
 
     unsigned int width = 0, height = 0;
@@ -1261,12 +1285,46 @@ void pgraph_vk_render_display(PGRAPHState *pg)
 
     pgraph_apply_scaling_factor(pg, &width, &height);
 
+    CONFIG_DISPLAY_QUALITY_UPSCALER upscaler;
+    int factor;
+    float sharpness;
+    xemu_settings_get_upscaler(qatomic_read(&d->title_id), &upscaler, &factor,
+                               &sharpness);
+
     PGRAPHVkDisplayState *disp = &r->display;
-    if (!disp->image || disp->width != width || disp->height != height) {
-        if (!create_display_image(pg, width, height)) {
-            return;
+    if (disp->image && !disp->storage_image) {
+        upscaler = CONFIG_DISPLAY_QUALITY_UPSCALER_OFF;
+    }
+
+    unsigned int out_width = width, out_height = height;
+    if (upscaler != CONFIG_DISPLAY_QUALITY_UPSCALER_OFF) {
+        unsigned int max_dim = r->device_props.limits.maxImageDimension2D;
+        factor = MAX(1, MIN(factor, 4));
+        while (factor > 1 &&
+               (width * factor > max_dim || height * factor > max_dim)) {
+            factor--;
+        }
+        out_width = width * factor;
+        out_height = height * factor;
+        sharpness = MAX(0.0f, MIN(sharpness, 1.0f));
+    }
+
+    if (!disp->image || disp->width != out_width ||
+        disp->height != out_height) {
+        if (!create_display_image(pg, out_width, out_height)) {
+            return false;
+        }
+        if (!disp->storage_image) {
+            upscaler = CONFIG_DISPLAY_QUALITY_UPSCALER_OFF;
+            if (out_width != width || out_height != height) {
+                // Cannot upscale into this image, render at internal res
+                if (!create_display_image(pg, width, height)) {
+                    return false;
+                }
+            }
         }
     }
 
-    render_display(pg, surface);
+    render_display(pg, surface, upscaler, width, height, sharpness);
+    return true;
 }
@@ -301,6 +301,9 @@ static void init_render_pass_state(PGRAPHState *pg, RenderPassState *state)
                               VK_FORMAT_UNDEFINED;
     state->zeta_format = r->zeta_binding ? r->zeta_binding->host_fmt.vk_format :
                                            VK_FORMAT_UNDEFINED;
+    state->color_load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+    state->depth_load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+    state->stencil_load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
 }
 
 static VkRenderPass create_render_pass(PGRAPHVkState *r, RenderPassState *state)
@@ -318,7 +321,7 @@ static VkRenderPass create_render_pass(PGRAPHVkState *r, RenderPassState *state)
         attachments[num_attachments] = (VkAttachmentDescription){
             .format = state->color_format,
             .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+            .loadOp = state->color_load_op,
             .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
@@ -336,9 +339,9 @@ static VkRenderPass create_render_pass(PGRAPHVkState *r, RenderPassState *state)
         attachments[num_attachments] = (VkAttachmentDescription){
             .format = state->zeta_format,
             .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+            .loadOp = state->depth_load_op,
             .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+            .stencilLoadOp = state->stencil_load_op,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE,
             .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
             .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
@@ -1093,23 +1096,108 @@ static void push_vertex_attr_values(PGRAPHState *pg)
     pgraph_get_inline_values(pg, r->shader_binding->state.vsh.uniform_attrs,
                              values, &num_uniform_attrs);
 
-    if (num_uniform_attrs > 0) {
-        vkCmdPushConstants(r->command_buffer, r->pipeline_binding->layout,
-                           VK_SHADER_STAGE_VERTEX_BIT, 0,
-                           num_uniform_attrs * 4 * sizeof(float),
-                           &values);
+    DrawBatchState *batch = &r->draw_batch;
+    size_t values_size = num_uniform_attrs * 4 * sizeof(float);
+
+    if (num_uniform_attrs == 0 ||
+        (batch->num_pushed_attr_values == num_uniform_attrs &&
+         !memcmp(batch->pushed_attr_values, values, values_size))) {
+        return;
     }
+
+    pgraph_vk_flush_draw_batch(r);
+    vkCmdPushConstants(r->command_buffer, r->pipeline_binding->layout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, values_size, &values);
+    memcpy(batch->pushed_attr_values, values, values_size);
+    batch->num_pushed_attr_values = num_uniform_attrs;
 }
 
 static void bind_descriptor_sets(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (r->push_descriptor_extension_enabled) {
+        pgraph_vk_push_descriptor_set(pg);
+        return;
+    }
+
     assert(r->descriptor_set_index >= 1);
 
+    DrawBatchState *batch = &r->draw_batch;
+    VkDescriptorSet set = r->descriptor_sets[r->descriptor_set_index - 1];
+
+    if (batch->bound_descriptor_set == set &&
+        !memcmp(batch->bound_uniform_buffer_offsets, r->uniform_buffer_offsets,
+                sizeof(r->uniform_buffer_offsets))) {
+        return;
+    }
+
+    pgraph_vk_flush_draw_batch(r);
     vkCmdBindDescriptorSets(r->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            r->pipeline_binding->layout, 0, 1,
-                            &r->descriptor_sets[r->descriptor_set_index - 1], 0,
-                            NULL);
+                            r->pipeline_binding->layout, 0, 1, &set,
+                            ARRAY_SIZE(r->uniform_buffer_offsets),
+                            r->uniform_buffer_offsets);
+    batch->bound_descriptor_set = set;
+    memcpy(batch->bound_uniform_buffer_offsets, r->uniform_buffer_offsets,
+           sizeof(r->uniform_buffer_offsets));
+}
+
+void pgraph_vk_flush_draw_batch(PGRAPHVkState *r)
+{
+    DrawBatchState *batch = &r->draw_batch;
+
+    if (batch->num_draws == 0) {
+        return;
+    }
+
+    assert(r->in_render_pass);
+    nv2a_profile_inc_counter(NV2A_PROF_DRAW_BATCH);
+
+    if (r->multi_draw_extension_enabled && batch->num_draws > 1) {
+        vkCmdDrawMultiEXT(r->command_buffer, batch->num_draws, batch->draws, 1,
+                          0, sizeof(batch->draws[0]));
+    } else {
+        for (int i = 0; i < batch->num_draws; i++) {
+            vkCmdDraw(r->command_buffer, batch->draws[i].vertexCount, 1,
+                      batch->draws[i].firstVertex, 0);
+        }
+    }
+
+    batch->num_draws = 0;
+}
+
+static void queue_draw(PGRAPHVkState *r, uint32_t first_vertex,
+                       uint32_t vertex_count)
+{
+    DrawBatchState *batch = &r->draw_batch;
+
+    assert(r->in_draw);
+    nv2a_profile_inc_counter(NV2A_PROF_DRAW);
+
+    if (batch->num_draws == ARRAY_SIZE(batch->draws)) {
+        pgraph_vk_flush_draw_batch(r);
+    }
+
+    batch->draws[batch->num_draws++] = (VkMultiDrawInfoEXT){
+        .firstVertex = first_vertex,
+        .vertexCount = vertex_count,
+    };
+}
+
+static void draw_indexed(PGRAPHState *pg, VkDeviceSize index_buffer_offset,
+                         uint32_t index_count)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    assert(r->in_draw);
+    nv2a_profile_inc_counter(NV2A_PROF_DRAW);
+
+    pgraph_vk_flush_draw_batch(r);
+    nv2a_profile_inc_counter(NV2A_PROF_DRAW_BATCH);
+    vkCmdBindIndexBuffer(r->command_buffer,
+                         r->storage_buffers[BUFFER_INDEX].buffer,
+                         index_buffer_offset, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(r->command_buffer, index_count, 1, 0, 0, 0);
 }
 
 static void begin_query(PGRAPHVkState *r)
@@ -1245,6 +1333,19 @@ static void begin_render_pass(PGRAPHState *pg)
         .clearValueCount = 0,
         .pClearValues = NULL,
     };
+
+    if (r->render_pass_clear_pending) {
+        // Load op variants are compatible with the pass the pipeline and
+        // framebuffer were created against, only the begin differs.
+        RenderPassState *state = &r->render_pass_clear_state;
+        render_pass_begin_info.renderPass = get_render_pass(r, state);
+        render_pass_begin_info.clearValueCount =
+            (state->color_format != VK_FORMAT_UNDEFINED) +
+            (state->zeta_format != VK_FORMAT_UNDEFINED);
+        render_pass_begin_info.pClearValues = r->render_pass_clear_values;
+        r->render_pass_clear_pending = false;
+    }
+
     vkCmdBeginRenderPass(r->command_buffer, &render_pass_begin_info,
                          VK_SUBPASS_CONTENTS_INLINE);
     r->in_render_pass = true;
@@ -1254,6 +1355,7 @@ static void begin_render_pass(PGRAPHState *pg)
 static void end_render_pass(PGRAPHVkState *r)
 {
     if (r->in_render_pass) {
+        pgraph_vk_flush_draw_batch(r);
         vkCmdEndRenderPass(r->command_buffer);
         r->in_render_pass = false;
     }
@@ -1287,6 +1389,7 @@ void pgraph_vk_finish(PGRAPHState *pg, FinishReason finish_reason)
         if (r->query_in_flight) {
             end_query(r);
         }
+        pgraph_vk_write_end_timestamp(r);
         VK_CHECK(vkEndCommandBuffer(r->command_buffer));
 
         VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg); // FIXME: Cleanup
@@ -1340,6 +1443,7 @@ void pgraph_vk_finish(PGRAPHState *pg, FinishReason finish_reason)
 
         VK_CHECK(vkWaitForFences(r->device, 1, &r->command_buffer_fence,
                                  VK_TRUE, UINT64_MAX));
+        pgraph_vk_accumulate_gpu_time(r);
 
         r->descriptor_set_index = 0;
         r->in_command_buffer = false;
@@ -1367,8 +1471,11 @@ void pgraph_vk_begin_command_buffer(PGRAPHState *pg)
     };
     VK_CHECK(vkBeginCommandBuffer(r->command_buffer,
                                   &command_buffer_begin_info));
+    pgraph_vk_write_begin_timestamp(r);
     r->command_buffer_start_time = pg->draw_time;
     r->in_command_buffer = true;
+    r->push_descriptor_layout = VK_NULL_HANDLE;
+    memset(&r->draw_batch, 0, sizeof(r->draw_batch));
 }
 
 // FIXME: Refactor below
@@ -1497,6 +1604,12 @@ static void begin_draw(PGRAPHState *pg)
     }
 
     if (must_bind_pipeline) {
+        pgraph_vk_flush_draw_batch(r);
+
+        // Conservatively rebind layout-dependent state after a pipeline change
+        r->draw_batch.bound_descriptor_set = VK_NULL_HANDLE;
+        r->draw_batch.num_pushed_attr_values = 0;
+
         nv2a_profile_inc_counter(NV2A_PROF_PIPELINE_BIND);
         vkCmdBindPipeline(r->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                           r->pipeline_binding->pipeline);
@@ -1560,6 +1673,9 @@ static void end_draw(PGRAPHState *pg)
 
     if (pg->clearing) {
         end_render_pass(r);
+    } else if (r->debug_utils_extension_enabled) {
+        // Keep draws inside their debug label
+        pgraph_vk_flush_draw_batch(r);
     }
 
     r->in_draw = false;
@@ -1700,6 +1816,72 @@ static void sync_vertex_ram_buffer(PGRAPHState *pg)
     NV2A_VK_DGROUP_END();
 }
 
+/*
+ * Pixel value a full clear leaves in guest memory, for the surface formats
+ * whose download is a plain copy of the host attachment.
+ */
+static bool get_surface_clear_fill(PGRAPHState *pg, SurfaceBinding *surface,
+                                   uint32_t parameter, uint32_t *fill)
+{
+    if (surface->color) {
+        if ((parameter & NV097_CLEAR_SURFACE_COLOR) !=
+            NV097_CLEAR_SURFACE_COLOR) {
+            return false;
+        }
+
+        // Host formats without alpha are cleared with alpha 1.0, so the
+        // X bits read back as ones.
+        uint32_t value = pgraph_reg_r(pg, NV_PGRAPH_COLORCLEARVALUE);
+        switch (pg->surface_shape.color_format) {
+        case NV097_SET_SURFACE_FORMAT_COLOR_LE_X1R5G5B5_Z1R5G5B5:
+            *fill = (value & 0x7FFF) | 0x8000;
+            return true;
+        case NV097_SET_SURFACE_FORMAT_COLOR_LE_R5G6B5:
+            *fill = value & 0xFFFF;
+            return true;
+        case NV097_SET_SURFACE_FORMAT_COLOR_LE_X8R8G8B8_Z8R8G8B8:
+            *fill = (value & 0xFFFFFF) | 0xFF000000;
+            return true;
+        case NV097_SET_SURFACE_FORMAT_COLOR_LE_A8R8G8B8:
+            *fill = value;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Float depth is converted on download, leave it to the GPU
+    if (pg->surface_shape.z_format || !(parameter & NV097_CLEAR_SURFACE_Z)) {
+        return false;
+    }
+
+    uint32_t value = pgraph_reg_r(pg, NV_PGRAPH_ZSTENCILCLEARVALUE);
+    switch (pg->surface_shape.zeta_format) {
+    case NV097_SET_SURFACE_FORMAT_ZETA_Z16:
+        *fill = value & 0xFFFF;
+        return true;
+    case NV097_SET_SURFACE_FORMAT_ZETA_Z24S8:
+        if (!(parameter & NV097_CLEAR_SURFACE_STENCIL) ||
+            surface->host_fmt.vk_format != VK_FORMAT_D24_UNORM_S8_UINT) {
+            return false;
+        }
+        *fill = value;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void update_surface_clear_state(PGRAPHState *pg,
+                                       SurfaceBinding *surface,
+                                       uint32_t parameter, bool full_clear)
+{
+    surface->cleared = full_clear;
+    surface->clear_fill_valid =
+        full_clear &&
+        get_surface_clear_fill(pg, surface, parameter, &surface->clear_fill);
+}
+
 void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
 {
     PGRAPHState *pg = &d->pgraph;
@@ -1713,8 +1895,6 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
 
     pg->clearing = true;
 
-    // FIXME: If doing a full surface clear, mark the surface for full clear
-    // and we can just do the clear as part of the surface load.
     pgraph_vk_surface_update(d, true, write_color, write_zeta);
 
     SurfaceBinding *binding = r->color_binding ?: r->zeta_binding;
@@ -1742,7 +1922,6 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
     pgraph_vk_begin_debug_marker(r, r->command_buffer,
         RGBA_BLUE, "Clear %08" HWADDR_PRIx,
         binding->vram_addr);
-    begin_draw(pg);
 
     // FIXME: What does hardware do when min >= max?
     // FIXME: What does hardware do when min >= surface size?
@@ -1757,6 +1936,10 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
     pgraph_apply_anti_aliasing_factor(pg, &xmin, &ymin);
     pgraph_apply_anti_aliasing_factor(pg, &scissor_width, &scissor_height);
 
+    bool full_clear = !xmin && !ymin &&
+                      scissor_width >= pg->surface_binding_dim.width &&
+                      scissor_height >= pg->surface_binding_dim.height;
+
     pgraph_apply_scaling_factor(pg, &xmin, &ymin);
     pgraph_apply_scaling_factor(pg, &scissor_width, &scissor_height);
 
@@ -1769,15 +1952,67 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
         .layerCount = 1,
     };
 
+    const bool clear_all_color_channels =
+        (parameter & NV097_CLEAR_SURFACE_COLOR) ==
+        (NV097_CLEAR_SURFACE_R | NV097_CLEAR_SURFACE_G |
+         NV097_CLEAR_SURFACE_B | NV097_CLEAR_SURFACE_A);
+
+    VkImageAspectFlags zeta_aspect = 0;
+    if (write_zeta && r->zeta_binding) {
+        if (parameter & NV097_CLEAR_SURFACE_Z) {
+            zeta_aspect |= VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+        if ((parameter & NV097_CLEAR_SURFACE_STENCIL) &&
+            (r->zeta_binding->host_fmt.aspect & VK_IMAGE_ASPECT_STENCIL_BIT)) {
+            zeta_aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+    }
+
+    // The clear always begins a new render pass, so a clear of the whole
+    // render area can be done by the attachment load op instead of
+    // loading the old contents and clearing over them.
+    bool load_op_color = full_clear && write_color && r->color_binding &&
+                         clear_all_color_channels;
+    bool load_op_zeta = full_clear && zeta_aspect;
+
+    if (load_op_color || load_op_zeta) {
+        RenderPassState *state = &r->render_pass_clear_state;
+        *state = r->pipeline_binding->key.render_pass_state;
+
+        int attachment = 0;
+        if (r->color_binding) {
+            if (load_op_color) {
+                state->color_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                pgraph_get_clear_color(
+                    pg, r->render_pass_clear_values[attachment].color.float32);
+            }
+            attachment++;
+        }
+        if (load_op_zeta) {
+            if (zeta_aspect & VK_IMAGE_ASPECT_DEPTH_BIT) {
+                state->depth_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            }
+            if (zeta_aspect & VK_IMAGE_ASPECT_STENCIL_BIT) {
+                state->stencil_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            }
+            int stencil_value = 0;
+            float depth_value = 1.0;
+            pgraph_get_clear_depth_stencil_value(pg, &depth_value,
+                                                 &stencil_value);
+            r->render_pass_clear_values[attachment].depthStencil =
+                (VkClearDepthStencilValue){ depth_value, stencil_value };
+        }
+
+        r->render_pass_clear_pending = true;
+        nv2a_profile_inc_counter(NV2A_PROF_CLEAR_LOAD_OP);
+    }
+
+    begin_draw(pg);
+
     int num_attachments = 0;
     VkClearAttachment attachments[2];
 
-    if (write_color && r->color_binding) {
-        const bool clear_all_color_channels =
-            (parameter & NV097_CLEAR_SURFACE_COLOR) ==
-            (NV097_CLEAR_SURFACE_R | NV097_CLEAR_SURFACE_G |
-             NV097_CLEAR_SURFACE_B | NV097_CLEAR_SURFACE_A);
-
+    if (write_color && r->color_binding && !load_op_color) {
         if (clear_all_color_channels) {
             attachments[num_attachments] = (VkClearAttachment){
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -1795,22 +2030,13 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
         }
     }
 
-    if (write_zeta && r->zeta_binding) {
+    if (write_zeta && r->zeta_binding && !load_op_zeta) {
         int stencil_value = 0;
         float depth_value = 1.0;
         pgraph_get_clear_depth_stencil_value(pg, &depth_value, &stencil_value);
 
-        VkImageAspectFlags aspect = 0;
-        if (parameter & NV097_CLEAR_SURFACE_Z) {
-            aspect |= VK_IMAGE_ASPECT_DEPTH_BIT;
-        }
-        if ((parameter & NV097_CLEAR_SURFACE_STENCIL) &&
-            (r->zeta_binding->host_fmt.aspect & VK_IMAGE_ASPECT_STENCIL_BIT)) {
-            aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
-        }
-
         attachments[num_attachments++] = (VkClearAttachment){
-            .aspectMask = aspect,
+            .aspectMask = zeta_aspect,
             .clearValue.depthStencil.depth = depth_value,
             .clearValue.depthStencil.stencil = stencil_value,
         };
@@ -1827,6 +2053,15 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
 
     pgraph_vk_set_surface_dirty(pg, write_color, write_zeta);
 
+    if (r->color_binding) {
+        update_surface_clear_state(pg, r->color_binding, parameter,
+                                   full_clear && write_color);
+    }
+    if (r->zeta_binding) {
+        update_surface_clear_state(pg, r->zeta_binding, parameter,
+                                   full_clear && write_zeta);
+    }
+
     NV2A_VK_DGROUP_END();
 }
 
@@ -1871,7 +2106,9 @@ static void bind_vertex_buffer(PGRAPHState *pg, uint16_t inline_map,
     VkBuffer buffers[NV2A_VERTEXSHADER_ATTRIBUTES];
     VkDeviceSize offsets[NV2A_VERTEXSHADER_ATTRIBUTES];
 
-    for (int i = 0; i < r->num_active_vertex_binding_descriptions; i++) {
+    int num_buffers = r->num_active_vertex_binding_descriptions;
+
+    for (int i = 0; i < num_buffers; i++) {
         int attr_idx = r->vertex_attribute_descriptions[i].location;
         int buffer_idx = (inline_map & (1 << attr_idx)) ? BUFFER_VERTEX_INLINE :
                                                           BUFFER_VERTEX_RAM;
@@ -1879,9 +2116,23 @@ static void bind_vertex_buffer(PGRAPHState *pg, uint16_t inline_map,
         offsets[i] = offset + r->vertex_attribute_offsets[attr_idx];
     }
 
-    vkCmdBindVertexBuffers(r->command_buffer, 0,
-                           r->num_active_vertex_binding_descriptions, buffers,
-                           offsets);
+    DrawBatchState *batch = &r->draw_batch;
+
+    if (batch->num_bound_vertex_buffers == num_buffers &&
+        !memcmp(batch->bound_vertex_buffers, buffers,
+                num_buffers * sizeof(buffers[0])) &&
+        !memcmp(batch->bound_vertex_buffer_offsets, offsets,
+                num_buffers * sizeof(offsets[0]))) {
+        return;
+    }
+
+    pgraph_vk_flush_draw_batch(r);
+    vkCmdBindVertexBuffers(r->command_buffer, 0, num_buffers, buffers, offsets);
+    memcpy(batch->bound_vertex_buffers, buffers,
+           num_buffers * sizeof(buffers[0]));
+    memcpy(batch->bound_vertex_buffer_offsets, offsets,
+           num_buffers * sizeof(offsets[0]));
+    batch->num_bound_vertex_buffers = num_buffers;
 }
 
 static void bind_inline_vertex_buffer(PGRAPHState *pg, VkDeviceSize offset)
@@ -1906,12 +2157,14 @@ void pgraph_vk_set_surface_dirty(PGRAPHState *pg, bool color, bool zeta)
         r->color_binding->draw_dirty |= color;
         r->color_binding->frame_time = pg->frame_time;
         r->color_binding->cleared = false;
+        r->color_binding->clear_fill_valid = false;
     }
 
     if (r->zeta_binding) {
         r->zeta_binding->draw_dirty |= zeta;
         r->zeta_binding->frame_time = pg->frame_time;
         r->zeta_binding->cleared = false;
+        r->zeta_binding->clear_fill_valid = false;
     }
 }
 
@@ -2146,17 +2399,13 @@ void pgraph_vk_flush_draw(NV2AState *d)
             size_t rewrite_size = prim_rw.num_indices * sizeof(uint32_t);
             VkDeviceSize buffer_offset = pgraph_vk_update_index_buffer(
                 pg, prim_rw.indices, rewrite_size);
-            vkCmdBindIndexBuffer(r->command_buffer,
-                                 r->storage_buffers[BUFFER_INDEX].buffer,
-                                 buffer_offset, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(r->command_buffer, prim_rw.num_indices, 1, 0, 0,
-                             0);
+            draw_indexed(pg, buffer_offset, prim_rw.num_indices);
         } else {
             for (int i = 0; i < pg->draw_arrays_length; i++) {
                 uint32_t start = pg->draw_arrays_start[i],
                          count = pg->draw_arrays_count[i];
                 NV2A_VK_DPRINTF("- [%d] Start:%d Count:%d", i, start, count);
-                vkCmdDraw(r->command_buffer, count, 1, start, 0);
+                queue_draw(r, start, count);
             }
         }
 
@@ -2204,10 +2453,7 @@ void pgraph_vk_flush_draw(NV2AState *d)
                                      "Inline Elements");
         begin_draw(pg);
         bind_vertex_buffer(pg, remap.attributes, 0);
-        vkCmdBindIndexBuffer(r->command_buffer,
-                             r->storage_buffers[BUFFER_INDEX].buffer,
-                             buffer_offset, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(r->command_buffer, draw_index_count, 1, 0, 0, 0);
+        draw_indexed(pg, buffer_offset, draw_index_count);
         end_draw(pg);
         pgraph_vk_end_debug_marker(r, r->command_buffer);
 
@@ -2256,13 +2502,9 @@ void pgraph_vk_flush_draw(NV2AState *d)
             size_t rewrite_size = prim_rw.num_indices * sizeof(uint32_t);
             VkDeviceSize idx_offset = pgraph_vk_update_index_buffer(
                 pg, prim_rw.indices, rewrite_size);
-            vkCmdBindIndexBuffer(r->command_buffer,
-                                 r->storage_buffers[BUFFER_INDEX].buffer,
-                                 idx_offset, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(r->command_buffer, prim_rw.num_indices, 1, 0, 0,
-                             0);
+            draw_indexed(pg, idx_offset, prim_rw.num_indices);
         } else {
-            vkCmdDraw(r->command_buffer, pg->inline_buffer_length, 1, 0, 0);
+            queue_draw(r, 0, pg->inline_buffer_length);
         }
 
         end_draw(pg);
@@ -2321,13 +2563,9 @@ void pgraph_vk_flush_draw(NV2AState *d)
             size_t rewrite_size = prim_rw.num_indices * sizeof(uint32_t);
             VkDeviceSize idx_offset = pgraph_vk_update_index_buffer(
                 pg, prim_rw.indices, rewrite_size);
-            vkCmdBindIndexBuffer(r->command_buffer,
-                                 r->storage_buffers[BUFFER_INDEX].buffer,
-                                 idx_offset, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(r->command_buffer, prim_rw.num_indices, 1, 0, 0,
-                             0);
+            draw_indexed(pg, idx_offset, prim_rw.num_indices);
         } else {
-            vkCmdDraw(r->command_buffer, index_count, 1, 0, 0);
+            queue_draw(r, 0, index_count);
         }
 
         end_draw(pg);
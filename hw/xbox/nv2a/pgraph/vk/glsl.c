@@ -17,133 +17,26 @@
  * License along with this library; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/units.h"
+#include "xemu-version.h"
 #include "ui/xemu-settings.h"
 #include "renderer.h"
+#include "glsl-limits.h"
 
 #include <assert.h>
+#include <glib/gstdio.h>
 #include <glslang/Include/glslang_c_interface.h>
 #include <stdio.h>
 
-static const glslang_resource_t
-    resource_limits = { .max_lights = 32,
-                        .max_clip_planes = 6,
-                        .max_texture_units = 32,
-                        .max_texture_coords = 32,
-                        .max_vertex_attribs = 64,
-                        .max_vertex_uniform_components = 4096,
-                        .max_varying_floats = 64,
-                        .max_vertex_texture_image_units = 32,
-                        .max_combined_texture_image_units = 80,
-                        .max_texture_image_units = 32,
-                        .max_fragment_uniform_components = 4096,
-                        .max_draw_buffers = 32,
-                        .max_vertex_uniform_vectors = 128,
-                        .max_varying_vectors = 8,
-                        .max_fragment_uniform_vectors = 16,
-                        .max_vertex_output_vectors = 16,
-                        .max_fragment_input_vectors = 15,
-                        .min_program_texel_offset = -8,
-                        .max_program_texel_offset = 7,
-                        .max_clip_distances = 8,
-                        .max_compute_work_group_count_x = 65535,
-                        .max_compute_work_group_count_y = 65535,
-                        .max_compute_work_group_count_z = 65535,
-                        .max_compute_work_group_size_x = 1024,
-                        .max_compute_work_group_size_y = 1024,
-                        .max_compute_work_group_size_z = 64,
-                        .max_compute_uniform_components = 1024,
-                        .max_compute_texture_image_units = 16,
-                        .max_compute_image_uniforms = 8,
-                        .max_compute_atomic_counters = 8,
-                        .max_compute_atomic_counter_buffers = 1,
-                        .max_varying_components = 60,
-                        .max_vertex_output_components = 64,
-                        .max_geometry_input_components = 64,
-                        .max_geometry_output_components = 128,
-                        .max_fragment_input_components = 128,
-                        .max_image_units = 8,
-                        .max_combined_image_units_and_fragment_outputs = 8,
-                        .max_combined_shader_output_resources = 8,
-                        .max_image_samples = 0,
-                        .max_vertex_image_uniforms = 0,
-                        .max_tess_control_image_uniforms = 0,
-                        .max_tess_evaluation_image_uniforms = 0,
-                        .max_geometry_image_uniforms = 0,
-                        .max_fragment_image_uniforms = 8,
-                        .max_combined_image_uniforms = 8,
-                        .max_geometry_texture_image_units = 16,
-                        .max_geometry_output_vertices = 256,
-                        .max_geometry_total_output_components = 1024,
-                        .max_geometry_uniform_components = 1024,
-                        .max_geometry_varying_components = 64,
-                        .max_tess_control_input_components = 128,
-                        .max_tess_control_output_components = 128,
-                        .max_tess_control_texture_image_units = 16,
-                        .max_tess_control_uniform_components = 1024,
-                        .max_tess_control_total_output_components = 4096,
-                        .max_tess_evaluation_input_components = 128,
-                        .max_tess_evaluation_output_components = 128,
-                        .max_tess_evaluation_texture_image_units = 16,
-                        .max_tess_evaluation_uniform_components = 1024,
-                        .max_tess_patch_components = 120,
-                        .max_patch_vertices = 32,
-                        .max_tess_gen_level = 64,
-                        .max_viewports = 16,
-                        .max_vertex_atomic_counters = 0,
-                        .max_tess_control_atomic_counters = 0,
-                        .max_tess_evaluation_atomic_counters = 0,
-                        .max_geometry_atomic_counters = 0,
-                        .max_fragment_atomic_counters = 8,
-                        .max_combined_atomic_counters = 8,
-                        .max_atomic_counter_bindings = 1,
-                        .max_vertex_atomic_counter_buffers = 0,
-                        .max_tess_control_atomic_counter_buffers = 0,
-                        .max_tess_evaluation_atomic_counter_buffers = 0,
-                        .max_geometry_atomic_counter_buffers = 0,
-                        .max_fragment_atomic_counter_buffers = 1,
-                        .max_combined_atomic_counter_buffers = 1,
-                        .max_atomic_counter_buffer_size = 16384,
-                        .max_transform_feedback_buffers = 4,
-                        .max_transform_feedback_interleaved_components = 64,
-                        .max_cull_distances = 8,
-                        .max_combined_clip_and_cull_distances = 8,
-                        .max_samples = 4,
-                        .max_mesh_output_vertices_nv = 256,
-                        .max_mesh_output_primitives_nv = 512,
-                        .max_mesh_work_group_size_x_nv = 32,
-                        .max_mesh_work_group_size_y_nv = 1,
-                        .max_mesh_work_group_size_z_nv = 1,
-                        .max_task_work_group_size_x_nv = 32,
-                        .max_task_work_group_size_y_nv = 1,
-                        .max_task_work_group_size_z_nv = 1,
-                        .max_mesh_view_count_nv = 4,
-                        .maxDualSourceDrawBuffersEXT = 1,
-                        .limits = {
-                            .non_inductive_for_loops = 1,
-                            .while_loops = 1,
-                            .do_while_loops = 1,
-                            .general_uniform_indexing = 1,
-                            .general_attribute_matrix_vector_indexing = 1,
-                            .general_varying_indexing = 1,
-                            .general_sampler_indexing = 1,
-                            .general_variable_indexing = 1,
-                            .general_constant_matrix_vector_indexing = 1,
-                        } };
+#define GLSLANG_LINK_MESSAGES \
+    (GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT)
 
-void pgraph_vk_init_glsl_compiler(void)
-{
-    glslang_initialize_process();
-}
-
-void pgraph_vk_finalize_glsl_compiler(void)
-{
-    glslang_finalize_process();
-}
-
-GByteArray *pgraph_vk_compile_glsl_to_spv(glslang_stage_t stage,
-                                          const char *glsl_source)
+static glslang_input_t get_glslang_input(glslang_stage_t stage,
+                                         const char *glsl_source)
 {
-    const glslang_input_t input = {
+    return (glslang_input_t){
         .language = GLSLANG_SOURCE_GLSL,
         .stage = stage,
         .client = GLSLANG_CLIENT_VULKAN,
@@ -158,6 +51,312 @@ GByteArray *pgraph_vk_compile_glsl_to_spv(glslang_stage_t stage,
         .messages = GLSLANG_MSG_DEFAULT_BIT,
         .resource = &resource_limits,
     };
+}
+
+/*
+ * Compiled SPIR-V is kept on disk so a shader seen in a previous session
+ * skips the glslang front end entirely. Entries are named by a SHA-256 of the
+ * compiler version, compile options, stage and GLSL source, and also store
+ * the full source, which is compared on load. Entries are written and
+ * evicted on a separate thread, oldest first once the cache grows too large.
+ */
+#define SPIRV_CACHE_MAGIC 0x56505358 // 'XSPV'
+#define SPIRV_CACHE_VERSION 2
+#define SPIRV_CACHE_MAX_SIZE (256 * MiB)
+#define SPIRV_MAGIC 0x07230203
+
+typedef struct SpirvCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stage;
+    uint32_t glsl_len;
+} SpirvCacheHeader;
+
+typedef struct SpirvCacheWrite {
+    char *path;
+    GByteArray *contents; // NULL to mark an existing entry as recently used
+    QSIMPLEQ_ENTRY(SpirvCacheWrite) entry;
+} SpirvCacheWrite;
+
+typedef struct SpirvCacheFile {
+    char *path;
+    gint64 mtime;
+    guint64 size;
+} SpirvCacheFile;
+
+static struct {
+    char *dir;
+    char *options;
+    QemuThread thread;
+    QemuMutex lock;
+    QemuCond cond;
+    QSIMPLEQ_HEAD(, SpirvCacheWrite) queue;
+    bool shutdown;
+    guint64 size; // Only accessed by the writer thread
+} spirv_cache;
+
+static bool spirv_cache_enabled(void)
+{
+    return spirv_cache.dir && g_config.perf.cache_shaders &&
+           !g_config.display.vulkan.debug_shaders;
+}
+
+static char *get_spirv_cache_options(void)
+{
+    glslang_version_t version;
+    glslang_get_version(&version);
+
+    glslang_input_t input = get_glslang_input(GLSLANG_STAGE_VERTEX, NULL);
+    glslang_spv_options_t spv_options = { .validate = true };
+
+    /* resource_limits is covered by the xemu version and commit */
+    return g_strdup_printf(
+        "xemu %s %s glslang %d.%d.%d%s client %d/%d target %d/%d "
+        "glsl %d/%d/%d/%d messages %x/%x validate %d",
+        xemu_version, xemu_commit, version.major, version.minor,
+        version.patch, version.flavor ? version.flavor : "", input.client,
+        input.client_version, input.target_language,
+        input.target_language_version, input.default_version,
+        input.default_profile, input.force_default_version_and_profile,
+        input.forward_compatible, input.messages, GLSLANG_LINK_MESSAGES,
+        spv_options.validate);
+}
+
+static char *get_spirv_cache_path(glslang_stage_t stage, const char *glsl,
+                                  size_t glsl_len)
+{
+    uint32_t stage_le = cpu_to_le32(stage);
+    g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+    g_checksum_update(checksum, (const guchar *)spirv_cache.options,
+                      strlen(spirv_cache.options) + 1);
+    g_checksum_update(checksum, (const guchar *)&stage_le, sizeof(stage_le));
+    g_checksum_update(checksum, (const guchar *)glsl, glsl_len);
+
+    return g_strdup_printf("%s/%s.spv", spirv_cache.dir,
+                           g_checksum_get_string(checksum));
+}
+
+static void queue_spirv_cache_write(char *path, GByteArray *contents)
+{
+    SpirvCacheWrite *write = g_new0(SpirvCacheWrite, 1);
+    write->path = path;
+    write->contents = contents;
+
+    qemu_mutex_lock(&spirv_cache.lock);
+    QSIMPLEQ_INSERT_TAIL(&spirv_cache.queue, write, entry);
+    qemu_cond_signal(&spirv_cache.cond);
+    qemu_mutex_unlock(&spirv_cache.lock);
+}
+
+static GByteArray *load_spirv_from_cache(glslang_stage_t stage,
+                                         const char *glsl, size_t glsl_len,
+                                         char *path)
+{
+    gchar *contents = NULL;
+    gsize len = 0;
+
+    if (!g_file_get_contents(path, &contents, &len, NULL)) {
+        g_free(path);
+        return NULL;
+    }
+
+    SpirvCacheHeader header;
+    if (len < sizeof(header)) {
+        goto invalid;
+    }
+
+    memcpy(&header, contents, sizeof(header));
+    if (le32_to_cpu(header.magic) != SPIRV_CACHE_MAGIC ||
+        le32_to_cpu(header.version) != SPIRV_CACHE_VERSION ||
+        le32_to_cpu(header.stage) != stage ||
+        le32_to_cpu(header.glsl_len) != glsl_len ||
+        len - sizeof(header) <= glsl_len ||
+        memcmp(contents + sizeof(header), glsl, glsl_len)) {
+        goto invalid;
+    }
+
+    const char *spv_data = contents + sizeof(header) + glsl_len;
+    size_t spv_len = len - sizeof(header) - glsl_len;
+    if (spv_len % sizeof(uint32_t) || ldl_le_p(spv_data) != SPIRV_MAGIC) {
+        goto invalid;
+    }
+
+    GByteArray *spv = g_byte_array_sized_new(spv_len);
+    g_byte_array_append(spv, (const guint8 *)spv_data, spv_len);
+    g_free(contents);
+
+    queue_spirv_cache_write(path, NULL);
+    return spv;
+
+invalid:
+    trace_nv2a_vk_spirv_cache_invalid(path);
+    g_free(contents);
+    g_free(path);
+    return NULL;
+}
+
+static void save_spirv_to_cache(glslang_stage_t stage, const char *glsl,
+                                size_t glsl_len, char *path, GByteArray *spv)
+{
+    SpirvCacheHeader header = {
+        .magic = cpu_to_le32(SPIRV_CACHE_MAGIC),
+        .version = cpu_to_le32(SPIRV_CACHE_VERSION),
+        .stage = cpu_to_le32(stage),
+        .glsl_len = cpu_to_le32(glsl_len),
+    };
+
+    GByteArray *contents =
+        g_byte_array_sized_new(sizeof(header) + glsl_len + spv->len);
+    g_byte_array_append(contents, (const guint8 *)&header, sizeof(header));
+    g_byte_array_append(contents, (const guint8 *)glsl, glsl_len);
+    g_byte_array_append(contents, spv->data, spv->len);
+
+    queue_spirv_cache_write(path, contents);
+}
+
+static gint compare_spirv_cache_files(gconstpointer a, gconstpointer b)
+{
+    const SpirvCacheFile *fa = a, *fb = b;
+    return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+/* Recount the cache and remove the least recently used entries if too big */
+static void evict_spirv_cache(void)
+{
+    g_autoptr(GDir) dir = g_dir_open(spirv_cache.dir, 0, NULL);
+    if (!dir) {
+        return;
+    }
+
+    g_autoptr(GArray) files = g_array_new(false, false, sizeof(SpirvCacheFile));
+    guint64 total = 0;
+    const char *name;
+
+    while ((name = g_dir_read_name(dir))) {
+        if (!g_str_has_suffix(name, ".spv")) {
+            continue;
+        }
+
+        SpirvCacheFile file = {
+            .path = g_build_filename(spirv_cache.dir, name, NULL),
+        };
+        GStatBuf st;
+        if (g_stat(file.path, &st)) {
+            g_free(file.path);
+            continue;
+        }
+        file.mtime = st.st_mtime;
+        file.size = st.st_size;
+        total += file.size;
+        g_array_append_val(files, file);
+    }
+
+    g_array_sort(files, compare_spirv_cache_files);
+
+    for (guint i = 0; i < files->len; i++) {
+        SpirvCacheFile *file = &g_array_index(files, SpirvCacheFile, i);
+        if (total > SPIRV_CACHE_MAX_SIZE * 3 / 4 && !g_unlink(file->path)) {
+            trace_nv2a_vk_spirv_cache_evict(file->path);
+            total -= file->size;
+        }
+        g_free(file->path);
+    }
+
+    spirv_cache.size = total;
+}
+
+static void *spirv_cache_writer_thread(void *opaque)
+{
+    evict_spirv_cache();
+
+    qemu_mutex_lock(&spirv_cache.lock);
+    while (true) {
+        while (QSIMPLEQ_EMPTY(&spirv_cache.queue) && !spirv_cache.shutdown) {
+            qemu_cond_wait(&spirv_cache.cond, &spirv_cache.lock);
+        }
+        if (QSIMPLEQ_EMPTY(&spirv_cache.queue)) {
+            break;
+        }
+
+        SpirvCacheWrite *write = QSIMPLEQ_FIRST(&spirv_cache.queue);
+        QSIMPLEQ_REMOVE_HEAD(&spirv_cache.queue, entry);
+        qemu_mutex_unlock(&spirv_cache.lock);
+
+        if (write->contents) {
+            GError *err = NULL;
+            if (g_file_set_contents(write->path,
+                                    (const gchar *)write->contents->data,
+                                    write->contents->len, &err)) {
+                spirv_cache.size += write->contents->len;
+            } else {
+                trace_nv2a_vk_spirv_cache_write_failed(write->path,
+                                                       err->message);
+                g_error_free(err);
+            }
+            g_byte_array_unref(write->contents);
+        } else {
+            g_utime(write->path, NULL);
+        }
+        g_free(write->path);
+        g_free(write);
+
+        if (spirv_cache.size > SPIRV_CACHE_MAX_SIZE) {
+            evict_spirv_cache();
+        }
+
+        qemu_mutex_lock(&spirv_cache.lock);
+    }
+    qemu_mutex_unlock(&spirv_cache.lock);
+
+    return NULL;
+}
+
+void pgraph_vk_init_glsl_compiler(void)
+{
+    glslang_initialize_process();
+
+    if (!g_config.perf.cache_shaders) {
+        return;
+    }
+
+    spirv_cache.dir =
+        g_strdup_printf("%sspirv", xemu_settings_get_base_path());
+    qemu_mkdir(spirv_cache.dir);
+    spirv_cache.options = get_spirv_cache_options();
+    spirv_cache.shutdown = false;
+    QSIMPLEQ_INIT(&spirv_cache.queue);
+    qemu_mutex_init(&spirv_cache.lock);
+    qemu_cond_init(&spirv_cache.cond);
+    qemu_thread_create(&spirv_cache.thread, "nv2a.spirv_cache",
+                       spirv_cache_writer_thread, NULL,
+                       QEMU_THREAD_JOINABLE);
+}
+
+void pgraph_vk_finalize_glsl_compiler(void)
+{
+    if (spirv_cache.dir) {
+        qemu_mutex_lock(&spirv_cache.lock);
+        spirv_cache.shutdown = true;
+        qemu_cond_signal(&spirv_cache.cond);
+        qemu_mutex_unlock(&spirv_cache.lock);
+        qemu_thread_join(&spirv_cache.thread);
+
+        qemu_cond_destroy(&spirv_cache.cond);
+        qemu_mutex_destroy(&spirv_cache.lock);
+        g_free(spirv_cache.options);
+        g_free(spirv_cache.dir);
+        spirv_cache.options = NULL;
+        spirv_cache.dir = NULL;
+    }
+
+    glslang_finalize_process();
+}
+
+GByteArray *pgraph_vk_compile_glsl_to_spv(glslang_stage_t stage,
+                                          const char *glsl_source)
+{
+    const glslang_input_t input = get_glslang_input(stage, glsl_source);
 
     glslang_shader_t *shader = glslang_shader_create(&input);
 
@@ -191,8 +390,7 @@ GByteArray *pgraph_vk_compile_glsl_to_spv(glslang_stage_t stage,
     glslang_program_t *program = glslang_program_create();
     glslang_program_add_shader(program, shader);
 
-    if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT |
-                                           GLSLANG_MSG_VULKAN_RULES_BIT)) {
+    if (!glslang_program_link(program, GLSLANG_LINK_MESSAGES)) {
         fprintf(stderr,
                 "GLSL linking failed\n"
                 "[INFO]: %s\n"
@@ -367,11 +565,27 @@ static glslang_stage_t vk_shader_stage_to_glslang_stage(VkShaderStageFlagBits st
 ShaderModuleInfo *pgraph_vk_create_shader_module_from_glsl(
     PGRAPHVkState *r, VkShaderStageFlagBits stage, const char *glsl)
 {
+    glslang_stage_t glslang_stage = vk_shader_stage_to_glslang_stage(stage);
     ShaderModuleInfo *info = g_malloc0(sizeof(*info));
     info->refcnt = 0;
     info->glsl = strdup(glsl);
-    info->spirv = pgraph_vk_compile_glsl_to_spv(
-        vk_shader_stage_to_glslang_stage(stage), glsl);
+
+    if (spirv_cache_enabled()) {
+        size_t glsl_len = strlen(glsl);
+        char *path = get_spirv_cache_path(glslang_stage, glsl, glsl_len);
+        info->spirv =
+            load_spirv_from_cache(glslang_stage, glsl, glsl_len, g_strdup(path));
+        if (info->spirv) {
+            nv2a_profile_inc_counter(NV2A_PROF_SHADER_SPIRV_CACHE_HIT);
+            g_free(path);
+        } else {
+            info->spirv = pgraph_vk_compile_glsl_to_spv(glslang_stage, glsl);
+            save_spirv_to_cache(glslang_stage, glsl, glsl_len, path,
+                                info->spirv);
+        }
+    } else {
+        info->spirv = pgraph_vk_compile_glsl_to_spv(glslang_stage, glsl);
+    }
     info->module = pgraph_vk_create_shader_module_from_spv(r, info->spirv);
     init_layout_from_spv(info);
     return info;
@@ -145,6 +145,44 @@ static inline void uniform_copy(ShaderUniformLayout *layout, int idx,
     }
 }
 
+/*
+ * Like uniform_copy, but starts at array element @first and only writes
+ * elements whose contents differ. Returns true if anything was written.
+ */
+static inline bool uniform_update(ShaderUniformLayout *layout, int idx,
+                                  size_t first, const void *values,
+                                  size_t value_size, size_t count)
+{
+    assert(idx > 0 && "invalid uniform index");
+
+    ShaderUniform *u = &layout->uniforms[idx - 1];
+    const size_t element_size = value_size * u->dim_v;
+
+    assert(first < u->dim_a);
+
+    size_t bytes_remaining = value_size * count;
+    char *p_out = (char *)uniform_ptr(layout, idx) + first * u->stride;
+    char *p_max = (char *)layout->allocation + layout->total_size;
+    const char *p_in = (const char *)values;
+    bool changed = false;
+
+    size_t index = first;
+    while (bytes_remaining) {
+        assert((p_out + element_size) <= p_max);
+        assert(index < u->dim_a);
+        if (memcmp(p_out, p_in, element_size)) {
+            memcpy(p_out, p_in, element_size);
+            changed = true;
+        }
+        bytes_remaining -= element_size;
+        p_out += u->stride;
+        p_in += element_size;
+        index += 1;
+    }
+
+    return changed;
+}
+
 static inline
 void uniform1fv(ShaderUniformLayout *layout, int idx, size_t count, float *values)
 {
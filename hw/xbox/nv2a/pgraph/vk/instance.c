@@ -27,6 +27,9 @@
 #include <dlfcn.h>
 #endif
 #include <volk.h>
+#ifdef __ANDROID__
+#include <vulkan/vulkan_android.h>
+#endif
 
 #ifdef __ANDROID__
 static void *g_custom_vk_handle = NULL;
@@ -176,6 +179,25 @@ add_optional_instance_extension_names(PGRAPHState *pg,
         g_config.display.vulkan.validation_layers &&
         add_extension_if_available(available_extensions, enabled_extension_names,
                                    VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+
+    if (g_config.display.vulkan.native_present) {
+        r->surface_extension_enabled = add_extension_if_available(
+            available_extensions, enabled_extension_names,
+            VK_KHR_SURFACE_EXTENSION_NAME);
+#ifdef __ANDROID__
+        r->android_surface_extension_enabled =
+            r->surface_extension_enabled &&
+            add_extension_if_available(
+                available_extensions, enabled_extension_names,
+                VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+#else
+        r->headless_surface_extension_enabled =
+            r->surface_extension_enabled &&
+            add_extension_if_available(
+                available_extensions, enabled_extension_names,
+                VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+#endif
+    }
 }
 
 static bool create_instance(PGRAPHState *pg, Error **errp)
@@ -365,6 +387,84 @@ static void add_optional_device_extension_names(
     r->memory_budget_extension_enabled = add_extension_if_available(
         available_extensions, enabled_extension_names,
         VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    r->push_descriptor_extension_enabled = add_extension_if_available(
+        available_extensions, enabled_extension_names,
+        VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+
+    r->multi_draw_extension_enabled = add_extension_if_available(
+        available_extensions, enabled_extension_names,
+        VK_EXT_MULTI_DRAW_EXTENSION_NAME);
+
+    r->fragment_shader_barycentric_extension_enabled =
+        add_extension_if_available(
+            available_extensions, enabled_extension_names,
+            VK_KHR_FRAGMENT_SHADER_BARYCENTRIC_EXTENSION_NAME);
+
+    if (r->android_surface_extension_enabled ||
+        r->headless_surface_extension_enabled) {
+        r->swapchain_extension_enabled = add_extension_if_available(
+            available_extensions, enabled_extension_names,
+            VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+        /* Present wait is only usable together with present ids */
+        r->present_wait_extension_enabled =
+            r->swapchain_extension_enabled &&
+            is_extension_available(available_extensions,
+                                   VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            is_extension_available(available_extensions,
+                                   VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        if (r->present_wait_extension_enabled) {
+            add_extension_if_available(available_extensions,
+                                       enabled_extension_names,
+                                       VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            add_extension_if_available(available_extensions,
+                                       enabled_extension_names,
+                                       VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+    }
+}
+
+/*
+ * Geometry shaders are missing or very slow on most tile-based mobile GPUs.
+ * On those, primitives are assembled by index rewriting alone and depth is
+ * reconstructed in the fragment shader.
+ */
+static bool is_geometry_stage_slow(const VkPhysicalDeviceProperties *props)
+{
+    switch (props->vendorID) {
+    case 0x13B5: /* ARM */
+    case 0x5143: /* Qualcomm */
+    case 0x1010: /* Imagination */
+    case 0x14E4: /* Broadcom */
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void select_geometry_stage(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    switch (g_config.display.vulkan.geometry_shader) {
+    case CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER_ENABLED:
+        r->geometry_shader_free = false;
+        break;
+    case CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER_DISABLED:
+        r->geometry_shader_free = true;
+        break;
+    default:
+        r->geometry_shader_free = is_geometry_stage_slow(&r->device_props);
+        break;
+    }
+
+    if (r->enabled_physical_device_features.geometryShader != VK_TRUE) {
+        r->geometry_shader_free = true;
+    }
+
+    fprintf(stderr, "Geometry shaders: %s\n",
+            r->geometry_shader_free ? "not used" : "used");
 }
 
 static bool check_device_support_required_extensions(VkPhysicalDevice device)
@@ -528,7 +628,7 @@ static bool create_logical_device(PGRAPHState *pg, Error **errp)
         }
         F(depthClamp, false),
         F(fillModeNonSolid, false),
-        F(geometryShader, true),
+        F(geometryShader, false),
         F(occlusionQueryPrecise, false),
         F(samplerAnisotropy, false),
         F(shaderClipDistance, false),
@@ -599,6 +699,52 @@ static bool create_logical_device(PGRAPHState *pg, Error **errp)
         next_struct = &custom_border_features;
     }
 
+    VkPhysicalDeviceMultiDrawFeaturesEXT multi_draw_features;
+    if (r->multi_draw_extension_enabled) {
+        multi_draw_features = (VkPhysicalDeviceMultiDrawFeaturesEXT){
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTI_DRAW_FEATURES_EXT,
+            .multiDraw = VK_TRUE,
+            .pNext = next_struct,
+        };
+        next_struct = &multi_draw_features;
+    }
+
+    VkPhysicalDeviceFragmentShaderBarycentricFeaturesKHR barycentric_features;
+    if (r->fragment_shader_barycentric_extension_enabled) {
+        barycentric_features =
+            (VkPhysicalDeviceFragmentShaderBarycentricFeaturesKHR){
+                .sType =
+                    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADER_BARYCENTRIC_FEATURES_KHR,
+                .fragmentShaderBarycentric = VK_TRUE,
+                .pNext = next_struct,
+            };
+        next_struct = &barycentric_features;
+    }
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features;
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features;
+    if (r->present_wait_extension_enabled) {
+        present_id_features = (VkPhysicalDevicePresentIdFeaturesKHR){
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        };
+        present_wait_features = (VkPhysicalDevicePresentWaitFeaturesKHR){
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+            .pNext = &present_id_features,
+        };
+        VkPhysicalDeviceFeatures2 features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &present_wait_features,
+        };
+        vkGetPhysicalDeviceFeatures2(r->physical_device, &features2);
+
+        r->present_wait_extension_enabled =
+            present_id_features.presentId && present_wait_features.presentWait;
+        if (r->present_wait_extension_enabled) {
+            present_id_features.pNext = next_struct;
+            next_struct = &present_wait_features;
+        }
+    }
+
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .queueCreateInfoCount = 1,
@@ -745,6 +891,7 @@ void pgraph_vk_init_instance(PGRAPHState *pg, Error **errp)
     if (!create_logical_device(pg, errp)) {
         goto done;
     }
+    select_geometry_stage(pg);
 #ifdef __ANDROID__
     __android_log_print(ANDROID_LOG_INFO, "xemu-android",
                         "vk init stage: init_allocator");
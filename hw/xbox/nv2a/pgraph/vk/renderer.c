@@ -142,6 +142,7 @@ static void pgraph_vk_init(NV2AState *d, Error **errp)
                         "vk init stage: display");
 #endif
     pgraph_vk_init_display(pg);
+    pgraph_vk_init_swapchain(pg);
 
     pgraph_vk_update_vertex_ram_buffer(&d->pgraph, 0, d->vram_ptr,
                                    memory_region_size(d->vram));
@@ -157,6 +158,7 @@ static void pgraph_vk_finalize(NV2AState *d)
 {
     PGRAPHState *pg = &d->pgraph;
 
+    pgraph_vk_finalize_swapchain(pg);
     pgraph_vk_finalize_display(pg);
     pgraph_vk_finalize_compute(pg);
     pgraph_vk_finalize_reports(pg);
@@ -192,6 +194,13 @@ static void pgraph_vk_flush(NV2AState *d)
         pg->texture_dirty[i] = true;
     }
 
+    /* Uniform blocks are updated from these, and they may have been
+     * replaced wholesale (e.g. by a snapshot load) */
+    memset(pg->vsh_constants_dirty, 1, sizeof(pg->vsh_constants_dirty));
+    memset(pg->ltctxa_dirty, 1, sizeof(pg->ltctxa_dirty));
+    memset(pg->ltctxb_dirty, 1, sizeof(pg->ltctxb_dirty));
+    memset(pg->ltc1_dirty, 1, sizeof(pg->ltc1_dirty));
+
     /* FIXME: Flush more? */
 
     qatomic_set(&d->pgraph.flush_pending, false);
@@ -201,28 +210,59 @@ static void pgraph_vk_flush(NV2AState *d)
 static void pgraph_vk_sync(NV2AState *d)
 {
     PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    pgraph_vk_update_present_window(pg);
+
+    bool present = qatomic_read(&r->swapchain.present_pending);
 #if HAVE_EXTERNAL_MEMORY
-    if (pg->vk_renderer_state->display.use_external_memory) {
-        pgraph_vk_render_display(pg);
-    }
+    bool render = present || r->display.use_external_memory;
 #else
-    pgraph_vk_render_display(pg);
+    bool render = true;
 #endif
+    bool have_frame = render && pgraph_vk_render_display(pg);
+    if (present) {
+        qatomic_set(&r->swapchain.present_pending, false);
+        pgraph_vk_present(pg, have_frame);
+    }
 
     qatomic_set(&d->pgraph.sync_pending, false);
     qemu_event_set(&d->pgraph.sync_complete);
 }
 
+/* Present each guest frame to a headless surface, which nobody else drives */
+static void pgraph_vk_present_headless(NV2AState *d)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    r->swapchain.headless_present_pending = false;
+    pgraph_vk_update_present_window(pg);
+    if (qatomic_read(&r->swapchain.active)) {
+        pgraph_vk_present(pg, pgraph_vk_render_display(pg));
+    }
+}
+
 static void pgraph_vk_process_pending(NV2AState *d)
 {
     PGRAPHVkState *r = d->pgraph.vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
 
     if (qatomic_read(&r->downloads_pending) ||
         qatomic_read(&r->download_dirty_surfaces_pending) ||
         qatomic_read(&d->pgraph.sync_pending) ||
-        qatomic_read(&d->pgraph.flush_pending)
+        qatomic_read(&d->pgraph.flush_pending) ||
+        sc->headless_present_pending
     ) {
+        bool present = sc->headless_present_pending ||
+                       (qatomic_read(&d->pgraph.sync_pending) &&
+                        qatomic_read(&sc->present_pending) &&
+                        !sc->window_changed);
         qemu_mutex_unlock(&d->pfifo.lock);
+        /* Presentation may wait on the display, keep that off pgraph.lock */
+        if (present) {
+            pgraph_vk_acquire_present_image(&d->pgraph);
+        }
         qemu_mutex_lock(&d->pgraph.lock);
         if (qatomic_read(&r->downloads_pending)) {
             pgraph_vk_process_pending_downloads(d);
@@ -230,6 +270,9 @@ static void pgraph_vk_process_pending(NV2AState *d)
         if (qatomic_read(&r->download_dirty_surfaces_pending)) {
             pgraph_vk_download_dirty_surfaces(d);
         }
+        if (sc->headless_present_pending) {
+            pgraph_vk_present_headless(d);
+        }
         if (qatomic_read(&d->pgraph.sync_pending)) {
             pgraph_vk_sync(d);
         }
@@ -243,8 +286,17 @@ static void pgraph_vk_process_pending(NV2AState *d)
 
 static void pgraph_vk_flip_stall(NV2AState *d)
 {
-    pgraph_vk_finish(&d->pgraph, VK_FINISH_REASON_FLIP_STALL);
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    pgraph_vk_finish(pg, VK_FINISH_REASON_FLIP_STALL);
+    pgraph_vk_update_dynamic_scale(d);
     pgraph_vk_debug_frame_terminator();
+
+    /* Presented from process_pending, outside of the method drain */
+    if (r->headless_surface_extension_enabled) {
+        r->swapchain.headless_present_pending = true;
+    }
 }
 
 static void pgraph_vk_pre_savevm_trigger(NV2AState *d)
@@ -309,6 +361,58 @@ static int pgraph_vk_get_framebuffer_surface(NV2AState *d)
 #endif
 }
 
+static bool pgraph_vk_set_present_window(NV2AState *d, void *window)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (!r->swapchain_extension_enabled) {
+        return false;
+    }
+
+    qemu_mutex_lock(&d->pfifo.lock);
+    r->swapchain.pending_window = window;
+    r->swapchain.window_changed = true;
+    qemu_event_reset(&pg->sync_complete);
+    qatomic_set(&pg->sync_pending, true);
+    pfifo_kick(d);
+    qemu_mutex_unlock(&d->pfifo.lock);
+    qemu_event_wait(&pg->sync_complete);
+
+    return qatomic_read(&r->swapchain.active);
+}
+
+static bool pgraph_vk_present_framebuffer(NV2AState *d, float aspect_ratio)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (!qatomic_read(&r->swapchain.active)) {
+        return false;
+    }
+
+    qemu_mutex_lock(&d->pfifo.lock);
+
+    VGADisplayParams vga_display_params;
+    d->vga.get_params(&d->vga, &vga_display_params);
+
+    SurfaceBinding *surface = pgraph_vk_surface_get_within(
+        d, d->pcrtc.start + vga_display_params.line_offset);
+    if (surface != NULL) {
+        surface->frame_time = pg->frame_time;
+    }
+
+    r->swapchain.aspect_ratio = aspect_ratio;
+    qatomic_set(&r->swapchain.present_pending, true);
+    qemu_event_reset(&pg->sync_complete);
+    qatomic_set(&pg->sync_pending, true);
+    pfifo_kick(d);
+    qemu_mutex_unlock(&d->pfifo.lock);
+    qemu_event_wait(&pg->sync_complete);
+
+    return true;
+}
+
 static PGRAPHRenderer pgraph_vk_renderer = {
     .type = CONFIG_DISPLAY_RENDERER_VULKAN,
     .name = "Vulkan",
@@ -334,6 +438,8 @@ static PGRAPHRenderer pgraph_vk_renderer = {
         .set_surface_scale_factor = pgraph_vk_set_surface_scale_factor,
         .get_surface_scale_factor = pgraph_vk_get_surface_scale_factor,
         .get_framebuffer_surface = pgraph_vk_get_framebuffer_surface,
+        .set_present_window = pgraph_vk_set_present_window,
+        .present_framebuffer = pgraph_vk_present_framebuffer,
     }
 };
 
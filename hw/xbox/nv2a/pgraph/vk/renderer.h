@@ -55,6 +55,9 @@ typedef struct MemorySyncRequirement {
 typedef struct RenderPassState {
     VkFormat color_format;
     VkFormat zeta_format;
+    VkAttachmentLoadOp color_load_op;
+    VkAttachmentLoadOp depth_load_op;
+    VkAttachmentLoadOp stencil_load_op;
 } RenderPassState;
 
 typedef struct RenderPass {
@@ -107,6 +110,8 @@ typedef struct StorageBuffer {
     uint8_t *mapped;
 } StorageBuffer;
 
+#define SURFACE_UPLOAD_ROW_RANGES_MAX 4
+
 typedef struct SurfaceBinding {
     QTAILQ_ENTRY(SurfaceBinding) entry;
     MemAccessCallback *access_cb;
@@ -125,12 +130,21 @@ typedef struct SurfaceBinding {
     size_t size;
 
     bool cleared;
+    bool clear_fill_valid; // Surface holds clear_fill in every pixel
+    uint32_t clear_fill; // Guest format pixel value of the last full clear
     int frame_time;
     int draw_time;
     bool draw_dirty;
     bool download_pending;
     bool upload_pending;
 
+    // CPU writes to linear surfaces only re-upload the rows they touched
+    bool upload_partial;
+    int num_upload_row_ranges;
+    struct {
+        unsigned int first, end;
+    } upload_row_ranges[SURFACE_UPLOAD_ROW_RANGES_MAX];
+
     BasicSurfaceFormatInfo fmt;
     SurfaceFormatInfo host_fmt;
 
@@ -284,9 +298,28 @@ typedef struct PGRAPHVkDisplayState {
         VkSampler sampler;
     } pvideo;
 
+    struct {
+        // Frame at internal resolution, upscaled into the display image
+        VkImage image;
+        VkImageView image_view;
+        VmaAllocation allocation;
+        VkFramebuffer framebuffer;
+        int width, height;
+
+        VkDescriptorPool descriptor_pool;
+        VkDescriptorSetLayout descriptor_set_layout;
+        VkDescriptorSet descriptor_set;
+        VkPipelineLayout pipeline_layout;
+        VkPipeline pipeline;
+
+        bool storage_optimal;
+        bool storage_linear;
+    } upscale;
+
     int width, height;
     int draw_time;
     bool use_external_memory;
+    bool storage_image; // Display image can be written by the upscaler
 
     // OpenGL Interop
 #ifdef WIN32
@@ -298,6 +331,49 @@ typedef struct PGRAPHVkDisplayState {
     GLuint gl_texture_id;
 } PGRAPHVkDisplayState;
 
+#define SWAPCHAIN_FRAMES_IN_FLIGHT 2
+#define SWAPCHAIN_MAX_IMAGES 8
+
+typedef struct PGRAPHVkSwapchainState {
+    // Handed over by the display thread, applied on the next sync
+    void *pending_window;
+    bool window_changed;
+    bool present_pending;
+    float aspect_ratio;
+    bool active;
+
+    void *window;
+    VkSurfaceKHR surface;
+    VkSwapchainKHR swapchain;
+    VkFormat format;
+    VkExtent2D extent;
+    VkPresentModeKHR present_mode;
+    VkPresentModeKHR requested_present_mode;
+    bool needs_recreate;
+
+    uint32_t num_images;
+    VkImage images[SWAPCHAIN_MAX_IMAGES];
+    VkSemaphore release_semaphores[SWAPCHAIN_MAX_IMAGES];
+
+    struct {
+        VkCommandBuffer cmd;
+        VkSemaphore acquire_semaphore;
+        VkFence fence;
+    } frames[SWAPCHAIN_FRAMES_IN_FLIGHT];
+    int frame_index;
+
+    uint64_t present_id;
+    uint64_t first_present_id;
+    int64_t present_submit_time[SWAPCHAIN_FRAMES_IN_FLIGHT];
+
+    // Acquired without pg->lock held, consumed by the next present
+    bool image_acquired;
+    uint32_t image_index;
+
+    // Set at flip stall when presenting to a headless surface
+    bool headless_present_pending;
+} PGRAPHVkSwapchainState;
+
 typedef struct ComputePipelineKey {
     VkFormat host_fmt;
     bool pack;
@@ -320,6 +396,29 @@ typedef struct PGRAPHVkComputeState {
     ComputePipeline *pipeline_cache_entries;
 } PGRAPHVkComputeState;
 
+#define NV2A_VK_MAX_BATCHED_DRAWS 256
+
+/*
+ * Non-indexed draws are not recorded immediately but accumulated here, and
+ * emitted together once some state they depend on is about to change. The
+ * bound_* fields mirror what was last recorded into the command buffer so
+ * redundant binds between otherwise identical draws can be skipped.
+ */
+typedef struct DrawBatchState {
+    VkMultiDrawInfoEXT draws[NV2A_VK_MAX_BATCHED_DRAWS];
+    int num_draws;
+
+    VkDescriptorSet bound_descriptor_set;
+    uint32_t bound_uniform_buffer_offsets[2];
+
+    int num_bound_vertex_buffers;
+    VkBuffer bound_vertex_buffers[NV2A_VERTEXSHADER_ATTRIBUTES];
+    VkDeviceSize bound_vertex_buffer_offsets[NV2A_VERTEXSHADER_ATTRIBUTES];
+
+    int num_pushed_attr_values;
+    float pushed_attr_values[NV2A_VERTEXSHADER_ATTRIBUTES][4];
+} DrawBatchState;
+
 typedef struct PGRAPHVkState {
     VkInstance instance;
     VkDebugUtilsMessengerEXT debug_messenger;
@@ -328,6 +427,14 @@ typedef struct PGRAPHVkState {
     bool debug_utils_extension_enabled;
     bool custom_border_color_extension_enabled;
     bool memory_budget_extension_enabled;
+    bool push_descriptor_extension_enabled;
+    bool multi_draw_extension_enabled;
+    bool fragment_shader_barycentric_extension_enabled;
+    bool surface_extension_enabled;
+    bool android_surface_extension_enabled;
+    bool headless_surface_extension_enabled;
+    bool swapchain_extension_enabled;
+    bool present_wait_extension_enabled;
 
     VkPhysicalDevice physical_device;
     VkPhysicalDeviceFeatures enabled_physical_device_features;
@@ -357,6 +464,9 @@ typedef struct PGRAPHVkState {
     VkRenderPass render_pass;
     GArray *render_passes; // RenderPass
     bool in_render_pass;
+    bool render_pass_clear_pending;
+    RenderPassState render_pass_clear_state;
+    VkClearValue render_pass_clear_values[2];
     bool in_draw;
 
     Lru pipeline_cache;
@@ -364,11 +474,14 @@ typedef struct PGRAPHVkState {
     PipelineBinding *pipeline_cache_entries;
     PipelineBinding *pipeline_binding;
     bool pipeline_binding_changed;
+    DrawBatchState draw_batch;
 
     VkDescriptorPool descriptor_pool;
     VkDescriptorSetLayout descriptor_set_layout;
     VkDescriptorSet descriptor_sets[1024];
     int descriptor_set_index;
+    VkPipelineLayout push_descriptor_layout;
+    bool push_descriptors_dirty;
 
     StorageBuffer storage_buffers[BUFFER_COUNT];
     PrimRewriteBuf prim_rewrite_buf;
@@ -407,13 +520,13 @@ typedef struct PGRAPHVkState {
     ShaderModuleInfo *quad_vert_module, *solid_frag_module;
     bool shader_bindings_changed;
     bool use_push_constants_for_uniform_attrs;
+    bool geometry_shader_free;
 
     Lru shader_module_cache;
     ShaderModuleCacheEntry *shader_module_cache_entries;
 
     // FIXME: Merge these into a structure
-    uint64_t uniform_buffer_hashes[2];
-    size_t uniform_buffer_offsets[2];
+    uint32_t uniform_buffer_offsets[2];
     bool uniforms_changed;
 
     VkQueryPool query_pool;
@@ -424,11 +537,27 @@ typedef struct PGRAPHVkState {
     uint32_t zpass_pixel_count_result;
     QSIMPLEQ_HEAD(, QueryReport) report_queue; // FIXME: Statically allocate
 
+    // GPU time of draw command buffers, for dynamic surface scaling
+    VkQueryPool timestamp_query_pool;
+    bool timestamps_supported;
+    bool timestamps_written;
+    uint64_t timestamp_mask;
+
+    struct {
+        int scale; // 0 when inactive, else overrides the configured scale
+        int64_t frame_gpu_ns;
+        float avg_frame_time; // Smoothed, in ms
+        int frames_since_change;
+        int frames_over;
+        int frames_under;
+    } dynamic_scale;
+
     SurfaceFormatInfo kelvin_surface_zeta_vk_map[3];
 
     uint32_t clear_parameter;
 
     PGRAPHVkDisplayState display;
+    PGRAPHVkSwapchainState swapchain;
     PGRAPHVkComputeState compute;
 } PGRAPHVkState;
 
@@ -511,6 +640,7 @@ VkDeviceSize pgraph_vk_update_vertex_inline_buffer(PGRAPHState *pg, void **data,
 void pgraph_vk_init_surfaces(PGRAPHState *pg);
 void pgraph_vk_finalize_surfaces(PGRAPHState *pg);
 void pgraph_vk_surface_flush(NV2AState *d);
+void pgraph_vk_surface_rescale(NV2AState *d);
 void pgraph_vk_process_pending_downloads(NV2AState *d);
 void pgraph_vk_surface_download_if_dirty(NV2AState *d, SurfaceBinding *surface);
 SurfaceBinding *pgraph_vk_surface_get_within(NV2AState *d, hwaddr addr);
@@ -526,6 +656,7 @@ void pgraph_vk_set_surface_dirty(PGRAPHState *pg, bool color, bool zeta);
 void pgraph_vk_set_surface_scale_factor(NV2AState *d, unsigned int scale);
 unsigned int pgraph_vk_get_surface_scale_factor(NV2AState *d);
 void pgraph_vk_reload_surface_scale_factor(PGRAPHState *pg);
+void pgraph_vk_update_dynamic_scale(NV2AState *d);
 
 // surface-compute.c
 void pgraph_vk_init_compute(PGRAPHState *pg);
@@ -542,9 +673,24 @@ void pgraph_vk_unpack_depth_stencil(PGRAPHState *pg, SurfaceBinding *surface,
 // display.c
 void pgraph_vk_init_display(PGRAPHState *pg);
 void pgraph_vk_finalize_display(PGRAPHState *pg);
-void pgraph_vk_render_display(PGRAPHState *pg);
+bool pgraph_vk_render_display(PGRAPHState *pg);
 bool pgraph_vk_gl_external_memory_available(void);
 
+// display-upscale.c
+void pgraph_vk_init_display_upscale(PGRAPHState *pg);
+void pgraph_vk_finalize_display_upscale(PGRAPHState *pg);
+VkFramebuffer pgraph_vk_display_upscale_source(PGRAPHState *pg, int width,
+                                               int height);
+void pgraph_vk_display_upscale(PGRAPHState *pg, VkCommandBuffer cmd,
+                               bool edge_adaptive, float sharpness);
+
+// swapchain.c
+void pgraph_vk_init_swapchain(PGRAPHState *pg);
+void pgraph_vk_finalize_swapchain(PGRAPHState *pg);
+void pgraph_vk_update_present_window(PGRAPHState *pg);
+void pgraph_vk_acquire_present_image(PGRAPHState *pg);
+void pgraph_vk_present(PGRAPHState *pg, bool have_frame);
+
 // texture.c
 void pgraph_vk_init_textures(PGRAPHState *pg);
 void pgraph_vk_finalize_textures(PGRAPHState *pg);
@@ -557,6 +703,7 @@ void pgraph_vk_trim_texture_cache(PGRAPHState *pg);
 void pgraph_vk_init_shaders(PGRAPHState *pg);
 void pgraph_vk_finalize_shaders(PGRAPHState *pg);
 void pgraph_vk_update_descriptor_sets(PGRAPHState *pg);
+void pgraph_vk_push_descriptor_set(PGRAPHState *pg);
 void pgraph_vk_bind_shaders(PGRAPHState *pg);
 
 // reports.c
@@ -566,6 +713,9 @@ void pgraph_vk_clear_report_value(NV2AState *d);
 void pgraph_vk_get_report(NV2AState *d, uint32_t parameter);
 void pgraph_vk_process_pending_reports(NV2AState *d);
 void pgraph_vk_process_pending_reports_internal(NV2AState *d);
+void pgraph_vk_write_begin_timestamp(PGRAPHVkState *r);
+void pgraph_vk_write_end_timestamp(PGRAPHVkState *r);
+void pgraph_vk_accumulate_gpu_time(PGRAPHVkState *r);
 
 typedef enum FinishReason {
     VK_FINISH_REASON_VERTEX_BUFFER_DIRTY,
@@ -590,6 +740,7 @@ void pgraph_vk_flush_draw(NV2AState *d);
 void pgraph_vk_begin_command_buffer(PGRAPHState *pg);
 void pgraph_vk_ensure_command_buffer(PGRAPHState *pg);
 void pgraph_vk_ensure_not_in_render_pass(PGRAPHState *pg);
+void pgraph_vk_flush_draw_batch(PGRAPHVkState *r);
 
 VkCommandBuffer pgraph_vk_begin_nondraw_commands(PGRAPHState *pg);
 void pgraph_vk_end_nondraw_commands(PGRAPHState *pg, VkCommandBuffer cmd);
@@ -18,6 +18,42 @@
  */
 
 #include "renderer.h"
+#include "ui/xemu-settings.h"
+
+static void init_timestamps(PGRAPHVkState *r)
+{
+    QueueFamilyIndices indices =
+        pgraph_vk_find_queue_families(r->physical_device);
+
+    uint32_t num_queue_families = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(r->physical_device,
+                                             &num_queue_families, NULL);
+    g_autofree VkQueueFamilyProperties *queue_families =
+        g_malloc_n(num_queue_families, sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(r->physical_device,
+                                             &num_queue_families,
+                                             queue_families);
+
+    uint32_t valid_bits =
+        queue_families[indices.queue_family].timestampValidBits;
+    r->timestamps_supported =
+        valid_bits > 0 && r->device_props.limits.timestampPeriod > 0;
+    if (!r->timestamps_supported) {
+        fprintf(stderr, "Vulkan: Timestamp queries not supported, dynamic "
+                        "surface scaling is disabled\n");
+        return;
+    }
+    r->timestamp_mask =
+        valid_bits >= 64 ? UINT64_MAX : ((uint64_t)1 << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo pool_create_info = (VkQueryPoolCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2,
+    };
+    VK_CHECK(vkCreateQueryPool(r->device, &pool_create_info, NULL,
+                               &r->timestamp_query_pool));
+}
 
 void pgraph_vk_init_reports(PGRAPHState *pg)
 {
@@ -37,6 +73,8 @@ void pgraph_vk_init_reports(PGRAPHState *pg)
     };
     VK_CHECK(
         vkCreateQueryPool(r->device, &pool_create_info, NULL, &r->query_pool));
+
+    init_timestamps(r);
 }
 
 void pgraph_vk_finalize_reports(PGRAPHState *pg)
@@ -50,6 +88,57 @@ void pgraph_vk_finalize_reports(PGRAPHState *pg)
     }
 
     vkDestroyQueryPool(r->device, r->query_pool, NULL);
+
+    if (r->timestamp_query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(r->device, r->timestamp_query_pool, NULL);
+        r->timestamp_query_pool = VK_NULL_HANDLE;
+    }
+}
+
+// Bracket the draw command buffer with timestamps while they are needed
+void pgraph_vk_write_begin_timestamp(PGRAPHVkState *r)
+{
+    if (!r->timestamps_supported ||
+        !g_config.display.quality.dynamic_scale.enable) {
+        return;
+    }
+
+    vkCmdResetQueryPool(r->command_buffer, r->timestamp_query_pool, 0, 2);
+    vkCmdWriteTimestamp(r->command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        r->timestamp_query_pool, 0);
+    r->timestamps_written = true;
+}
+
+void pgraph_vk_write_end_timestamp(PGRAPHVkState *r)
+{
+    if (!r->timestamps_written) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(r->command_buffer,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        r->timestamp_query_pool, 1);
+}
+
+// Called once the command buffer has completed
+void pgraph_vk_accumulate_gpu_time(PGRAPHVkState *r)
+{
+    if (!r->timestamps_written) {
+        return;
+    }
+    r->timestamps_written = false;
+
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(
+        r->device, r->timestamp_query_pool, 0, 2, sizeof(timestamps),
+        timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    uint64_t ticks = (timestamps[1] - timestamps[0]) & r->timestamp_mask;
+    r->dynamic_scale.frame_gpu_ns +=
+        (int64_t)(ticks * (double)r->device_props.limits.timestampPeriod);
 }
 
 void pgraph_vk_clear_report_value(NV2AState *d)
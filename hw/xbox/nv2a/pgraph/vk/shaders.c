@@ -28,6 +28,19 @@
 
 const size_t MAX_UNIFORM_ATTR_VALUES_SIZE = NV2A_VERTEXSHADER_ATTRIBUTES * 4 * sizeof(float);
 
+/*
+ * With VK_KHR_push_descriptor, descriptors are recorded straight into the
+ * command buffer and no descriptor sets are allocated. Push descriptor layouts
+ * cannot contain dynamic buffers, so the uniform buffer offsets are baked into
+ * the pushed descriptors instead.
+ */
+static VkDescriptorType get_ubo_descriptor_type(PGRAPHVkState *r)
+{
+    return r->push_descriptor_extension_enabled ?
+               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER :
+               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+}
+
 static void create_descriptor_pool(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -36,7 +49,7 @@ static void create_descriptor_pool(PGRAPHState *pg)
 
     VkDescriptorPoolSize pool_sizes[] = {
         {
-            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 2 * num_sets,
         },
         {
@@ -69,17 +82,18 @@ static void create_descriptor_set_layout(PGRAPHState *pg)
     PGRAPHVkState *r = pg->vk_renderer_state;
 
     VkDescriptorSetLayoutBinding bindings[2 + NV2A_MAX_TEXTURES];
+    VkDescriptorType ubo_type = get_ubo_descriptor_type(r);
 
     bindings[0] = (VkDescriptorSetLayoutBinding){
         .binding = VSH_UBO_BINDING,
         .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorType = ubo_type,
         .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
     };
     bindings[1] = (VkDescriptorSetLayoutBinding){
         .binding = PSH_UBO_BINDING,
         .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorType = ubo_type,
         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
     };
     for (int i = 0; i < NV2A_MAX_TEXTURES; i++) {
@@ -94,6 +108,9 @@ static void create_descriptor_set_layout(PGRAPHState *pg)
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .bindingCount = ARRAY_SIZE(bindings),
         .pBindings = bindings,
+        .flags = r->push_descriptor_extension_enabled ?
+                     VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR :
+                     0,
     };
     VK_CHECK(vkCreateDescriptorSetLayout(r->device, &layout_info, NULL,
                                          &r->descriptor_set_layout));
@@ -137,6 +154,54 @@ static void destroy_descriptor_sets(PGRAPHState *pg)
     }
 }
 
+static void init_descriptor_writes(PGRAPHState *pg, VkDescriptorSet dst_set,
+                                   VkWriteDescriptorSet *descriptor_writes,
+                                   VkDescriptorBufferInfo *ubo_buffer_infos,
+                                   VkDescriptorImageInfo *image_infos)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    ShaderBinding *binding = r->shader_binding;
+    ShaderUniformLayout *layouts[] = { &binding->vsh.module_info->uniforms,
+                                       &binding->psh.module_info->uniforms };
+
+    for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
+        ubo_buffer_infos[i] = (VkDescriptorBufferInfo){
+            .buffer = r->storage_buffers[BUFFER_UNIFORM].buffer,
+            .offset = r->push_descriptor_extension_enabled ?
+                          r->uniform_buffer_offsets[i] :
+                          0,
+            .range = layouts[i]->total_size,
+        };
+        descriptor_writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = dst_set,
+            .dstBinding = i == 0 ? VSH_UBO_BINDING : PSH_UBO_BINDING,
+            .dstArrayElement = 0,
+            .descriptorType = get_ubo_descriptor_type(r),
+            .descriptorCount = 1,
+            .pBufferInfo = &ubo_buffer_infos[i],
+        };
+    }
+
+    for (int i = 0; i < NV2A_MAX_TEXTURES; i++) {
+        image_infos[i] = (VkDescriptorImageInfo){
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .imageView = r->texture_bindings[i]->image_view,
+            .sampler = r->texture_bindings[i]->sampler,
+        };
+        descriptor_writes[2 + i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = dst_set,
+            .dstBinding = PSH_TEX_BINDING + i,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &image_infos[i],
+        };
+    }
+}
+
 void pgraph_vk_update_descriptor_sets(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -145,8 +210,16 @@ void pgraph_vk_update_descriptor_sets(PGRAPHState *pg)
         r->uniforms_changed ||
         !r->storage_buffers[BUFFER_UNIFORM_STAGING].buffer_offset;
 
-    if (!(r->shader_bindings_changed || r->texture_bindings_changed ||
-          (r->descriptor_set_index == 0) || need_uniform_write)) {
+    /*
+     * Uniform buffers are bound with dynamic offsets, so a uniform-only change
+     * just appends a new snapshot to the staging buffer and the current set
+     * is reused with the new offsets.
+     */
+    bool need_descriptor_write = r->shader_bindings_changed ||
+                                 r->texture_bindings_changed ||
+                                 (r->descriptor_set_index == 0);
+
+    if (!(need_descriptor_write || need_uniform_write)) {
         return; // Nothing changed
     }
 
@@ -158,23 +231,21 @@ void pgraph_vk_update_descriptor_sets(PGRAPHState *pg)
         ubo_buffer_total_size += layouts[i]->total_size;
     }
     bool need_ubo_staging_buffer_reset =
-        r->uniforms_changed &&
+        need_uniform_write &&
         !pgraph_vk_buffer_has_space_for(pg, BUFFER_UNIFORM_STAGING,
                                         ubo_buffer_total_size,
                                         r->device_props.limits.minUniformBufferOffsetAlignment);
 
     bool need_descriptor_write_reset =
+        need_descriptor_write && !r->push_descriptor_extension_enabled &&
         (r->descriptor_set_index >= ARRAY_SIZE(r->descriptor_sets));
 
     if (need_descriptor_write_reset || need_ubo_staging_buffer_reset) {
         pgraph_vk_finish(pg, VK_FINISH_REASON_NEED_BUFFER_SPACE);
         need_uniform_write = true;
+        need_descriptor_write = true;
     }
 
-    VkWriteDescriptorSet descriptor_writes[2 + NV2A_MAX_TEXTURES];
-
-    assert(r->descriptor_set_index < ARRAY_SIZE(r->descriptor_sets));
-
     if (need_uniform_write) {
         for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
             void *data = layouts[i]->allocation;
@@ -187,47 +258,59 @@ void pgraph_vk_update_descriptor_sets(PGRAPHState *pg)
         r->uniforms_changed = false;
     }
 
-    VkDescriptorBufferInfo ubo_buffer_infos[2];
-    for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
-        ubo_buffer_infos[i] = (VkDescriptorBufferInfo){
-            .buffer = r->storage_buffers[BUFFER_UNIFORM].buffer,
-            .offset = r->uniform_buffer_offsets[i],
-            .range = layouts[i]->total_size,
-        };
-        descriptor_writes[i] = (VkWriteDescriptorSet){
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = r->descriptor_sets[r->descriptor_set_index],
-            .dstBinding = i == 0 ? VSH_UBO_BINDING : PSH_UBO_BINDING,
-            .dstArrayElement = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 1,
-            .pBufferInfo = &ubo_buffer_infos[i],
-        };
+    if (r->push_descriptor_extension_enabled) {
+        r->push_descriptors_dirty = true;
+        return;
     }
 
-    VkDescriptorImageInfo image_infos[NV2A_MAX_TEXTURES];
-    for (int i = 0; i < NV2A_MAX_TEXTURES; i++) {
-        image_infos[i] = (VkDescriptorImageInfo){
-            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .imageView = r->texture_bindings[i]->image_view,
-            .sampler = r->texture_bindings[i]->sampler,
-        };
-        descriptor_writes[2 + i] = (VkWriteDescriptorSet){
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = r->descriptor_sets[r->descriptor_set_index],
-            .dstBinding = PSH_TEX_BINDING + i,
-            .dstArrayElement = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = 1,
-            .pImageInfo = &image_infos[i],
-        };
+    if (!need_descriptor_write) {
+        return;
     }
 
-    vkUpdateDescriptorSets(r->device, 6, descriptor_writes, 0, NULL);
+    nv2a_profile_inc_counter(NV2A_PROF_DESCRIPTOR_SET_WRITE);
+
+    assert(r->descriptor_set_index < ARRAY_SIZE(r->descriptor_sets));
+
+    VkWriteDescriptorSet descriptor_writes[2 + NV2A_MAX_TEXTURES];
+    VkDescriptorBufferInfo ubo_buffer_infos[2];
+    VkDescriptorImageInfo image_infos[NV2A_MAX_TEXTURES];
+    init_descriptor_writes(pg, r->descriptor_sets[r->descriptor_set_index],
+                           descriptor_writes, ubo_buffer_infos, image_infos);
+
+    vkUpdateDescriptorSets(r->device, ARRAY_SIZE(descriptor_writes),
+                           descriptor_writes, 0, NULL);
 
     r->descriptor_set_index++;
 }
 
+void pgraph_vk_push_descriptor_set(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    VkPipelineLayout layout = r->pipeline_binding->layout;
+
+    assert(r->push_descriptor_extension_enabled);
+
+    if (!r->push_descriptors_dirty && r->push_descriptor_layout == layout) {
+        return;
+    }
+
+    nv2a_profile_inc_counter(NV2A_PROF_DESCRIPTOR_SET_PUSH);
+
+    VkWriteDescriptorSet descriptor_writes[2 + NV2A_MAX_TEXTURES];
+    VkDescriptorBufferInfo ubo_buffer_infos[2];
+    VkDescriptorImageInfo image_infos[NV2A_MAX_TEXTURES];
+    init_descriptor_writes(pg, VK_NULL_HANDLE, descriptor_writes,
+                           ubo_buffer_infos, image_infos);
+
+    pgraph_vk_flush_draw_batch(r);
+    vkCmdPushDescriptorSetKHR(r->command_buffer,
+                              VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
+                              ARRAY_SIZE(descriptor_writes), descriptor_writes);
+
+    r->push_descriptor_layout = layout;
+    r->push_descriptors_dirty = false;
+}
+
 static void update_shader_uniform_locs(ShaderBinding *binding)
 {
     for (int i = 0; i < ARRAY_SIZE(binding->vsh.uniform_locs); i++) {
@@ -253,6 +336,25 @@ get_and_ref_shader_module_for_key(PGRAPHVkState *r,
     return module->module_info;
 }
 
+/*
+ * Without a geometry shader, line and point fill modes are left to the
+ * rasterizer. If it can't do them either, they are emulated in the fragment
+ * shader when barycentric coordinates are available, otherwise the triangle
+ * is filled.
+ */
+static enum ShaderPolygonMode
+get_polygon_mode_emulation(PGRAPHVkState *r, const GeomState *geom)
+{
+    if (geom->primitive_mode != PRIM_TYPE_TRIANGLES ||
+        geom->polygon_front_mode == POLY_MODE_FILL ||
+        r->enabled_physical_device_features.fillModeNonSolid == VK_TRUE ||
+        !r->fragment_shader_barycentric_extension_enabled) {
+        return POLY_MODE_FILL;
+    }
+
+    return geom->polygon_front_mode;
+}
+
 static void shader_cache_entry_init(Lru *lru, LruNode *node, const void *state)
 {
     PGRAPHVkState *r = container_of(lru, PGRAPHVkState, shader_cache);
@@ -264,7 +366,8 @@ static void shader_cache_entry_init(Lru *lru, LruNode *node, const void *state)
 
     ShaderModuleCacheKey key;
 
-    bool need_geometry_shader = pgraph_glsl_need_geom(&binding->state.geom);
+    bool need_geometry_shader = !r->geometry_shader_free &&
+                                pgraph_glsl_need_geom(&binding->state.geom);
     if (need_geometry_shader) {
         memset(&key, 0, sizeof(key));
         key.kind = VK_SHADER_STAGE_GEOMETRY_BIT;
@@ -280,6 +383,7 @@ static void shader_cache_entry_init(Lru *lru, LruNode *node, const void *state)
     key.vsh.state = binding->state.vsh;
     key.vsh.glsl_opts.vulkan = true;
     key.vsh.glsl_opts.prefix_outputs = need_geometry_shader;
+    key.vsh.glsl_opts.interpolated_pos = r->geometry_shader_free;
     key.vsh.glsl_opts.use_push_constants_for_uniform_attrs =
         r->use_push_constants_for_uniform_attrs;
     key.vsh.glsl_opts.ubo_binding = VSH_UBO_BINDING;
@@ -291,6 +395,14 @@ static void shader_cache_entry_init(Lru *lru, LruNode *node, const void *state)
     key.psh.glsl_opts.vulkan = true;
     key.psh.glsl_opts.ubo_binding = PSH_UBO_BINDING;
     key.psh.glsl_opts.tex_binding = PSH_TEX_BINDING;
+    if (r->geometry_shader_free) {
+        const GeomState *geom = &binding->state.geom;
+        key.psh.glsl_opts.interpolated_pos = true;
+        key.psh.glsl_opts.depth_slope_from_derivatives =
+            geom->primitive_mode == PRIM_TYPE_TRIANGLES;
+        key.psh.glsl_opts.polygon_mode_emulation =
+            get_polygon_mode_emulation(r, geom);
+    }
     binding->psh.module_info = get_and_ref_shader_module_for_key(r, &key);
 
     update_shader_uniform_locs(binding);
@@ -425,19 +537,105 @@ static ShaderBinding *get_shader_binding_for_state(PGRAPHVkState *r,
     return binding;
 }
 
-static void apply_uniform_updates(ShaderUniformLayout *layout,
-                                  const UniformInfo *info, int *locs,
+static bool apply_uniform_updates(ShaderUniformLayout *layout,
+                                  const UniformInfo *info, const int *locs,
                                   void *values, size_t count)
 {
+    bool changed = false;
+
     for (int i = 0; i < count; i++) {
         if (locs[i] != -1) {
-            uniform_copy(layout, locs[i], (char*)values + info[i].val_offs,
-                         4, (info[i].size * info[i].count) / 4);
+            changed |= uniform_update(layout, locs[i], 0,
+                                      (char *)values + info[i].val_offs, 4,
+                                      (info[i].size * info[i].count) / 4);
         }
     }
+
+    return changed;
+}
+
+/*
+ * Copy only the vec4 rows flagged in @dirty into the uniform at @loc, then
+ * clear the flags.
+ */
+static bool apply_dirty_rows(ShaderUniformLayout *layout, int loc,
+                             uint32_t (*rows)[4], bool *dirty, size_t count)
+{
+    bool changed = false;
+
+    for (int i = 0; i < count; i++) {
+        if (!dirty[i]) {
+            continue;
+        }
+        if (loc != -1) {
+            changed |= uniform_update(layout, loc, i, rows[i], 4, 4);
+        }
+        dirty[i] = false;
+    }
+
+    return changed;
+}
+
+static void clear_constant_dirty_flags(PGRAPHState *pg)
+{
+    memset(pg->vsh_constants_dirty, 0, sizeof(pg->vsh_constants_dirty));
+    memset(pg->ltctxa_dirty, 0, sizeof(pg->ltctxa_dirty));
+    memset(pg->ltctxb_dirty, 0, sizeof(pg->ltctxb_dirty));
+    memset(pg->ltc1_dirty, 0, sizeof(pg->ltc1_dirty));
+}
+
+static bool update_vsh_uniforms(PGRAPHState *pg, ShaderBinding *binding,
+                                bool full)
+{
+    ShaderUniformLayout *layout = &binding->vsh.module_info->uniforms;
+    const VshState *state = &binding->state.vsh;
+    VshUniformValues vsh_values;
+
+    if (full) {
+        pgraph_glsl_set_vsh_uniform_values(pg, state, binding->vsh.uniform_locs,
+                                           &vsh_values);
+        apply_uniform_updates(layout, VshUniformInfo,
+                              binding->vsh.uniform_locs, &vsh_values,
+                              VshUniform__COUNT);
+        clear_constant_dirty_flags(pg);
+        return true;
+    }
+
+    /*
+     * The constant arrays make up nearly all of the block and are tracked per
+     * row by the method handlers, so only the rows written since the last
+     * update are copied. Everything else is small enough to just compare.
+     */
+    VshUniformLocs locs;
+    memcpy(locs, binding->vsh.uniform_locs, sizeof(locs));
+    locs[VshUniform_c] = -1;
+    locs[VshUniform_ltctxa] = -1;
+    locs[VshUniform_ltctxb] = -1;
+    locs[VshUniform_ltc1] = -1;
+
+    pgraph_glsl_set_vsh_uniform_values(pg, state, locs, &vsh_values);
+    bool changed = apply_uniform_updates(layout, VshUniformInfo, locs,
+                                         &vsh_values, VshUniform__COUNT);
+
+    const int *all_locs = binding->vsh.uniform_locs;
+    changed |= apply_dirty_rows(layout, all_locs[VshUniform_c],
+                                pg->vsh_constants, pg->vsh_constants_dirty,
+                                NV2A_VERTEXSHADER_CONSTANTS);
+    if (state->is_fixed_function) {
+        changed |= apply_dirty_rows(layout, all_locs[VshUniform_ltctxa],
+                                    pg->ltctxa, pg->ltctxa_dirty,
+                                    NV2A_LTCTXA_COUNT);
+        changed |= apply_dirty_rows(layout, all_locs[VshUniform_ltctxb],
+                                    pg->ltctxb, pg->ltctxb_dirty,
+                                    NV2A_LTCTXB_COUNT);
+        changed |= apply_dirty_rows(layout, all_locs[VshUniform_ltc1],
+                                    pg->ltc1, pg->ltc1_dirty, NV2A_LTC1_COUNT);
+    }
+    clear_constant_dirty_flags(pg);
+
+    return changed;
 }
 
-// FIXME: Dirty tracking
 static void update_shader_uniforms(PGRAPHState *pg)
 {
     NV2A_VK_DGROUP_BEGIN("%s", __func__);
@@ -447,15 +645,15 @@ static void update_shader_uniforms(PGRAPHState *pg)
 
     assert(r->shader_binding);
     ShaderBinding *binding = r->shader_binding;
-    ShaderUniformLayout *layouts[] = { &binding->vsh.module_info->uniforms,
-                                       &binding->psh.module_info->uniforms };
 
-    VshUniformValues vsh_values;
-    pgraph_glsl_set_vsh_uniform_values(pg, &binding->state.vsh,
-                                  binding->vsh.uniform_locs, &vsh_values);
-    apply_uniform_updates(&binding->vsh.module_info->uniforms, VshUniformInfo,
-                          binding->vsh.uniform_locs, &vsh_values,
-                          VshUniform__COUNT);
+    /*
+     * Dirty flags are global while uniform blocks belong to shader modules,
+     * so whenever a different binding becomes current its blocks are rebuilt
+     * from scratch. Otherwise only the ranges written since the last draw are
+     * updated.
+     */
+    bool full = r->shader_bindings_changed;
+    bool changed = update_vsh_uniforms(pg, binding, full);
 
     PshUniformValues psh_values;
     pgraph_glsl_set_psh_uniform_values(pg, binding->psh.uniform_locs,
@@ -474,16 +672,11 @@ static void update_shader_uniforms(PGRAPHState *pg)
 
         psh_values.texScale[i] = scale;
     }
-    apply_uniform_updates(&binding->psh.module_info->uniforms, PshUniformInfo,
-                          binding->psh.uniform_locs, &psh_values,
-                          PshUniform__COUNT);
+    changed |= apply_uniform_updates(&binding->psh.module_info->uniforms,
+                                     PshUniformInfo, binding->psh.uniform_locs,
+                                     &psh_values, PshUniform__COUNT);
 
-    for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
-        uint64_t hash =
-            fast_hash(layouts[i]->allocation, layouts[i]->total_size);
-        r->uniforms_changed |= (hash != r->uniform_buffer_hashes[i]);
-        r->uniform_buffer_hashes[i] = hash;
-    }
+    r->uniforms_changed |= changed;
 
     nv2a_profile_inc_counter(r->uniforms_changed ?
                                  NV2A_PROF_SHADER_UBO_DIRTY :
@@ -522,9 +715,11 @@ void pgraph_vk_init_shaders(PGRAPHState *pg)
     PGRAPHVkState *r = pg->vk_renderer_state;
 
     pgraph_vk_init_glsl_compiler();
-    create_descriptor_pool(pg);
     create_descriptor_set_layout(pg);
-    create_descriptor_sets(pg);
+    if (!r->push_descriptor_extension_enabled) {
+        create_descriptor_pool(pg);
+        create_descriptor_sets(pg);
+    }
     shader_cache_init(pg);
 
     r->use_push_constants_for_uniform_attrs =
@@ -534,9 +729,13 @@ void pgraph_vk_init_shaders(PGRAPHState *pg)
 
 void pgraph_vk_finalize_shaders(PGRAPHState *pg)
 {
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
     shader_cache_finalize(pg);
-    destroy_descriptor_sets(pg);
+    if (!r->push_descriptor_extension_enabled) {
+        destroy_descriptor_sets(pg);
+        destroy_descriptor_pool(pg);
+    }
     destroy_descriptor_set_layout(pg);
-    destroy_descriptor_pool(pg);
     pgraph_vk_finalize_glsl_compiler();
 }
@@ -25,6 +25,7 @@
 
 #include "hw/xbox/nv2a/nv2a_int.h"
 #include "hw/xbox/nv2a/pgraph/swizzle.h"
+#include "qemu/bswap.h"
 #include "qemu/compiler.h"
 #include "ui/xemu-settings.h"
 #include "renderer.h"
@@ -72,10 +73,97 @@ unsigned int pgraph_vk_get_surface_scale_factor(NV2AState *d)
 
 void pgraph_vk_reload_surface_scale_factor(PGRAPHState *pg)
 {
-    int factor = g_config.display.quality.surface_scale;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    int factor = r->dynamic_scale.scale ?
+                     r->dynamic_scale.scale :
+                     g_config.display.quality.surface_scale;
     pg->surface_scale_factor = MAX(factor, 1);
 }
 
+// Frames to let the smoothed frame time settle after a scale change
+#define DYNAMIC_SCALE_SETTLE_FRAMES 30
+// Frames the frame time must stay over/under budget before changing scale
+#define DYNAMIC_SCALE_DOWN_FRAMES 10
+#define DYNAMIC_SCALE_UP_FRAMES 120
+
+static void set_dynamic_scale(NV2AState *d, int scale)
+{
+    PGRAPHVkState *r = d->pgraph.vk_renderer_state;
+
+    r->dynamic_scale.scale = scale;
+    r->dynamic_scale.avg_frame_time = 0;
+    r->dynamic_scale.frames_since_change = 0;
+    r->dynamic_scale.frames_over = 0;
+    r->dynamic_scale.frames_under = 0;
+
+    int factor = scale ? scale : g_config.display.quality.surface_scale;
+    if (MAX(factor, 1) != (int)d->pgraph.surface_scale_factor) {
+        pgraph_vk_surface_rescale(d);
+    }
+}
+
+/*
+ * At the end of each frame, step the surface scale towards the largest one
+ * that keeps the GPU time per frame under the configured target. Called with
+ * the draw command buffer finished.
+ */
+void pgraph_vk_update_dynamic_scale(NV2AState *d)
+{
+    PGRAPHVkState *r = d->pgraph.vk_renderer_state;
+    int64_t frame_ns = r->dynamic_scale.frame_gpu_ns;
+    r->dynamic_scale.frame_gpu_ns = 0;
+
+    if (!g_config.display.quality.dynamic_scale.enable ||
+        !r->timestamps_supported) {
+        if (r->dynamic_scale.scale) {
+            set_dynamic_scale(d, 0);
+        }
+        return;
+    }
+
+    int min_scale = MAX(g_config.display.quality.dynamic_scale.min_scale, 1);
+    int max_scale = MAX(g_config.display.quality.dynamic_scale.max_scale,
+                        min_scale);
+    int scale = r->dynamic_scale.scale ? r->dynamic_scale.scale :
+                                         d->pgraph.surface_scale_factor;
+    int clamped = MAX(min_scale, MIN(scale, max_scale));
+    if (!r->dynamic_scale.scale || clamped != scale) {
+        set_dynamic_scale(d, clamped);
+        return;
+    }
+
+    if (frame_ns <= 0) {
+        return;
+    }
+
+    float frame_time = frame_ns / 1000000.0f;
+    float *avg = &r->dynamic_scale.avg_frame_time;
+    *avg = *avg ? *avg + (frame_time - *avg) * 0.1f : frame_time;
+
+    if (++r->dynamic_scale.frames_since_change < DYNAMIC_SCALE_SETTLE_FRAMES) {
+        return;
+    }
+
+    // Fill cost grows with pixel count, the square of the scale
+    float target = g_config.display.quality.dynamic_scale.target_frame_time;
+    float next_up = (float)((scale + 1) * (scale + 1)) / (scale * scale);
+
+    if (*avg > target * 1.05f && scale > min_scale) {
+        r->dynamic_scale.frames_under = 0;
+        if (++r->dynamic_scale.frames_over >= DYNAMIC_SCALE_DOWN_FRAMES) {
+            set_dynamic_scale(d, scale - 1);
+        }
+    } else if (*avg * next_up < target * 0.85f && scale < max_scale) {
+        r->dynamic_scale.frames_over = 0;
+        if (++r->dynamic_scale.frames_under >= DYNAMIC_SCALE_UP_FRAMES) {
+            set_dynamic_scale(d, scale + 1);
+        }
+    } else {
+        r->dynamic_scale.frames_over = 0;
+        r->dynamic_scale.frames_under = 0;
+    }
+}
+
 // FIXME: Move to common
 static void get_surface_dimensions(PGRAPHState const *pg, unsigned int *width,
                                    unsigned int *height)
@@ -471,6 +559,52 @@ static void download_surface_to_buffer(NV2AState *d, SurfaceBinding *surface,
     }
 }
 
+/*
+ * Write the value of the last full clear to every pixel of a surface that has
+ * not been drawn to since, without touching the GPU. Returns false if guest
+ * memory already held that value.
+ */
+static bool fill_surface_with_clear_value(SurfaceBinding *surface,
+                                          uint8_t *pixels)
+{
+    unsigned int bytes_per_pixel = surface->fmt.bytes_per_pixel;
+    size_t row_bytes = surface->width * bytes_per_pixel;
+    unsigned int pitch = surface->pitch;
+    unsigned int rows = surface->height;
+
+    assert(bytes_per_pixel == 2 || bytes_per_pixel == 4);
+
+    // Every texel is the same, so a swizzled surface is a single run
+    if (surface->swizzle) {
+        row_bytes *= rows;
+        rows = 1;
+    }
+
+    uint8_t value[4];
+    if (bytes_per_pixel == 2) {
+        stw_le_p(value, surface->clear_fill);
+    } else {
+        stl_le_p(value, surface->clear_fill);
+    }
+
+    bool changed = false;
+    for (unsigned int y = 0; y < rows; y++) {
+        uint8_t *row = pixels + y * pitch;
+        size_t x = 0;
+        while (x < row_bytes && !memcmp(row + x, value, bytes_per_pixel)) {
+            x += bytes_per_pixel;
+        }
+        if (x < row_bytes) {
+            changed = true;
+            for (; x < row_bytes; x += bytes_per_pixel) {
+                memcpy(row + x, value, bytes_per_pixel);
+            }
+        }
+    }
+
+    return changed;
+}
+
 static void download_surface(NV2AState *d, SurfaceBinding *surface, bool force)
 {
     if (!(surface->download_pending || force) || !surface->width ||
@@ -480,14 +614,25 @@ static void download_surface(NV2AState *d, SurfaceBinding *surface, bool force)
 
     // FIXME: Respect write enable at last TOU?
 
-    download_surface_to_buffer(d, surface, d->vram_ptr + surface->vram_addr);
+    bool changed = true;
+    uint8_t *pixels = d->vram_ptr + surface->vram_addr;
 
-    memory_region_set_client_dirty(d->vram, surface->vram_addr,
-                                   surface->pitch * surface->height,
-                                   DIRTY_MEMORY_VGA);
-    memory_region_set_client_dirty(d->vram, surface->vram_addr,
-                                   surface->pitch * surface->height,
-                                   DIRTY_MEMORY_NV2A_TEX);
+    if (surface->clear_fill_valid) {
+        changed = fill_surface_with_clear_value(surface, pixels);
+        nv2a_profile_inc_counter(changed ? NV2A_PROF_SURF_DOWNLOAD_FILL :
+                                           NV2A_PROF_SURF_DOWNLOAD_ELIDED);
+    } else {
+        download_surface_to_buffer(d, surface, pixels);
+    }
+
+    if (changed) {
+        memory_region_set_client_dirty(d->vram, surface->vram_addr,
+                                       surface->pitch * surface->height,
+                                       DIRTY_MEMORY_VGA);
+        memory_region_set_client_dirty(d->vram, surface->vram_addr,
+                                       surface->pitch * surface->height,
+                                       DIRTY_MEMORY_NV2A_TEX);
+    }
 
     surface->download_pending = false;
     surface->draw_dirty = false;
@@ -544,6 +689,62 @@ void pgraph_vk_download_dirty_surfaces(NV2AState *d)
     qemu_event_set(&r->dirty_surfaces_download_complete);
 }
 
+/*
+ * Record the rows of a linear surface covered by a CPU write, so the next
+ * upload can skip the rest of the surface. Swizzled surfaces scatter rows
+ * across memory and are always uploaded whole.
+ */
+static void mark_surface_rows_for_upload(SurfaceBinding *surface,
+                                         hwaddr offset, hwaddr len)
+{
+    if (surface->upload_pending && !surface->upload_partial) {
+        return;
+    }
+
+    if (surface->swizzle || !surface->pitch) {
+        surface->upload_pending = true;
+        surface->upload_partial = false;
+        return;
+    }
+
+    if (!surface->upload_pending) {
+        surface->upload_pending = true;
+        surface->upload_partial = true;
+        surface->num_upload_row_ranges = 0;
+    }
+
+    unsigned int first = MIN(offset / surface->pitch, surface->height - 1);
+    unsigned int end =
+        MIN((offset + MAX(len, 1) - 1) / surface->pitch + 1, surface->height);
+
+    for (int i = 0; i < surface->num_upload_row_ranges; i++) {
+        if (first <= surface->upload_row_ranges[i].end &&
+            end >= surface->upload_row_ranges[i].first) {
+            surface->upload_row_ranges[i].first =
+                MIN(surface->upload_row_ranges[i].first, first);
+            surface->upload_row_ranges[i].end =
+                MAX(surface->upload_row_ranges[i].end, end);
+            return;
+        }
+    }
+
+    if (surface->num_upload_row_ranges < SURFACE_UPLOAD_ROW_RANGES_MAX) {
+        int i = surface->num_upload_row_ranges++;
+        surface->upload_row_ranges[i].first = first;
+        surface->upload_row_ranges[i].end = end;
+        return;
+    }
+
+    // Out of ranges, collapse into a single span
+    for (int i = 0; i < surface->num_upload_row_ranges; i++) {
+        first = MIN(first, surface->upload_row_ranges[i].first);
+        end = MAX(end, surface->upload_row_ranges[i].end);
+    }
+    surface->upload_row_ranges[0].first = first;
+    surface->upload_row_ranges[0].end = end;
+    surface->num_upload_row_ranges = 1;
+}
+
 static void surface_access_callback(void *opaque, MemoryRegion *mr, hwaddr addr,
                                     hwaddr len, bool write)
 {
@@ -573,7 +774,10 @@ static void surface_access_callback(void *opaque, MemoryRegion *mr, hwaddr addr,
         }
 
         if (write) {
-            surface->upload_pending = true;
+            hwaddr start = MAX(addr, surface->vram_addr);
+            hwaddr end = MIN(addr + len, surface->vram_addr + surface->size);
+            mark_surface_rows_for_upload(surface, start - surface->vram_addr,
+                                         end - start);
         }
     }
 
@@ -875,6 +1079,64 @@ static void destroy_surface_image(PGRAPHVkState *r, SurfaceBinding *surface)
     surface->allocation_scratch = VK_NULL_HANDLE;
 }
 
+/* Resample a surface image created at old_scale to the current scale */
+static void rescale_surface_image(PGRAPHState *pg, SurfaceBinding *surface,
+                                  unsigned int old_scale)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    SurfaceBinding old;
+    memset(&old, 0, sizeof(old));
+    migrate_surface_image(&old, surface);
+    create_surface_image(pg, surface);
+    set_surface_label(pg, surface);
+
+    unsigned int width = surface->width ? surface->width : 1;
+    unsigned int height = surface->height ? surface->height : 1;
+    unsigned int scaled_width = width, scaled_height = height;
+    pgraph_apply_scaling_factor(pg, &scaled_width, &scaled_height);
+
+    VkImageLayout layout =
+        surface->color ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL :
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
+    pgraph_vk_begin_debug_marker(r, cmd, RGBA_RED, __func__);
+
+    pgraph_vk_transition_image_layout(pg, cmd, old.image,
+                                      surface->host_fmt.vk_format, layout,
+                                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    pgraph_vk_transition_image_layout(pg, cmd, surface->image,
+                                      surface->host_fmt.vk_format, layout,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkImageBlit blit_region = {
+        .srcSubresource.aspectMask = surface->host_fmt.aspect,
+        .srcSubresource.layerCount = 1,
+        .srcOffsets[0] = (VkOffset3D){ 0, 0, 0 },
+        .srcOffsets[1] = (VkOffset3D){ width * old_scale, height * old_scale,
+                                       1 },
+        .dstSubresource.aspectMask = surface->host_fmt.aspect,
+        .dstSubresource.layerCount = 1,
+        .dstOffsets[0] = (VkOffset3D){ 0, 0, 0 },
+        .dstOffsets[1] = (VkOffset3D){ scaled_width, scaled_height, 1 },
+    };
+    vkCmdBlitImage(cmd, old.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   surface->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                   &blit_region,
+                   surface->color ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+
+    pgraph_vk_transition_image_layout(pg, cmd, surface->image,
+                                      surface->host_fmt.vk_format,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                      layout);
+
+    pgraph_vk_end_debug_marker(r, cmd);
+    pgraph_vk_end_single_time_commands(pg, cmd);
+
+    destroy_surface_image(r, &old);
+}
+
 static bool check_invalid_surface_is_compatibile(SurfaceBinding *surface,
                                                  SurfaceBinding *target)
 {
@@ -953,6 +1215,179 @@ void pgraph_vk_surface_download_if_dirty(NV2AState *d, SurfaceBinding *surface)
     }
 }
 
+/*
+ * Upload only the row ranges recorded by mark_surface_rows_for_upload. The
+ * rest of the surface image is known to match guest memory.
+ */
+static void upload_surface_rows(NV2AState *d, SurfaceBinding *surface)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    nv2a_profile_inc_counter(NV2A_PROF_SURF_UPLOAD_ROWS);
+
+    pgraph_vk_finish(pg, VK_FINISH_REASON_SURFACE_CREATE);
+
+    surface->upload_pending = false;
+    surface->upload_partial = false;
+    surface->draw_time = pg->draw_time;
+    surface->cleared = false;
+    surface->clear_fill_valid = false;
+
+    // Upscaling filters across rows, so the rows bordering each range are
+    // loaded into the staging image too and only the range is blitted
+    bool upscale = pg->surface_scale_factor > 1;
+    size_t row_bytes = surface->width * surface->fmt.bytes_per_pixel;
+    int num_ranges = surface->num_upload_row_ranges;
+    VkBufferImageCopy regions[SURFACE_UPLOAD_ROW_RANGES_MAX];
+
+    StorageBuffer *copy_buffer = &r->storage_buffers[BUFFER_STAGING_SRC];
+    void *mapped_memory_ptr = NULL;
+    VK_CHECK(vmaMapMemory(r->allocator, copy_buffer->allocation,
+                          &mapped_memory_ptr));
+
+    VkDeviceSize buffer_offset = 0;
+    for (int i = 0; i < num_ranges; i++) {
+        unsigned int first = surface->upload_row_ranges[i].first;
+        unsigned int end = surface->upload_row_ranges[i].end;
+        if (upscale) {
+            first = first ? first - 1 : 0;
+            end = MIN(end + 1, surface->height);
+        }
+
+        // Depth/stencil copies need 4-byte aligned buffer offsets
+        buffer_offset = ROUND_UP(buffer_offset, 4);
+        assert(buffer_offset + row_bytes * (end - first) <=
+               copy_buffer->buffer_size);
+
+        memcpy_image((uint8_t *)mapped_memory_ptr + buffer_offset,
+                     d->vram_ptr + surface->vram_addr + first * surface->pitch,
+                     row_bytes, surface->pitch, end - first);
+
+        regions[i] = (VkBufferImageCopy){
+            .bufferOffset = buffer_offset,
+            .imageSubresource.aspectMask = surface->host_fmt.aspect,
+            .imageSubresource.layerCount = 1,
+            .imageOffset = (VkOffset3D){ 0, first, 0 },
+            .imageExtent = (VkExtent3D){ surface->width, end - first, 1 },
+        };
+        buffer_offset += row_bytes * (end - first);
+    }
+
+    vmaFlushAllocation(r->allocator, copy_buffer->allocation, 0, VK_WHOLE_SIZE);
+    vmaUnmapMemory(r->allocator, copy_buffer->allocation);
+
+    VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
+    pgraph_vk_begin_debug_marker(r, cmd, RGBA_RED, __func__);
+
+    VkBufferMemoryBarrier host_barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_HOST_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = copy_buffer->buffer,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_HOST_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 1,
+                         &host_barrier, 0, NULL);
+
+    if (surface->image_scratch_current_layout !=
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        pgraph_vk_transition_image_layout(pg, cmd, surface->image_scratch,
+                                          surface->host_fmt.vk_format,
+                                          surface->image_scratch_current_layout,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        surface->image_scratch_current_layout =
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    }
+
+    vkCmdCopyBufferToImage(cmd, copy_buffer->buffer, surface->image_scratch,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, num_ranges,
+                           regions);
+
+    VkBufferMemoryBarrier post_copy_src_buffer_barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = copy_buffer->buffer,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 1,
+                         &post_copy_src_buffer_barrier, 0, NULL);
+
+    pgraph_vk_transition_image_layout(pg, cmd, surface->image_scratch,
+                                      surface->host_fmt.vk_format,
+                                      surface->image_scratch_current_layout,
+                                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    surface->image_scratch_current_layout =
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    pgraph_vk_transition_image_layout(
+        pg, cmd, surface->image, surface->host_fmt.vk_format,
+        surface->color ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL :
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    for (int i = 0; i < num_ranges; i++) {
+        unsigned int first = surface->upload_row_ranges[i].first;
+        unsigned int end = surface->upload_row_ranges[i].end;
+
+        if (upscale) {
+            unsigned int scaled_width = surface->width, scaled_first = first;
+            unsigned int scaled_end_x = 0, scaled_end = end;
+            pgraph_apply_scaling_factor(pg, &scaled_width, &scaled_first);
+            pgraph_apply_scaling_factor(pg, &scaled_end_x, &scaled_end);
+
+            VkImageBlit blit_region = {
+                .srcSubresource.aspectMask = surface->host_fmt.aspect,
+                .srcSubresource.layerCount = 1,
+                .srcOffsets[0] = (VkOffset3D){ 0, first, 0 },
+                .srcOffsets[1] = (VkOffset3D){ surface->width, end, 1 },
+                .dstSubresource.aspectMask = surface->host_fmt.aspect,
+                .dstSubresource.layerCount = 1,
+                .dstOffsets[0] = (VkOffset3D){ 0, scaled_first, 0 },
+                .dstOffsets[1] = (VkOffset3D){ scaled_width, scaled_end, 1 },
+            };
+            vkCmdBlitImage(cmd, surface->image_scratch,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           surface->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &blit_region,
+                           surface->color ? VK_FILTER_LINEAR :
+                                            VK_FILTER_NEAREST);
+        } else {
+            VkImageCopy copy_region = {
+                .srcSubresource.aspectMask = surface->host_fmt.aspect,
+                .srcSubresource.layerCount = 1,
+                .srcOffset = (VkOffset3D){ 0, first, 0 },
+                .dstSubresource.aspectMask = surface->host_fmt.aspect,
+                .dstSubresource.layerCount = 1,
+                .dstOffset = (VkOffset3D){ 0, first, 0 },
+                .extent = (VkExtent3D){ surface->width, end - first, 1 },
+            };
+            vkCmdCopyImage(cmd, surface->image_scratch,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, surface->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &copy_region);
+        }
+    }
+
+    pgraph_vk_transition_image_layout(
+        pg, cmd, surface->image, surface->host_fmt.vk_format,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        surface->color ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL :
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+    nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_2);
+    pgraph_vk_end_debug_marker(r, cmd);
+    pgraph_vk_end_single_time_commands(pg, cmd);
+}
+
 void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
                                    bool force)
 {
@@ -963,6 +1398,15 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
         return;
     }
 
+    // Packed depth-stencil goes through a compute unpack of the whole image
+    if (surface->upload_partial && !force && surface->initialized &&
+        !surface->swizzle && surface->num_upload_row_ranges &&
+        (surface->color ||
+         surface->host_fmt.vk_format == VK_FORMAT_D16_UNORM)) {
+        upload_surface_rows(d, surface);
+        return;
+    }
+
     nv2a_profile_inc_counter(NV2A_PROF_SURF_UPLOAD);
 
     pgraph_vk_finish(pg, VK_FINISH_REASON_SURFACE_CREATE); // FIXME: SURFACE_UP
@@ -974,7 +1418,10 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
                  surface->fmt.bytes_per_pixel);
 
     surface->upload_pending = false;
+    surface->upload_partial = false;
     surface->draw_time = pg->draw_time;
+    surface->cleared = false;
+    surface->clear_fill_valid = false;
 
     if (!surface->width || !surface->height) {
         surface->initialized = true;
@@ -1369,6 +1816,7 @@ static void populate_surface_binding_target_sized(NV2AState *d, bool color,
     target->pitch = surface->pitch;
     target->size = height * MAX(surface->pitch, width * fmt.bytes_per_pixel);
     target->upload_pending = true;
+    target->upload_partial = false;
     target->download_pending = false;
     target->draw_dirty = false;
     target->dma_addr = dma.address;
@@ -1376,6 +1824,7 @@ static void populate_surface_binding_target_sized(NV2AState *d, bool color,
     target->frame_time = pg->frame_time;
     target->draw_time = pg->draw_time;
     target->cleared = false;
+    target->clear_fill_valid = false;
 
     target->initialized = false;
 }
@@ -1515,7 +1964,10 @@ static void update_surface_part(NV2AState *d, bool upload, bool color)
                 pg->surface_binding_dim.height = surface->height;
                 pg->surface_binding_dim.clip_y = surface->shape.clip_y;
                 pg->surface_binding_dim.clip_height = surface->shape.clip_height;
-                surface->upload_pending |= mem_dirty;
+                if (mem_dirty) {
+                    surface->upload_pending = true;
+                    surface->upload_partial = false;
+                }
                 pg->surface_zeta.buffer_dirty |= color;
                 should_create = false;
             } else {
@@ -1753,6 +2205,57 @@ void pgraph_vk_finalize_surfaces(PGRAPHState *pg)
     pgraph_vk_surface_flush(container_of(pg, NV2AState, pgraph));
 }
 
+static bool check_format_blit_supported(PGRAPHVkState *r, VkFormat format)
+{
+    VkFormatFeatureFlags blit =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(r->physical_device, format, &props);
+    return (props.optimalTilingFeatures & blit) == blit;
+}
+
+/*
+ * Move surfaces to a changed scale factor without a full surface flush.
+ * Surfaces that match guest memory are dropped and uploaded again at the new
+ * scale when next used. The bound targets and surfaces holding rendering not
+ * yet written back are resampled on the GPU instead.
+ */
+void pgraph_vk_surface_rescale(NV2AState *d)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    unsigned int old_scale = pg->surface_scale_factor;
+
+    SurfaceBinding *s, *next;
+    QTAILQ_FOREACH_SAFE(s, &r->surfaces, entry, next) {
+        bool bound = (s == r->color_binding || s == r->zeta_binding);
+        if ((bound || s->draw_dirty) &&
+            check_format_blit_supported(r, s->host_fmt.vk_format)) {
+            continue;
+        }
+
+        if (bound) {
+            // Recreate the target at the next draw
+            Surface *pg_surface = s->color ? &pg->surface_color :
+                                             &pg->surface_zeta;
+            pg_surface->draw_dirty = false;
+            memset(&pg->last_surface_shape, 0, sizeof(pg->last_surface_shape));
+            unbind_surface(d, s->color);
+        }
+        pgraph_vk_surface_download_if_dirty(d, s);
+        invalidate_surface(d, s);
+    }
+    prune_invalid_surfaces(r, 0);
+
+    pgraph_vk_reload_surface_scale_factor(pg);
+
+    QTAILQ_FOREACH(s, &r->surfaces, entry) {
+        rescale_surface_image(pg, s, old_scale);
+    }
+    r->framebuffer_dirty = true;
+}
+
 void pgraph_vk_surface_flush(NV2AState *d)
 {
     PGRAPHState *pg = &d->pgraph;
@@ -0,0 +1,717 @@
+/*
+ * Geforce NV2A PGRAPH Vulkan Renderer
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include "ui/xemu-settings.h"
+#include "renderer.h"
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#include <vulkan/vulkan_android.h>
+#endif
+
+/*
+ * Upper bound on each wait of a present. A frame that cannot get a swapchain
+ * image in time is dropped rather than holding up the renderer thread.
+ */
+#define PRESENT_WAIT_TIMEOUT_NS 50000000
+
+static void swapchain_warn(const char *what, VkResult result)
+{
+    fprintf(stderr, "Warning: swapchain: %s failed (%d)\n", what, result);
+#ifdef __ANDROID__
+    __android_log_print(ANDROID_LOG_WARN, "xemu-android",
+                        "swapchain: %s failed (%d)", what, result);
+#endif
+}
+
+static VkPresentModeKHR get_requested_present_mode(void)
+{
+    switch (g_config.display.vulkan.present_mode) {
+    case CONFIG_DISPLAY_VULKAN_PRESENT_MODE_FIFO_RELAXED:
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    case CONFIG_DISPLAY_VULKAN_PRESENT_MODE_MAILBOX:
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    default:
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+}
+
+static bool create_surface(PGRAPHState *pg, void *window)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+    VkResult result = VK_ERROR_EXTENSION_NOT_PRESENT;
+
+#ifdef __ANDROID__
+    if (window == NULL) {
+        return false;
+    }
+
+    /* Platform entry points are not loaded by volk */
+    PFN_vkCreateAndroidSurfaceKHR create_android_surface =
+        (PFN_vkCreateAndroidSurfaceKHR)vkGetInstanceProcAddr(
+            r->instance, "vkCreateAndroidSurfaceKHR");
+    if (r->android_surface_extension_enabled && create_android_surface) {
+        VkAndroidSurfaceCreateInfoKHR create_info = {
+            .sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR,
+            .window = (struct ANativeWindow *)window,
+        };
+        result = create_android_surface(r->instance, &create_info, NULL,
+                                        &sc->surface);
+    }
+#else
+    if (window != NULL) {
+        return false;
+    }
+
+    if (r->headless_surface_extension_enabled) {
+        VkHeadlessSurfaceCreateInfoEXT create_info = {
+            .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+        };
+        result = vkCreateHeadlessSurfaceEXT(r->instance, &create_info, NULL,
+                                            &sc->surface);
+    }
+#endif
+
+    if (result != VK_SUCCESS) {
+        swapchain_warn("surface creation", result);
+        sc->surface = VK_NULL_HANDLE;
+        return false;
+    }
+
+    QueueFamilyIndices indices =
+        pgraph_vk_find_queue_families(r->physical_device);
+    VkBool32 supported = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(r->physical_device,
+                                         indices.queue_family, sc->surface,
+                                         &supported);
+    if (!supported) {
+        swapchain_warn("present queue check", VK_ERROR_INCOMPATIBLE_DISPLAY_KHR);
+        vkDestroySurfaceKHR(r->instance, sc->surface, NULL);
+        sc->surface = VK_NULL_HANDLE;
+        return false;
+    }
+
+    sc->window = window;
+    return true;
+}
+
+static void destroy_surface(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    if (sc->surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(r->instance, sc->surface, NULL);
+        sc->surface = VK_NULL_HANDLE;
+    }
+    sc->window = NULL;
+}
+
+static void destroy_swapchain_images(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    for (uint32_t i = 0; i < sc->num_images; i++) {
+        vkDestroySemaphore(r->device, sc->release_semaphores[i], NULL);
+        sc->release_semaphores[i] = VK_NULL_HANDLE;
+        sc->images[i] = VK_NULL_HANDLE;
+    }
+    sc->num_images = 0;
+}
+
+static void destroy_swapchain(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    if (sc->swapchain == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VK_CHECK(vkQueueWaitIdle(r->queue));
+
+    /* The acquire semaphore may never signal for an image left unpresented */
+    if (sc->image_acquired) {
+        VkSemaphore *semaphore =
+            &sc->frames[sc->frame_index].acquire_semaphore;
+        VkSemaphoreCreateInfo semaphore_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        };
+        vkDestroySemaphore(r->device, *semaphore, NULL);
+        VK_CHECK(vkCreateSemaphore(r->device, &semaphore_info, NULL,
+                                   semaphore));
+        sc->image_acquired = false;
+    }
+
+    destroy_swapchain_images(pg);
+    vkDestroySwapchainKHR(r->device, sc->swapchain, NULL);
+    sc->swapchain = VK_NULL_HANDLE;
+}
+
+static bool choose_surface_format(PGRAPHState *pg, VkSurfaceFormatKHR *out)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    uint32_t num_formats = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(r->physical_device, sc->surface,
+                                         &num_formats, NULL);
+    if (num_formats == 0) {
+        return false;
+    }
+
+    g_autofree VkSurfaceFormatKHR *formats =
+        g_malloc_n(num_formats, sizeof(VkSurfaceFormatKHR));
+    vkGetPhysicalDeviceSurfaceFormatsKHR(r->physical_device, sc->surface,
+                                         &num_formats, formats);
+
+    /* The display image is already gamma encoded, so avoid sRGB formats */
+    for (uint32_t i = 0; i < num_formats; i++) {
+        if ((formats[i].format == VK_FORMAT_R8G8B8A8_UNORM ||
+             formats[i].format == VK_FORMAT_B8G8R8A8_UNORM) &&
+            formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            *out = formats[i];
+            return true;
+        }
+    }
+
+    *out = formats[0];
+    if (out->format == VK_FORMAT_UNDEFINED) {
+        out->format = VK_FORMAT_B8G8R8A8_UNORM;
+    }
+    return true;
+}
+
+static VkPresentModeKHR choose_present_mode(PGRAPHState *pg,
+                                            VkPresentModeKHR requested)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    uint32_t num_modes = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(r->physical_device, sc->surface,
+                                              &num_modes, NULL);
+    g_autofree VkPresentModeKHR *modes =
+        g_malloc_n(MAX(num_modes, 1), sizeof(VkPresentModeKHR));
+    vkGetPhysicalDeviceSurfacePresentModesKHR(r->physical_device, sc->surface,
+                                              &num_modes, modes);
+
+    for (uint32_t i = 0; i < num_modes; i++) {
+        if (modes[i] == requested) {
+            return requested;
+        }
+    }
+
+    /* FIFO is the only mode every implementation must support */
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static VkCompositeAlphaFlagBitsKHR
+choose_composite_alpha(VkCompositeAlphaFlagsKHR supported)
+{
+    static const VkCompositeAlphaFlagBitsKHR preferred[] = {
+        VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+        VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+        VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR,
+        VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR,
+    };
+
+    for (int i = 0; i < ARRAY_SIZE(preferred); i++) {
+        if (supported & preferred[i]) {
+            return preferred[i];
+        }
+    }
+    return VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+}
+
+static bool create_swapchain(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    VkSurfaceCapabilitiesKHR caps;
+    VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+        r->physical_device, sc->surface, &caps);
+    if (result != VK_SUCCESS) {
+        swapchain_warn("surface query", result);
+        return false;
+    }
+
+    VkExtent2D extent = caps.currentExtent;
+    if (extent.width == UINT32_MAX) {
+        /* Surface size follows the swapchain, e.g. headless surfaces */
+        extent.width = r->display.width ? r->display.width : 640;
+        extent.height = r->display.height ? r->display.height : 480;
+        extent.width = MAX(MIN(extent.width, caps.maxImageExtent.width),
+                           caps.minImageExtent.width);
+        extent.height = MAX(MIN(extent.height, caps.maxImageExtent.height),
+                            caps.minImageExtent.height);
+    }
+    if (extent.width == 0 || extent.height == 0) {
+        /* Minimized, try again on a later present */
+        return false;
+    }
+
+    if (!(caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        swapchain_warn("transfer usage check", VK_ERROR_FEATURE_NOT_PRESENT);
+        return false;
+    }
+
+    VkSurfaceFormatKHR surface_format;
+    if (!choose_surface_format(pg, &surface_format)) {
+        swapchain_warn("surface format query", VK_ERROR_FORMAT_NOT_SUPPORTED);
+        return false;
+    }
+
+    VkPresentModeKHR requested = get_requested_present_mode();
+    VkPresentModeKHR present_mode = choose_present_mode(pg, requested);
+
+    uint32_t num_images = MAX(caps.minImageCount + 1,
+                              present_mode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 :
+                                                                            2);
+    if (caps.maxImageCount) {
+        num_images = MIN(num_images, caps.maxImageCount);
+    }
+
+    VkSwapchainKHR old_swapchain = sc->swapchain;
+    VkSwapchainCreateInfoKHR create_info = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = sc->surface,
+        .minImageCount = num_images,
+        .imageFormat = surface_format.format,
+        .imageColorSpace = surface_format.colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        .imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .preTransform = caps.currentTransform,
+        .compositeAlpha = choose_composite_alpha(caps.supportedCompositeAlpha),
+        .presentMode = present_mode,
+        .clipped = VK_TRUE,
+        .oldSwapchain = old_swapchain,
+    };
+
+    VkSwapchainKHR swapchain;
+    result = vkCreateSwapchainKHR(r->device, &create_info, NULL, &swapchain);
+    destroy_swapchain(pg);
+    if (result != VK_SUCCESS) {
+        swapchain_warn("vkCreateSwapchainKHR", result);
+        return false;
+    }
+
+    uint32_t count = 0;
+    vkGetSwapchainImagesKHR(r->device, swapchain, &count, NULL);
+    if (count > SWAPCHAIN_MAX_IMAGES) {
+        swapchain_warn("image count check", VK_ERROR_TOO_MANY_OBJECTS);
+        vkDestroySwapchainKHR(r->device, swapchain, NULL);
+        return false;
+    }
+    VK_CHECK(vkGetSwapchainImagesKHR(r->device, swapchain, &count, sc->images));
+
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        VK_CHECK(vkCreateSemaphore(r->device, &semaphore_info, NULL,
+                                   &sc->release_semaphores[i]));
+    }
+
+    sc->swapchain = swapchain;
+    sc->num_images = count;
+    sc->format = surface_format.format;
+    sc->extent = extent;
+    sc->present_mode = present_mode;
+    sc->requested_present_mode = requested;
+    sc->first_present_id = sc->present_id + 1;
+    sc->needs_recreate = false;
+
+    fprintf(stderr, "Swapchain: %ux%u, %u images, format %d, present mode %d\n",
+            extent.width, extent.height, count, sc->format, present_mode);
+#ifdef __ANDROID__
+    __android_log_print(ANDROID_LOG_INFO, "xemu-android",
+                        "swapchain: %ux%u, %u images, format %d, "
+                        "present mode %d",
+                        extent.width, extent.height, count, sc->format,
+                        present_mode);
+#endif
+
+    return true;
+}
+
+static void lose_surface(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    destroy_swapchain(pg);
+    destroy_surface(pg);
+    qatomic_set(&r->swapchain.active, false);
+}
+
+/* Fit the display image into the swapchain, letterboxed to @aspect_ratio */
+static VkRect2D get_present_rect(PGRAPHVkSwapchainState *sc)
+{
+    VkRect2D rect = { .extent = sc->extent };
+
+    if (sc->aspect_ratio <= 0) {
+        return rect;
+    }
+
+    float screen = (float)sc->extent.width / (float)sc->extent.height;
+    if (screen > sc->aspect_ratio) {
+        rect.extent.width = sc->extent.height * sc->aspect_ratio;
+        rect.offset.x = (sc->extent.width - rect.extent.width) / 2;
+    } else {
+        rect.extent.height = sc->extent.width / sc->aspect_ratio;
+        rect.offset.y = (sc->extent.height - rect.extent.height) / 2;
+    }
+
+    return rect;
+}
+
+static void record_present(PGRAPHState *pg, VkCommandBuffer cmd,
+                           VkImage image, bool have_frame)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+    PGRAPHVkDisplayState *disp = &r->display;
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+    pgraph_vk_begin_debug_marker(r, cmd, RGBA_GREEN, "Present");
+
+    pgraph_vk_transition_image_layout(pg, cmd, image, sc->format,
+                                      VK_IMAGE_LAYOUT_UNDEFINED,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkRect2D rect = get_present_rect(sc);
+    bool fills_image = rect.extent.width == sc->extent.width &&
+                       rect.extent.height == sc->extent.height;
+
+    if (!have_frame || !fills_image) {
+        VkClearColorValue black = { .float32 = { 0, 0, 0, 1 } };
+        VkImageSubresourceRange range = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1,
+        };
+        vkCmdClearColorImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             &black, 1, &range);
+
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                             NULL, 0, NULL);
+    }
+
+    if (have_frame) {
+        pgraph_vk_transition_image_layout(
+            pg, cmd, disp->image, VK_FORMAT_R8G8B8A8_UNORM,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+        /* The display image is stored bottom-up for GL, flip it back */
+        VkImageBlit region = {
+            .srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .srcSubresource.layerCount = 1,
+            .srcOffsets[0] = { 0, disp->height, 0 },
+            .srcOffsets[1] = { disp->width, 0, 1 },
+            .dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .dstSubresource.layerCount = 1,
+            .dstOffsets[0] = { rect.offset.x, rect.offset.y, 0 },
+            .dstOffsets[1] = { rect.offset.x + rect.extent.width,
+                               rect.offset.y + rect.extent.height, 1 },
+        };
+        VkFilter filter =
+            g_config.display.filtering == CONFIG_DISPLAY_FILTERING_LINEAR ?
+                VK_FILTER_LINEAR :
+                VK_FILTER_NEAREST;
+        vkCmdBlitImage(cmd, disp->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                       filter);
+
+        pgraph_vk_transition_image_layout(
+            pg, cmd, disp->image, VK_FORMAT_R8G8B8A8_UNORM,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    pgraph_vk_transition_image_layout(pg, cmd, image, sc->format,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    pgraph_vk_end_debug_marker(r, cmd);
+    VK_CHECK(vkEndCommandBuffer(cmd));
+}
+
+/*
+ * Wait until the previous present reaches the screen or the timeout expires.
+ * This keeps at most one frame queued ahead of the display. The latency recorded runs from queueing
+ * that present until this wait returns, so it is an upper bound.
+ */
+static void wait_for_previous_present(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    uint64_t id = sc->present_id - 1;
+    if (id < sc->first_present_id) {
+        return;
+    }
+
+    int64_t start = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    VkResult result = vkWaitForPresentKHR(r->device, sc->swapchain, id,
+                                          PRESENT_WAIT_TIMEOUT_NS);
+    int64_t end = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+
+    int *counters = g_nv2a_stats.frame_working.counters;
+    qatomic_add(&counters[NV2A_PROF_PRESENT_WAIT_US], (end - start) / 1000);
+    if (result == VK_SUCCESS) {
+        int64_t queued =
+            sc->present_submit_time[id % SWAPCHAIN_FRAMES_IN_FLIGHT];
+        qatomic_add(&counters[NV2A_PROF_PRESENT_LATENCY_US],
+                    (end - queued) / 1000);
+    } else if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        sc->needs_recreate = true;
+    } else if (result == VK_ERROR_SURFACE_LOST_KHR) {
+        lose_surface(pg);
+    }
+}
+
+/*
+ * Wait for the previous present and acquire the image the next present draws
+ * to. Called from the FIFO thread without pg->lock held, so neither wait
+ * blocks other threads that need PGRAPH. Every wait is bounded; if no image
+ * is acquired, the next present is dropped.
+ */
+void pgraph_vk_acquire_present_image(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    if (sc->surface == VK_NULL_HANDLE || sc->image_acquired) {
+        return;
+    }
+
+    if (r->present_wait_extension_enabled && sc->swapchain != VK_NULL_HANDLE) {
+        wait_for_previous_present(pg);
+        if (sc->surface == VK_NULL_HANDLE) {
+            return;
+        }
+    }
+
+    if (sc->swapchain == VK_NULL_HANDLE || sc->needs_recreate ||
+        sc->requested_present_mode != get_requested_present_mode()) {
+        if (!create_swapchain(pg)) {
+            return;
+        }
+    }
+
+    int frame = sc->frame_index;
+    VkResult result = vkWaitForFences(r->device, 1, &sc->frames[frame].fence,
+                                      VK_TRUE, PRESENT_WAIT_TIMEOUT_NS);
+    if (result == VK_TIMEOUT) {
+        return;
+    }
+    VK_CHECK(result);
+
+    result = vkAcquireNextImageKHR(r->device, sc->swapchain,
+                                   PRESENT_WAIT_TIMEOUT_NS,
+                                   sc->frames[frame].acquire_semaphore,
+                                   VK_NULL_HANDLE, &sc->image_index);
+    switch (result) {
+    case VK_SUCCESS:
+        break;
+    case VK_SUBOPTIMAL_KHR:
+        sc->needs_recreate = true;
+        break;
+    case VK_TIMEOUT:
+    case VK_NOT_READY:
+        return;
+    case VK_ERROR_OUT_OF_DATE_KHR:
+        sc->needs_recreate = true;
+        return;
+    case VK_ERROR_SURFACE_LOST_KHR:
+        lose_surface(pg);
+        return;
+    default:
+        swapchain_warn("vkAcquireNextImageKHR", result);
+        return;
+    }
+
+    sc->image_acquired = true;
+}
+
+/* Present the display image to the image acquired beforehand, if any */
+void pgraph_vk_present(PGRAPHState *pg, bool have_frame)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+    int *counters = g_nv2a_stats.frame_working.counters;
+
+    if (sc->surface == VK_NULL_HANDLE) {
+        return;
+    }
+
+    if (!sc->image_acquired) {
+        qatomic_inc(&counters[NV2A_PROF_PRESENT_DROPPED]);
+        return;
+    }
+
+    int frame = sc->frame_index;
+    sc->frame_index = (frame + 1) % SWAPCHAIN_FRAMES_IN_FLIGHT;
+    VkFence fence = sc->frames[frame].fence;
+    VkSemaphore acquire_semaphore = sc->frames[frame].acquire_semaphore;
+    VkCommandBuffer cmd = sc->frames[frame].cmd;
+    uint32_t image_index = sc->image_index;
+    sc->image_acquired = false;
+
+    record_present(pg, cmd, sc->images[image_index], have_frame);
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &acquire_semaphore,
+        .pWaitDstStageMask = &wait_stage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &sc->release_semaphores[image_index],
+    };
+    VK_CHECK(vkResetFences(r->device, 1, &fence));
+    VK_CHECK(vkQueueSubmit(r->queue, 1, &submit_info, fence));
+
+    uint64_t present_id = ++sc->present_id;
+    VkPresentIdKHR present_id_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .swapchainCount = 1,
+        .pPresentIds = &present_id,
+    };
+    VkPresentInfoKHR present_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .pNext = r->present_wait_extension_enabled ? &present_id_info : NULL,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &sc->release_semaphores[image_index],
+        .swapchainCount = 1,
+        .pSwapchains = &sc->swapchain,
+        .pImageIndices = &image_index,
+    };
+    sc->present_submit_time[present_id % SWAPCHAIN_FRAMES_IN_FLIGHT] =
+        qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    VkResult result = vkQueuePresentKHR(r->queue, &present_info);
+    qatomic_inc(&counters[NV2A_PROF_PRESENT]);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        sc->needs_recreate = true;
+    } else if (result == VK_ERROR_SURFACE_LOST_KHR) {
+        lose_surface(pg);
+    } else if (result != VK_SUCCESS) {
+        swapchain_warn("vkQueuePresentKHR", result);
+    }
+}
+
+void pgraph_vk_update_present_window(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    if (!sc->window_changed) {
+        return;
+    }
+    sc->window_changed = false;
+
+    lose_surface(pg);
+    if (create_surface(pg, sc->pending_window)) {
+        qatomic_set(&sc->active, true);
+    }
+}
+
+void pgraph_vk_init_swapchain(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    if (!r->swapchain_extension_enabled) {
+        return;
+    }
+
+    VkCommandBuffer cmds[SWAPCHAIN_FRAMES_IN_FLIGHT];
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = r->command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = ARRAY_SIZE(cmds),
+    };
+    VK_CHECK(vkAllocateCommandBuffers(r->device, &alloc_info, cmds));
+
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    VkFenceCreateInfo fence_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+    for (int i = 0; i < SWAPCHAIN_FRAMES_IN_FLIGHT; i++) {
+        sc->frames[i].cmd = cmds[i];
+        VK_CHECK(vkCreateSemaphore(r->device, &semaphore_info, NULL,
+                                   &sc->frames[i].acquire_semaphore));
+        VK_CHECK(vkCreateFence(r->device, &fence_info, NULL,
+                               &sc->frames[i].fence));
+    }
+
+#ifndef __ANDROID__
+    /* There is no native window to hand over, present to a headless surface */
+    sc->pending_window = NULL;
+    sc->window_changed = true;
+#endif
+}
+
+void pgraph_vk_finalize_swapchain(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkSwapchainState *sc = &r->swapchain;
+
+    if (!r->swapchain_extension_enabled) {
+        return;
+    }
+
+    VK_CHECK(vkQueueWaitIdle(r->queue));
+    lose_surface(pg);
+
+    for (int i = 0; i < SWAPCHAIN_FRAMES_IN_FLIGHT; i++) {
+        vkFreeCommandBuffers(r->device, r->command_pool, 1,
+                             &sc->frames[i].cmd);
+        vkDestroySemaphore(r->device, sc->frames[i].acquire_semaphore, NULL);
+        vkDestroyFence(r->device, sc->frames[i].fence, NULL);
+        sc->frames[i].cmd = VK_NULL_HANDLE;
+        sc->frames[i].acquire_semaphore = VK_NULL_HANDLE;
+        sc->frames[i].fence = VK_NULL_HANDLE;
+    }
+}
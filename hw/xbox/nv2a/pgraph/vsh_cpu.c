@@ -0,0 +1,404 @@
+/*
+ * QEMU Geforce NV2A vertex program CPU emulation
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Vertex state programs (XVSS) are run on the CPU when the guest issues
+ * NV097_LAUNCH_TRANSFORM_PROGRAM, typically to compute transform constants.
+ *
+ * Programs are decoded once into VshCpuInstruction and cached until the
+ * program memory changes. Execution follows the semantics of the GLSL
+ * translation in glsl/vsh-prog.c. All register math is written as 4-lane
+ * loops over plain float arrays, which compilers turn into SSE/NEON code
+ * without needing per-architecture intrinsics.
+ */
+
+#include "qemu/osdep.h"
+#include <math.h>
+#include "vsh_cpu.h"
+
+#define VSH_CPU_NUM_TEMPS 16
+#define VSH_CPU_NUM_OUTPUTS 16
+#define VSH_CPU_OUTPUT_POS 0
+#define VSH_CPU_TEMP_POS 12 /* R12 aliases oPos */
+
+typedef struct VshCpuState {
+    float r[VSH_CPU_NUM_TEMPS][4];
+    float o[VSH_CPU_NUM_OUTPUTS][4];
+    float v0[4];
+    int a0;
+} VshCpuState;
+
+/* Converts the C register address to a 0..191 constant index */
+static int16_t convert_c_register(int16_t c_reg)
+{
+    int16_t r = ((((c_reg >> 5) & 7) - 3) * 32) + (c_reg & 31);
+    return r + VSH_D3DSCM_CORRECTION;
+}
+
+static void decode_input(VshCpuInput *in, const uint32_t *token,
+                         VshFieldName neg_field, VshFieldName mux_field,
+                         uint8_t r)
+{
+    in->mux = vsh_get_field(token, mux_field);
+    in->neg = vsh_get_field(token, neg_field);
+    in->r = r;
+    for (int i = 0; i < 4; i++) {
+        in->swizzle[i] = vsh_get_field(token, neg_field + 1 + i);
+    }
+}
+
+static void decode_instruction(VshCpuInstruction *insn, const uint32_t *token)
+{
+    insn->mac = vsh_get_field(token, FLD_MAC);
+    insn->ilu = vsh_get_field(token, FLD_ILU);
+    if (insn->mac > MAC_ARL) {
+        insn->mac = MAC_NOP;
+    }
+
+    decode_input(&insn->in[0], token, FLD_A_NEG, FLD_A_MUX,
+                 vsh_get_field(token, FLD_A_R));
+    decode_input(&insn->in[1], token, FLD_B_NEG, FLD_B_MUX,
+                 vsh_get_field(token, FLD_B_R));
+    decode_input(&insn->in[2], token, FLD_C_NEG, FLD_C_MUX,
+                 (vsh_get_field(token, FLD_C_R_HIGH) << 2) |
+                     vsh_get_field(token, FLD_C_R_LOW));
+    insn->v = vsh_get_field(token, FLD_V);
+    insn->c = convert_c_register(vsh_get_field(token, FLD_CONST));
+    insn->a0x = vsh_get_field(token, FLD_A0X);
+
+    bool paired = insn->mac != MAC_NOP && insn->ilu != ILU_NOP;
+    uint8_t out_r = vsh_get_field(token, FLD_OUT_R);
+
+    /* Paired MAC opcodes that write to R1 are ignored */
+    insn->mac_r = out_r;
+    insn->mac_mask = (insn->mac == MAC_NOP || insn->mac == MAC_ARL ||
+                      (paired && out_r == 1)) ?
+                         0 :
+                         vsh_get_field(token, FLD_OUT_MAC_MASK);
+
+    /* Paired ILU opcodes can only write to R1 */
+    insn->ilu_r = paired ? 1 : out_r;
+    insn->ilu_mask = insn->ilu == ILU_NOP ?
+                         0 :
+                         vsh_get_field(token, FLD_OUT_ILU_MASK);
+
+    insn->out_ilu = vsh_get_field(token, FLD_OUT_MUX) == OMUX_ILU;
+    insn->out_c = vsh_get_field(token, FLD_OUT_ORB) == OUTPUT_C;
+    insn->out_address = vsh_get_field(token, FLD_OUT_ADDRESS);
+    if (insn->out_c) {
+        insn->out_address = convert_c_register(insn->out_address);
+    } else {
+        insn->out_address &= 0xF;
+    }
+    bool out_unit_active = insn->out_ilu ? insn->ilu != ILU_NOP :
+                                           (insn->mac != MAC_NOP &&
+                                            insn->mac != MAC_ARL);
+    insn->out_mask =
+        out_unit_active ? vsh_get_field(token, FLD_OUT_O_MASK) : 0;
+}
+
+void vsh_cpu_decode_program(VshCpuProgram *program, const uint32_t *tokens,
+                            unsigned int max_length)
+{
+    assert(max_length <= NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
+
+    program->length = 0;
+    for (unsigned int slot = 0; slot < max_length; slot++) {
+        const uint32_t *token = &tokens[slot * VSH_TOKEN_SIZE];
+        decode_instruction(&program->insns[slot], token);
+        program->length = slot + 1;
+        if (vsh_get_field(token, FLD_FINAL)) {
+            break;
+        }
+    }
+}
+
+const VshCpuProgram *vsh_cpu_get_program(VshCpuProgramCache *cache,
+                                         const uint32_t *tokens,
+                                         unsigned int start,
+                                         unsigned int max_length,
+                                         uint32_t generation)
+{
+    assert(start < max_length);
+
+    for (int i = 0; i < VSH_CPU_CACHE_SIZE; i++) {
+        if (cache->entries[i].valid && cache->entries[i].start == start &&
+            cache->entries[i].generation == generation) {
+            return &cache->entries[i].program;
+        }
+    }
+
+    unsigned int i = cache->next;
+    cache->next = (cache->next + 1) % VSH_CPU_CACHE_SIZE;
+
+    vsh_cpu_decode_program(&cache->entries[i].program,
+                           &tokens[start * VSH_TOKEN_SIZE],
+                           max_length - start);
+    cache->entries[i].start = start;
+    cache->entries[i].generation = generation;
+    cache->entries[i].valid = true;
+
+    return &cache->entries[i].program;
+}
+
+static float *temp_reg(VshCpuState *s, unsigned int r)
+{
+    return r == VSH_CPU_TEMP_POS ? s->o[VSH_CPU_OUTPUT_POS] : s->r[r];
+}
+
+static void fetch_input(VshCpuState *s, const VshCpuInstruction *insn,
+                        const VshCpuInput *in, uint32_t constants[][4],
+                        float out[4])
+{
+    float src[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    switch (in->mux) {
+    case PARAM_R:
+        memcpy(src, temp_reg(s, in->r), sizeof(src));
+        break;
+    case PARAM_V:
+        /* Vertex state programs only have v0 */
+        if (insn->v == 0) {
+            memcpy(src, s->v0, sizeof(src));
+        }
+        break;
+    case PARAM_C: {
+        int index = insn->c + (insn->a0x ? s->a0 : 0);
+        if (index >= 0 && index < NV2A_VERTEXSHADER_CONSTANTS) {
+            memcpy(src, constants[index], sizeof(src));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        out[i] = in->neg ? -src[in->swizzle[i]] : src[in->swizzle[i]];
+    }
+}
+
+static void write_masked(float *dst, const float src[4], uint8_t mask)
+{
+    for (int i = 0; i < 4; i++) {
+        dst[i] = (mask & (8 >> i)) ? src[i] : dst[i];
+    }
+}
+
+static void splat(float out[4], float v)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = v;
+    }
+}
+
+/* Anything multiplied by zero is zero, including inf and NaN */
+static void mul(float out[4], const float a[4], const float b[4])
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = (a[i] == 0.0f || b[i] == 0.0f) ? 0.0f : a[i] * b[i];
+    }
+}
+
+static float clamp_away_zero_inf(float t)
+{
+    uint32_t bits;
+    memcpy(&bits, &t, sizeof(bits));
+    if (t > 0.0f || bits == 0) {
+        return fminf(fmaxf(t, 0x1p-64f), 0x1p64f);
+    }
+    return fminf(fmaxf(t, -0x1p64f), -0x1p-64f);
+}
+
+static void exec_mac(VshCpuState *s, uint8_t op, const float in[3][4],
+                     float out[4])
+{
+    const float *a = in[0], *b = in[1], *c = in[2];
+
+    switch (op) {
+    case MAC_MOV:
+        memcpy(out, a, sizeof(float[4]));
+        break;
+    case MAC_MUL:
+        mul(out, a, b);
+        break;
+    case MAC_ADD:
+        for (int i = 0; i < 4; i++) {
+            out[i] = a[i] + c[i];
+        }
+        break;
+    case MAC_MAD:
+        mul(out, a, b);
+        for (int i = 0; i < 4; i++) {
+            out[i] += c[i];
+        }
+        break;
+    case MAC_DP3:
+        splat(out, a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
+        break;
+    case MAC_DPH:
+        splat(out, a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + b[3]);
+        break;
+    case MAC_DP4:
+        splat(out, a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]);
+        break;
+    case MAC_DST:
+        out[0] = 1.0f;
+        out[1] = a[1] * b[1];
+        out[2] = a[2];
+        out[3] = b[3];
+        break;
+    case MAC_MIN:
+        for (int i = 0; i < 4; i++) {
+            out[i] = b[i] < a[i] ? b[i] : a[i];
+        }
+        break;
+    case MAC_MAX:
+        for (int i = 0; i < 4; i++) {
+            out[i] = a[i] < b[i] ? b[i] : a[i];
+        }
+        break;
+    case MAC_SLT:
+        for (int i = 0; i < 4; i++) {
+            out[i] = a[i] < b[i] ? 1.0f : 0.0f;
+        }
+        break;
+    case MAC_SGE:
+        for (int i = 0; i < 4; i++) {
+            out[i] = a[i] >= b[i] ? 1.0f : 0.0f;
+        }
+        break;
+    case MAC_ARL:
+        /* Biased like the GLSL translation, see _ARL */
+        s->a0 = (int)floorf(a[0] + 0.001f);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Input C is shared with the MAC and keeps its full swizzle. Scalar ops use
+ * the first swizzled component.
+ */
+static void exec_ilu(uint8_t op, const float c[4], float out[4])
+{
+    float x = c[0];
+
+    switch (op) {
+    case ILU_MOV:
+        memcpy(out, c, sizeof(float[4]));
+        break;
+    case ILU_RCP:
+        splat(out, 1.0f / x);
+        break;
+    case ILU_RCC:
+        splat(out, clamp_away_zero_inf(1.0f / x));
+        break;
+    case ILU_RSQ:
+        if (x == 0.0f) {
+            splat(out, INFINITY);
+        } else if (isinf(x)) {
+            splat(out, 0.0f);
+        } else {
+            splat(out, 1.0f / sqrtf(fabsf(x)));
+        }
+        break;
+    case ILU_EXP:
+        out[0] = exp2f(floorf(x));
+        out[1] = x - floorf(x);
+        out[2] = exp2f(x);
+        out[3] = 1.0f;
+        break;
+    case ILU_LOG: {
+        float t = fabsf(x);
+        if (t == 0.0f) {
+            out[0] = -INFINITY;
+            out[1] = 1.0f;
+            out[2] = -INFINITY;
+            out[3] = 1.0f;
+        } else {
+            out[0] = floorf(log2f(t));
+            out[1] = t / exp2f(floorf(log2f(t)));
+            out[2] = log2f(t);
+            out[3] = 1.0f;
+        }
+        break;
+    }
+    case ILU_LIT: {
+        const float epsilon = 1.0f / 256.0f;
+        float sx = fmaxf(c[0], 0.0f);
+        float sy = fmaxf(c[1], 0.0f);
+        float sw = fminf(fmaxf(c[3], -(128.0f - epsilon)), 128.0f - epsilon);
+        out[0] = 1.0f;
+        out[1] = sx;
+        out[2] = sx > 0.0f ? exp2f(sw * log2f(sy)) : 0.0f;
+        out[3] = 1.0f;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void vsh_cpu_execute_xvss(const VshCpuProgram *program, const uint32_t v0[4],
+                          uint32_t constants[][4], bool *constants_dirty)
+{
+    VshCpuState s;
+    memset(&s, 0, sizeof(s));
+    memcpy(s.v0, v0, sizeof(s.v0));
+
+    for (unsigned int slot = 0; slot < program->length; slot++) {
+        const VshCpuInstruction *insn = &program->insns[slot];
+
+        /* Paired MAC and ILU ops read their inputs before either writes */
+        float in[3][4];
+        for (int i = 0; i < 3; i++) {
+            fetch_input(&s, insn, &insn->in[i], constants, in[i]);
+        }
+
+        float mac_out[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float ilu_out[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        exec_mac(&s, insn->mac, in, mac_out);
+        exec_ilu(insn->ilu, in[2], ilu_out);
+
+        if (insn->out_mask) {
+            const float *src = insn->out_ilu ? ilu_out : mac_out;
+            if (insn->out_c) {
+                int index = insn->out_address;
+                if (index >= 0 && index < NV2A_VERTEXSHADER_CONSTANTS) {
+                    float row[4];
+                    memcpy(row, constants[index], sizeof(row));
+                    write_masked(row, src, insn->out_mask);
+                    memcpy(constants[index], row, sizeof(row));
+                    constants_dirty[index] = true;
+                }
+            } else {
+                write_masked(s.o[insn->out_address], src, insn->out_mask);
+            }
+        }
+
+        if (insn->ilu_mask) {
+            write_masked(temp_reg(&s, insn->ilu_r), ilu_out, insn->ilu_mask);
+        }
+        if (insn->mac_mask) {
+            write_masked(temp_reg(&s, insn->mac_r), mac_out, insn->mac_mask);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * QEMU Geforce NV2A vertex program CPU emulation
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_XBOX_NV2A_PGRAPH_VSH_CPU_H
+#define HW_XBOX_NV2A_PGRAPH_VSH_CPU_H
+
+#include "qemu/osdep.h"
+#include "hw/xbox/nv2a/nv2a_regs.h"
+#include "vsh_regs.h"
+
+#define VSH_CPU_CACHE_SIZE 4
+
+typedef struct VshCpuInput {
+    uint8_t mux; /* VshParameterType */
+    bool neg;
+    uint8_t r;
+    uint8_t swizzle[4];
+} VshCpuInput;
+
+/* A vertex program instruction, decoded once from its microcode token */
+typedef struct VshCpuInstruction {
+    uint8_t mac; /* VshMAC */
+    uint8_t ilu; /* VshILU */
+    VshCpuInput in[3]; /* A, B, C */
+    uint8_t v;
+    int16_t c;
+    bool a0x;
+
+    uint8_t mac_r;
+    uint8_t mac_mask;
+    uint8_t ilu_r;
+    uint8_t ilu_mask;
+
+    uint8_t out_mask; /* 0 if nothing is written to an output or constant */
+    bool out_ilu;
+    bool out_c;
+    int16_t out_address;
+} VshCpuInstruction;
+
+typedef struct VshCpuProgram {
+    VshCpuInstruction insns[NV2A_MAX_TRANSFORM_PROGRAM_LENGTH];
+    unsigned int length;
+} VshCpuProgram;
+
+/*
+ * Decoded programs, keyed by start slot and the program_data generation they
+ * were decoded from.
+ */
+typedef struct VshCpuProgramCache {
+    struct {
+        VshCpuProgram program;
+        unsigned int start;
+        uint32_t generation;
+        bool valid;
+    } entries[VSH_CPU_CACHE_SIZE];
+    unsigned int next;
+} VshCpuProgramCache;
+
+void vsh_cpu_decode_program(VshCpuProgram *program, const uint32_t *tokens,
+                            unsigned int max_length);
+
+const VshCpuProgram *vsh_cpu_get_program(VshCpuProgramCache *cache,
+                                         const uint32_t *tokens,
+                                         unsigned int start,
+                                         unsigned int max_length,
+                                         uint32_t generation);
+
+/*
+ * Run a vertex state program (XVSS) with v0 as its only input. Constants
+ * written by the program are updated in place and flagged in
+ * @constants_dirty.
+ */
+void vsh_cpu_execute_xvss(const VshCpuProgram *program, const uint32_t v0[4],
+                          uint32_t constants[][4], bool *constants_dirty);
+
+#endif
@@ -29,11 +29,20 @@ uint64_t user_read(void *opaque, hwaddr addr, unsigned int size)
     unsigned int channel_id = addr >> 16;
     assert(channel_id < NV2A_NUM_CHANNELS);
 
+    uint64_t r = 0;
+
+    /* Polling GET/REF of the current channel doesn't need pfifo.lock */
+    uint32_t poll_generation = nv2a_poll_begin(d);
+    if (pfifo_read_user_shadow_reg(d, channel_id, addr & 0xFFFF, &r)) {
+        nv2a_poll_check(d, NV_USER, addr, r, poll_generation);
+        nv2a_reg_log_read(NV_USER, addr, size, r);
+        return r;
+    }
+
     qemu_mutex_lock(&d->pfifo.lock);
 
     uint32_t channel_modes = d->pfifo.regs[NV_PFIFO_MODE];
 
-    uint64_t r = 0;
     if (channel_modes & (1 << channel_id)) {
         /* DMA Mode */
 
@@ -95,6 +104,7 @@ void user_write(void *opaque, hwaddr addr, uint64_t val, unsigned int size)
                 break;
             case NV_USER_DMA_GET:
                 d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET] = val;
+                pfifo_invalidate_method_queue(d);
                 break;
             case NV_USER_REF:
                 d->pfifo.regs[NV_PFIFO_CACHE1_REF] = val;
@@ -104,6 +114,7 @@ void user_write(void *opaque, hwaddr addr, uint64_t val, unsigned int size)
                 break;
             }
 
+            pfifo_update_shadow_regs(d);
             pfifo_kick(d);
 
         } else {
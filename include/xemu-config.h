@@ -11,6 +11,35 @@ typedef enum CONFIG_DISPLAY_RENDERER {
     CONFIG_DISPLAY_RENDERER__COUNT,
 } CONFIG_DISPLAY_RENDERER;
 
+typedef enum CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER {
+    CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER_AUTO = 0,
+    CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER_ENABLED,
+    CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER_DISABLED,
+    CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER__COUNT,
+} CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER;
+
+typedef enum CONFIG_DISPLAY_VULKAN_PRESENT_MODE {
+    CONFIG_DISPLAY_VULKAN_PRESENT_MODE_FIFO = 0,
+    CONFIG_DISPLAY_VULKAN_PRESENT_MODE_FIFO_RELAXED,
+    CONFIG_DISPLAY_VULKAN_PRESENT_MODE_MAILBOX,
+    CONFIG_DISPLAY_VULKAN_PRESENT_MODE__COUNT,
+} CONFIG_DISPLAY_VULKAN_PRESENT_MODE;
+
+typedef enum CONFIG_DISPLAY_QUALITY_UPSCALER {
+    CONFIG_DISPLAY_QUALITY_UPSCALER_OFF = 0,
+    CONFIG_DISPLAY_QUALITY_UPSCALER_SHARPEN,
+    CONFIG_DISPLAY_QUALITY_UPSCALER_EDGE_ADAPTIVE,
+    CONFIG_DISPLAY_QUALITY_UPSCALER__COUNT,
+} CONFIG_DISPLAY_QUALITY_UPSCALER;
+
+typedef enum CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER {
+    CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER_GLOBAL = 0,
+    CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER_OFF,
+    CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER_SHARPEN,
+    CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER_EDGE_ADAPTIVE,
+    CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER__COUNT,
+} CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER;
+
 typedef enum CONFIG_DISPLAY_FILTERING {
     CONFIG_DISPLAY_FILTERING_LINEAR = 0,
     CONFIG_DISPLAY_FILTERING_NEAREST,
@@ -32,6 +61,13 @@ typedef enum CONFIG_DISPLAY_WINDOW_STARTUP_SIZE {
     CONFIG_DISPLAY_WINDOW_STARTUP_SIZE__COUNT,
 } CONFIG_DISPLAY_WINDOW_STARTUP_SIZE;
 
+typedef enum CONFIG_DISPLAY_WINDOW_FRAME_PACING {
+    CONFIG_DISPLAY_WINDOW_FRAME_PACING_VSYNC = 0,
+    CONFIG_DISPLAY_WINDOW_FRAME_PACING_MAILBOX,
+    CONFIG_DISPLAY_WINDOW_FRAME_PACING_HALVE,
+    CONFIG_DISPLAY_WINDOW_FRAME_PACING__COUNT,
+} CONFIG_DISPLAY_WINDOW_FRAME_PACING;
+
 typedef enum CONFIG_DISPLAY_UI_FIT {
     CONFIG_DISPLAY_UI_FIT_CENTER = 0,
     CONFIG_DISPLAY_UI_FIT_SCALE,
@@ -208,9 +244,28 @@ struct config {
             bool debug_shaders;
             bool assert_on_validation_msg;
             const char *preferred_physical_device;
+            CONFIG_DISPLAY_VULKAN_GEOMETRY_SHADER geometry_shader;
+            bool native_present;
+            CONFIG_DISPLAY_VULKAN_PRESENT_MODE present_mode;
         } vulkan;
         struct {
             int surface_scale;
+            CONFIG_DISPLAY_QUALITY_UPSCALER upscaler;
+            int upscale_factor;
+            float sharpness;
+            struct title_override {
+                const char *title_id;
+                CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER upscaler;
+                int upscale_factor;
+                float sharpness;
+            } *title_overrides;
+            unsigned int title_overrides_count;
+            struct {
+                bool enable;
+                int min_scale;
+                int max_scale;
+                float target_frame_time;
+            } dynamic_scale;
         } quality;
         CONFIG_DISPLAY_FILTERING filtering;
         struct window {
@@ -220,6 +275,7 @@ struct config {
             int last_width;
             int last_height;
             bool vsync;
+            CONFIG_DISPLAY_WINDOW_FRAME_PACING frame_pacing;
         } window;
         struct ui {
             bool show_menubar;
@@ -288,6 +344,9 @@ struct config {
     struct perf {
         bool hard_fpu;
         bool cache_shaders;
+        bool async_shader_compile;
+        bool pipeline_fifo;
+        bool yield_on_gpu_wait;
     } perf;
 };
 
@@ -0,0 +1,189 @@
+/*
+ * Benchmark NV2A vertex data method handling.
+ *
+ * Compares per-word dispatch, as done by pgraph_method_non_inc, against the
+ * bulk kernels used by the NV097_INLINE_ARRAY, NV097_ARRAY_ELEMENT* and
+ * NV097_SET_VERTEX_DATA* handlers, over synthetic method streams. The output
+ * of both paths is cross-checked.
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include "hw/xbox/nv2a/pgraph/vertex_data.h"
+
+#define STREAM_WORDS (1 << 16)
+#define ITERATIONS 256
+
+typedef struct BenchState {
+    uint32_t *out;
+    size_t out_len;
+    float (*attrs)[4];
+    size_t attrs_len;
+} BenchState;
+
+typedef void (*WordHandler)(BenchState *s, uint32_t parameter);
+
+static void inline_array_word(BenchState *s, uint32_t parameter)
+{
+    s->out[s->out_len++] = parameter;
+}
+
+static void array_element16_word(BenchState *s, uint32_t parameter)
+{
+    s->out[s->out_len++] = parameter & 0xFFFF;
+    s->out[s->out_len++] = parameter >> 16;
+}
+
+static void vertex_data4ub_word(BenchState *s, uint32_t parameter)
+{
+    float *v = s->attrs[s->attrs_len++];
+    v[0] = (parameter & 0xFF) / 255.0;
+    v[1] = ((parameter >> 8) & 0xFF) / 255.0;
+    v[2] = ((parameter >> 16) & 0xFF) / 255.0;
+    v[3] = ((parameter >> 24) & 0xFF) / 255.0;
+}
+
+static void vertex_data2s_word(BenchState *s, uint32_t parameter)
+{
+    float *v = s->attrs[s->attrs_len++];
+    v[0] = (float)(int16_t)(parameter & 0xFFFF);
+    v[1] = (float)(int16_t)(parameter >> 16);
+    v[2] = 0.0;
+    v[3] = 1.0;
+}
+
+static void __attribute__((noinline))
+run_per_word(BenchState *s, WordHandler handler, const uint32_t *words,
+             size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        handler(s, ldl_le_p(words + i));
+    }
+}
+
+static void __attribute__((noinline))
+run_bulk(BenchState *s, WordHandler handler, const uint32_t *words,
+         size_t count)
+{
+    if (handler == inline_array_word) {
+        pgraph_copy_words_le(&s->out[s->out_len], words, count);
+        s->out_len += count;
+    } else if (handler == array_element16_word) {
+        pgraph_unpack_index16_pairs(&s->out[s->out_len], words, count);
+        s->out_len += count * 2;
+    } else if (handler == vertex_data4ub_word) {
+        pgraph_unpack_4ub_unorm_run(s->attrs[s->attrs_len], words, count);
+        s->attrs_len += count;
+    } else if (handler == vertex_data2s_word) {
+        /* As pgraph_append_inline_buffer_vertices repeats the current value */
+        for (size_t i = 0; i < count; i++) {
+            float *v = s->attrs[s->attrs_len + i];
+            v[2] = 0.0;
+            v[3] = 1.0;
+        }
+        pgraph_unpack_2s_run(s->attrs[s->attrs_len], words, count);
+        s->attrs_len += count;
+    } else {
+        g_assert_not_reached();
+    }
+}
+
+static const struct {
+    const char *name;
+    WordHandler handler;
+} methods[] = {
+    { "INLINE_ARRAY", inline_array_word },
+    { "ARRAY_ELEMENT16", array_element16_word },
+    { "SET_VERTEX_DATA4UB", vertex_data4ub_word },
+    { "SET_VERTEX_DATA2S", vertex_data2s_word },
+};
+
+static void bench_state_init(BenchState *s)
+{
+    s->out = g_new(uint32_t, STREAM_WORDS * 2);
+    s->attrs = g_new(float[4], STREAM_WORDS);
+}
+
+static void bench_state_reset(BenchState *s)
+{
+    s->out_len = 0;
+    s->attrs_len = 0;
+}
+
+static void bench_state_free(BenchState *s)
+{
+    g_free(s->out);
+    g_free(s->attrs);
+}
+
+static int64_t time_method(BenchState *s, WordHandler handler, bool bulk,
+                           const uint32_t *words)
+{
+    int64_t start_ns = get_clock();
+    for (int i = 0; i < ITERATIONS; i++) {
+        bench_state_reset(s);
+        if (bulk) {
+            run_bulk(s, handler, words, STREAM_WORDS);
+        } else {
+            run_per_word(s, handler, words, STREAM_WORDS);
+        }
+    }
+    return get_clock() - start_ns;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t *words = g_new(uint32_t, STREAM_WORDS);
+    for (size_t i = 0; i < STREAM_WORDS; i++) {
+        stl_le_p(&words[i], g_random_int());
+    }
+
+    BenchState ref, test;
+    bench_state_init(&ref);
+    bench_state_init(&test);
+
+    printf("%-20s %14s %14s %8s\n", "Method", "Per-word MW/s", "Bulk MW/s",
+           "Speedup");
+
+    for (size_t m = 0; m < ARRAY_SIZE(methods); m++) {
+        WordHandler handler = methods[m].handler;
+
+        bench_state_reset(&ref);
+        bench_state_reset(&test);
+        run_per_word(&ref, handler, words, STREAM_WORDS);
+        run_bulk(&test, handler, words, STREAM_WORDS);
+        g_assert_cmpuint(ref.out_len, ==, test.out_len);
+        g_assert_cmpuint(ref.attrs_len, ==, test.attrs_len);
+        g_assert(!memcmp(ref.out, test.out, ref.out_len * sizeof(uint32_t)));
+        g_assert(!memcmp(ref.attrs, test.attrs,
+                         ref.attrs_len * sizeof(ref.attrs[0])));
+
+        int64_t per_word_ns = time_method(&ref, handler, false, words);
+        int64_t bulk_ns = time_method(&test, handler, true, words);
+        double total_words = (double)STREAM_WORDS * ITERATIONS;
+
+        printf("%-20s %14.1f %14.1f %7.2fx\n", methods[m].name,
+               total_words * 1e3 / per_word_ns, total_words * 1e3 / bulk_ns,
+               (double)per_word_ns / bulk_ns);
+    }
+
+    bench_state_free(&ref);
+    bench_state_free(&test);
+    g_free(words);
+
+    return 0;
+}
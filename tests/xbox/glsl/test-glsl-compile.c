@@ -0,0 +1,235 @@
+/*
+ * NV2A GLSL generator compile tests.
+ *
+ * Generates the Vulkan vertex and fragment shaders for each polygon mode
+ * emulation and vtxPos0 interpolation combination the renderer can select,
+ * and compiles them to SPIR-V with glslang the way the Vulkan renderer does.
+ *
+ * Comparing the rendered output against the geometry shader path needs a
+ * Vulkan device, so it is not done here.
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/xbox/nv2a/pgraph/pgraph.h"
+#include "hw/xbox/nv2a/pgraph/texture.h"
+#include "hw/xbox/nv2a/pgraph/glsl/psh.h"
+#include "hw/xbox/nv2a/pgraph/glsl/vsh.h"
+#include "hw/xbox/nv2a/pgraph/vk/glsl-limits.h"
+
+/* As in vk/shaders.c and vk/glsl.c */
+#define VSH_UBO_BINDING 0
+#define PSH_UBO_BINDING 1
+#define PSH_TEX_BINDING 2
+#define LINK_MESSAGES \
+    (GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT)
+
+typedef struct TestCase {
+    bool interpolated_pos;
+    enum ShaderPolygonMode polygon_mode_emulation;
+    bool triangles;
+    bool z_perspective;
+} TestCase;
+
+static glslang_input_t get_input(glslang_stage_t stage, const char *glsl)
+{
+    return (glslang_input_t){
+        .language = GLSLANG_SOURCE_GLSL,
+        .stage = stage,
+        .client = GLSLANG_CLIENT_VULKAN,
+        .client_version = GLSLANG_TARGET_VULKAN_1_3,
+        .target_language = GLSLANG_TARGET_SPV,
+        .target_language_version = GLSLANG_TARGET_SPV_1_6,
+        .code = glsl,
+        .default_version = 460,
+        .default_profile = GLSLANG_NO_PROFILE,
+        .messages = GLSLANG_MSG_DEFAULT_BIT,
+        .resource = &resource_limits,
+    };
+}
+
+static glslang_shader_t *parse_glsl(glslang_stage_t stage, const char *glsl)
+{
+    glslang_input_t input = get_input(stage, glsl);
+    glslang_shader_t *shader = glslang_shader_create(&input);
+
+    if (!glslang_shader_preprocess(shader, &input) ||
+        !glslang_shader_parse(shader, &input)) {
+        g_test_message("%s", glsl);
+        g_test_message("%s", glslang_shader_get_info_log(shader));
+        g_test_fail();
+        glslang_shader_delete(shader);
+        return NULL;
+    }
+
+    return shader;
+}
+
+static bool link_program(glslang_program_t *program)
+{
+    if (!glslang_program_link(program, LINK_MESSAGES)) {
+        g_test_message("%s", glslang_program_get_info_log(program));
+        g_test_fail();
+        return false;
+    }
+    return true;
+}
+
+/* Compile a single stage to SPIR-V, as pgraph_vk_compile_glsl_to_spv does */
+static void compile_glsl(glslang_stage_t stage, const char *glsl)
+{
+    glslang_shader_t *shader = parse_glsl(stage, glsl);
+    if (!shader) {
+        return;
+    }
+
+    glslang_program_t *program = glslang_program_create();
+    glslang_program_add_shader(program, shader);
+
+    if (link_program(program)) {
+        glslang_spv_options_t spv_options = { .validate = true };
+        glslang_program_SPIRV_generate_with_options(program, stage,
+                                                    &spv_options);
+        g_assert_cmpuint(glslang_program_SPIRV_get_size(program), >, 0);
+        const char *messages = glslang_program_SPIRV_get_messages(program);
+        if (messages && *messages) {
+            g_test_message("%s", glsl);
+            g_test_message("%s", messages);
+            g_test_fail();
+        }
+    }
+
+    glslang_program_delete(program);
+    glslang_shader_delete(shader);
+}
+
+/* Stages are compiled separately, so check their interface here */
+static void link_stages(const char *vsh_glsl, const char *psh_glsl)
+{
+    glslang_shader_t *vsh = parse_glsl(GLSLANG_STAGE_VERTEX, vsh_glsl);
+    glslang_shader_t *psh = parse_glsl(GLSLANG_STAGE_FRAGMENT, psh_glsl);
+
+    if (vsh && psh) {
+        glslang_program_t *program = glslang_program_create();
+        glslang_program_add_shader(program, vsh);
+        glslang_program_add_shader(program, psh);
+        link_program(program);
+        glslang_program_delete(program);
+    }
+
+    if (vsh) {
+        glslang_shader_delete(vsh);
+    }
+    if (psh) {
+        glslang_shader_delete(psh);
+    }
+}
+
+static void test_compile(gconstpointer opaque)
+{
+    const TestCase *tc = opaque;
+
+    /* A fixed function vertex shader and a single combiner stage */
+    VshState vsh;
+    memset(&vsh, 0, sizeof(vsh));
+    vsh.surface_scale_factor = 1;
+    vsh.is_fixed_function = true;
+    vsh.smooth_shading = true;
+    vsh.z_perspective = tc->z_perspective;
+
+    PshState psh;
+    memset(&psh, 0, sizeof(psh));
+    psh.combiner_control = 1;
+    psh.smooth_shading = true;
+    psh.z_perspective = tc->z_perspective;
+
+    /* Options as set up by the Vulkan renderer when no geometry shader runs */
+    GenVshGlslOptions vsh_opts = {
+        .vulkan = true,
+        .interpolated_pos = tc->interpolated_pos,
+        .ubo_binding = VSH_UBO_BINDING,
+    };
+    GenPshGlslOptions psh_opts = {
+        .vulkan = true,
+        .ubo_binding = PSH_UBO_BINDING,
+        .tex_binding = PSH_TEX_BINDING,
+        .interpolated_pos = tc->interpolated_pos,
+        .depth_slope_from_derivatives = tc->interpolated_pos && tc->triangles,
+        .polygon_mode_emulation = tc->polygon_mode_emulation,
+    };
+
+    MString *vsh_glsl = pgraph_glsl_gen_vsh(&vsh, vsh_opts);
+    MString *psh_glsl = pgraph_glsl_gen_psh(&psh, psh_opts);
+
+    compile_glsl(GLSLANG_STAGE_VERTEX, mstring_get_str(vsh_glsl));
+    compile_glsl(GLSLANG_STAGE_FRAGMENT, mstring_get_str(psh_glsl));
+    link_stages(mstring_get_str(vsh_glsl), mstring_get_str(psh_glsl));
+
+    mstring_unref(vsh_glsl);
+    mstring_unref(psh_glsl);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        enum ShaderPolygonMode mode;
+        const char *name;
+    } polygon_modes[] = {
+        { POLY_MODE_FILL, "fill" },
+        { POLY_MODE_LINE, "line" },
+        { POLY_MODE_POINT, "point" },
+    };
+
+    g_test_init(&argc, &argv, NULL);
+    glslang_initialize_process();
+
+    /*
+     * As chosen in vk/shaders.c: vtxPos0 is interpolated only when no
+     * geometry shader is available, and only then are fill modes other than
+     * FILL emulated, for triangles.
+     */
+    for (int pos = 0; pos < 2; pos++) {
+        for (int mode = 0; mode < ARRAY_SIZE(polygon_modes); mode++) {
+            for (int tri = 0; tri < 2; tri++) {
+                bool emulated = polygon_modes[mode].mode != POLY_MODE_FILL;
+                if (emulated && !(pos && tri)) {
+                    continue;
+                }
+
+                for (int zp = 0; zp < 2; zp++) {
+                    TestCase *tc = g_new0(TestCase, 1);
+                    tc->interpolated_pos = pos;
+                    tc->polygon_mode_emulation = polygon_modes[mode].mode;
+                    tc->triangles = tri;
+                    tc->z_perspective = zp;
+
+                    g_autofree char *path = g_strdup_printf(
+                        "/vk/%s/%s/%s/%s",
+                        pos ? "interpolated-pos" : "flat-pos",
+                        polygon_modes[mode].name,
+                        tri ? "triangles" : "other-prims",
+                        zp ? "z-perspective" : "z-linear");
+                    g_test_add_data_func_full(path, tc, test_compile, g_free);
+                }
+            }
+        }
+    }
+
+    int ret = g_test_run();
+    glslang_finalize_process();
+    return ret;
+}
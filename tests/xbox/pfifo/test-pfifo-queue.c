@@ -0,0 +1,210 @@
+/*
+ * NV2A PFIFO method queue tests.
+ *
+ * Decodes small pushbuffers into method records and drains them through a
+ * stand-in for PGRAPH that squashes BEGIN/DRAW_ARRAYS/END sequences the way
+ * pgraph_method does, by consuming words past the end of its own record.
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "hw/xbox/nv2a/pfifo_queue.h"
+
+#define SET_BEGIN_END 0x17fc
+#define DRAW_ARRAYS 0x1810
+#define OP_END 0
+#define OP_TRIANGLES 5
+
+#define MAX_WORDS 1024
+#define MAX_RECORDS 512
+#define MAX_LOG 512
+
+typedef struct LoggedMethod {
+    unsigned int method;
+    uint32_t parameter;
+} LoggedMethod;
+
+typedef struct TestContext {
+    uint32_t pb[MAX_WORDS];
+    unsigned int num_words;
+    PfifoMethodRecord records[MAX_RECORDS];
+    LoggedMethod log[MAX_LOG];
+    unsigned int num_logged;
+    uint32_t primitive_mode;
+    unsigned int calls;
+    unsigned int stall_every;
+} TestContext;
+
+static void emit_method(TestContext *ctx, unsigned int method,
+                        uint32_t parameter)
+{
+    g_assert_cmpuint(ctx->num_words + 2, <=, MAX_WORDS);
+    stl_le_p(&ctx->pb[ctx->num_words++], (1 << 18) | method);
+    stl_le_p(&ctx->pb[ctx->num_words++], parameter);
+}
+
+static void emit_draw(TestContext *ctx, uint32_t start, uint32_t count)
+{
+    emit_method(ctx, SET_BEGIN_END, OP_TRIANGLES);
+    emit_method(ctx, DRAW_ARRAYS, ((count - 1) << 24) | start);
+    emit_method(ctx, SET_BEGIN_END, OP_END);
+}
+
+/* Mirrors the BEGIN/DRAW_ARRAYS/END squash in pgraph_method */
+static int run_method(void *opaque, PfifoMethodRecord *rec)
+{
+    TestContext *ctx = opaque;
+    uint32_t *p = rec->parameters;
+    uint32_t parameter = ldl_le_p(p);
+
+    if (ctx->stall_every && (++ctx->calls % ctx->stall_every) == 0) {
+        return -1;
+    }
+
+    g_assert_cmpuint(ctx->num_logged, <, MAX_LOG);
+    ctx->log[ctx->num_logged++] = (LoggedMethod){ rec->method, parameter };
+
+    if (rec->method == SET_BEGIN_END && parameter != OP_END) {
+        ctx->primitive_mode = parameter;
+    }
+
+#define LAM(i, mthd) ((ldl_le_p(&p[i*2+1]) & 0x31fff) == (mthd))
+#define LAP(i, prm) (ldl_le_p(&p[i*2+2]) == (prm))
+#define LAMP(i, mthd, prm) (LAM(i, mthd) && LAP(i, prm))
+
+    if (rec->method == DRAW_ARRAYS && rec->max_lookahead_words >= 7 &&
+        LAMP(0, SET_BEGIN_END, OP_END) &&
+        LAMP(1, SET_BEGIN_END, ctx->primitive_mode) &&
+        LAM(2, DRAW_ARRAYS)) {
+        return 5;
+    }
+
+#undef LAM
+#undef LAP
+#undef LAMP
+
+    return 1;
+}
+
+/*
+ * Decode the whole pushbuffer, then drain it in batches of up to
+ * @batch_size records the way the puller does, resuming stalled records in
+ * place. Returns the DMA state after the last consumed word.
+ */
+static PfifoDmaState run_pushbuffer(TestContext *ctx, int batch_size)
+{
+    PfifoDmaState s = { 0 };
+    uint32_t put = ctx->num_words * 4;
+
+    int num_records = pfifo_decode_methods((uint8_t *)ctx->pb, sizeof(ctx->pb),
+                                           put, &s, ctx->records, MAX_RECORDS);
+    g_assert_cmpuint(s.get, ==, put);
+
+    int head = 0;
+    while (head < num_records) {
+        int n = MIN(batch_size, num_records - head);
+        head += pfifo_drain_methods(&ctx->records[head], n, run_method, ctx);
+    }
+
+    return s;
+}
+
+static void check_squashed(TestContext *ctx, unsigned int num_draws)
+{
+    g_assert_cmpuint(ctx->num_logged, ==, num_draws + 2);
+    g_assert_cmpuint(ctx->log[0].method, ==, SET_BEGIN_END);
+    g_assert_cmpuint(ctx->log[0].parameter, ==, OP_TRIANGLES);
+    for (unsigned int i = 0; i < num_draws; i++) {
+        g_assert_cmpuint(ctx->log[i + 1].method, ==, DRAW_ARRAYS);
+        g_assert_cmpuint(ctx->log[i + 1].parameter & 0xffffff, ==, i * 3);
+    }
+    g_assert_cmpuint(ctx->log[num_draws + 1].method, ==, SET_BEGIN_END);
+    g_assert_cmpuint(ctx->log[num_draws + 1].parameter, ==, OP_END);
+}
+
+static void test_squash(void)
+{
+    TestContext *ctx = g_new0(TestContext, 1);
+
+    emit_draw(ctx, 0, 3);
+    emit_draw(ctx, 3, 3);
+
+    PfifoDmaState end = run_pushbuffer(ctx, MAX_RECORDS);
+    check_squashed(ctx, 2);
+    g_assert_cmpuint(end.get, ==, ctx->num_words * 4);
+    g_assert_cmpuint(end.data_shadow, ==, OP_END);
+
+    g_free(ctx);
+}
+
+/* Methods must not look into records outside of the batch being drained */
+static void test_squash_batch_boundary(void)
+{
+    TestContext *ctx = g_new0(TestContext, 1);
+
+    emit_draw(ctx, 0, 3);
+    emit_draw(ctx, 3, 3);
+
+    run_pushbuffer(ctx, 1);
+    g_assert_cmpuint(ctx->num_logged, ==, 6);
+
+    g_free(ctx);
+}
+
+static void test_squash_with_stalls(void)
+{
+    for (int batch_size = 2; batch_size <= 9; batch_size++) {
+        for (int stall_every = 2; stall_every <= 5; stall_every++) {
+            TestContext *ctx = g_new0(TestContext, 1);
+            const unsigned int num_draws = 40;
+
+            for (unsigned int i = 0; i < num_draws; i++) {
+                emit_draw(ctx, i * 3, 3);
+            }
+            ctx->stall_every = stall_every;
+
+            run_pushbuffer(ctx, batch_size);
+
+            /* Every draw runs once; END/BEGIN pairs are skipped or run */
+            unsigned int draws = 0;
+            uint32_t next_start = 0;
+            for (unsigned int i = 0; i < ctx->num_logged; i++) {
+                if (ctx->log[i].method == DRAW_ARRAYS) {
+                    g_assert_cmpuint(ctx->log[i].parameter & 0xffffff, ==,
+                                     next_start);
+                    next_start += 3;
+                    draws++;
+                }
+            }
+            g_assert_cmpuint(draws, ==, num_draws);
+            g_assert_cmpuint(ctx->log[ctx->num_logged - 1].parameter, ==,
+                             OP_END);
+
+            g_free(ctx);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/squash", test_squash);
+    g_test_add_func("/squash/batch-boundary", test_squash_batch_boundary);
+    g_test_add_func("/squash/stalls", test_squash_with_stalls);
+    return g_test_run();
+}
@@ -0,0 +1,337 @@
+/*
+ * NV2A vertex program CPU emulation tests.
+ *
+ * Runs randomized vertex state programs through vsh_cpu and the
+ * nv2a_vsh_cpu reference emulator and compares the resulting constants.
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/xbox/nv2a/pgraph/vsh_cpu.h"
+#include "nv2a_vsh_emulator.h"
+
+#define NUM_RANDOM_PROGRAMS 20000
+#define MAX_RANDOM_PROGRAM_LENGTH 16
+
+typedef struct TestContext {
+    uint32_t program[NV2A_MAX_TRANSFORM_PROGRAM_LENGTH][VSH_TOKEN_SIZE];
+    uint32_t v0[4];
+    uint32_t constants[NV2A_VERTEXSHADER_CONSTANTS][4];
+    bool dirty[NV2A_VERTEXSHADER_CONSTANTS];
+} TestContext;
+
+static void set_bits(uint32_t *token, int subtoken, int start_bit,
+                     int bit_length, uint32_t value)
+{
+    uint32_t mask = ((1u << bit_length) - 1) << start_bit;
+    token[subtoken] = (token[subtoken] & ~mask) | ((value << start_bit) & mask);
+}
+
+static uint32_t random_float_bits(void)
+{
+    static const float specials[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 2.0f, INFINITY, -INFINITY,
+    };
+
+    if (g_random_int_range(0, 8) == 0) {
+        float f = specials[g_random_int_range(0, ARRAY_SIZE(specials))];
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+
+    float f = g_random_double_range(-64.0, 64.0);
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static void randomize_context(TestContext *ctx)
+{
+    for (int i = 0; i < NV2A_VERTEXSHADER_CONSTANTS; i++) {
+        for (int j = 0; j < 4; j++) {
+            ctx->constants[i][j] = random_float_bits();
+        }
+    }
+    for (int j = 0; j < 4; j++) {
+        ctx->v0[j] = random_float_bits();
+    }
+}
+
+/*
+ * Produce a random program that stays inside the constant file: relative
+ * addressing is left to the directed tests, and constant indices are limited
+ * to the 192 registers that exist.
+ */
+static unsigned int randomize_program(TestContext *ctx)
+{
+    unsigned int length = g_random_int_range(1, MAX_RANDOM_PROGRAM_LENGTH + 1);
+
+    for (unsigned int slot = 0; slot < length; slot++) {
+        uint32_t *token = ctx->program[slot];
+        token[0] = 0;
+        for (int i = 1; i < VSH_TOKEN_SIZE; i++) {
+            token[i] = g_random_int();
+        }
+        set_bits(token, 1, 21, 4, g_random_int_range(MAC_NOP, MAC_ARL));
+        set_bits(token, 1, 13, 8, g_random_int_range(0, 192));
+        set_bits(token, 1, 9, 4, g_random_int_range(0, 2) ? 0 : 1);
+        set_bits(token, 2, 26, 2, g_random_int_range(PARAM_R, PARAM_C + 1));
+        set_bits(token, 2, 11, 2, g_random_int_range(PARAM_R, PARAM_C + 1));
+        set_bits(token, 3, 28, 2, g_random_int_range(PARAM_R, PARAM_C + 1));
+        set_bits(token, 3, 3, 8, g_random_int_range(0, 192));
+        set_bits(token, 3, 1, 1, 0);
+        set_bits(token, 3, 0, 1, slot == length - 1);
+    }
+
+    return length;
+}
+
+static void run_reference(TestContext *ctx, unsigned int start)
+{
+    Nv2aVshProgram program;
+    Nv2aVshParseResult result = nv2a_vsh_parse_program(
+        &program, ctx->program[start],
+        NV2A_MAX_TRANSFORM_PROGRAM_LENGTH - start);
+    g_assert_cmpint(result, ==, NV2AVPR_SUCCESS);
+
+    Nv2aVshCPUXVSSExecutionState state_linkage;
+    Nv2aVshExecutionState state = nv2a_vsh_emu_initialize_xss_execution_state(
+        &state_linkage, (float *)ctx->constants);
+    memcpy(state_linkage.input_regs, ctx->v0, sizeof(ctx->v0));
+
+    nv2a_vsh_emu_execute_track_context_writes(&state, &program, ctx->dirty);
+
+    nv2a_vsh_program_destroy(&program);
+}
+
+static void run_vsh_cpu(TestContext *ctx, unsigned int start)
+{
+    VshCpuProgram program;
+    vsh_cpu_decode_program(&program, ctx->program[start],
+                           NV2A_MAX_TRANSFORM_PROGRAM_LENGTH - start);
+    vsh_cpu_execute_xvss(&program, ctx->v0, ctx->constants, ctx->dirty);
+}
+
+static bool float_bits_match(uint32_t a_bits, uint32_t b_bits)
+{
+    float a, b;
+    memcpy(&a, &a_bits, sizeof(a));
+    memcpy(&b, &b_bits, sizeof(b));
+
+    if (isnan(a) || isnan(b)) {
+        return isnan(a) && isnan(b);
+    }
+    if (isinf(a) || isinf(b)) {
+        return a == b;
+    }
+    return fabsf(a - b) <= 1e-5f * MAX(1.0f, fabsf(a));
+}
+
+static void compare_contexts(const TestContext *ref, const TestContext *test,
+                             unsigned int length)
+{
+    for (int i = 0; i < NV2A_VERTEXSHADER_CONSTANTS; i++) {
+        g_assert_cmpint(ref->dirty[i], ==, test->dirty[i]);
+        for (int j = 0; j < 4; j++) {
+            if (!float_bits_match(ref->constants[i][j],
+                                  test->constants[i][j])) {
+                for (unsigned int slot = 0; slot < length; slot++) {
+                    g_test_message("slot %u: %08x %08x %08x %08x", slot,
+                                   ref->program[slot][0],
+                                   ref->program[slot][1],
+                                   ref->program[slot][2],
+                                   ref->program[slot][3]);
+                }
+                g_test_message("c[%d].%c: expected %08x, got %08x", i,
+                               "xyzw"[j], ref->constants[i][j],
+                               test->constants[i][j]);
+                g_assert_not_reached();
+            }
+        }
+    }
+}
+
+static void test_random_programs(void)
+{
+    TestContext *ref = g_new0(TestContext, 1);
+    TestContext *test = g_new0(TestContext, 1);
+
+    for (int i = 0; i < NUM_RANDOM_PROGRAMS; i++) {
+        memset(ref, 0, sizeof(*ref));
+        unsigned int length = randomize_program(ref);
+        randomize_context(ref);
+        *test = *ref;
+
+        run_reference(ref, 0);
+        run_vsh_cpu(test, 0);
+        compare_contexts(ref, test, length);
+    }
+
+    g_free(ref);
+    g_free(test);
+}
+
+/* Constant reads relative to A0, with A0 loaded from v0.x */
+static void test_relative_addressing(void)
+{
+    TestContext *ref = g_new0(TestContext, 1);
+    TestContext *test = g_new0(TestContext, 1);
+
+    for (int offset = 0; offset < 32; offset++) {
+        memset(ref, 0, sizeof(*ref));
+        randomize_context(ref);
+        float a0 = offset;
+        memcpy(&ref->v0[0], &a0, sizeof(a0));
+
+        /* ARL A0, v0.x */
+        uint32_t *token = ref->program[0];
+        set_bits(token, 1, 21, 4, MAC_ARL);
+        set_bits(token, 2, 26, 2, PARAM_V);
+
+        /* MOV R0, c[A0 + 96] ; MOV c[100], R0 */
+        token = ref->program[1];
+        set_bits(token, 1, 21, 4, MAC_MOV);
+        set_bits(token, 1, 13, 8, 96);
+        set_bits(token, 1, 0, 8, 0x1B); /* .xyzw */
+        set_bits(token, 2, 26, 2, PARAM_C);
+        set_bits(token, 3, 24, 4, 0xF);
+        set_bits(token, 3, 12, 4, 0xF);
+        set_bits(token, 3, 11, 1, OUTPUT_C);
+        set_bits(token, 3, 3, 8, 100);
+        set_bits(token, 3, 1, 1, 1);
+        set_bits(token, 3, 0, 1, 1);
+
+        *test = *ref;
+        run_reference(ref, 0);
+        run_vsh_cpu(test, 0);
+        compare_contexts(ref, test, 2);
+    }
+
+    g_free(ref);
+    g_free(test);
+}
+
+static void set_float(uint32_t *dst, float f)
+{
+    memcpy(dst, &f, sizeof(f));
+}
+
+static void assert_float_row(const uint32_t row[4], float x, float y,
+                             float z, float w)
+{
+    const float expected[4] = { x, y, z, w };
+
+    for (int j = 0; j < 4; j++) {
+        float f;
+        memcpy(&f, &row[j], sizeof(f));
+        g_assert_cmpfloat(f, ==, expected[j]);
+    }
+}
+
+/*
+ * A paired MAC and ILU op share input C. A scalar ILU op must not change the
+ * swizzle the MAC sees.
+ */
+static void test_paired_scalar_ilu(void)
+{
+    TestContext *ctx = g_new0(TestContext, 1);
+
+    set_float(&ctx->v0[0], 1.0f);
+    set_float(&ctx->v0[1], 2.0f);
+    set_float(&ctx->v0[2], 3.0f);
+    set_float(&ctx->v0[3], 4.0f);
+    set_float(&ctx->constants[10][0], 2.0f);
+    set_float(&ctx->constants[10][1], 4.0f);
+    set_float(&ctx->constants[10][2], 8.0f);
+    set_float(&ctx->constants[10][3], 16.0f);
+
+    /* MAD c[100], v0, c[10], c[10].wzyx + RCP R1, c[10].wzyx */
+    uint32_t *token = ctx->program[0];
+    set_bits(token, 1, 25, 3, ILU_RCP);
+    set_bits(token, 1, 21, 4, MAC_MAD);
+    set_bits(token, 1, 13, 8, 10);
+    set_bits(token, 1, 0, 8, 0x1B); /* A.xyzw */
+    set_bits(token, 2, 26, 2, PARAM_V);
+    set_bits(token, 2, 17, 8, 0x1B); /* B.xyzw */
+    set_bits(token, 2, 11, 2, PARAM_C);
+    set_bits(token, 2, 2, 8, 0xE4); /* C.wzyx */
+    set_bits(token, 3, 28, 2, PARAM_C);
+    set_bits(token, 3, 16, 4, 0xF);
+    set_bits(token, 3, 12, 4, 0xF);
+    set_bits(token, 3, 11, 1, OUTPUT_C);
+    set_bits(token, 3, 3, 8, 100);
+    set_bits(token, 3, 2, 1, OMUX_MAC);
+
+    /* MOV c[101], R1 */
+    token = ctx->program[1];
+    set_bits(token, 1, 21, 4, MAC_MOV);
+    set_bits(token, 1, 0, 8, 0x1B); /* A.xyzw */
+    set_bits(token, 2, 28, 4, 1);
+    set_bits(token, 2, 26, 2, PARAM_R);
+    set_bits(token, 3, 12, 4, 0xF);
+    set_bits(token, 3, 11, 1, OUTPUT_C);
+    set_bits(token, 3, 3, 8, 101);
+    set_bits(token, 3, 0, 1, 1);
+
+    run_vsh_cpu(ctx, 0);
+
+    assert_float_row(ctx->constants[100], 18.0f, 16.0f, 28.0f, 66.0f);
+    assert_float_row(ctx->constants[101], 0.0625f, 0.0625f, 0.0625f, 0.0625f);
+    g_assert_true(ctx->dirty[100]);
+    g_assert_true(ctx->dirty[101]);
+
+    g_free(ctx);
+}
+
+static void test_program_cache(void)
+{
+    TestContext *ctx = g_new0(TestContext, 1);
+    VshCpuProgramCache *cache = g_new0(VshCpuProgramCache, 1);
+
+    randomize_program(ctx);
+    const VshCpuProgram *p1 = vsh_cpu_get_program(
+        cache, &ctx->program[0][0], 0, NV2A_MAX_TRANSFORM_PROGRAM_LENGTH, 1);
+    const VshCpuProgram *p2 = vsh_cpu_get_program(
+        cache, &ctx->program[0][0], 0, NV2A_MAX_TRANSFORM_PROGRAM_LENGTH, 1);
+    g_assert(p1 == p2);
+
+    /* A new generation is decoded again from program memory */
+    ctx->program[0][1] ^= 1 << 21;
+    p2 = vsh_cpu_get_program(cache, &ctx->program[0][0], 0,
+                             NV2A_MAX_TRANSFORM_PROGRAM_LENGTH, 2);
+    g_assert(p1 != p2);
+
+    VshCpuProgram expected;
+    vsh_cpu_decode_program(&expected, &ctx->program[0][0],
+                           NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
+    g_assert_cmpint(p2->insns[0].mac, ==, expected.insns[0].mac);
+    g_assert_cmpint(p2->length, ==, expected.length);
+
+    g_free(cache);
+    g_free(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/random", test_random_programs);
+    g_test_add_func("/relative-addressing", test_relative_addressing);
+    g_test_add_func("/paired-scalar-ilu", test_paired_scalar_ilu);
+    g_test_add_func("/cache", test_program_cache);
+    return g_test_run();
+}
@@ -0,0 +1,257 @@
+/*
+ * NV2A vertex program liveness tests.
+ *
+ * Runs randomized vertex state programs through vsh_cpu as written and with
+ * the temporary writes that pgraph_glsl_compute_vsh_liveness finds dead
+ * removed, and checks that the constants they write are identical.
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/xbox/nv2a/pgraph/vsh_cpu.h"
+#include "hw/xbox/nv2a/pgraph/glsl/vsh-prog.h"
+
+#define NUM_RANDOM_PROGRAMS 20000
+#define MAX_RANDOM_PROGRAM_LENGTH 24
+
+/* Keep programs to a few temporaries so that writes are often read back */
+#define NUM_RANDOM_TEMPS 4
+
+typedef struct TestContext {
+    uint32_t program[NV2A_MAX_TRANSFORM_PROGRAM_LENGTH][VSH_TOKEN_SIZE];
+    uint32_t v0[4];
+    uint32_t constants[NV2A_VERTEXSHADER_CONSTANTS][4];
+    bool dirty[NV2A_VERTEXSHADER_CONSTANTS];
+} TestContext;
+
+static void set_bits(uint32_t *token, int subtoken, int start_bit,
+                     int bit_length, uint32_t value)
+{
+    uint32_t mask = ((1u << bit_length) - 1) << start_bit;
+    token[subtoken] = (token[subtoken] & ~mask) | ((value << start_bit) & mask);
+}
+
+static uint32_t random_float_bits(void)
+{
+    float f = g_random_double_range(-8.0, 8.0);
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static void randomize_context(TestContext *ctx)
+{
+    for (int i = 0; i < NV2A_VERTEXSHADER_CONSTANTS; i++) {
+        for (int j = 0; j < 4; j++) {
+            ctx->constants[i][j] = random_float_bits();
+        }
+    }
+    for (int j = 0; j < 4; j++) {
+        ctx->v0[j] = random_float_bits();
+    }
+}
+
+static uint32_t random_temp(void)
+{
+    /* Occasionally use R12, which aliases oPos and is never trimmed */
+    return g_random_int_range(0, 16) ? g_random_int_range(0, NUM_RANDOM_TEMPS)
+                                     : 12;
+}
+
+/*
+ * Random programs lean on a few temporaries with random write masks and
+ * swizzles, so that partially dead writes, ARL and relative constant reads
+ * all occur. Constant writes are the only observable result.
+ */
+static unsigned int randomize_program(TestContext *ctx)
+{
+    unsigned int length = g_random_int_range(1, MAX_RANDOM_PROGRAM_LENGTH + 1);
+
+    for (unsigned int slot = 0; slot < length; slot++) {
+        uint32_t *token = ctx->program[slot];
+        token[0] = 0;
+        for (int i = 1; i < VSH_TOKEN_SIZE; i++) {
+            token[i] = g_random_int();
+        }
+        set_bits(token, 1, 25, 3,
+                 g_random_boolean() ? ILU_NOP
+                                    : g_random_int_range(ILU_MOV, ILU_LIT + 1));
+        set_bits(token, 1, 21, 4, g_random_int_range(MAC_NOP, MAC_ARL + 1));
+        set_bits(token, 1, 13, 8, g_random_int_range(0, 192));
+        set_bits(token, 1, 9, 4, 0);
+        set_bits(token, 2, 28, 4, random_temp());
+        set_bits(token, 2, 26, 2, g_random_int_range(PARAM_R, PARAM_C + 1));
+        set_bits(token, 2, 13, 4, random_temp());
+        set_bits(token, 2, 11, 2, g_random_int_range(PARAM_R, PARAM_C + 1));
+        uint32_t c_r = random_temp();
+        set_bits(token, 2, 0, 2, c_r >> 2);
+        set_bits(token, 3, 30, 2, c_r & 3);
+        set_bits(token, 3, 28, 2, g_random_int_range(PARAM_R, PARAM_C + 1));
+        set_bits(token, 3, 20, 4, random_temp());
+        set_bits(token, 3, 12, 4, g_random_int_range(0, 4) ? 0 : 0xF);
+        set_bits(token, 3, 11, 1, OUTPUT_C);
+        set_bits(token, 3, 3, 8, g_random_int_range(0, 192));
+        set_bits(token, 3, 1, 1, g_random_int_range(0, 4) == 0);
+        set_bits(token, 3, 0, 1, slot == length - 1);
+    }
+
+    return length;
+}
+
+/*
+ * Rewrite the program to do only what the generated GLSL does: dead MAC and
+ * ILU results no longer reach their temporaries, and a dead ARL loads A0
+ * from a different value.
+ */
+static void apply_liveness(TestContext *ctx, unsigned int length,
+                           unsigned int *num_trimmed)
+{
+    VshSlotLiveness liveness[NV2A_MAX_TRANSFORM_PROGRAM_LENGTH];
+    pgraph_glsl_compute_vsh_liveness(&ctx->program[0][0], length, liveness);
+
+    for (unsigned int slot = 0; slot < length; slot++) {
+        uint32_t *token = ctx->program[slot];
+        const VshSlotLiveness *l = &liveness[slot];
+        uint32_t mac = (token[1] >> 21) & 0xF;
+        uint32_t ilu = (token[1] >> 25) & 0x7;
+
+        if (mac == MAC_ARL) {
+            if (!l->mac_live) {
+                token[1] ^= 1 << 8;
+                (*num_trimmed)++;
+            }
+        } else if (mac != MAC_NOP) {
+            uint32_t mask = l->mac_live ? l->mac_mask : 0;
+            *num_trimmed += mask != ((token[3] >> 24) & 0xF);
+            set_bits(token, 3, 24, 4, mask);
+        }
+
+        if (ilu != ILU_NOP) {
+            uint32_t mask = l->ilu_live ? l->ilu_mask : 0;
+            *num_trimmed += mask != ((token[3] >> 16) & 0xF);
+            set_bits(token, 3, 16, 4, mask);
+        }
+    }
+}
+
+static void run_vsh_cpu(TestContext *ctx)
+{
+    VshCpuProgram program;
+    vsh_cpu_decode_program(&program, &ctx->program[0][0],
+                           NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
+    vsh_cpu_execute_xvss(&program, ctx->v0, ctx->constants, ctx->dirty);
+}
+
+static void compare_contexts(const TestContext *ref, const TestContext *test,
+                             unsigned int length)
+{
+    for (int i = 0; i < NV2A_VERTEXSHADER_CONSTANTS; i++) {
+        g_assert_cmpint(ref->dirty[i], ==, test->dirty[i]);
+        if (!memcmp(ref->constants[i], test->constants[i],
+                    sizeof(ref->constants[i]))) {
+            continue;
+        }
+        for (unsigned int slot = 0; slot < length; slot++) {
+            g_test_message("slot %u: %08x %08x %08x %08x -> %08x %08x", slot,
+                           ref->program[slot][0], ref->program[slot][1],
+                           ref->program[slot][2], ref->program[slot][3],
+                           test->program[slot][1], test->program[slot][3]);
+        }
+        for (int j = 0; j < 4; j++) {
+            g_test_message("c[%d].%c: expected %08x, got %08x", i, "xyzw"[j],
+                           ref->constants[i][j], test->constants[i][j]);
+        }
+        g_assert_not_reached();
+    }
+}
+
+static void test_random_programs(void)
+{
+    TestContext *ref = g_new0(TestContext, 1);
+    TestContext *test = g_new0(TestContext, 1);
+    unsigned int num_trimmed = 0;
+
+    for (int i = 0; i < NUM_RANDOM_PROGRAMS; i++) {
+        memset(ref, 0, sizeof(*ref));
+        unsigned int length = randomize_program(ref);
+        randomize_context(ref);
+        *test = *ref;
+        apply_liveness(test, length, &num_trimmed);
+
+        run_vsh_cpu(ref);
+        run_vsh_cpu(test);
+        compare_contexts(ref, test, length);
+    }
+
+    /* Make sure the comparison covered writes the pass actually removed */
+    g_assert_cmpuint(num_trimmed, >, NUM_RANDOM_PROGRAMS);
+
+    g_free(ref);
+    g_free(test);
+}
+
+/* MOV R0, v0 ; MOV R1.xy, c[96] ; MOV c[100], R0 */
+static void test_dead_write(void)
+{
+    TestContext *ctx = g_new0(TestContext, 1);
+    uint32_t *token;
+
+    token = ctx->program[0];
+    set_bits(token, 1, 21, 4, MAC_MOV);
+    set_bits(token, 1, 0, 8, 0x1B); /* .xyzw */
+    set_bits(token, 2, 26, 2, PARAM_V);
+    set_bits(token, 3, 24, 4, 0xF);
+    set_bits(token, 3, 20, 4, 0);
+
+    token = ctx->program[1];
+    set_bits(token, 1, 21, 4, MAC_MOV);
+    set_bits(token, 1, 13, 8, 96);
+    set_bits(token, 1, 0, 8, 0x1B);
+    set_bits(token, 2, 26, 2, PARAM_C);
+    set_bits(token, 3, 24, 4, 0xC);
+    set_bits(token, 3, 20, 4, 1);
+
+    token = ctx->program[2];
+    set_bits(token, 1, 21, 4, MAC_MOV);
+    set_bits(token, 1, 0, 8, 0x1B);
+    set_bits(token, 2, 28, 4, 0);
+    set_bits(token, 2, 26, 2, PARAM_R);
+    set_bits(token, 3, 12, 4, 0xF);
+    set_bits(token, 3, 11, 1, OUTPUT_C);
+    set_bits(token, 3, 3, 8, 100);
+    set_bits(token, 3, 0, 1, 1);
+
+    VshSlotLiveness liveness[3];
+    pgraph_glsl_compute_vsh_liveness(&ctx->program[0][0], 3, liveness);
+
+    g_assert_true(liveness[0].mac_live);
+    g_assert_cmpuint(liveness[0].mac_mask, ==, 0xF);
+    g_assert_false(liveness[1].mac_live);
+    g_assert_cmpuint(liveness[1].mac_mask, ==, 0);
+    g_assert_true(liveness[2].mac_live);
+    g_assert_cmpuint(liveness[2].mac_mask, ==, 0);
+
+    g_free(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/liveness/random", test_random_programs);
+    g_test_add_func("/liveness/dead-write", test_dead_write);
+    return g_test_run();
+}
@@ -182,7 +182,7 @@ bool xemu_settings_load(void)
 #ifdef __ANDROID__
                     if (auto android_tbl = tbl["android"].as_table()) {
                         if (auto v = android_tbl->get("force_cpu_blit"); v && v->is_boolean()) {
-                            if (v->value<bool>().value_or(false)) {
+                            if (v->value<bool>().value_or(true)) {
                                 setenv("XEMU_ANDROID_FORCE_CPU_BLIT", "1", 1);
                                 __android_log_print(ANDROID_LOG_INFO, "xemu-android",
                                                     "Config android.force_cpu_blit=1");
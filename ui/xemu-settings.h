@@ -70,6 +70,42 @@ static inline void xemu_settings_set_string(const char **str, const char *new_st
     *str = strdup(new_str);
 }
 
+// Get the display upscaler settings for a title, applying its entry in
+// display.quality.title_overrides (if any) over the global settings
+static inline void xemu_settings_get_upscaler(
+    uint32_t title_id, CONFIG_DISPLAY_QUALITY_UPSCALER *upscaler, int *factor,
+    float *sharpness)
+{
+    *upscaler = g_config.display.quality.upscaler;
+    *factor = g_config.display.quality.upscale_factor;
+    *sharpness = g_config.display.quality.sharpness;
+
+    if (!title_id) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < g_config.display.quality.title_overrides_count;
+         i++) {
+        const char *id = g_config.display.quality.title_overrides[i].title_id;
+        if (!id || strtoul(id, NULL, 16) != title_id) {
+            continue;
+        }
+
+        int mode = g_config.display.quality.title_overrides[i].upscaler;
+        if (mode != CONFIG_DISPLAY_QUALITY_TITLE_OVERRIDES_UPSCALER_GLOBAL) {
+            // Same order as the global enum, shifted by the 'global' entry
+            *upscaler = (CONFIG_DISPLAY_QUALITY_UPSCALER)(mode - 1);
+        }
+        if (g_config.display.quality.title_overrides[i].upscale_factor > 0) {
+            *factor = g_config.display.quality.title_overrides[i].upscale_factor;
+        }
+        if (g_config.display.quality.title_overrides[i].sharpness >= 0) {
+            *sharpness = g_config.display.quality.title_overrides[i].sharpness;
+        }
+        return;
+    }
+}
+
 void add_net_nat_forward_ports(int host, int guest, CONFIG_NET_NAT_FORWARD_PORTS_PROTOCOL protocol);
 void remove_net_nat_forward_ports(unsigned int index);
 
@@ -50,11 +50,13 @@
 #include "xemu-snapshots.h"
 #include "xemu-version.h"
 #include "xemu-os-utils.h"
+#include "xemu-xbe.h"
 
 #include "data/xemu_64x64.png.h"
 
 #include "hw/xbox/smbus.h" // For eject, drive tray
 #include "hw/xbox/nv2a/nv2a.h"
+#include "hw/xbox/nv2a/debug.h"
 #include "ui/xemu-notifications.h"
 
 #include <stb_image.h>
@@ -62,6 +64,8 @@
 
 #ifdef __ANDROID__
 #include <android/log.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
 #endif
 #ifdef _WIN32
 #include "nvapi.h"
@@ -138,11 +142,13 @@ static GLuint g_android_blit_vbo;
 static GLint g_android_blit_tex_loc = -1;
 static GLint g_android_blit_flip_loc = -1;
 static int g_android_display_mode = 0; /* 0=stretch, 1=4:3, 2=16:9 */
-static GLuint g_android_cpu_tex = 0;
-static int g_android_cpu_tex_w = 0;
-static int g_android_cpu_tex_h = 0;
-static uint8_t *g_android_cpu_buf = NULL;
-static size_t g_android_cpu_buf_size = 0;
+static GLuint g_android_fb_image_tex = 0;
+static unsigned int g_android_fb_image_generation = 0;
+/* Vulkan renderer presents to the window itself; no GL on this thread */
+static bool g_android_native_present = false;
+static void *g_android_present_window = NULL;
+
+static void android_update_present_window(bool visible);
 
 static bool sdl2_is_render_thread(void)
 {
@@ -285,6 +291,47 @@ static bool android_blit_init(void)
     return true;
 }
 
+/*
+ * Bind the EGLImage exported by the nv2a display to a texture in this
+ * context. The image is only recreated when the display buffer is resized.
+ */
+static GLuint android_import_framebuffer_image(void)
+{
+    static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC p_glEGLImageTargetTexture2DOES;
+
+    void *image;
+    unsigned int generation;
+    if (!nv2a_android_get_framebuffer_image(&image, &generation)) {
+        return 0;
+    }
+
+    if (!p_glEGLImageTargetTexture2DOES) {
+        p_glEGLImageTargetTexture2DOES =
+            (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress(
+                "glEGLImageTargetTexture2DOES");
+        if (!p_glEGLImageTargetTexture2DOES) {
+            return 0;
+        }
+    }
+
+    if (g_android_fb_image_tex &&
+        g_android_fb_image_generation == generation) {
+        return g_android_fb_image_tex;
+    }
+
+    if (!g_android_fb_image_tex) {
+        glGenTextures(1, &g_android_fb_image_tex);
+    }
+    glBindTexture(GL_TEXTURE_2D, g_android_fb_image_tex);
+    p_glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, (GLeglImageOES)image);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    g_android_fb_image_generation = generation;
+
+    return g_android_fb_image_tex;
+}
+
 static void android_blit_frame(GLuint tex, bool flip)
 {
     if (!android_blit_init()) {
@@ -1058,10 +1105,15 @@ static void sdl2_display_very_early_init(DisplayOptions *o)
         window_height = min_window_height;
     }
 
-    // On Android, always use OpenGL window even for Vulkan because Vulkan
-    // needs GL context for external memory display presentation
+    // On Android, use an OpenGL window even for Vulkan, which hands frames
+    // to GL for display, unless the renderer presents to the window itself
 #ifdef __ANDROID__
-    SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+    g_android_native_present =
+        g_config.display.renderer == CONFIG_DISPLAY_RENDERER_VULKAN &&
+        g_config.display.vulkan.native_present;
+    SDL_WindowFlags window_flags = (SDL_WindowFlags)(
+        (g_android_native_present ? SDL_WINDOW_VULKAN : SDL_WINDOW_OPENGL) |
+        SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
 #else
     bool use_vulkan = (g_config.display.renderer == CONFIG_DISPLAY_RENDERER_VULKAN);
     SDL_WindowFlags window_flags = (SDL_WindowFlags)(
@@ -1088,6 +1140,15 @@ static void sdl2_display_very_early_init(DisplayOptions *o)
         SDL_SetWindowPosition(m_window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
     }
 
+#ifdef __ANDROID__
+    if (g_android_native_present) {
+        __android_log_print(ANDROID_LOG_INFO, "xemu-android",
+                            "sdl2_display_very_early_init: native Vulkan "
+                            "present, no GL context");
+        return;
+    }
+#endif
+
     m_context = SDL_GL_CreateContext(m_window);
 
 #ifndef __ANDROID__
@@ -1311,6 +1372,33 @@ static void register_sdl1(void)
 
 type_init(register_sdl1);
 
+/*
+ * Display thread BQL sections. These are kept to input, UI and device state
+ * work; acquiring and presenting the frame happens outside of them. Waits are
+ * attributed to each call site by the sync profiler ("sync-profile on", then
+ * "info sync-profile"), and hold time is added to the NV2A profile counters.
+ */
+static int64_t display_bql_acquired;
+
+#define display_bql_lock() display_bql_lock_impl(__FILE__, __LINE__)
+
+static void display_bql_lock_impl(const char *file, int line)
+{
+    qemu_mutex_lock_main_loop();
+    bql_lock_impl(file, line);
+    display_bql_acquired = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+}
+
+static void display_bql_unlock(void)
+{
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    /* Runs on the UI thread, not the FIFO thread that owns the counters */
+    qatomic_add(&g_nv2a_stats.frame_working.counters[NV2A_PROF_UI_BQL_HOLD_US],
+                (now - display_bql_acquired) / 1000);
+    bql_unlock();
+    qemu_mutex_unlock_main_loop();
+}
+
 #ifdef __ANDROID__
 void xemu_android_force_xemu_display_link(void)
 {
@@ -1325,6 +1413,11 @@ void xemu_android_display_preinit(void)
     initialized = true;
     sdl_render_thread_id = SDL_ThreadID();
     sdl2_display_very_early_init(NULL);
+    if (g_android_native_present) {
+        nv2a_android_early_context_init();
+        qemu_sem_init(&display_init_sem, 0);
+        return;
+    }
     if (SDL_GL_MakeCurrent(m_window, m_context) != 0) {
 #ifdef __ANDROID__
         __android_log_print(ANDROID_LOG_ERROR, "xemu-android",
@@ -1366,7 +1459,8 @@ void xemu_android_display_loop(void)
     if (sdl_render_thread_id == 0) {
         sdl_render_thread_id = SDL_ThreadID();
     }
-    if (SDL_GL_GetCurrentContext() != m_context) {
+    if (!g_android_native_present &&
+        SDL_GL_GetCurrentContext() != m_context) {
         if (SDL_GL_MakeCurrent(m_window, m_context) != 0) {
 #ifdef __ANDROID__
             __android_log_print(ANDROID_LOG_ERROR, "xemu-android",
@@ -1377,7 +1471,9 @@ void xemu_android_display_loop(void)
         }
     }
 #ifdef __ANDROID__
-    SDL_GL_SetSwapInterval(g_config.display.window.vsync ? 1 : 0);
+    if (!g_android_native_present) {
+        SDL_GL_SetSwapInterval(g_config.display.window.vsync ? 1 : 0);
+    }
     if (g_android_use_hud) {
         xemu_hud_init(m_window, m_context);
     }
@@ -1395,17 +1491,17 @@ void xemu_android_display_loop(void)
             break;
         }
         if (g_android_paused || sdl2_console[0].hidden) {
-            qemu_mutex_lock_main_loop();
-            bql_lock();
+            android_update_present_window(false);
+            display_bql_lock();
             sdl2_poll_events(&sdl2_console[0]);
-            bql_unlock();
-            qemu_mutex_unlock_main_loop();
+            display_bql_unlock();
             SDL_Delay(100);
             continue;
         }
         sdl2_gl_refresh(&sdl2_console[0].dcl);
 #ifdef __ANDROID__
-        if (!g_android_paused && SDL_GL_GetCurrentContext() != NULL) {
+        if (!g_android_paused && !g_android_native_present &&
+            SDL_GL_GetCurrentContext() != NULL) {
             android_log_gl_error("loop-end");
         }
 #else
@@ -1519,7 +1615,7 @@ void sdl2_gl_update(DisplayChangeListener *dcl,
     assert(scon->opengl);
 
 #ifdef __ANDROID__
-    if (!sdl2_is_render_thread()) {
+    if (!sdl2_is_render_thread() || g_android_native_present) {
         return;
     }
 #endif
@@ -1534,7 +1630,7 @@ void sdl2_gl_switch(DisplayChangeListener *dcl,
     DisplaySurface *old_surface = scon->surface;
     scon->surface = new_surface;
 #ifdef __ANDROID__
-    if (!sdl2_is_render_thread()) {
+    if (!sdl2_is_render_thread() || g_android_native_present) {
         return;
     }
 #endif
@@ -1566,6 +1662,144 @@ static void update_fps(void)
     fps = 1000.0/avg;
 }
 
+/*
+ * Tell nv2a which title is running, for per-title display settings. Reading
+ * the XBE header walks the guest page tables, so call this with the BQL held.
+ * Titles don't change often; check about once a second.
+ */
+static void update_title_id(void)
+{
+    static int64_t last_check = 0;
+    int64_t now = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+    if (now - last_check < 1000) {
+        return;
+    }
+    last_check = now;
+
+    struct xbe *xbe = xemu_get_xbe_info();
+    nv2a_set_title_id(xbe && xbe->cert ? xbe->cert->m_titleid : 0);
+}
+
+#ifdef __ANDROID__
+/* Hand the current native window to the renderer, or take it away */
+static void android_update_present_window(bool visible)
+{
+    if (!g_android_native_present) {
+        return;
+    }
+
+    void *window = NULL;
+    if (visible) {
+        SDL_SysWMinfo info;
+        SDL_VERSION(&info.version);
+        if (SDL_GetWindowWMInfo(m_window, &info)) {
+            window = info.info.android.window;
+        }
+    }
+    if (window == g_android_present_window) {
+        return;
+    }
+
+    bool active = nv2a_set_present_window(window);
+    __android_log_print(ANDROID_LOG_INFO, "xemu-android",
+                        "present window %p active=%d", window, active ? 1 : 0);
+    g_android_present_window = window;
+}
+
+static void android_native_refresh(struct sdl2_console *scon)
+{
+    update_fps();
+    g_android_frame_counter++;
+
+    display_bql_lock();
+    sdl2_poll_events(scon);
+    update_title_id();
+    /* Dispatches snapshot requests; thumbnails need GL and are skipped */
+    xemu_hud_render();
+    display_bql_unlock();
+
+    android_update_present_window(!g_android_paused);
+    if (g_android_paused) {
+        return;
+    }
+
+    float aspect_ratio = 0;
+    if (g_android_display_mode == 1) {
+        aspect_ratio = 4.0f / 3.0f;
+    } else if (g_android_display_mode == 2) {
+        aspect_ratio = 16.0f / 9.0f;
+    }
+    if (!nv2a_present_framebuffer(aspect_ratio) &&
+        (g_android_frame_counter % 120) == 0) {
+        __android_log_print(ANDROID_LOG_WARN, "xemu-android",
+                            "refresh: native present unavailable");
+    }
+}
+#endif
+
+static void sdl2_pace_frames(void)
+{
+    /*
+     * Pace presentation. Each present shows whatever the guest flipped to
+     * last, so this only decides how often that happens:
+     *  - vsync: once per guest VBLANK period
+     *  - mailbox: as often as the host display allows (swap interval)
+     *  - halve: every other guest VBLANK period, for steady frame times on
+     *    hosts that can't keep up with the full rate
+     */
+    static int64_t last_update = 0;
+    int64_t period = nv2a_get_vblank_period_ns();
+    switch (g_config.display.window.frame_pacing) {
+    case CONFIG_DISPLAY_WINDOW_FRAME_PACING_MAILBOX:
+        last_update = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+        return;
+    case CONFIG_DISPLAY_WINDOW_FRAME_PACING_HALVE:
+        period *= 2;
+        break;
+    default:
+        break;
+    }
+    int64_t deadline = last_update + period;
+
+#ifdef DEBUG_XEMU_C
+    int64_t sleep_acc = 0;
+    int64_t spin_acc = 0;
+#endif
+
+#ifdef __ANDROID__
+    const int64_t sleep_threshold = 500000;   // 0.5ms — Android CFS scheduler jitter is ~0.2ms
+#elif !defined(_WIN32)
+    const int64_t sleep_threshold = 2000000;
+#else
+    const int64_t sleep_threshold = 250000;
+#endif
+
+    while (1) {
+        int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+        int64_t time_remaining = deadline - now;
+        if (now < deadline) {
+            if (time_remaining > sleep_threshold) {
+                // Try to sleep until the until reaching the sleep threshold.
+                sleep_ns(time_remaining - sleep_threshold);
+#ifdef DEBUG_XEMU_C
+                sleep_acc += qemu_clock_get_ns(QEMU_CLOCK_REALTIME)-now;
+#endif
+            } else {
+                // Simply spin to avoid extra delays incurred with swapping to
+                // another process and back in the event of being within
+                // threshold to desired event.
+#ifdef DEBUG_XEMU_C
+                spin_acc++;
+#endif
+            }
+        } else {
+            DPRINTF("zzZz %g %ld\n", (double)sleep_acc/1000000.0, spin_acc);
+            last_update = now;
+            break;
+        }
+    }
+}
+
 void sdl2_gl_refresh(DisplayChangeListener *dcl)
 {
     struct sdl2_console *scon = container_of(dcl, struct sdl2_console, dcl);
@@ -1584,14 +1818,18 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
                                 g_android_paused ? 1 : 0,
                                 (int)runstate_get());
         }
-        qemu_mutex_lock_main_loop();
-        bql_lock();
+        android_update_present_window(false);
+        display_bql_lock();
         sdl2_poll_events(scon);
-        bql_unlock();
-        qemu_mutex_unlock_main_loop();
+        display_bql_unlock();
         SDL_Delay(100);
         return;
     }
+    if (g_android_native_present) {
+        android_native_refresh(scon);
+        sdl2_pace_frames();
+        return;
+    }
 #endif
     if (SDL_GL_MakeCurrent(scon->real_window, scon->winctx) != 0 ||
         SDL_GL_GetCurrentContext() == NULL) {
@@ -1601,11 +1839,9 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
                             SDL_GetError());
         g_android_paused = true;
 #endif
-        qemu_mutex_lock_main_loop();
-        bql_lock();
+        display_bql_lock();
         sdl2_poll_events(scon);
-        bql_unlock();
-        qemu_mutex_unlock_main_loop();
+        display_bql_unlock();
         SDL_Delay(16);
         return;
     }
@@ -1635,11 +1871,9 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
         }
     }
     bool force_cpu_blit = false;
-    if (force_cpu_blit_mode == -1) {
-        /* Vulkan path should prefer direct texture presentation on Android. */
+    if (force_cpu_blit_mode != 0) {
+        /* Only the OpenGL renderer reads back, Vulkan presents directly */
         force_cpu_blit = (g_config.display.renderer != CONFIG_DISPLAY_RENDERER_VULKAN);
-    } else {
-        force_cpu_blit = (force_cpu_blit_mode == 1);
     }
 #endif
 
@@ -1656,9 +1890,11 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
     GLuint tex = 0;
 #ifdef __ANDROID__
     if (force_cpu_blit) {
-        /* Trigger a render/sync so the readback buffer gets updated. */
+        /*
+         * Trigger a render/sync so the readback buffer gets updated. The
+         * reference is dropped with the others at the end of the refresh.
+         */
         (void)nv2a_get_framebuffer_surface();
-        nv2a_release_framebuffer_surface();
 
         int rb_w = 0;
         int rb_h = 0;
@@ -1717,12 +1953,12 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
     } else {
         tex = nv2a_get_framebuffer_surface();
         if (tex != 0 && glIsTexture(tex) == GL_FALSE) {
-            if ((g_android_frame_counter % 120) == 0) {
+            /* Not sharing objects with the render context, sample its EGLImage */
+            tex = android_import_framebuffer_image();
+            if (tex == 0 && (g_android_frame_counter % 120) == 0) {
                 __android_log_print(ANDROID_LOG_WARN, "xemu-android",
-                                    "refresh: nv2a tex %u not valid in display context",
-                                    (unsigned)tex);
+                                    "refresh: nv2a framebuffer not shareable");
             }
-            tex = 0;
         }
     }
 #else
@@ -1745,11 +1981,9 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
     if (tex == 0) {
 #ifdef __ANDROID__
         // Ensure the software VGA path updates the surface before uploading.
-        qemu_mutex_lock_main_loop();
-        bql_lock();
+        display_bql_lock();
         graphic_hw_update(scon->dcl.con);
-        bql_unlock();
-        qemu_mutex_unlock_main_loop();
+        display_bql_unlock();
 #endif
         // FIXME: Don't upload if notdirty
         xb_surface_gl_create_texture(scon->surface);
@@ -1768,19 +2002,22 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
     android_log_gl_error("refresh-create-texture");
 #endif
 
-    /* FIXME: Finer locking. Event handlers in segments of the code expect
-     * to be running on the main thread with the BQL. For now, acquire the
-     * lock and perform rendering, but release before swap to avoid
-     * possible lengthy blocking (for vsync).
-     */
-    qemu_mutex_lock_main_loop();
-    bql_lock();
-    sdl2_poll_events(scon);
-
     glClearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
 #ifdef __ANDROID__
     android_blit_frame(tex, flip_required);
+#endif
+
+    /* FIXME: Finer locking. Event handlers and the HUD expect to be running
+     * on the main thread with the BQL. The frame has already been acquired
+     * above without it; hold it only for input and UI work, and release
+     * before finishing and swapping, which may block on the GPU or vsync.
+     */
+    display_bql_lock();
+    sdl2_poll_events(scon);
+    update_title_id();
+
+#ifdef __ANDROID__
     /*
      * Android uses a HUD stub, but snapshot JNI requests are dispatched
      * from xemu_hud_render(). Keep this hook active each frame so save/load
@@ -1796,9 +2033,7 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
     xemu_hud_render();
 #endif
 
-    // Release BQL before swapping (which may sleep if swap interval is not immediate)
-    bql_unlock();
-    qemu_mutex_unlock_main_loop();
+    display_bql_unlock();
 
 #ifdef __ANDROID__
     glFlush();
@@ -1814,60 +2049,15 @@ void sdl2_gl_refresh(DisplayChangeListener *dcl)
     android_log_gl_error("refresh-swap");
 #endif
 
-    /* VGA update (see note above) + vblank */
-    qemu_mutex_lock_main_loop();
-    bql_lock();
+    /* VGA update (see note above). VBLANK is raised by the NV2A itself. */
+    display_bql_lock();
     graphic_hw_update(scon->dcl.con);
     if (scon->updates && scon->surface) {
         scon->updates = 0;
     }
-    bql_unlock();
-    qemu_mutex_unlock_main_loop();
-
-    /*
-     * Throttle to make sure swaps happen at 60Hz
-     */
-    static int64_t last_update = 0;
-    int64_t deadline = last_update + 16666666;
-
-#ifdef DEBUG_XEMU_C
-    int64_t sleep_acc = 0;
-    int64_t spin_acc = 0;
-#endif
-
-#ifdef __ANDROID__
-    const int64_t sleep_threshold = 500000;   // 0.5ms — Android CFS scheduler jitter is ~0.2ms
-#elif !defined(_WIN32)
-    const int64_t sleep_threshold = 2000000;
-#else
-    const int64_t sleep_threshold = 250000;
-#endif
-
-    while (1) {
-        int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
-        int64_t time_remaining = deadline - now;
-        if (now < deadline) {
-            if (time_remaining > sleep_threshold) {
-                // Try to sleep until the until reaching the sleep threshold.
-                sleep_ns(time_remaining - sleep_threshold);
-#ifdef DEBUG_XEMU_C
-                sleep_acc += qemu_clock_get_ns(QEMU_CLOCK_REALTIME)-now;
-#endif
-            } else {
-                // Simply spin to avoid extra delays incurred with swapping to
-                // another process and back in the event of being within
-                // threshold to desired event.
-#ifdef DEBUG_XEMU_C
-                spin_acc++;
-#endif
-            }
-        } else {
-            DPRINTF("zzZz %g %ld\n", (double)sleep_acc/1000000.0, spin_acc);
-            last_update = now;
-            break;
-        }
-    }
+    display_bql_unlock();
 
+    sdl2_pace_frames();
 }
 
 void sdl2_gl_redraw(struct sdl2_console *scon)
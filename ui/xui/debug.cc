@@ -360,6 +360,17 @@ void DebugVideoWindow::Draw()
             ImGui::TreeNode("Advanced");
 
         if (g_config.display.debug.video.advanced_tree_state) {
+            ImGui::SetNextWindowBgAlpha(alpha);
+            if (ImPlot::BeginPlot("Frame time (ms)", ImVec2(-1,100*g_viewport_mgr.m_scale))) {
+                ImPlot::SetupAxes(NULL, NULL, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                ImPlot::SetupAxisLimits(ImAxis_X1, 0, NV2A_PROF_FRAME_TIME_BUCKETS, ImPlotCond_Always);
+                ImPlot::PlotBars("##frame_time", g_nv2a_stats.frame_time_histogram, NV2A_PROF_FRAME_TIME_BUCKETS, 0.8, 0.5);
+                ImPlot::EndPlot();
+            }
+            if (ImGui::SmallButton("Reset frame times")) {
+                nv2a_profile_reset_frame_time_histogram();
+            }
+
             ImGui::SetNextWindowBgAlpha(alpha);
             if (ImPlot::BeginPlot("##ScrollingDraws", ImVec2(-1,-1))) {
                 ImPlot::SetupAxes(NULL, NULL, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
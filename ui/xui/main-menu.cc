@@ -67,6 +67,12 @@ void MainMenuGeneralView::Draw()
 
     Toggle("Cache shaders to disk", &g_config.perf.cache_shaders,
            "Reduce stutter in games by caching previously generated shaders");
+    Toggle("Compile shaders asynchronously", &g_config.perf.async_shader_compile,
+           "Skip draws while their shaders compile; may drop geometry");
+    Toggle("Pipeline GPU command processing", &g_config.perf.pipeline_fifo,
+           "Decode GPU command buffers on a separate thread (requires restart)");
+    Toggle("Yield CPU while waiting on GPU", &g_config.perf.yield_on_gpu_wait,
+           "Pause the emulated CPU when it is polling for GPU progress");
 
     SectionTitle("Miscellaneous");
     Toggle("Skip startup animation", &g_config.general.skip_boot_anim,
@@ -761,6 +767,29 @@ void MainMenuDisplayView::Draw()
                      "Increase surface scaling factor for higher quality")) {
         nv2a_set_surface_scale_factor(rendering_scale+1);
     }
+    Toggle("Dynamic resolution", &g_config.display.quality.dynamic_scale.enable,
+           "Vary internal resolution to hold the GPU frame time (Vulkan only)");
+    ChevronCombo("Upscaler", &g_config.display.quality.upscaler,
+                 "Off\0"
+                 "Sharpen\0"
+                 "Edge adaptive\0",
+                 "Upscale and sharpen the final image (Vulkan only)");
+    if (g_config.display.quality.upscaler !=
+        CONFIG_DISPLAY_QUALITY_UPSCALER_OFF) {
+        int upscale_factor = g_config.display.quality.upscale_factor - 1;
+        if (ChevronCombo("Upscale factor", &upscale_factor,
+                         "1x\0"
+                         "2x\0"
+                         "3x\0"
+                         "4x\0",
+                         "Output resolution relative to internal resolution")) {
+            g_config.display.quality.upscale_factor = upscale_factor + 1;
+        }
+        char buf[32];
+        snprintf(buf, sizeof(buf), "Sharpen edges (%d%%)",
+                 (int)(g_config.display.quality.sharpness * 100));
+        Slider("Sharpness", &g_config.display.quality.sharpness, buf);
+    }
 
     SectionTitle("Window");
     bool fs = xemu_is_fullscreen();
@@ -789,6 +818,11 @@ void MainMenuDisplayView::Draw()
     }
     Toggle("Vertical refresh sync", &g_config.display.window.vsync,
            "Sync to screen vertical refresh to reduce tearing artifacts");
+    ChevronCombo("Frame pacing", &g_config.display.window.frame_pacing,
+                 "Guest refresh rate\0"
+                 "Latest frame\0"
+                 "Half rate\0",
+                 "Select how often guest frames are presented");
 
     SectionTitle("Interface");
     Toggle("Show main menu bar", &g_config.display.ui.show_menubar,